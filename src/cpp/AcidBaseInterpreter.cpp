@@ -0,0 +1,71 @@
+#include "AcidBaseInterpreter.h"
+
+namespace AcidBaseInterpreter {
+
+void classifyBatch(const Batch &batch, Flags *flags, qsizetype count)
+{
+    // Straight-line body over plain arrays; the compiler vectorises it
+    const float *pH = batch.pH;
+    const float *pCO2 = batch.pCO2;
+    const float *pO2 = batch.pO2;
+    const float *hco3 = batch.HCO3;
+    const float *be = batch.BE;
+    for (qsizetype i = 0; i < count; ++i) {
+        flags[i] = detail::classify(pH[i], pCO2[i], pO2[i], hco3[i], be[i]);
+    }
+}
+
+Primary primary(Flags flags)
+{
+    if (flags & Unclassified) {
+        return Primary::Unclassified;
+    }
+    if (flags & Acidemia) {
+        if (flags & RespiratoryAcidosis) {
+            return Primary::RespiratoryAcidosis;
+        }
+        return (flags & MetabolicAcidosis) ? Primary::MetabolicAcidosis : Primary::MixedAcidosis;
+    }
+    if (flags & Alkalemia) {
+        if (flags & RespiratoryAlkalosis) {
+            return Primary::RespiratoryAlkalosis;
+        }
+        return (flags & MetabolicAlkalosis) ? Primary::MetabolicAlkalosis : Primary::MixedAlkalosis;
+    }
+    return Primary::NormalPH;
+}
+
+Compensation compensation(Flags flags)
+{
+    if (flags & FullyCompensated) {
+        return Compensation::FullyCompensated;
+    }
+    return (flags & PartiallyCompensated) ? Compensation::PartiallyCompensated : Compensation::Uncompensated;
+}
+
+const char *primaryName(Primary primary)
+{
+    switch (primary) {
+    case Primary::NormalPH: return "Normal pH";
+    case Primary::RespiratoryAcidosis: return "Respiratory Acidosis";
+    case Primary::MetabolicAcidosis: return "Metabolic Acidosis";
+    case Primary::MixedAcidosis: return "Mixed Acidosis";
+    case Primary::RespiratoryAlkalosis: return "Respiratory Alkalosis";
+    case Primary::MetabolicAlkalosis: return "Metabolic Alkalosis";
+    case Primary::MixedAlkalosis: return "Mixed Alkalosis";
+    case Primary::Unclassified: break;
+    }
+    return "Unclassified";
+}
+
+const char *compensationName(Compensation compensation)
+{
+    switch (compensation) {
+    case Compensation::FullyCompensated: return " (Fully Compensated)";
+    case Compensation::PartiallyCompensated: return " (Partially Compensated)";
+    case Compensation::Uncompensated: break;
+    }
+    return " (Uncompensated)";
+}
+
+} // namespace AcidBaseInterpreter
@@ -0,0 +1,98 @@
+#ifndef ACIDBASEINTERPRETER_H
+#define ACIDBASEINTERPRETER_H
+
+#include <QtGlobal>
+
+// Acid-base classification of a blood gas, as compact flags. Allocation
+// free, so new results are annotated inline and historical results can be
+// re-classified in bulk. Thresholds follow the prototype's interpretation.
+namespace AcidBaseInterpreter {
+
+enum Flag : quint16 {
+    Acidemia = 1 << 0,             // pH < 7.35
+    Alkalemia = 1 << 1,            // pH > 7.45
+    RespiratoryAcidosis = 1 << 2,  // pCO2 > 45
+    RespiratoryAlkalosis = 1 << 3, // pCO2 < 35
+    MetabolicAcidosis = 1 << 4,    // HCO3 < 22 or BE < -2
+    MetabolicAlkalosis = 1 << 5,   // HCO3 > 28 or BE > 2
+    FullyCompensated = 1 << 6,
+    PartiallyCompensated = 1 << 7,
+    Hypoxemia = 1 << 8,            // pO2 < 80
+    Hyperoxemia = 1 << 9,          // pO2 > 100
+    Unclassified = 1 << 15         // pH, pCO2 or HCO3 missing
+};
+using Flags = quint16;
+
+enum class Primary : quint8 {
+    NormalPH,
+    RespiratoryAcidosis,
+    MetabolicAcidosis,
+    MixedAcidosis,
+    RespiratoryAlkalosis,
+    MetabolicAlkalosis,
+    MixedAlkalosis,
+    Unclassified
+};
+
+enum class Compensation : quint8 {
+    Uncompensated,
+    PartiallyCompensated,
+    FullyCompensated
+};
+
+// Structure-of-arrays input for classifyBatch(); missing values are NaN
+struct Batch {
+    const float *pH;
+    const float *pCO2;
+    const float *pO2;
+    const float *HCO3;
+    const float *BE;
+};
+
+namespace detail {
+// One sample, with every condition computed as 0/1 and combined with
+// bitwise operators, so the batch loop has no data-dependent branches
+inline Flags classify(float pH, float pCO2, float pO2, float hco3, float be)
+{
+    const unsigned acid = pH < 7.35f;
+    const unsigned alk = pH > 7.45f;
+    const unsigned respAcid = pCO2 > 45.0f;
+    const unsigned respAlk = pCO2 < 35.0f;
+    const unsigned metAcid = (hco3 < 22.0f) | (be < -2.0f);
+    const unsigned metAlk = (hco3 > 28.0f) | (be > 2.0f);
+
+    const unsigned full = (acid & ((respAcid & (hco3 > 28.0f)) | (metAcid & (pCO2 < 35.0f)))) |
+                          (alk & ((respAlk & (hco3 < 22.0f)) | (metAlk & (pCO2 > 45.0f))));
+    // Acidemia and alkalemia already imply |pH - 7.4| > 0.05
+    const unsigned partial = (full ^ 1u) &
+                             ((acid & ((respAcid & (hco3 > 24.0f)) | (metAcid & (pCO2 < 40.0f)))) |
+                              (alk & ((respAlk & (hco3 < 24.0f)) | (metAlk & (pCO2 > 40.0f)))));
+
+    // NaN compares unequal to itself
+    const unsigned missing = (pH != pH) | (pCO2 != pCO2) | (hco3 != hco3);
+
+    return Flags(acid | alk << 1 | respAcid << 2 | respAlk << 3 | metAcid << 4 | metAlk << 5 |
+                 full << 6 | partial << 7 | unsigned(pO2 < 80.0f) << 8 | unsigned(pO2 > 100.0f) << 9 |
+                 missing << 15);
+}
+}
+
+inline Flags classify(double pH, double pCO2, double pO2, double hco3, double be)
+{
+    return detail::classify(float(pH), float(pCO2), float(pO2), float(hco3), float(be));
+}
+
+// Classifies count samples into flags[]
+void classifyBatch(const Batch &batch, Flags *flags, qsizetype count);
+
+Primary primary(Flags flags);
+Compensation compensation(Flags flags);
+
+// Static display strings, e.g. "Metabolic Acidosis (Partially Compensated)"
+// is primaryName() + compensationName()
+const char *primaryName(Primary primary);
+const char *compensationName(Compensation compensation);
+
+} // namespace AcidBaseInterpreter
+
+#endif // ACIDBASEINTERPRETER_H
@@ -0,0 +1,345 @@
+#include "AnalyteDistributions.h"
+#include "DatabaseManager.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSysInfo>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+const char *const ALL = "all";
+const char *const SHIFT = "shift";
+const char *const OPERATOR = "operator";
+const char *const DEVICE = "device";
+
+const std::pair<double, const char *> REPORTED_QUANTILES[] = {
+    {0.05, "p5"}, {0.25, "p25"}, {0.50, "p50"}, {0.75, "p75"}, {0.95, "p95"}
+};
+
+int analyteIndex(const QString &field)
+{
+    for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+        if (field == QLatin1String(ResultRules::ANALYTE_FIELDS[analyte])) {
+            return analyte;
+        }
+    }
+    return -1;
+}
+}
+
+AnalyteDistributions::AnalyteDistributions(DatabaseManager *dbManager, QObject *parent)
+    : QObject(parent)
+    , m_dbManager(dbManager)
+    , m_deviceId(deviceId())
+    , m_saveTimer(new QTimer(this))
+    , m_rebuilding(false)
+    , m_stopping(false)
+{
+    m_rebuildPool.setMaxThreadCount(1);
+    connect(m_saveTimer, &QTimer::timeout, this, &AnalyteDistributions::save);
+    m_saveTimer->start(SAVE_INTERVAL_MS);
+}
+
+AnalyteDistributions::~AnalyteDistributions()
+{
+    m_stopping.store(true);
+    m_rebuildPool.waitForDone();
+}
+
+void AnalyteDistributions::load()
+{
+    QVariantList rows;
+    for (const char *dimension : {ALL, OPERATOR, DEVICE}) {
+        rows += m_dbManager->loadQuantileSketches(dimension);
+    }
+    // Three shifts a day
+    const QDateTime since = QDateTime::currentDateTime().addDays(-(MAX_SHIFTS / 3));
+    rows += m_dbManager->loadQuantileSketches(SHIFT, shiftKey(since));
+
+    if (rows.isEmpty()) {
+        rebuild();
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    for (const QVariant &item : rows) {
+        const QVariantMap row = item.toMap();
+        const int analyte = analyteIndex(row.value("analyte").toString());
+        if (analyte < 0) {
+            continue;
+        }
+        Group &group = m_groups[{row.value("dimension").toString(), row.value("key").toString()}];
+        if (!group.sketches[analyte].deserialize(row.value("sketch").toByteArray())) {
+            qWarning() << "Discarded unreadable quantile sketch" << row.value("dimension").toString()
+                       << row.value("key").toString() << row.value("analyte").toString();
+        }
+    }
+    qDebug() << "Loaded" << rows.size() << "quantile sketches in" << m_groups.size() << "groups";
+}
+
+void AnalyteDistributions::addResult(const QVariantMap &result)
+{
+    QMutexLocker locker(&m_mutex);
+    add(m_groups, m_deviceId, result);
+    if (m_rebuilding) {
+        m_rebuildBacklog.append(result);
+    }
+}
+
+QString AnalyteDistributions::shiftKey(const QDateTime &time)
+{
+    const int hour = time.time().hour();
+    if (hour >= 7 && hour < 15) {
+        return time.date().toString(Qt::ISODate) + " Day";
+    }
+    if (hour >= 15 && hour < 23) {
+        return time.date().toString(Qt::ISODate) + " Evening";
+    }
+    // The night shift belongs to the day it starts on
+    const QDate start = hour < 7 ? time.date().addDays(-1) : time.date();
+    return start.toString(Qt::ISODate) + " Night";
+}
+
+QString AnalyteDistributions::deviceId()
+{
+    return qEnvironmentVariable("BGA_DEVICE_ID", QSysInfo::machineHostName());
+}
+
+QVariantMap AnalyteDistributions::quantiles(const QString &analyte, const QString &dimension,
+                                            const QStringList &keys) const
+{
+    QVariantMap summary;
+    summary["count"] = 0;
+    const int index = analyteIndex(analyte);
+    if (index < 0) {
+        return summary;
+    }
+
+    QuantileSketch merged;
+    QStringList saved;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (const QString &key : keys) {
+            const auto found = m_groups.constFind({dimension, key});
+            if (found == m_groups.cend()) {
+                saved.append(key);
+                continue;
+            }
+            merged.merge(found->sketches[index]);
+        }
+    }
+    for (const QString &key : std::as_const(saved)) {
+        QuantileSketch sketch;
+        if (loadSketch(dimension, key, index, sketch)) {
+            merged.merge(sketch);
+        }
+    }
+
+    if (merged.isEmpty()) {
+        return summary;
+    }
+    summary["count"] = merged.count();
+    summary["min"] = merged.min();
+    summary["max"] = merged.max();
+    for (const auto &[q, name] : REPORTED_QUANTILES) {
+        summary[name] = merged.quantile(q);
+    }
+    return summary;
+}
+
+QStringList AnalyteDistributions::keys(const QString &dimension) const
+{
+    QStringList keys = m_dbManager->getQuantileSketchKeys(dimension);
+    {
+        QMutexLocker locker(&m_mutex);
+        for (auto it = m_groups.cbegin(); it != m_groups.cend(); ++it) {
+            if (it.key().first == dimension) {
+                keys.append(it.key().second);
+            }
+        }
+    }
+    keys.sort();
+    keys.removeDuplicates();
+    return keys;
+}
+
+bool AnalyteDistributions::save()
+{
+    QVariantList rows;
+    QList<GroupKey> saved;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (auto it = m_groups.begin(); it != m_groups.end(); ++it) {
+            if (!it->dirty) {
+                continue;
+            }
+            for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+                const QuantileSketch &sketch = it->sketches[analyte];
+                if (sketch.isEmpty()) {
+                    continue;
+                }
+                QVariantMap row;
+                row["dimension"] = it.key().first;
+                row["key"] = it.key().second;
+                row["analyte"] = ResultRules::ANALYTE_FIELDS[analyte];
+                row["count"] = sketch.count();
+                row["sketch"] = sketch.serialize();
+                rows.append(row);
+            }
+            it->dirty = false;
+            saved.append(it.key());
+        }
+    }
+
+    const bool ok = m_dbManager->saveQuantileSketches(rows);
+
+    QMutexLocker locker(&m_mutex);
+    if (!ok) {
+        // Tried again on the next save
+        for (const GroupKey &key : std::as_const(saved)) {
+            const auto found = m_groups.find(key);
+            if (found != m_groups.end()) {
+                found->dirty = true;
+            }
+        }
+        return false;
+    }
+    evictShifts();
+    return true;
+}
+
+bool AnalyteDistributions::rebuild()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_rebuilding) {
+            return false;
+        }
+        m_rebuilding = true;
+        m_rebuildBacklog.clear();
+    }
+
+    m_rebuildPool.start([this, deviceId = m_deviceId]() {
+        QElapsedTimer timer;
+        timer.start();
+
+        Groups groups;
+        qint64 lastId = 0;
+        int resultCount = 0;
+        bool ok = false;
+        {
+            // SQLite connections are per thread, so the rebuild opens its own
+            DatabaseManager database;
+            ok = database.openConnection("distributions");
+            while (ok && !m_stopping.load()) {
+                const QVariantList results = database.getResultsAfter(lastId, REBUILD_CHUNK);
+                if (results.isEmpty()) {
+                    break;
+                }
+                for (const QVariant &result : results) {
+                    add(groups, deviceId, result.toMap());
+                }
+                lastId = results.last().toMap().value("id").toLongLong();
+                resultCount += int(results.size());
+            }
+        }
+        if (m_stopping.load()) {
+            return;
+        }
+        qDebug() << "Read" << resultCount << "results for the analyte distributions in" << timer.elapsed() << "ms";
+        QMetaObject::invokeMethod(this, [this, groups = std::move(groups), lastId, resultCount, ok]() mutable {
+            finishRebuild(std::move(groups), lastId, resultCount, ok);
+        });
+    });
+    return true;
+}
+
+void AnalyteDistributions::finishRebuild(Groups groups, qint64 lastId, int resultCount, bool ok)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_rebuilding = false;
+        if (ok) {
+            // Results the rebuild did not read, saved after it had passed them
+            for (const QVariantMap &result : std::as_const(m_rebuildBacklog)) {
+                if (result.value("id").toLongLong() > lastId) {
+                    add(groups, m_deviceId, result);
+                }
+            }
+            m_groups = std::move(groups);
+        }
+        m_rebuildBacklog.clear();
+    }
+    if (!ok) {
+        qWarning() << "Analyte distributions not rebuilt: no database connection";
+        return;
+    }
+
+    if (!m_dbManager->clearQuantileSketches() || !save()) {
+        qWarning() << "Rebuilt analyte distributions not saved";
+    }
+    emit rebuilt(resultCount);
+}
+
+void AnalyteDistributions::add(Groups &groups, const QString &deviceId, const QVariantMap &result)
+{
+    std::array<float, ResultRules::ANALYTE_COUNT> values;
+    for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+        const QVariant value = result.value(ResultRules::ANALYTE_FIELDS[analyte]);
+        values[analyte] = value.isValid() && !value.isNull() ? value.toFloat()
+                                                              : std::numeric_limits<float>::quiet_NaN();
+    }
+
+    // Stored results do not record the device; they are all this one's
+    QList<GroupKey> keys = {{ALL, ALL}, {DEVICE, deviceId}};
+    const QDateTime time = QDateTime::fromString(result.value("timestamp").toString(), Qt::ISODate);
+    if (time.isValid()) {
+        keys.append({SHIFT, shiftKey(time)});
+    }
+    const QString operatorName = result.value("operator").toString();
+    if (!operatorName.isEmpty()) {
+        keys.append({OPERATOR, operatorName});
+    }
+
+    for (const GroupKey &key : std::as_const(keys)) {
+        Group &group = groups[key];
+        for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+            group.sketches[analyte].add(values[analyte]);
+        }
+        group.dirty = true;
+    }
+}
+
+void AnalyteDistributions::evictShifts()
+{
+    // Keys sort by date, then Day, Evening, Night: oldest first
+    QStringList shifts;
+    for (auto it = m_groups.cbegin(); it != m_groups.cend(); ++it) {
+        if (it.key().first == QLatin1String(SHIFT) && !it->dirty) {
+            shifts.append(it.key().second);
+        }
+    }
+    if (shifts.size() <= MAX_SHIFTS) {
+        return;
+    }
+    shifts.sort();
+    for (qsizetype i = 0; i < shifts.size() - MAX_SHIFTS; ++i) {
+        m_groups.remove({SHIFT, shifts.at(i)});
+    }
+}
+
+bool AnalyteDistributions::loadSketch(const QString &dimension, const QString &key, int analyte,
+                                      QuantileSketch &sketch) const
+{
+    const QVariantList rows = m_dbManager->loadQuantileSketches(dimension, key, key);
+    for (const QVariant &item : rows) {
+        const QVariantMap row = item.toMap();
+        if (row.value("analyte").toString() == QLatin1String(ResultRules::ANALYTE_FIELDS[analyte])) {
+            return sketch.deserialize(row.value("sketch").toByteArray());
+        }
+    }
+    return false;
+}
@@ -0,0 +1,105 @@
+#ifndef ANALYTEDISTRIBUTIONS_H
+#define ANALYTEDISTRIBUTIONS_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVariantMap>
+
+#include <array>
+#include <atomic>
+
+#include "QuantileSketch.h"
+#include "ResultRules.h"
+
+class DatabaseManager;
+
+// Distribution of each analyte over all results and by shift, operator
+// and device, for the supervisors' dashboards. Every saved result adds
+// its values to one quantile sketch per analyte in each dimension, so a
+// query reads a sketch instead of the results. Changed sketches are
+// saved every few minutes; the most recent MAX_SHIFTS shifts stay in
+// memory and older ones are read back when asked for.
+// addResult() is thread-safe; the rest runs on the main thread, except
+// that rebuild() reads the results on a worker thread.
+class AnalyteDistributions : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AnalyteDistributions(DatabaseManager *dbManager, QObject *parent = nullptr);
+    ~AnalyteDistributions();
+
+    // Reads the saved sketches; builds them from the stored results when
+    // none were saved yet
+    void load();
+    void addResult(const QVariantMap &result);
+
+    // Day 07-15, Evening 15-23, Night 23-07 under the date it starts on,
+    // as "yyyy-MM-dd Day"
+    static QString shiftKey(const QDateTime &time);
+    // BGA_DEVICE_ID, or the host name
+    static QString deviceId();
+
+public slots:
+    // count, min, max, p5, p25, p50, p75 and p95 of the analyte (a result
+    // field) in the dimension ("all", "shift", "operator" or "device"),
+    // merged over the keys when there are several; count 0 when none
+    Q_INVOKABLE QVariantMap quantiles(const QString &analyte, const QString &dimension,
+                                      const QStringList &keys) const;
+    // Keys with results, in memory or saved, sorted
+    Q_INVOKABLE QStringList keys(const QString &dimension) const;
+    Q_INVOKABLE QString currentShift() const { return shiftKey(QDateTime::currentDateTime()); }
+    Q_INVOKABLE bool save();
+    // From the stored results; sketches cannot take values out, so this
+    // is how deleted results leave them. The results are read on a worker
+    // thread and the new sketches swapped in, with the results saved
+    // meanwhile, when done. False when a rebuild is already running.
+    Q_INVOKABLE bool rebuild();
+
+signals:
+    void rebuilt(int resultCount);
+
+private:
+    using Sketches = std::array<QuantileSketch, ResultRules::ANALYTE_COUNT>;
+    using GroupKey = QPair<QString, QString>; // dimension, key
+
+    struct Group {
+        Sketches sketches;
+        bool dirty = false;
+    };
+    using Groups = QHash<GroupKey, Group>;
+
+    static void add(Groups &groups, const QString &deviceId, const QVariantMap &result);
+    // On the main thread, with the worker's sketches and the last result
+    // id it read
+    void finishRebuild(Groups groups, qint64 lastId, int resultCount, bool ok);
+    void evictShifts();
+    // A group's saved sketch, when it is not in memory
+    bool loadSketch(const QString &dimension, const QString &key, int analyte,
+                    QuantileSketch &sketch) const;
+
+    DatabaseManager *m_dbManager;
+    QString m_deviceId;
+    QTimer *m_saveTimer;
+
+    mutable QMutex m_mutex;
+    Groups m_groups;
+    bool m_rebuilding;
+    // Results added while a rebuild runs
+    QList<QVariantMap> m_rebuildBacklog;
+
+    QThreadPool m_rebuildPool;
+    std::atomic<bool> m_stopping;
+
+    static const int MAX_SHIFTS = 93; // a month
+    static const int SAVE_INTERVAL_MS = 5 * 60 * 1000;
+    static const int REBUILD_CHUNK = 4096;
+};
+
+#endif // ANALYTEDISTRIBUTIONS_H
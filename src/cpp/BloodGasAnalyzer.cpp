@@ -1,23 +1,73 @@
 #include "BloodGasAnalyzer.h"
 #include "HistoricalDataModel.h"
+#include "TrendModel.h"
+#include "AnalyteDistributions.h"
+#include "PatientDriftMonitor.h"
 #include "DatabaseManager.h"
 #include "AuthenticationManager.h"
 #include "CalibrationManager.h"
+#include "QcEngine.h"
 #include "HL7Manager.h"
+#include "OrderWorklist.h"
+#include "SampleQueueModel.h"
+#include "ResultPipeline.h"
+#include "SensorDevice.h"
+#include "SignalProcessor.h"
+#include "ResultRules.h"
+#include "ReflagJob.h"
+#include "PatientHistoryWorker.h"
 
 #include <QDebug>
 #include <QTimer>
 #include <QDateTime>
 #include <QRandomGenerator>
 
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <memory>
+
+namespace {
+// Sensor channel groups in the order they settle, as a fraction of the
+// measurement time; firstField tells whether a group has been read
+struct ChannelGroup {
+    const char *name;
+    const char *firstField;
+    double settleFraction;
+};
+
+const ChannelGroup CHANNEL_GROUPS[] = {
+    {"bloodGas", "pH", 0.4},
+    {"electrolytes", "Na", 0.7},
+    {"metabolites", "Glucose", 1.0},
+};
+
+const int CHANNEL_GROUP_COUNT = int(std::size(CHANNEL_GROUPS));
+}
+
 BloodGasAnalyzer::BloodGasAnalyzer(QObject *parent)
     : QObject(parent)
     , m_historicalDataModel(nullptr)
+    , m_trendModel(nullptr)
+    , m_analyteDistributions(nullptr)
     , m_databaseManager(nullptr)
     , m_authManager(nullptr)
     , m_calibrationManager(nullptr)
     , m_hl7Manager(nullptr)
+    , m_orderWorklist(nullptr)
+    , m_sampleQueue(nullptr)
+    , m_resultPipeline(nullptr)
+    , m_reflagJob(nullptr)
+    , m_driftMonitor(nullptr)
+    , m_historyWorker(nullptr)
+    , m_sensorDevice(nullptr)
+    , m_signalProcessor(nullptr)
     , m_analysisTimer(new QTimer(this))
+    , m_progressTimer(new QTimer(this))
+    , m_channelTimer(new QTimer(this))
+    , m_measurementDurationMs(0)
+    , m_measuringId(0)
+    , m_nextChannelGroup(0)
     , m_isAnalyzing(false)
     , m_isCalibrated(false)
 {
@@ -26,11 +76,27 @@ BloodGasAnalyzer::BloodGasAnalyzer(QObject *parent)
     // Setup analysis timer
     m_analysisTimer->setSingleShot(true);
     connect(m_analysisTimer, &QTimer::timeout, this, &BloodGasAnalyzer::onAnalysisTimeout);
+    connect(m_progressTimer, &QTimer::timeout, this, &BloodGasAnalyzer::onProgressTick);
+    m_channelTimer->setSingleShot(true);
+    connect(m_channelTimer, &QTimer::timeout, this, &BloodGasAnalyzer::onChannelSettled);
 }
 
 BloodGasAnalyzer::~BloodGasAnalyzer()
 {
-    // Cleanup is handled by Qt's parent-child relationship
+    // Stage handlers use the components below, so the pipeline threads
+    // are joined before Qt's parent-child cleanup deletes them
+    m_resultPipeline->stop();
+    // Results persisted since the last periodic save
+    m_analyteDistributions->save();
+    m_driftMonitor->save();
+    m_sensorThread.quit();
+    m_sensorThread.wait();
+    // The device feeds the processor, so it goes first
+    m_signalThread.quit();
+    m_signalThread.wait();
+    // The worker uses the patient cache, which goes with this object
+    m_historyThread.quit();
+    m_historyThread.wait();
 }
 
 void BloodGasAnalyzer::initializeComponents()
@@ -41,6 +107,11 @@ void BloodGasAnalyzer::initializeComponents()
     // Create historical data model
     m_historicalDataModel = new HistoricalDataModel(m_databaseManager, this);
     
+    // Create trend model; series are read when a chart first asks for them
+    m_trendModel = new TrendModel(this);
+    connect(m_historicalDataModel, &HistoricalDataModel::resultRemoved, m_trendModel, &TrendModel::reload);
+    connect(m_historicalDataModel, &HistoricalDataModel::cleared, m_trendModel, &TrendModel::reload);
+    
     // Create authentication manager
     m_authManager = new AuthenticationManager(m_databaseManager, this);
     connect(m_authManager, &AuthenticationManager::userLoggedIn, 
@@ -56,107 +127,629 @@ void BloodGasAnalyzer::initializeComponents()
     // Create HL7 manager
     m_hl7Manager = new HL7Manager(this);
     
+    // Create order worklist, fed by inbound HL7 order and ADT messages
+    m_orderWorklist = new OrderWorklist(m_databaseManager, this);
+    // The sender's ACK waits until the message has been applied and saved
+    connect(m_hl7Manager, &HL7Manager::inboundMessageReceived, this,
+            [this](quint64 inboundId, const QVariantMap &decoded) {
+                m_hl7Manager->acknowledgeInbound(inboundId, m_orderWorklist->applyMessage(decoded));
+            });
+    
+    // Create sample queue
+    m_sampleQueue = new SampleQueueModel(this);
+    connect(m_sampleQueue, &SampleQueueModel::sampleCancelled,
+            this, &BloodGasAnalyzer::onSampleCancelled);
+    
     // Initialize database
     if (!m_databaseManager->initializeDatabase()) {
         qWarning() << "Failed to initialize database";
+    } else if (!m_calibrationManager->qcEngine()->load()) {
+        // Without it patient analysis stays locked, as it does without a database
+        qWarning() << "Failed to load QC history";
+    }
+    
+    reloadReferenceRanges();
+    m_patientCache.warm(m_databaseManager->getRecentPatientResults(
+        PatientResultCache::HISTORY_SIZE, m_patientCache.capacity() * PatientResultCache::HISTORY_SIZE));
+    
+    // Before the pipeline starts adding to it
+    m_analyteDistributions = new AnalyteDistributions(m_databaseManager, this);
+    m_analyteDistributions->load();
+    
+    // Patient-based QC; a drifting channel asks for its recalibration,
+    // which restarts the drift statistics it covers
+    m_driftMonitor = new PatientDriftMonitor(m_databaseManager, this);
+    connect(m_driftMonitor, &PatientDriftMonitor::driftDetected, this,
+            [this](const QString &, int, const QString &calibrationType, const QString &reason) {
+                m_calibrationManager->recommendRecalibration(calibrationType, reason);
+            });
+    connect(m_calibrationManager, &CalibrationManager::calibrationCompleted, this, [this](bool success) {
+        if (success) {
+            m_driftMonitor->reset(m_calibrationManager->calibrationType());
+        }
+    });
+    // A drift saved before the restart is reported again
+    m_driftMonitor->load();
+    
+    setupResultPipeline();
+    
+    m_historyWorker = new PatientHistoryWorker(&m_patientCache);
+    m_historyWorker->moveToThread(&m_historyThread);
+    connect(&m_historyThread, &QThread::finished, m_historyWorker, &QObject::deleteLater);
+    connect(m_historyWorker, &PatientHistoryWorker::fetched,
+            this, &BloodGasAnalyzer::onPatientHistoryFetched);
+    m_historyThread.setObjectName("Patient history");
+    m_historyThread.start();
+    
+    // Stored results flagged under an older rule set are re-flagged in the
+    // background; an interrupted run resumes where it stopped
+    m_reflagJob = new ReflagJob(this);
+    connect(this, &BloodGasAnalyzer::isAnalyzingChanged, m_reflagJob, &ReflagJob::setThrottled);
+    m_reflagJob->start();
+    
+    // Create the sensor board link; BGA_SENSOR_DEVICE names a tty or the simulator's pty
+    m_signalProcessor = new SignalProcessor;
+    m_sensorDevice = new SensorDevice(m_signalProcessor);
+    m_signalProcessor->moveToThread(&m_signalThread);
+    m_sensorDevice->moveToThread(&m_sensorThread);
+    connect(&m_signalThread, &QThread::finished, m_signalProcessor, &QObject::deleteLater);
+    connect(&m_sensorThread, &QThread::finished, m_sensorDevice, &QObject::deleteLater);
+    connect(m_sensorDevice, &SensorDevice::deviceError, this, &BloodGasAnalyzer::analysisError);
+    connect(m_signalProcessor, &SignalProcessor::channelSettled,
+            this, &BloodGasAnalyzer::onSensorChannelSettled);
+    connect(m_signalProcessor, &SignalProcessor::traceFinished,
+            this, &BloodGasAnalyzer::onTraceFinished);
+    
+    // Each electrode converts with its two-point calibration once it has
+    // one; until then its values are marked uncalibrated
+    auto applyCalibration = [this](int channel, double slope, double offset) {
+        QMetaObject::invokeMethod(m_signalProcessor, [processor = m_signalProcessor, channel, slope, offset]() {
+            processor->setCalibration(channel, slope, offset);
+        }, Qt::QueuedConnection);
+    };
+    connect(m_calibrationManager, &CalibrationManager::electrodeCalibrated, this, applyCalibration);
+    const auto calibrations = m_calibrationManager->electrodeCalibrations();
+    for (auto it = calibrations.cbegin(); it != calibrations.cend(); ++it) {
+        applyCalibration(it.key(), it->slope, it->offset);
     }
+    auto mergeStats = [this](const QVariantMap &stats) {
+        m_sensorStats.insert(stats);
+        emit sensorStatsChanged();
+    };
+    connect(m_sensorDevice, &SensorDevice::statsChanged, this, mergeStats);
+    connect(m_signalProcessor, &SignalProcessor::statsChanged, this, mergeStats);
+    m_signalThread.setObjectName("Signal processing");
+    m_signalThread.start();
+    m_sensorThread.setObjectName("Sensor I/O");
+    m_sensorThread.start();
     
-    // Load historical data
+    const QString sensorPath = qEnvironmentVariable("BGA_SENSOR_DEVICE");
+    if (!sensorPath.isEmpty()) {
+        attachSensorDevice(sensorPath);
+    }
+    
+    // Load historical data and the persisted worklist
     m_historicalDataModel->loadData();
+    m_orderWorklist->loadWorklist();
+    
+    // Inbound orders are opt-in, on one local address and from the allowed
+    // peers only (loopback when none are listed)
+    const QString listenAddress = qEnvironmentVariable("BGA_HL7_LISTEN_ADDRESS");
+    if (!listenAddress.isEmpty()) {
+        bool ok = false;
+        int port = qEnvironmentVariableIntValue("BGA_HL7_LISTEN_PORT", &ok);
+        if (!ok) {
+            port = HL7Manager::DEFAULT_LISTENER_PORT;
+        }
+        const QStringList allowedPeers = qEnvironmentVariable("BGA_HL7_ALLOWED_PEERS").split(',', Qt::SkipEmptyParts);
+        m_hl7Manager->startListener(listenAddress, port, allowedPeers);
+    }
 }
 
-void BloodGasAnalyzer::startAnalysis(const QVariantMap &sampleData)
+void BloodGasAnalyzer::setupResultPipeline()
 {
-    if (m_isAnalyzing) {
-        qWarning() << "Analysis already in progress";
-        return;
-    }
+    // acquisition -> compute -> persist -> transmit, one thread per stage.
+    // The UI takes results from compute, so a slow disk or HL7 link never
+    // delays display; it only shows up as backpressure in the stage stats.
+    m_resultPipeline = new ResultPipeline(this);
+    connect(m_resultPipeline, &ResultPipeline::itemFailed,
+            this, &BloodGasAnalyzer::onPipelineItemFailed);
+    
+    m_resultPipeline->addStage("acquisition", [](PipelineItem &item) {
+        completeChannelReadings(item.results);
+        return true;
+    });
+    
+    m_resultPipeline->addStage("compute", [this, database = std::shared_ptr<DatabaseManager>()](PipelineItem &item) mutable {
+        computeResults(item.sampleData, item.results);
+        // Against the patient's previous results, before anything is stored.
+        // A patient the cache does not know is read first, on the stage's
+        // own connection; without one the result is marked unchecked.
+        const QString patientId = item.results.value("patientId").toString();
+        if (!patientId.isEmpty() && !m_patientCache.contains(patientId)) {
+            if (!database) {
+                auto opened = std::make_shared<DatabaseManager>();
+                if (opened->openConnection("compute")) {
+                    database = opened;
+                } else {
+                    qWarning() << "Compute stage cannot open its database connection";
+                }
+            }
+            if (database) {
+                m_patientCache.seed(patientId, PatientResultCache::entries(
+                    database->getResultsByPatient(patientId, PatientResultCache::HISTORY_SIZE)));
+            }
+        }
+        m_patientCache.checkAndAdd(item.results);
+        QMetaObject::invokeMethod(this, [this, queueId = item.queueId, results = item.results]() {
+            onResultComputed(queueId, results);
+        });
+        return true;
+    });
     
+    // SQLite connections are per thread, so the persist stage opens its own
+    m_resultPipeline->addStage("persist", [this, database = std::shared_ptr<DatabaseManager>()](PipelineItem &item) mutable {
+        // The main connection has set the schema up; a failed open is tried
+        // again with the next result
+        if (!database) {
+            auto opened = std::make_shared<DatabaseManager>();
+            if (!opened->openConnection("persist")) {
+                qWarning() << "Persist stage cannot open its database connection";
+                return false;
+            }
+            database = opened;
+        }
+        const int id = database->insertResult(item.results);
+        if (id < 0) {
+            return false;
+        }
+        item.results["id"] = id;
+        m_analyteDistributions->addResult(item.results);
+        // The result stands without its traces, so this is not fatal
+        if (!item.waveform.isEmpty()) {
+            database->saveWaveform(id, item.waveform);
+        }
+        QMetaObject::invokeMethod(this, [this, queueId = item.queueId, results = item.results]() {
+            onResultPersisted(queueId, results);
+        });
+        return true;
+    });
+    
+    // Only hands the result to the HL7 I/O thread's lock-free intake
+    m_resultPipeline->addStage("transmit", [this](PipelineItem &item) {
+        m_hl7Manager->sendResults(item.results);
+        return true;
+    });
+    
+    m_resultPipeline->start();
+}
+
+int BloodGasAnalyzer::startAnalysis(const QVariantMap &sampleData)
+{
     if (m_currentUser.isEmpty()) {
         emit analysisError("No user logged in");
-        return;
+        return 0;
     }
     
     if (!m_isCalibrated) {
         emit analysisError("Device not calibrated");
-        return;
+        return 0;
+    }
+    
+    if (!m_calibrationManager->qcEngine()->isLoaded()) {
+        emit analysisError("Quality control history could not be read; patient analysis is locked");
+        return 0;
     }
     
-    m_currentSampleData = sampleData;
-    m_isAnalyzing = true;
-    emit isAnalyzingChanged(true);
+    // Until a corrective action is recorded for the rejected control run
+    if (m_calibrationManager->qcEngine()->isLocked()) {
+        emit analysisError("Quality control rejected; record a corrective action before analyzing");
+        return 0;
+    }
     
-    // Simulate analysis time (3-5 seconds)
-    int analysisTime = 3000 + QRandomGenerator::global()->bounded(2000);
-    m_analysisTimer->start(analysisTime);
+    // Samples are accepted while another one is being measured; the
+    // operator is recorded now, not when the result is computed
+    QVariantMap queuedData = sampleData;
+    queuedData["operator"] = m_currentUser;
+    int queueId = m_sampleQueue->enqueue(queuedData);
+    qDebug() << "Queued sample" << queueId << ":" << sampleData;
     
-    qDebug() << "Started analysis for sample:" << sampleData;
+    // Also covers patients set from an order rather than typed in
+    prefetchPatientHistory(sampleData.value("patientId").toString());
+    
+    startNextMeasurement();
+    updateAnalyzingState();
+    return queueId;
 }
 
 void BloodGasAnalyzer::stopAnalysis()
 {
     if (!m_isAnalyzing)
         return;
-        
-    m_analysisTimer->stop();
-    m_isAnalyzing = false;
-    emit isAnalyzingChanged(false);
+    
+    // Cancels the sample being measured and everything still queued;
+    // samples already measured finish processing
+    m_sampleQueue->cancelAll();
     
     qDebug() << "Analysis stopped by user";
 }
 
+void BloodGasAnalyzer::startNextMeasurement()
+{
+    if (m_measuringId != 0) {
+        return;
+    }
+    
+    int queueId = m_sampleQueue->nextQueued();
+    if (queueId == 0) {
+        return;
+    }
+    
+    m_measuringId = queueId;
+    m_sampleQueue->setState(queueId, SampleQueueModel::Measuring);
+    
+    // Simulate analysis time (3-5 seconds)
+    m_measurementDurationMs = 3000 + QRandomGenerator::global()->bounded(2000);
+    m_measurementClock.start();
+    m_analysisTimer->start(m_measurementDurationMs);
+    m_progressTimer->start(PROGRESS_INTERVAL_MS);
+    
+    // Channel groups are published as they settle; the last one settles
+    // with the measurement itself
+    const QVariantMap sampleData = m_sampleQueue->sampleData(queueId);
+    m_nextChannelGroup = 0;
+    m_channelReadings.clear();
+    m_settledValues.clear();
+    m_liveResults = QVariantMap{{"queueId", queueId},
+                                {"sampleId", sampleData.value("sampleId")},
+                                {"patientId", sampleData.value("patientId")},
+                                {"complete", false}};
+    ResultRules::addDemographics(m_liveResults, sampleData);
+    emit liveResultsChanged();
+    scheduleNextChannelGroup();
+    QMetaObject::invokeMethod(m_sensorDevice, [device = m_sensorDevice, queueId]() {
+        device->startMeasurement(queueId);
+    });
+    
+    qDebug() << "Started analysis for sample" << queueId;
+}
+
+void BloodGasAnalyzer::onProgressTick()
+{
+    if (m_measuringId == 0) {
+        m_progressTimer->stop();
+        return;
+    }
+    
+    int progress = int(m_measurementClock.elapsed() * 100 / qMax(1, m_measurementDurationMs));
+    m_sampleQueue->setProgress(m_measuringId, qMin(progress, 99));
+}
+
+void BloodGasAnalyzer::onSampleCancelled(int queueId)
+{
+    if (queueId == m_measuringId) {
+        m_analysisTimer->stop();
+        m_progressTimer->stop();
+        m_channelTimer->stop();
+        QMetaObject::invokeMethod(m_sensorDevice, &SensorDevice::stopMeasurement);
+        m_measuringId = 0;
+        startNextMeasurement();
+    }
+    updateAnalyzingState();
+}
+
+void BloodGasAnalyzer::failMeasurement(const QString &error)
+{
+    m_analysisTimer->stop();
+    m_progressTimer->stop();
+    m_channelTimer->stop();
+    QMetaObject::invokeMethod(m_sensorDevice, &SensorDevice::stopMeasurement);
+    m_sampleQueue->setState(m_measuringId, SampleQueueModel::Failed, error);
+    m_measuringId = 0;
+    emit analysisError(error);
+    
+    startNextMeasurement();
+    updateAnalyzingState();
+}
+
 void BloodGasAnalyzer::onAnalysisTimeout()
 {
-    if (!m_isAnalyzing)
+    if (m_measuringId == 0)
         return;
     
-    // Simulate analysis results
-    QVariantMap results = simulateAnalysis(m_currentSampleData);
-    m_lastResults = results;
+    // Whatever has not been published yet settles now
+    m_channelTimer->stop();
+    while (m_nextChannelGroup < CHANNEL_GROUP_COUNT) {
+        if (!publishChannelGroup(m_nextChannelGroup++)) {
+            return;
+        }
+    }
+    
+    int queueId = m_measuringId;
+    m_measuringId = 0;
+    m_progressTimer->stop();
+    QMetaObject::invokeMethod(m_sensorDevice, &SensorDevice::stopMeasurement);
+    m_sampleQueue->setState(queueId, SampleQueueModel::Processing);
+    
+    // The result goes down the pipeline with its raw traces
+    m_awaitingTrace.insert(queueId, m_channelReadings);
+    QMetaObject::invokeMethod(m_signalProcessor, [processor = m_signalProcessor, queueId]() {
+        processor->finishTrace(queueId);
+    });
+    
+    // The measuring channel is free again
+    startNextMeasurement();
+}
+
+void BloodGasAnalyzer::onTraceFinished(int measurementId, const QByteArray &waveform)
+{
+    if (!m_awaitingTrace.contains(measurementId)) {
+        return;
+    }
+    
+    PipelineItem item;
+    item.queueId = measurementId;
+    item.sampleData = m_sampleQueue->sampleData(measurementId);
+    item.results = m_awaitingTrace.take(measurementId);
+    item.waveform = waveform;
+    item.submittedNs = ResultPipeline::monotonicNs();
+    if (!m_resultPipeline->submit(item)) {
+        m_sampleQueue->setState(measurementId, SampleQueueModel::Failed, "Result pipeline full");
+        emit analysisError("Result pipeline full");
+        updateAnalyzingState();
+    }
+}
+
+void BloodGasAnalyzer::onChannelSettled()
+{
+    if (m_measuringId == 0 || m_nextChannelGroup >= CHANNEL_GROUP_COUNT - 1) {
+        return;
+    }
+    
+    if (publishChannelGroup(m_nextChannelGroup++)) {
+        scheduleNextChannelGroup();
+    }
+}
+
+void BloodGasAnalyzer::onSensorChannelSettled(int measurementId, int channel, double value)
+{
+    // Plateaus can arrive after the deadline already closed the sample
+    if (measurementId != m_measuringId) {
+        return;
+    }
+    m_settledValues.insert(channel, value);
+    
+    // Groups go out in order, each as soon as all of its electrodes settle
+    bool published = false;
+    while (m_nextChannelGroup < CHANNEL_GROUP_COUNT) {
+        for (int c = 0; c < SensorProtocol::CHANNEL_COUNT; ++c) {
+            if (SensorProtocol::ELECTRODES[c].group == m_nextChannelGroup && !m_settledValues.contains(c)) {
+                if (published) {
+                    scheduleNextChannelGroup();
+                }
+                return;
+            }
+        }
+        if (m_nextChannelGroup == CHANNEL_GROUP_COUNT - 1) {
+            // Every electrode has settled; the measurement ends early
+            m_analysisTimer->stop();
+            onAnalysisTimeout();
+            return;
+        }
+        if (!publishChannelGroup(m_nextChannelGroup++)) {
+            return;
+        }
+        published = true;
+    }
+}
+
+void BloodGasAnalyzer::scheduleNextChannelGroup()
+{
+    // The settle fractions are deadlines; the last group is left to
+    // onAnalysisTimeout()
+    if (m_nextChannelGroup >= CHANNEL_GROUP_COUNT - 1) {
+        m_channelTimer->stop();
+        return;
+    }
+    const int settleAtMs = int(m_measurementDurationMs * CHANNEL_GROUPS[m_nextChannelGroup].settleFraction);
+    m_channelTimer->start(qMax(0, settleAtMs - int(m_measurementClock.elapsed())));
+}
+
+bool BloodGasAnalyzer::publishChannelGroup(int group)
+{
+    QVariantMap values;
+    QStringList uncalibrated;
+    QStringList unsettled;
+    if (!m_sensorPath.isEmpty()) {
+        // A configured board is never stood in for by simulated values
+        values = readSensorGroup(group, unsettled);
+        if (values.isEmpty()) {
+            failMeasurement(QString("No signal from sensor %1 for %2").arg(m_sensorPath, CHANNEL_GROUPS[group].name));
+            return false;
+        }
+        uncalibrated = uncalibratedFields(group);
+    } else {
+        values = readChannelGroup(group);
+    }
+    m_channelReadings.insert(values);
+    m_liveResults.insert(values);
+    if (!uncalibrated.isEmpty()) {
+        uncalibrated.prepend(m_channelReadings.value("uncalibratedFields").toStringList());
+        m_channelReadings["uncalibratedFields"] = uncalibrated;
+        m_liveResults["uncalibratedFields"] = uncalibrated;
+    }
+    if (!unsettled.isEmpty()) {
+        unsettled.prepend(m_channelReadings.value("unsettledFields").toStringList());
+        m_channelReadings["unsettledFields"] = unsettled;
+        m_liveResults["unsettledFields"] = unsettled;
+    }
     
-    // Add to historical data
-    m_historicalDataModel->addResult(results);
+    // Critical values are flagged as soon as their channel is in
+    ResultRules::apply(m_liveResults);
+    m_liveResults["complete"] = group == CHANNEL_GROUP_COUNT - 1;
+    m_sampleQueue->setResults(m_measuringId, m_liveResults);
+    
+    emit channelGroupCompleted(m_measuringId, CHANNEL_GROUPS[group].name, values);
+    emit liveResultsChanged();
+    return true;
+}
+
+QVariantMap BloodGasAnalyzer::readSensorGroup(int group, QStringList &unsettled) const
+{
+    // Plateau values where the electrode settled, otherwise the latest
+    // filtered signal, listed in unsettled; empty when any channel of the
+    // group has no data for this measurement
+    QVariantMap values;
+    for (int channel = 0; channel < SensorProtocol::CHANNEL_COUNT; ++channel) {
+        const SensorProtocol::Electrode &electrode = SensorProtocol::ELECTRODES[channel];
+        if (electrode.group != group) {
+            continue;
+        }
+        double value = m_settledValues.value(channel, std::numeric_limits<double>::quiet_NaN());
+        if (std::isnan(value)) {
+            value = m_signalProcessor->latestValue(m_measuringId, channel);
+            if (std::isnan(value)) {
+                return QVariantMap();
+            }
+            unsettled.append(electrode.field);
+        }
+        values[electrode.field] = value;
+    }
     
-    // Send to HL7 if configured
-    m_hl7Manager->sendResults(results);
+    if (group == 0) {
+        deriveBloodGasValues(values);
+    }
+    return values;
+}
+
+QStringList BloodGasAnalyzer::uncalibratedFields(int group) const
+{
+    QStringList fields;
+    for (int channel = 0; channel < SensorProtocol::CHANNEL_COUNT; ++channel) {
+        if (SensorProtocol::ELECTRODES[channel].group == group && !m_signalProcessor->isCalibrated(channel)) {
+            fields.append(SensorProtocol::ELECTRODES[channel].field);
+        }
+    }
+    return fields;
+}
+
+void BloodGasAnalyzer::onResultComputed(int queueId, const QVariantMap &results)
+{
+    m_lastResults = results;
+    m_sampleQueue->setResults(queueId, results);
     
-    m_isAnalyzing = false;
-    emit isAnalyzingChanged(false);
+    // Shown before persistence and transmission have happened
+    m_historicalDataModel->insertResult(results);
+    m_trendModel->addResult(results);
     emit analysisCompleted(results);
     
     qDebug() << "Analysis completed with results:" << results;
 }
 
-QVariantMap BloodGasAnalyzer::simulateAnalysis(const QVariantMap &sampleData)
+void BloodGasAnalyzer::onResultPersisted(int queueId, const QVariantMap &results)
 {
-    QVariantMap results;
+    m_historicalDataModel->setResultId(results.value("sampleId").toString(), results.value("id").toInt());
+    m_driftMonitor->addResult(results);
+    
+    // The order is fulfilled and leaves the worklist
+    m_orderWorklist->completeOrder(results.value("accession").toString());
     
-    // Basic blood gas parameters with realistic ranges
-    results["pH"] = 7.35 + (QRandomGenerator::global()->bounded(100) / 1000.0);
-    results["pCO2"] = 35.0 + QRandomGenerator::global()->bounded(15);
-    results["pO2"] = 80.0 + QRandomGenerator::global()->bounded(40);
-    results["HCO3"] = 22.0 + QRandomGenerator::global()->bounded(6);
-    results["SO2"] = 95.0 + QRandomGenerator::global()->bounded(5);
-    results["BE"] = -2.0 + QRandomGenerator::global()->bounded(8);
+    m_sampleQueue->setState(queueId, SampleQueueModel::Completed);
+    updateAnalyzingState();
+    
+    emit analysisFinalized(results);
+}
+
+void BloodGasAnalyzer::onPipelineItemFailed(const QString &stage, int queueId)
+{
+    qWarning() << "Result pipeline stage" << stage << "failed for sample" << queueId;
+    m_sampleQueue->setState(queueId, SampleQueueModel::Failed, "Failed in " + stage);
+    emit analysisError("Failed to " + stage + " result");
+    updateAnalyzingState();
+}
+
+void BloodGasAnalyzer::updateAnalyzingState()
+{
+    bool analyzing = m_sampleQueue->pendingCount() > 0;
+    if (m_isAnalyzing != analyzing) {
+        m_isAnalyzing = analyzing;
+        emit isAnalyzingChanged(analyzing);
+    }
+}
+
+QVariantMap BloodGasAnalyzer::readChannelGroup(int group)
+{
+    QVariantMap results;
     
-    // Electrolytes
-    results["Na"] = 135.0 + QRandomGenerator::global()->bounded(10);
-    results["K"] = 3.5 + (QRandomGenerator::global()->bounded(20) / 10.0);
-    results["Cl"] = 95.0 + QRandomGenerator::global()->bounded(15);
-    results["Ca"] = 2.2 + (QRandomGenerator::global()->bounded(6) / 10.0);
+    switch (group) {
+    case 0:
+        // Basic blood gas parameters with realistic ranges
+        results["pH"] = 7.35 + (QRandomGenerator::global()->bounded(100) / 1000.0);
+        results["pCO2"] = 35.0 + QRandomGenerator::global()->bounded(15);
+        results["pO2"] = 80.0 + QRandomGenerator::global()->bounded(40);
+        results["HCO3"] = 22.0 + QRandomGenerator::global()->bounded(6);
+        results["SO2"] = 95.0 + QRandomGenerator::global()->bounded(5);
+        results["BE"] = -2.0 + QRandomGenerator::global()->bounded(8);
+        break;
+    case 1:
+        // Electrolytes
+        results["Na"] = 135.0 + QRandomGenerator::global()->bounded(10);
+        results["K"] = 3.5 + (QRandomGenerator::global()->bounded(20) / 10.0);
+        results["Cl"] = 95.0 + QRandomGenerator::global()->bounded(15);
+        results["Ca"] = 2.2 + (QRandomGenerator::global()->bounded(6) / 10.0);
+        break;
+    case 2:
+        // Metabolites
+        results["Glucose"] = 70.0 + QRandomGenerator::global()->bounded(50);
+        results["Lactate"] = 0.5 + (QRandomGenerator::global()->bounded(30) / 10.0);
+        break;
+    }
     
-    // Metabolites
-    results["Glucose"] = 70.0 + QRandomGenerator::global()->bounded(50);
-    results["Lactate"] = 0.5 + (QRandomGenerator::global()->bounded(30) / 10.0);
+    return results;
+}
+
+void BloodGasAnalyzer::deriveBloodGasValues(QVariantMap &results)
+{
+    const double pH = results.value("pH").toDouble();
+    const double pCO2 = results.value("pCO2").toDouble();
+    const double pO2 = results.value("pO2").toDouble();
     
+    // Henderson-Hasselbalch, Van Slyke base excess, Severinghaus saturation
+    const double HCO3 = 0.0307 * pCO2 * std::pow(10.0, pH - 6.1);
+    results["HCO3"] = HCO3;
+    results["BE"] = 0.93 * (HCO3 - 24.4 + 14.8 * (pH - 7.4));
+    results["SO2"] = pO2 > 0.0 ? 100.0 / (1.0 + 23400.0 / (pO2 * pO2 * pO2 + 150.0 * pO2)) : 0.0;
+}
+
+void BloodGasAnalyzer::completeChannelReadings(QVariantMap &readings)
+{
+    // Normally every group has been read during the measurement
+    for (int group = 0; group < CHANNEL_GROUP_COUNT; ++group) {
+        if (!readings.contains(CHANNEL_GROUPS[group].firstField)) {
+            readings.insert(readChannelGroup(group));
+        }
+    }
+}
+
+void BloodGasAnalyzer::computeResults(const QVariantMap &sampleData, QVariantMap &results)
+{
     // Add metadata
     results["timestamp"] = QDateTime::currentDateTime().toString(Qt::ISODate);
-    results["operator"] = m_currentUser;
+    results["operator"] = sampleData.value("operator");
     results["sampleId"] = sampleData.value("sampleId", "AUTO_" + QString::number(QDateTime::currentSecsSinceEpoch()));
     results["patientId"] = sampleData.value("patientId", "");
+    results["accession"] = sampleData.value("accession", "");
     results["temperature"] = sampleData.value("temperature", 37.0);
-    
-    return results;
+    ResultRules::addDemographics(results, sampleData);
+
+    // Optional inputs of the derived parameters (DerivedParameters)
+    for (const char *field : {"FiO2", "albumin", "Hb"}) {
+        if (sampleData.contains(field)) {
+            results[field] = sampleData.value(field);
+        }
+    }
+
+    ResultRules::apply(results);
 }
 
 void BloodGasAnalyzer::exportResults(const QString &format)
@@ -170,11 +763,57 @@ void BloodGasAnalyzer::exportResults(const QString &format)
     qDebug() << "Export results in format:" << format;
 }
 
+void BloodGasAnalyzer::reloadReferenceRanges()
+{
+    QList<ResultRules::RangeRule> rules;
+    int revision = 0;
+    if (!m_databaseManager->loadReferenceRanges(rules, revision)) {
+        qWarning() << "Failed to load reference ranges; keeping the ones in use";
+        return;
+    }
+    
+    // Results in flight pick up the new table with their next evaluation
+    ResultRules::install(std::make_shared<const ResultRules::RangeTable>(rules, revision));
+    qDebug() << "Reference ranges revision" << revision << "loaded," << rules.size() << "rules";
+    
+    if (m_reflagJob) {
+        m_reflagJob->start();
+    }
+}
+
+void BloodGasAnalyzer::prefetchPatientHistory(const QString &patientId)
+{
+    const QString id = patientId.trimmed();
+    if (id.isEmpty() || m_pendingHistories.contains(id)) {
+        return;
+    }
+    
+    // A cached patient costs a few hundred bytes of copying; anyone else
+    // is read on the history thread while the sample is measured
+    if (m_patientCache.contains(id)) {
+        onPatientHistoryFetched(id, PatientResultCache::history(id, m_patientCache.recent(id)));
+        return;
+    }
+    m_pendingHistories.insert(id);
+    QMetaObject::invokeMethod(m_historyWorker, [worker = m_historyWorker, id]() { worker->fetch(id); });
+}
+
+QVariantMap BloodGasAnalyzer::patientHistory(const QString &patientId) const
+{
+    return m_patientHistories.value(patientId.trimmed());
+}
+
 QVariantMap BloodGasAnalyzer::getLastResults() const
 {
     return m_lastResults;
 }
 
+void BloodGasAnalyzer::attachSensorDevice(const QString &path)
+{
+    m_sensorPath = path;
+    QMetaObject::invokeMethod(m_sensorDevice, [device = m_sensorDevice, path]() { device->open(path); });
+}
+
 void BloodGasAnalyzer::onUserLoggedIn(const QString &username)
 {
     m_currentUser = username;
@@ -194,4 +833,15 @@ void BloodGasAnalyzer::onCalibrationCompleted(bool success)
     m_isCalibrated = success;
     emit isCalibratedChanged();
     qDebug() << "Calibration completed:" << (success ? "SUCCESS" : "FAILED");
+}
+
+void BloodGasAnalyzer::onPatientHistoryFetched(const QString &patientId, const QVariantMap &history)
+{
+    m_pendingHistories.remove(patientId);
+    // Only the patients of samples in progress are of interest
+    if (m_patientHistories.size() >= MAX_PATIENT_HISTORIES && !m_patientHistories.contains(patientId)) {
+        m_patientHistories.clear();
+    }
+    m_patientHistories.insert(patientId, history);
+    emit patientHistoryReady(patientId, history);
 }
\ No newline at end of file
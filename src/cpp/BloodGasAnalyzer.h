@@ -4,12 +4,28 @@
 #include <QObject>
 #include <QTimer>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+#include <QThread>
+
+#include "PatientResultCache.h"
 
 class HistoricalDataModel;
+class TrendModel;
+class AnalyteDistributions;
+class PatientDriftMonitor;
 class DatabaseManager;
 class AuthenticationManager;
 class CalibrationManager;
 class HL7Manager;
+class OrderWorklist;
+class SampleQueueModel;
+class ResultPipeline;
+class SensorDevice;
+class SignalProcessor;
+class ReflagJob;
+class PatientHistoryWorker;
 
 class BloodGasAnalyzer : public QObject
 {
@@ -17,6 +33,8 @@ class BloodGasAnalyzer : public QObject
     Q_PROPERTY(bool isAnalyzing READ isAnalyzing NOTIFY isAnalyzingChanged)
     Q_PROPERTY(QString currentUser READ currentUser NOTIFY currentUserChanged)
     Q_PROPERTY(bool isCalibrated READ isCalibrated NOTIFY isCalibratedChanged)
+    Q_PROPERTY(QVariantMap liveResults READ liveResults NOTIFY liveResultsChanged)
+    Q_PROPERTY(QVariantMap sensorStats READ sensorStats NOTIFY sensorStatsChanged)
     
 public:
     explicit BloodGasAnalyzer(QObject *parent = nullptr);
@@ -25,48 +43,139 @@ public:
     bool isAnalyzing() const { return m_isAnalyzing; }
     QString currentUser() const { return m_currentUser; }
     bool isCalibrated() const { return m_isCalibrated; }
+    // Channels of the sample being measured, filled in as each group settles
+    QVariantMap liveResults() const { return m_liveResults; }
+    QVariantMap sensorStats() const { return m_sensorStats; }
     
     HistoricalDataModel* getHistoricalDataModel() const { return m_historicalDataModel; }
+    TrendModel* getTrendModel() const { return m_trendModel; }
+    AnalyteDistributions* getAnalyteDistributions() const { return m_analyteDistributions; }
+    PatientDriftMonitor* getPatientDriftMonitor() const { return m_driftMonitor; }
     DatabaseManager* getDatabaseManager() const { return m_databaseManager; }
     AuthenticationManager* getAuthenticationManager() const { return m_authManager; }
     CalibrationManager* getCalibrationManager() const { return m_calibrationManager; }
     HL7Manager* getHL7Manager() const { return m_hl7Manager; }
+    OrderWorklist* getOrderWorklist() const { return m_orderWorklist; }
+    SampleQueueModel* getSampleQueueModel() const { return m_sampleQueue; }
+    ResultPipeline* getResultPipeline() const { return m_resultPipeline; }
+    ReflagJob* getReflagJob() const { return m_reflagJob; }
+    PatientResultCache& getPatientResultCache() { return m_patientCache; }
     
 public slots:
-    Q_INVOKABLE void startAnalysis(const QVariantMap &sampleData);
+    // Queues the sample; measurement starts as soon as the analyzer is free
+    Q_INVOKABLE int startAnalysis(const QVariantMap &sampleData);
     Q_INVOKABLE void stopAnalysis();
     Q_INVOKABLE void exportResults(const QString &format);
     Q_INVOKABLE QVariantMap getLastResults() const;
+    // Reads channels from a sensor board (or the simulator's pty) instead
+    // of simulating them; channels fall back to simulation until data arrives
+    Q_INVOKABLE void attachSensorDevice(const QString &path);
+    // Compiles the latest stored reference ranges and flags with them from
+    // now on; stored results are re-flagged in the background
+    Q_INVOKABLE void reloadReferenceRanges();
+    // Reads the patient's recent results ahead of their sample's result;
+    // patientHistoryReady follows, right away when the patient is cached
+    Q_INVOKABLE void prefetchPatientHistory(const QString &patientId);
+    // The latest prefetched history, or an empty map
+    Q_INVOKABLE QVariantMap patientHistory(const QString &patientId) const;
     
 signals:
     void isAnalyzingChanged(bool isAnalyzing);
     void currentUserChanged();
     void isCalibratedChanged();
+    void liveResultsChanged();
+    void sensorStatsChanged();
+    void channelGroupCompleted(int queueId, const QString &group, const QVariantMap &values);
     void analysisCompleted(const QVariantMap &results);
+    // The record is complete and persisted
+    void analysisFinalized(const QVariantMap &results);
     void analysisError(const QString &error);
+    void patientHistoryReady(const QString &patientId, const QVariantMap &history);
     
 private slots:
     void onAnalysisTimeout();
+    void onChannelSettled();
+    void onSensorChannelSettled(int measurementId, int channel, double value);
+    void onTraceFinished(int measurementId, const QByteArray &waveform);
+    void onProgressTick();
+    void onSampleCancelled(int queueId);
+    void onResultComputed(int queueId, const QVariantMap &results);
+    void onResultPersisted(int queueId, const QVariantMap &results);
+    void onPipelineItemFailed(const QString &stage, int queueId);
     void onUserLoggedIn(const QString &username);
     void onUserLoggedOut();
     void onCalibrationCompleted(bool success);
+    void onPatientHistoryFetched(const QString &patientId, const QVariantMap &history);
     
 private:
     void initializeComponents();
-    QVariantMap simulateAnalysis(const QVariantMap &sampleData);
+    void setupResultPipeline();
+    void startNextMeasurement();
+    // False when the group could not be read and the sample failed
+    bool publishChannelGroup(int group);
+    void failMeasurement(const QString &error);
+    void scheduleNextChannelGroup();
+    QVariantMap readSensorGroup(int group, QStringList &unsettled) const;
+    // The group's electrodes still on their nominal slope and offset
+    QStringList uncalibratedFields(int group) const;
+    void updateAnalyzingState();
+    
+    // Pipeline stage work; static because it runs on the stage threads
+    static QVariantMap readChannelGroup(int group);
+    static void completeChannelReadings(QVariantMap &readings);
+    static void deriveBloodGasValues(QVariantMap &results);
+    static void computeResults(const QVariantMap &sampleData, QVariantMap &results);
     
     HistoricalDataModel *m_historicalDataModel;
+    TrendModel *m_trendModel;
+    // Updated by the persist stage
+    AnalyteDistributions *m_analyteDistributions;
     DatabaseManager *m_databaseManager;
     AuthenticationManager *m_authManager;
     CalibrationManager *m_calibrationManager;
     HL7Manager *m_hl7Manager;
+    OrderWorklist *m_orderWorklist;
+    SampleQueueModel *m_sampleQueue;
+    ResultPipeline *m_resultPipeline;
+    ReflagJob *m_reflagJob;
+    // Patient-based QC, fed each persisted result
+    PatientDriftMonitor *m_driftMonitor;
+    // Recent results per patient, for delta checks on the compute stage
+    PatientResultCache m_patientCache;
+    // Patient histories are read on their own thread, on a cache miss
+    QThread m_historyThread;
+    PatientHistoryWorker *m_historyWorker;
+    QHash<QString, QVariantMap> m_patientHistories;
+    QSet<QString> m_pendingHistories;
     
+    // Sensor board I/O and signal processing run on their own threads
+    QThread m_sensorThread;
+    QThread m_signalThread;
+    SensorDevice *m_sensorDevice;
+    SignalProcessor *m_signalProcessor;
+    QString m_sensorPath; // empty: no board, values are simulated
+    QVariantMap m_sensorStats;
+    
+    // One sample is measured at a time; those before it may still be in the
+    // result pipeline when the next measurement starts
     QTimer *m_analysisTimer;
+    QTimer *m_progressTimer;
+    QTimer *m_channelTimer;
+    QElapsedTimer m_measurementClock;
+    int m_measurementDurationMs;
+    int m_measuringId;
+    int m_nextChannelGroup;
+    QVariantMap m_channelReadings;
+    QHash<int, double> m_settledValues; // by channel, for the measuring sample
+    QHash<int, QVariantMap> m_awaitingTrace; // readings by queue id
+    QVariantMap m_liveResults;
     bool m_isAnalyzing;
     QString m_currentUser;
     bool m_isCalibrated;
-    QVariantMap m_currentSampleData;
     QVariantMap m_lastResults;
+    
+    static const int PROGRESS_INTERVAL_MS = 200;
+    static const int MAX_PATIENT_HISTORIES = 32;
 };
 
 #endif // BLOODGASANALYZER_H
\ No newline at end of file
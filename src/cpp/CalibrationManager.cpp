@@ -1,5 +1,7 @@
 #include "CalibrationManager.h"
 #include "DatabaseManager.h"
+#include "QcEngine.h"
+#include "SensorProtocol.h"
 
 #include <QDebug>
 #include <QTimer>
@@ -7,9 +9,47 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 
+#include <cmath>
+#include <iterator>
+#include <random>
+
+namespace {
+// The two calibrant levels of each electrode, in SensorProtocol::ELECTRODES
+// order and analyte units
+const double CALIBRANT_LEVELS[][2] = {
+    {7.384, 6.840}, // pH: the two phosphate buffers
+    {40.0, 80.0},   // pCO2: 5% and 10% CO2 gas
+    {150.0, 0.0},   // pO2: 20% O2 gas and the zero solution
+    {140.0, 100.0}, // Na
+    {4.0, 8.0},     // K
+    {100.0, 60.0},  // Cl
+    {1.25, 2.5},    // Ca
+    {100.0, 400.0}, // Glucose
+    {1.0, 8.0}      // Lactate
+};
+static_assert(std::size(CALIBRANT_LEVELS) == SensorProtocol::CHANNEL_COUNT);
+
+// Electrode readings are within a fraction of a millivolt at a plateau
+const double CALIBRANT_NOISE_MV = 0.2;
+
+QList<int> channelsOf(std::initializer_list<const char *> fields)
+{
+    QList<int> channels;
+    for (const char *field : fields) {
+        for (int channel = 0; channel < SensorProtocol::CHANNEL_COUNT; ++channel) {
+            if (qstrcmp(SensorProtocol::ELECTRODES[channel].field, field) == 0) {
+                channels.append(channel);
+            }
+        }
+    }
+    return channels;
+}
+}
+
 CalibrationManager::CalibrationManager(DatabaseManager *dbManager, QObject *parent)
     : QObject(parent)
     , m_dbManager(dbManager)
+    , m_qcEngine(new QcEngine(dbManager, this))
     , m_isCalibrating(false)
     , m_isCalibrated(true)
     , m_calibrationProgress(0)
@@ -47,6 +87,7 @@ void CalibrationManager::initializeCalibrationSteps()
     step2.duration = 2000; // ms
     step2.expectedValues = QVariantMap{{"pH_buffer1", 7.40}, {"pH_buffer2", 6.84}};
     step2.tolerances = QVariantMap{{"pH_buffer1", 0.02}, {"pH_buffer2", 0.02}};
+    step2.electrodes = channelsOf({"pH"});
     m_calibrationSteps.append(step2);
     
     CalibrationStep step3;
@@ -55,6 +96,7 @@ void CalibrationManager::initializeCalibrationSteps()
     step3.duration = 2000; // ms
     step3.expectedValues = QVariantMap{{"pO2_cal", 150.0}, {"pCO2_cal", 40.0}};
     step3.tolerances = QVariantMap{{"pO2_cal", 5.0}, {"pCO2_cal", 2.0}};
+    step3.electrodes = channelsOf({"pCO2", "pO2"});
     m_calibrationSteps.append(step3);
     
     CalibrationStep step4;
@@ -63,15 +105,25 @@ void CalibrationManager::initializeCalibrationSteps()
     step4.duration = 2000; // ms
     step4.expectedValues = QVariantMap{{"Na_cal", 140.0}, {"K_cal", 4.0}, {"Cl_cal", 100.0}};
     step4.tolerances = QVariantMap{{"Na_cal", 2.0}, {"K_cal", 0.2}, {"Cl_cal", 2.0}};
+    step4.electrodes = channelsOf({"Na", "K", "Cl", "Ca"});
     m_calibrationSteps.append(step4);
     
     CalibrationStep step5;
-    step5.name = "Quality Control";
-    step5.description = "Running quality control samples";
+    step5.name = "Metabolite Calibration";
+    step5.description = "Calibrating glucose and lactate sensors";
     step5.duration = 2000; // ms
-    step5.expectedValues = QVariantMap{{"qc_passed", true}};
-    step5.tolerances = QVariantMap{};
+    step5.expectedValues = QVariantMap{{"Glucose_cal", 100.0}, {"Lactate_cal", 1.0}};
+    step5.tolerances = QVariantMap{{"Glucose_cal", 4.0}, {"Lactate_cal", 0.1}};
+    step5.electrodes = channelsOf({"Glucose", "Lactate"});
     m_calibrationSteps.append(step5);
+    
+    CalibrationStep step6;
+    step6.name = "Quality Control";
+    step6.description = "Running control levels 1-3 against the Westgard rules";
+    step6.duration = 2000; // ms
+    step6.expectedValues = QVariantMap{{"levels", QcEngine::LEVEL_COUNT}};
+    step6.tolerances = QVariantMap{};
+    m_calibrationSteps.append(step6);
 }
 
 void CalibrationManager::startCalibration(const QString& calibrationType)
@@ -189,8 +241,14 @@ void CalibrationManager::simulateCalibrationStep()
 {
     const CalibrationStep &step = m_calibrationSteps[m_currentStepIndex];
     
-    // Simulate success/failure (90% success rate for demo)
-    bool success = QRandomGenerator::global()->bounded(100) < 90;
+    // Simulate success/failure (90% success rate for demo); quality
+    // control is evaluated for real
+    QString failure;
+    bool success = step.name == "Quality Control" ? runQualityControl(failure)
+                                                  : QRandomGenerator::global()->bounded(100) < 90;
+    if (success && !step.electrodes.isEmpty()) {
+        success = calibrateElectrodes(step, failure);
+    }
     
     emit calibrationStepCompleted(step.name, success);
     
@@ -199,9 +257,72 @@ void CalibrationManager::simulateCalibrationStep()
         acceptCalibrationStep();
     } else {
         // Step failed, require user intervention
-        qWarning() << "Calibration step failed:" << step.name;
-        emit calibrationFailed("Calibration step failed: " + step.name + ". Retry or cancel calibration.");
+        qWarning() << "Calibration step failed:" << step.name << failure;
+        emit calibrationFailed("Calibration step failed: " + step.name + (failure.isEmpty() ? "" : " (" + failure + ")") +
+                               ". Retry or cancel calibration.");
+    }
+}
+
+bool CalibrationManager::runQualityControl(QString &failure)
+{
+    if (!m_dbManager) {
+        return true;
+    }
+    
+    // Simulated control measurements: each level's targets plus normal
+    // noise of the target SD
+    std::normal_distribution<double> noise;
+    QVariantMap run;
+    for (int level = 1; level <= QcEngine::LEVEL_COUNT; ++level) {
+        QVariantMap values;
+        for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+            const QcEngine::Target target = m_qcEngine->target(level, analyte);
+            if (target.sd > 0.0) {
+                values[ResultRules::ANALYTE_FIELDS[analyte]] = target.mean + noise(*QRandomGenerator::global()) * target.sd;
+            }
+        }
+        run[QString::number(level)] = values;
     }
+    
+    const QVariantMap outcome = m_qcEngine->addControlRun(run, "SYSTEM");
+    if (outcome.contains("error")) {
+        failure = outcome.value("error").toString();
+        return false;
+    }
+    if (outcome.value("rejected").toBool()) {
+        failure = "QC rejected: " + outcome.value("rules").toString();
+        return false;
+    }
+    return true;
+}
+
+bool CalibrationManager::calibrateElectrodes(const CalibrationStep &step, QString &failure)
+{
+    // Simulated plateau readings of the two calibrants, from the
+    // electrode's nominal response
+    std::normal_distribution<double> noise(0.0, CALIBRANT_NOISE_MV);
+    for (const int channel : step.electrodes) {
+        const SensorProtocol::Electrode &electrode = SensorProtocol::ELECTRODES[channel];
+        double x[2];
+        double millivolts[2];
+        for (int level = 0; level < 2; ++level) {
+            const double value = CALIBRANT_LEVELS[channel][level];
+            x[level] = electrode.logarithmic ? std::log10(value) : value;
+            millivolts[level] = SensorProtocol::toMillivolts(electrode, value) + noise(*QRandomGenerator::global());
+        }
+        
+        const double slope = (millivolts[1] - millivolts[0]) / (x[1] - x[0]);
+        const double offset = millivolts[0] - slope * x[0];
+        if (std::abs(slope / electrode.slope - 1.0) > MAX_SLOPE_DEVIATION) {
+            failure = QString("%1 slope %2 mV outside %3% of nominal")
+                          .arg(electrode.field)
+                          .arg(slope, 0, 'f', 2)
+                          .arg(MAX_SLOPE_DEVIATION * 100.0, 0, 'f', 0);
+            return false;
+        }
+        m_pendingCalibrations.insert(channel, ElectrodeCalibration{slope, offset});
+    }
+    return true;
 }
 
 void CalibrationManager::completeCalibration(bool success)
@@ -221,8 +342,26 @@ void CalibrationManager::completeCalibration(bool success)
         calibrationData["steps_completed"] = m_calibrationSteps.size();
         calibrationData["success"] = true;
         
+        // The electrodes this calibration covered take their new slopes
+        QVariantList electrodes;
+        for (auto it = m_pendingCalibrations.cbegin(); it != m_pendingCalibrations.cend(); ++it) {
+            m_electrodeCalibrations.insert(it.key(), it.value());
+            electrodes.append(QVariantMap{{"field", SensorProtocol::ELECTRODES[it.key()].field},
+                                          {"slope", it->slope},
+                                          {"offset", it->offset}});
+            emit electrodeCalibrated(it.key(), it->slope, it->offset);
+        }
+        calibrationData["electrodes"] = electrodes;
+        
         saveCalibrationData(calibrationData);
         
+        if (recalibrationRecommended() &&
+            (m_calibrationType == "full" || m_calibrationType == m_recommendedCalibrationType)) {
+            m_recommendedCalibrationType.clear();
+            m_recalibrationReason.clear();
+            emit recalibrationRecommendedChanged();
+        }
+        
         emit calibratedStatusChanged();
         emit lastCalibrationTimeChanged();
         emit calibrationProgressChanged();
@@ -239,6 +378,7 @@ void CalibrationManager::completeCalibration(bool success)
 void CalibrationManager::resetCalibration()
 {
     m_isCalibrating = false;
+    m_pendingCalibrations.clear();
     m_calibrationStep.clear();
     m_calibrationProgress = 0;
     m_currentStepIndex = 0;
@@ -309,4 +449,18 @@ int CalibrationManager::getCalibrationValidityDays()
     QDateTime now = QDateTime::currentDateTime();
     int daysPassed = m_lastCalibrationTime.daysTo(now);
     return qMax(0, CALIBRATION_VALIDITY_DAYS - daysPassed);
+}
+
+void CalibrationManager::recommendRecalibration(const QString &calibrationType, const QString &reason)
+{
+    if (m_recommendedCalibrationType.isEmpty() || m_recommendedCalibrationType == calibrationType) {
+        m_recommendedCalibrationType = calibrationType;
+        m_recalibrationReason = reason;
+    } else {
+        m_recommendedCalibrationType = "full";
+        m_recalibrationReason += "\n" + reason;
+    }
+    
+    qWarning() << "Recalibration recommended:" << m_recommendedCalibrationType << "-" << reason;
+    emit recalibrationRecommendedChanged();
 }
\ No newline at end of file
@@ -1,12 +1,14 @@
 #ifndef CALIBRATIONMANAGER_H
 #define CALIBRATIONMANAGER_H
 
+#include <QHash>
 #include <QObject>
 #include <QTimer>
 #include <QVariantMap>
 #include <QDateTime>
 
 class DatabaseManager;
+class QcEngine;
 
 class CalibrationManager : public QObject
 {
@@ -16,8 +18,17 @@ class CalibrationManager : public QObject
     Q_PROPERTY(QString calibrationStep READ calibrationStep NOTIFY calibrationStepChanged)
     Q_PROPERTY(bool isCalibrated READ isCalibrated NOTIFY calibratedStatusChanged)
     Q_PROPERTY(QDateTime lastCalibrationTime READ lastCalibrationTime NOTIFY lastCalibrationTimeChanged)
+    // Set by patient-based QC when a channel drifts; cleared by a calibration
+    Q_PROPERTY(bool recalibrationRecommended READ recalibrationRecommended NOTIFY recalibrationRecommendedChanged)
+    Q_PROPERTY(QString recommendedCalibrationType READ recommendedCalibrationType NOTIFY recalibrationRecommendedChanged)
+    Q_PROPERTY(QString recalibrationReason READ recalibrationReason NOTIFY recalibrationRecommendedChanged)
     
 public:
+    struct ElectrodeCalibration {
+        double slope;  // mV per unit, or per decade
+        double offset; // mV
+    };
+    
     explicit CalibrationManager(DatabaseManager *dbManager, QObject *parent = nullptr);
     
     bool isCalibrating() const { return m_isCalibrating; }
@@ -25,6 +36,15 @@ public:
     QString calibrationStep() const { return m_calibrationStep; }
     bool isCalibrated() const { return m_isCalibrated; }
     QDateTime lastCalibrationTime() const { return m_lastCalibrationTime; }
+    QcEngine* qcEngine() const { return m_qcEngine; }
+    // Of the running or last calibration
+    QString calibrationType() const { return m_calibrationType; }
+    bool recalibrationRecommended() const { return !m_recommendedCalibrationType.isEmpty(); }
+    QString recommendedCalibrationType() const { return m_recommendedCalibrationType; }
+    QString recalibrationReason() const { return m_recalibrationReason; }
+    // Two-point results of the electrodes calibrated so far, by
+    // SensorProtocol channel
+    QHash<int, ElectrodeCalibration> electrodeCalibrations() const { return m_electrodeCalibrations; }
     
 public slots:
     Q_INVOKABLE void startCalibration(const QString &calibrationType = "full");
@@ -35,6 +55,8 @@ public slots:
     Q_INVOKABLE QVariantMap getLastCalibrationData();
     Q_INVOKABLE bool isCalibrationRequired();
     Q_INVOKABLE int getCalibrationValidityDays();
+    // A second recommendation for another channel widens it to "full"
+    void recommendRecalibration(const QString &calibrationType, const QString &reason);
     
 signals:
     void calibrationStatusChanged();
@@ -45,28 +67,39 @@ signals:
     void calibrationCompleted(bool success);
     void calibrationFailed(const QString &reason);
     void calibrationStepCompleted(const QString &step, bool success);
+    void recalibrationRecommendedChanged();
+    // Once per electrode on a successful calibration
+    void electrodeCalibrated(int channel, double slope, double offset);
     
 private slots:
     void performCalibrationStep();
     void onCalibrationTimeout();
     
 private:
-    void loadCalibrationState();
-    void saveCalibrationData(const QVariantMap &data);
-    void simulateCalibrationStep();
-    void resetCalibration();
-    void completeCalibration(bool success);
-    void initializeCalibrationSteps();
-    
     struct CalibrationStep {
         QString name;
         QString description;
         int duration; // in milliseconds
         QVariantMap expectedValues;
         QVariantMap tolerances;
+        QList<int> electrodes; // channels given a two-point calibration
     };
     
+    void loadCalibrationState();
+    void saveCalibrationData(const QVariantMap &data);
+    void simulateCalibrationStep();
+    // Measures the control levels and evaluates them against the
+    // Westgard rules; false when the run is rejected
+    bool runQualityControl(QString &failure);
+    // Measures the step's electrodes at their two calibrant levels; false
+    // when a slope is out of range. Kept until the calibration completes.
+    bool calibrateElectrodes(const CalibrationStep &step, QString &failure);
+    void resetCalibration();
+    void completeCalibration(bool success);
+    void initializeCalibrationSteps();
+    
     DatabaseManager *m_dbManager;
+    QcEngine *m_qcEngine;
     bool m_isCalibrating;
     bool m_isCalibrated;
     int m_calibrationProgress;
@@ -74,6 +107,10 @@ private:
     QString m_calibrationType;
     QDateTime m_lastCalibrationTime;
     QDateTime m_calibrationStartTime;
+    QString m_recommendedCalibrationType;
+    QString m_recalibrationReason;
+    QHash<int, ElectrodeCalibration> m_electrodeCalibrations;
+    QHash<int, ElectrodeCalibration> m_pendingCalibrations;
     
     QTimer *m_calibrationTimer;
     QList<CalibrationStep> m_calibrationSteps;
@@ -82,6 +119,7 @@ private:
     
     static const int MAX_RETRY_COUNT = 3;
     static const int CALIBRATION_VALIDITY_DAYS = 30;
+    static constexpr double MAX_SLOPE_DEVIATION = 0.10; // of the nominal slope
 };
 
 #endif // CALIBRATIONMANAGER_H
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "DatabaseManager.h"
+#include "ResultRules.h"
 
 #include <QSqlDatabase>
 #include <QSqlQuery>
@@ -12,6 +13,131 @@
 #include <QDateTime>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QHash>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iterator>
+#include <limits>
+
+namespace {
+enum RollupGranularity {
+    HourRollup,
+    DayRollup,
+    ROLLUP_GRANULARITY_COUNT
+};
+
+const char *const ROLLUP_TABLES[ROLLUP_GRANULARITY_COUNT] = {"result_rollups_hour", "result_rollups_day"};
+const char *const ROLLUP_GRANULARITIES[ROLLUP_GRANULARITY_COUNT] = {"hour", "day"};
+
+struct RollupTotals {
+    qint64 count = 0;
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+
+    void add(double value)
+    {
+        ++count;
+        sum += value;
+        sumSquares += value * value;
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+};
+
+using RollupKey = QPair<QString, QString>; // bucket, operator
+using RollupRows = QHash<RollupKey, std::array<RollupTotals, ResultRules::ANALYTE_COUNT>>;
+
+// Buckets are in local time, like the result timestamps
+QDateTime rollupBucketStart(const QDateTime &time, int granularity)
+{
+    return granularity == HourRollup ? QDateTime(time.date(), QTime(time.time().hour(), 0))
+                                     : QDateTime(time.date(), QTime(0, 0));
+}
+
+QDateTime rollupBucketEnd(const QDateTime &start, int granularity)
+{
+    return granularity == HourRollup ? start.addSecs(3600) : start.addDays(1);
+}
+
+QString rollupBucket(const QDateTime &start, int granularity)
+{
+    return granularity == HourRollup ? start.toString("yyyy-MM-dd'T'hh") : start.date().toString(Qt::ISODate);
+}
+
+void addToRollupRows(RollupRows &rows, const QDateTime &time, const QString &operatorName,
+                     const QVariantMap &result, int granularity)
+{
+    auto &totals = rows[{rollupBucket(rollupBucketStart(time, granularity), granularity), operatorName}];
+    for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+        const QVariant value = result.value(ResultRules::ANALYTE_FIELDS[analyte]);
+        if (value.isValid() && !value.isNull()) {
+            totals[analyte].add(value.toDouble());
+        }
+    }
+}
+
+// Adds the totals to the table's rows, creating the missing ones
+bool writeRollupRows(QSqlDatabase &database, int granularity, const RollupRows &rows)
+{
+    QVariantList buckets;
+    QVariantList operators;
+    QVariantList analytes;
+    QVariantList counts;
+    QVariantList sums;
+    QVariantList sumSquares;
+    QVariantList mins;
+    QVariantList maxes;
+    for (auto it = rows.cbegin(); it != rows.cend(); ++it) {
+        for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+            const RollupTotals &totals = it.value()[analyte];
+            if (totals.count == 0) {
+                continue;
+            }
+            buckets.append(it.key().first);
+            operators.append(it.key().second);
+            analytes.append(ResultRules::ANALYTE_FIELDS[analyte]);
+            counts.append(totals.count);
+            sums.append(totals.sum);
+            sumSquares.append(totals.sumSquares);
+            mins.append(totals.min);
+            maxes.append(totals.max);
+        }
+    }
+    if (buckets.isEmpty()) {
+        return true;
+    }
+
+    QSqlQuery query(database);
+    query.prepare(QString(R"(
+        INSERT INTO %1 (bucket, operator, analyte, value_count, value_sum, value_sum_squares, value_min, value_max)
+        VALUES (?, ?, ?, ?, ?, ?, ?, ?)
+        ON CONFLICT (bucket, operator, analyte) DO UPDATE SET
+            value_count = value_count + excluded.value_count,
+            value_sum = value_sum + excluded.value_sum,
+            value_sum_squares = value_sum_squares + excluded.value_sum_squares,
+            value_min = MIN(value_min, excluded.value_min),
+            value_max = MAX(value_max, excluded.value_max)
+    )").arg(ROLLUP_TABLES[granularity]));
+    query.addBindValue(buckets);
+    query.addBindValue(operators);
+    query.addBindValue(analytes);
+    query.addBindValue(counts);
+    query.addBindValue(sums);
+    query.addBindValue(sumSquares);
+    query.addBindValue(mins);
+    query.addBindValue(maxes);
+
+    if (!query.execBatch()) {
+        qWarning() << "Failed to update" << ROLLUP_TABLES[granularity] << ":" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+}
 
 DatabaseManager::DatabaseManager(QObject *parent)
     : QObject(parent)
@@ -26,9 +152,69 @@ DatabaseManager::~DatabaseManager()
     if (m_database.isOpen()) {
         m_database.close();
     }
+    if (!m_connectionName.isEmpty()) {
+        m_database = QSqlDatabase();
+        QSqlDatabase::removeDatabase(m_connectionName);
+    }
+}
+
+bool DatabaseManager::initializeDatabase(const QString &connectionName)
+{
+    if (!openDatabase(connectionName)) {
+        return false;
+    }
+    QSqlQuery query(m_database);
+    
+    // Create tables
+    if (!createTables()) {
+        qCritical() << "Failed to create database tables";
+        return false;
+    }
+    
+    m_isConnected = true;
+    emit connectionStatusChanged(true);
+    
+    // Create default admin user if no users exist
+    QVariantList users = getAllUsers();
+    if (users.isEmpty()) {
+        createUser("admin", "admin123", "administrator");
+        createUser("operator", "operator123", "operator");
+        logAuditEvent("SYSTEM_INIT", "SYSTEM", QVariantMap{{"action", "Default users created"}});
+    }
+    
+    // Start with the shipped reference ranges
+    QList<ResultRules::RangeRule> rules;
+    int revision = 0;
+    if (loadReferenceRanges(rules, revision) && revision == 0) {
+        saveReferenceRanges(ResultRules::defaultRules(), "SYSTEM");
+    }
+    
+    // Results stored before the rollups existed
+    if (query.exec("SELECT EXISTS (SELECT 1 FROM results) AND NOT EXISTS (SELECT 1 FROM result_rollups_day)") &&
+        query.next() && query.value(0).toBool()) {
+        rebuildRollups();
+    }
+    
+    qDebug() << "Database initialized successfully at:" << m_databasePath;
+    return true;
+}
+
+bool DatabaseManager::isConnected() const
+{
+    return m_isConnected && m_database.isOpen();
+}
+
+bool DatabaseManager::openConnection(const QString &connectionName)
+{
+    if (!openDatabase(connectionName)) {
+        return false;
+    }
+    m_isConnected = true;
+    emit connectionStatusChanged(true);
+    return true;
 }
 
-bool DatabaseManager::initializeDatabase()
+bool DatabaseManager::openDatabase(const QString &connectionName)
 {
     // Create application data directory
     QString dataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
@@ -41,8 +227,10 @@ bool DatabaseManager::initializeDatabase()
     const auto dbName = QString("bloodgasanalyzer.db");
     m_databasePath = dir.filePath(dbName);
 
-    // Setup database connection
-    m_database = QSqlDatabase::addDatabase("QSQLITE");
+    // Setup database connection; named connections are for use from other threads
+    m_connectionName = connectionName;
+    m_database = connectionName.isEmpty() ? QSqlDatabase::addDatabase("QSQLITE")
+                                          : QSqlDatabase::addDatabase("QSQLITE", connectionName);
     m_database.setDatabaseName(dbName);
     
     if (!m_database.open()) {
@@ -57,38 +245,31 @@ bool DatabaseManager::initializeDatabase()
         qWarning() << "Failed to enable foreign keys:" << query.lastError().text();
     }
     
-    // Create tables
-    if (!createTables()) {
-        qCritical() << "Failed to create database tables";
-        return false;
+    // Let readers on other connections proceed while results are being written
+    if (!query.exec("PRAGMA journal_mode = WAL")) {
+        qWarning() << "Failed to enable WAL journal:" << query.lastError().text();
     }
-    
-    m_isConnected = true;
-    emit connectionStatusChanged(true);
-    
-    // Create default admin user if no users exist
-    QVariantList users = getAllUsers();
-    if (users.isEmpty()) {
-        createUser("admin", "admin123", "administrator");
-        createUser("operator", "operator123", "operator");
-        logAuditEvent("SYSTEM_INIT", "SYSTEM", QVariantMap{{"action", "Default users created"}});
+    if (!query.exec("PRAGMA busy_timeout = 5000")) {
+        qWarning() << "Failed to set busy timeout:" << query.lastError().text();
     }
     
-    qDebug() << "Database initialized successfully at:" << m_databasePath;
     return true;
 }
 
-bool DatabaseManager::isConnected() const
-{
-    return m_isConnected && m_database.isOpen();
-}
-
 bool DatabaseManager::createTables()
 {
     return createUsersTable() && 
            createResultsTable() && 
            createCalibrationTable() && 
-           createAuditTable();
+           createAuditTable() &&
+           createWorklistTables() &&
+           createWaveformTable() &&
+           createReflagTable() &&
+           createReferenceRangeTables() &&
+           createQuantileSketchTable() &&
+           createRollupTables() &&
+           createQcTables() &&
+           createDriftStateTable();
 }
 
 bool DatabaseManager::createUsersTable()
@@ -148,6 +329,52 @@ bool DatabaseManager::createResultsTable()
         return false;
     }
     
+    // Patient history lookups (delta checks, comparisons)
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_results_patient ON results (patient_id, timestamp)")) {
+        qCritical() << "Failed to create results patient index:" << query.lastError().text();
+        return false;
+    }
+    // Date range filters, and recomputing a rollup bucket
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_results_timestamp ON results (timestamp)")) {
+        qCritical() << "Failed to create results timestamp index:" << query.lastError().text();
+        return false;
+    }
+    
+    // Flags as evaluated under rule_version; re-flagging rewrites them. The
+    // patient's demographics pick the reference ranges.
+    return addMissingColumns("results", {{"acid_base_flags", "INTEGER"},
+                                         {"critical_flags", "INTEGER"},
+                                         {"low_flags", "INTEGER"},
+                                         {"high_flags", "INTEGER"},
+                                         {"rule_version", "INTEGER"},
+                                         {"specimen", "TEXT"},
+                                         {"patient_sex", "TEXT"},
+                                         {"patient_age_days", "INTEGER"}});
+}
+
+bool DatabaseManager::addMissingColumns(const QString &table, const QList<QPair<QString, QString>> &columns)
+{
+    QSqlQuery query(m_database);
+    if (!query.exec(QString("PRAGMA table_info(%1)").arg(table))) {
+        qCritical() << "Failed to read columns of" << table << ":" << query.lastError().text();
+        return false;
+    }
+    
+    QStringList existing;
+    while (query.next()) {
+        existing.append(query.value("name").toString());
+    }
+    
+    for (const auto &column : columns) {
+        if (existing.contains(column.first)) {
+            continue;
+        }
+        if (!query.exec(QString("ALTER TABLE %1 ADD COLUMN %2 %3").arg(table, column.first, column.second))) {
+            qCritical() << "Failed to add column" << column.first << "to" << table << ":" << query.lastError().text();
+            return false;
+        }
+    }
+    
     return true;
 }
 
@@ -198,6 +425,252 @@ bool DatabaseManager::createAuditTable()
     return true;
 }
 
+bool DatabaseManager::createWorklistTables()
+{
+    // Orders and demographics received from the HIS; the full decoded
+    // message part is kept as JSON, the indexed keys as columns
+    QStringList queries = {
+        R"(
+        CREATE TABLE IF NOT EXISTS worklist (
+            accession TEXT PRIMARY KEY,
+            barcode TEXT,
+            patient_id TEXT,
+            order_data TEXT NOT NULL,
+            updated_at DATETIME NOT NULL
+        )
+        )",
+        R"(
+        CREATE TABLE IF NOT EXISTS worklist_patients (
+            patient_id TEXT PRIMARY KEY,
+            patient_data TEXT NOT NULL,
+            updated_at DATETIME NOT NULL
+        )
+        )",
+        "CREATE INDEX IF NOT EXISTS idx_worklist_updated ON worklist (updated_at)",
+        "CREATE INDEX IF NOT EXISTS idx_worklist_patients_updated ON worklist_patients (updated_at)"
+    };
+    
+    if (!executeBatch(queries)) {
+        qCritical() << "Failed to create worklist tables";
+        return false;
+    }
+    
+    return true;
+}
+
+bool DatabaseManager::createWaveformTable()
+{
+    // Kept apart from results so listing results never reads the blobs
+    QSqlQuery query(m_database);
+    QString sql = R"(
+        CREATE TABLE IF NOT EXISTS result_waveforms (
+            result_id INTEGER PRIMARY KEY,
+            waveform BLOB NOT NULL,
+            created_at DATETIME DEFAULT CURRENT_TIMESTAMP
+        )
+    )";
+    
+    if (!query.exec(sql)) {
+        qCritical() << "Failed to create result_waveforms table:" << query.lastError().text();
+        return false;
+    }
+    
+    return true;
+}
+
+bool DatabaseManager::createReflagTable()
+{
+    QSqlQuery query(m_database);
+    QString sql = R"(
+        CREATE TABLE IF NOT EXISTS reflag_jobs (
+            rule_version INTEGER PRIMARY KEY,
+            last_id INTEGER NOT NULL DEFAULT 0,
+            processed INTEGER NOT NULL DEFAULT 0,
+            started_at DATETIME DEFAULT CURRENT_TIMESTAMP,
+            finished_at DATETIME
+        )
+    )";
+    
+    if (!query.exec(sql)) {
+        qCritical() << "Failed to create reflag_jobs table:" << query.lastError().text();
+        return false;
+    }
+    
+    return true;
+}
+
+bool DatabaseManager::createQuantileSketchTable()
+{
+    QSqlQuery query(m_database);
+    QString sql = R"(
+        CREATE TABLE IF NOT EXISTS quantile_sketches (
+            dimension TEXT NOT NULL,
+            key TEXT NOT NULL,
+            analyte TEXT NOT NULL,
+            count INTEGER NOT NULL,
+            sketch BLOB NOT NULL,
+            updated_at DATETIME DEFAULT CURRENT_TIMESTAMP,
+            PRIMARY KEY (dimension, key, analyte)
+        )
+    )";
+    
+    if (!query.exec(sql)) {
+        qCritical() << "Failed to create quantile_sketches table:" << query.lastError().text();
+        return false;
+    }
+    
+    return true;
+}
+
+bool DatabaseManager::createRollupTables()
+{
+    QSqlQuery query(m_database);
+    for (const char *table : ROLLUP_TABLES) {
+        const QString sql = QString(R"(
+            CREATE TABLE IF NOT EXISTS %1 (
+                bucket TEXT NOT NULL,
+                operator TEXT NOT NULL,
+                analyte TEXT NOT NULL,
+                value_count INTEGER NOT NULL,
+                value_sum REAL NOT NULL,
+                value_sum_squares REAL NOT NULL,
+                value_min REAL NOT NULL,
+                value_max REAL NOT NULL,
+                PRIMARY KEY (bucket, operator, analyte)
+            ) WITHOUT ROWID
+        )").arg(table);
+        
+        if (!query.exec(sql)) {
+            qCritical() << "Failed to create" << table << "table:" << query.lastError().text();
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+bool DatabaseManager::createQcTables()
+{
+    const QStringList queries = {
+        R"(
+            CREATE TABLE IF NOT EXISTS qc_targets (
+                level INTEGER NOT NULL,
+                analyte TEXT NOT NULL,
+                mean REAL NOT NULL,
+                sd REAL NOT NULL,
+                updated_by TEXT,
+                updated_at DATETIME DEFAULT CURRENT_TIMESTAMP,
+                PRIMARY KEY (level, analyte)
+            )
+        )",
+        R"(
+            CREATE TABLE IF NOT EXISTS qc_runs (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                timestamp DATETIME NOT NULL,
+                operator TEXT,
+                rejected INTEGER NOT NULL
+            )
+        )",
+        R"(
+            CREATE TABLE IF NOT EXISTS qc_results (
+                run_id INTEGER NOT NULL REFERENCES qc_runs(id),
+                level INTEGER NOT NULL,
+                analyte TEXT NOT NULL,
+                value REAL NOT NULL,
+                z REAL NOT NULL,
+                rules INTEGER NOT NULL,
+                PRIMARY KEY (run_id, level, analyte)
+            )
+        )",
+        R"(
+            CREATE TABLE IF NOT EXISTS qc_violations (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                run_id INTEGER NOT NULL REFERENCES qc_runs(id),
+                level INTEGER NOT NULL,
+                analyte TEXT NOT NULL,
+                rule TEXT NOT NULL,
+                value REAL NOT NULL,
+                z REAL NOT NULL,
+                reject INTEGER NOT NULL,
+                acknowledged_by TEXT,
+                acknowledged_at DATETIME,
+                corrective_action TEXT
+            )
+        )",
+        "CREATE INDEX IF NOT EXISTS idx_qc_violations_open ON qc_violations (acknowledged_at, reject)"
+    };
+    
+    if (!executeBatch(queries)) {
+        qCritical() << "Failed to create QC tables";
+        return false;
+    }
+    
+    return true;
+}
+
+bool DatabaseManager::createDriftStateTable()
+{
+    QSqlQuery query(m_database);
+    QString sql = R"(
+        CREATE TABLE IF NOT EXISTS patient_drift_state (
+            analyte TEXT PRIMARY KEY,
+            baseline_mean REAL NOT NULL,
+            baseline_sd REAL NOT NULL,
+            ewma REAL NOT NULL,
+            cusum_high REAL NOT NULL,
+            cusum_low REAL NOT NULL,
+            result_count INTEGER NOT NULL,
+            truncated_count INTEGER NOT NULL,
+            drift INTEGER NOT NULL,
+            updated_at DATETIME DEFAULT CURRENT_TIMESTAMP
+        )
+    )";
+    
+    if (!query.exec(sql)) {
+        qCritical() << "Failed to create patient_drift_state table:" << query.lastError().text();
+        return false;
+    }
+    
+    return true;
+}
+
+bool DatabaseManager::createReferenceRangeTables()
+{
+    QStringList queries = {
+        R"(
+        CREATE TABLE IF NOT EXISTS reference_range_sets (
+            revision INTEGER PRIMARY KEY AUTOINCREMENT,
+            created_by TEXT,
+            created_at DATETIME DEFAULT CURRENT_TIMESTAMP
+        )
+        )",
+        // NULL specimen, sex or age bound matches every patient
+        R"(
+        CREATE TABLE IF NOT EXISTS reference_ranges (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            revision INTEGER NOT NULL,
+            analyte TEXT NOT NULL,
+            specimen TEXT,
+            sex TEXT,
+            min_age_days INTEGER,
+            max_age_days INTEGER,
+            low REAL,
+            high REAL,
+            critical_low REAL,
+            critical_high REAL
+        )
+        )",
+        "CREATE INDEX IF NOT EXISTS idx_reference_ranges_revision ON reference_ranges(revision)"
+    };
+    
+    if (!executeBatch(queries)) {
+        qCritical() << "Failed to create reference range tables";
+        return false;
+    }
+    
+    return true;
+}
+
 bool DatabaseManager::createUser(const QString &username, const QString &password, const QString &role)
 {
     if (!isConnected() || username.isEmpty() || password.isEmpty()) {
@@ -260,9 +733,20 @@ bool DatabaseManager::authenticateUser(const QString &username, const QString &p
 }
 
 bool DatabaseManager::saveResult(const QVariantMap &result)
+{
+    return insertResult(result) >= 0;
+}
+
+int DatabaseManager::insertResult(const QVariantMap &result)
 {
     if (!isConnected()) {
-        return false;
+        return -1;
+    }
+    
+    // The rollups change with the result or not at all
+    if (!m_database.transaction()) {
+        qWarning() << "Failed to begin transaction:" << m_database.lastError().text();
+        return -1;
     }
     
     QSqlQuery query(m_database);
@@ -270,8 +754,10 @@ bool DatabaseManager::saveResult(const QVariantMap &result)
         INSERT INTO results (
             timestamp, operator, sample_id, patient_id,
             pH, pCO2, pO2, HCO3, SO2, BE,
-            Na, K, Cl, Ca, Glucose, Lactate, temperature, raw_data
-        ) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
+            Na, K, Cl, Ca, Glucose, Lactate, temperature, raw_data,
+            acid_base_flags, critical_flags, low_flags, high_flags, rule_version,
+            specimen, patient_sex, patient_age_days
+        ) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
     )";
     
     query.prepare(sql);
@@ -296,16 +782,44 @@ bool DatabaseManager::saveResult(const QVariantMap &result)
     // Store raw data as JSON
     QJsonDocument rawDoc = QJsonDocument::fromVariant(result);
     query.addBindValue(rawDoc.toJson(QJsonDocument::Compact));
+    query.addBindValue(result.value("acidBaseFlags"));
+    query.addBindValue(result.value("criticalFlags"));
+    query.addBindValue(result.value("lowFlags"));
+    query.addBindValue(result.value("highFlags"));
+    query.addBindValue(result.value("ruleVersion"));
+    query.addBindValue(result.value("specimen"));
+    query.addBindValue(result.value("sex"));
+    query.addBindValue(result.value("ageDays"));
     
     if (!query.exec()) {
         qWarning() << "Failed to save result:" << query.lastError().text();
-        return false;
+        m_database.rollback();
+        return -1;
+    }
+    
+    const int id = query.lastInsertId().toInt();
+    const QDateTime time = QDateTime::fromString(result.value("timestamp").toString(), Qt::ISODate);
+    if (time.isValid()) {
+        for (int granularity = 0; granularity < ROLLUP_GRANULARITY_COUNT; ++granularity) {
+            RollupRows rows;
+            addToRollupRows(rows, time, result.value("operator").toString(), result, granularity);
+            if (!writeRollupRows(m_database, granularity, rows)) {
+                m_database.rollback();
+                return -1;
+            }
+        }
+    }
+    
+    if (!m_database.commit()) {
+        qWarning() << "Failed to commit result:" << m_database.lastError().text();
+        m_database.rollback();
+        return -1;
     }
     
     logAuditEvent("RESULT_SAVED", result.value("operator").toString(),
                   QVariantMap{{"sampleId", result.value("sampleId")}, 
                              {"patientId", result.value("patientId")}});
-    return true;
+    return id;
 }
 
 QVariantList DatabaseManager::getAllResults()
@@ -344,6 +858,16 @@ QVariantList DatabaseManager::getAllResults()
             }
         }
         
+        // Flags from the latest re-flagging win over the copy in raw_data
+        if (!result.value("rule_version").isNull()) {
+            ResultRules::Flags flags;
+            flags.acidBase = quint16(result.value("acid_base_flags").toUInt());
+            flags.critical = quint16(result.value("critical_flags").toUInt());
+            flags.low = quint16(result.value("low_flags").toUInt());
+            flags.high = quint16(result.value("high_flags").toUInt());
+            ResultRules::annotate(result, flags, result.value("rule_version").toInt());
+        }
+        
         results.append(result);
     }
     
@@ -356,17 +880,58 @@ bool DatabaseManager::removeResult(int id)
         return false;
     }
     
+    if (!m_database.transaction()) {
+        qWarning() << "Failed to begin transaction:" << m_database.lastError().text();
+        return false;
+    }
+    
     QSqlQuery query(m_database);
+    query.prepare("SELECT timestamp, operator FROM results WHERE id = ?");
+    query.addBindValue(id);
+    if (!query.exec()) {
+        qWarning() << "Failed to read result:" << query.lastError().text();
+        m_database.rollback();
+        return false;
+    }
+    QDateTime time;
+    QString operatorName;
+    if (query.next()) {
+        time = QDateTime::fromString(query.value(0).toString(), Qt::ISODate);
+        operatorName = query.value(1).toString();
+    }
+    
     query.prepare("DELETE FROM results WHERE id = ?");
     query.addBindValue(id);
     
     if (!query.exec()) {
         qWarning() << "Failed to remove result:" << query.lastError().text();
+        m_database.rollback();
+        return false;
+    }
+    const bool removed = query.numRowsAffected() > 0;
+    
+    // A removed value may have been a bucket's min or max, so the buckets
+    // are recomputed rather than subtracted from
+    if (removed && time.isValid() && !recomputeRollups(time, operatorName)) {
+        m_database.rollback();
+        return false;
+    }
+    
+    QSqlQuery waveformQuery(m_database);
+    waveformQuery.prepare("DELETE FROM result_waveforms WHERE result_id = ?");
+    waveformQuery.addBindValue(id);
+    if (!waveformQuery.exec()) {
+        qWarning() << "Failed to remove result waveform:" << waveformQuery.lastError().text();
+    }
+    
+    if (!m_database.commit()) {
+        qWarning() << "Failed to commit result removal:" << m_database.lastError().text();
+        m_database.rollback();
         return false;
     }
     
     logAuditEvent("RESULT_DELETED", "SYSTEM", QVariantMap{{"resultId", id}});
-    return query.numRowsAffected() > 0;
+    return removed;
 }
 
 bool DatabaseManager::clearAllResults()
@@ -375,9 +940,31 @@ bool DatabaseManager::clearAllResults()
         return false;
     }
     
+    if (!m_database.transaction()) {
+        qWarning() << "Failed to begin transaction:" << m_database.lastError().text();
+        return false;
+    }
+    
     QSqlQuery query(m_database);
     if (!query.exec("DELETE FROM results")) {
         qWarning() << "Failed to clear all results:" << query.lastError().text();
+        m_database.rollback();
+        return false;
+    }
+    for (const char *table : ROLLUP_TABLES) {
+        if (!query.exec(QString("DELETE FROM %1").arg(table))) {
+            qWarning() << "Failed to clear" << table << ":" << query.lastError().text();
+            m_database.rollback();
+            return false;
+        }
+    }
+    if (!query.exec("DELETE FROM result_waveforms")) {
+        qWarning() << "Failed to clear result waveforms:" << query.lastError().text();
+    }
+    
+    if (!m_database.commit()) {
+        qWarning() << "Failed to commit clearing results:" << m_database.lastError().text();
+        m_database.rollback();
         return false;
     }
     
@@ -385,10 +972,1105 @@ bool DatabaseManager::clearAllResults()
     return true;
 }
 
-void DatabaseManager::logAuditEvent(const QString& event, const QString& username, const QVariantMap& details)
+QVariantList DatabaseManager::getRollups(const QString &granularity, const QDateTime &from, const QDateTime &to,
+                                         bool byOperator)
 {
+    QVariantList rollups;
     if (!isConnected()) {
-        return;
+        return rollups;
+    }
+    const int index = int(std::find_if(std::begin(ROLLUP_GRANULARITIES), std::end(ROLLUP_GRANULARITIES),
+                                       [&granularity](const char *name) { return granularity == QLatin1String(name); })
+                          - std::begin(ROLLUP_GRANULARITIES));
+    if (index >= ROLLUP_GRANULARITY_COUNT) {
+        qWarning() << "Unknown rollup granularity:" << granularity;
+        return rollups;
+    }
+    
+    QString sql = byOperator
+        ? "SELECT bucket, operator, analyte, value_count, value_sum, value_sum_squares, value_min, value_max FROM %1"
+        : "SELECT bucket, '', analyte, SUM(value_count), SUM(value_sum), SUM(value_sum_squares), "
+          "MIN(value_min), MAX(value_max) FROM %1";
+    sql = sql.arg(ROLLUP_TABLES[index]);
+    QStringList conditions;
+    if (from.isValid()) {
+        conditions.append("bucket >= ?");
+    }
+    if (to.isValid()) {
+        conditions.append("bucket <= ?");
+    }
+    if (!conditions.isEmpty()) {
+        sql += " WHERE " + conditions.join(" AND ");
+    }
+    if (!byOperator) {
+        sql += " GROUP BY bucket, analyte";
+    }
+    sql += " ORDER BY 1, 2, 3";
+    
+    QSqlQuery query(m_database);
+    query.setForwardOnly(true);
+    query.prepare(sql);
+    if (from.isValid()) {
+        query.addBindValue(rollupBucket(rollupBucketStart(from, index), index));
+    }
+    if (to.isValid()) {
+        query.addBindValue(rollupBucket(rollupBucketStart(to, index), index));
+    }
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to get rollups:" << query.lastError().text();
+        return rollups;
+    }
+    
+    while (query.next()) {
+        const qint64 count = query.value(3).toLongLong();
+        const double sum = query.value(4).toDouble();
+        const double sumSquares = query.value(5).toDouble();
+        QVariantMap rollup;
+        rollup["bucket"] = query.value(0);
+        rollup["operator"] = query.value(1);
+        rollup["analyte"] = query.value(2);
+        rollup["count"] = count;
+        rollup["sum"] = sum;
+        rollup["sumSquares"] = sumSquares;
+        rollup["min"] = query.value(6);
+        rollup["max"] = query.value(7);
+        rollup["mean"] = count > 0 ? sum / count : 0.0;
+        rollup["sd"] = count > 1 ? std::sqrt(std::max(0.0, (sumSquares - sum * sum / count) / (count - 1))) : 0.0;
+        rollups.append(rollup);
+    }
+    
+    return rollups;
+}
+
+bool DatabaseManager::rebuildRollups()
+{
+    if (!isConnected()) {
+        return false;
+    }
+    
+    if (!m_database.transaction()) {
+        qWarning() << "Failed to begin transaction:" << m_database.lastError().text();
+        return false;
+    }
+    
+    QSqlQuery query(m_database);
+    for (const char *table : ROLLUP_TABLES) {
+        if (!query.exec(QString("DELETE FROM %1").arg(table))) {
+            qWarning() << "Failed to clear" << table << ":" << query.lastError().text();
+            m_database.rollback();
+            return false;
+        }
+    }
+    
+    // A chunk at a time, since the rows add up
+    const int chunkSize = 4096;
+    qint64 lastId = 0;
+    qint64 resultCount = 0;
+    for (;;) {
+        const QVariantList results = getResultsAfter(lastId, chunkSize);
+        if (results.isEmpty()) {
+            break;
+        }
+        for (int granularity = 0; granularity < ROLLUP_GRANULARITY_COUNT; ++granularity) {
+            RollupRows rows;
+            for (const QVariant &item : results) {
+                const QVariantMap result = item.toMap();
+                const QDateTime time = QDateTime::fromString(result.value("timestamp").toString(), Qt::ISODate);
+                if (time.isValid()) {
+                    addToRollupRows(rows, time, result.value("operator").toString(), result, granularity);
+                }
+            }
+            if (!writeRollupRows(m_database, granularity, rows)) {
+                m_database.rollback();
+                return false;
+            }
+        }
+        lastId = results.last().toMap().value("id").toLongLong();
+        resultCount += results.size();
+    }
+    
+    if (!m_database.commit()) {
+        qWarning() << "Failed to commit rollups:" << m_database.lastError().text();
+        m_database.rollback();
+        return false;
+    }
+    
+    logAuditEvent("ROLLUPS_REBUILT", "SYSTEM", QVariantMap{{"results", resultCount}});
+    return true;
+}
+
+bool DatabaseManager::recomputeRollups(const QDateTime &time, const QString &operatorName)
+{
+    QStringList fields;
+    for (const char *field : ResultRules::ANALYTE_FIELDS) {
+        fields.append(field);
+    }
+    
+    QSqlQuery query(m_database);
+    for (int granularity = 0; granularity < ROLLUP_GRANULARITY_COUNT; ++granularity) {
+        const QDateTime start = rollupBucketStart(time, granularity);
+        const QString bucket = rollupBucket(start, granularity);
+        
+        query.prepare(QString("DELETE FROM %1 WHERE bucket = ? AND operator = ?").arg(ROLLUP_TABLES[granularity]));
+        query.addBindValue(bucket);
+        query.addBindValue(operatorName);
+        if (!query.exec()) {
+            qWarning() << "Failed to clear" << ROLLUP_TABLES[granularity] << "bucket:" << query.lastError().text();
+            return false;
+        }
+        
+        // ISO timestamps sort as strings
+        query.prepare(QString("SELECT %1 FROM results WHERE timestamp >= ? AND timestamp < ? AND operator = ?")
+                          .arg(fields.join(", ")));
+        query.addBindValue(start.toString(Qt::ISODate));
+        query.addBindValue(rollupBucketEnd(start, granularity).toString(Qt::ISODate));
+        query.addBindValue(operatorName);
+        if (!query.exec()) {
+            qWarning() << "Failed to read results for rollups:" << query.lastError().text();
+            return false;
+        }
+        
+        RollupRows rows;
+        while (query.next()) {
+            QVariantMap result;
+            for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+                result[ResultRules::ANALYTE_FIELDS[analyte]] = query.value(analyte);
+            }
+            addToRollupRows(rows, start, operatorName, result, granularity);
+        }
+        if (!writeRollupRows(m_database, granularity, rows)) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+bool DatabaseManager::saveWaveform(int resultId, const QByteArray &waveform)
+{
+    if (!isConnected() || resultId <= 0 || waveform.isEmpty()) {
+        return false;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare("INSERT OR REPLACE INTO result_waveforms (result_id, waveform) VALUES (?, ?)");
+    query.addBindValue(resultId);
+    query.addBindValue(waveform);
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to save result waveform:" << query.lastError().text();
+        return false;
+    }
+    
+    return true;
+}
+
+QByteArray DatabaseManager::getWaveform(int resultId)
+{
+    if (!isConnected() || resultId <= 0) {
+        return QByteArray();
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare("SELECT waveform FROM result_waveforms WHERE result_id = ?");
+    query.addBindValue(resultId);
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to get result waveform:" << query.lastError().text();
+        return QByteArray();
+    }
+    
+    return query.next() ? query.value(0).toByteArray() : QByteArray();
+}
+
+QVariantMap DatabaseManager::getReflagJob(int ruleVersion)
+{
+    QVariantMap job;
+    if (!isConnected()) {
+        return job;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare("SELECT * FROM reflag_jobs WHERE rule_version = ?");
+    query.addBindValue(ruleVersion);
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to get reflag job:" << query.lastError().text();
+        return job;
+    }
+    
+    if (query.next()) {
+        QSqlRecord record = query.record();
+        for (int i = 0; i < record.count(); ++i) {
+            job[record.fieldName(i)] = record.value(i);
+        }
+    }
+    
+    return job;
+}
+
+bool DatabaseManager::beginReflagJob(int ruleVersion)
+{
+    if (!isConnected()) {
+        return false;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare("INSERT OR IGNORE INTO reflag_jobs (rule_version) VALUES (?)");
+    query.addBindValue(ruleVersion);
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to begin reflag job:" << query.lastError().text();
+        return false;
+    }
+    
+    return true;
+}
+
+bool DatabaseManager::finishReflagJob(int ruleVersion)
+{
+    if (!isConnected()) {
+        return false;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare("UPDATE reflag_jobs SET finished_at = CURRENT_TIMESTAMP WHERE rule_version = ?");
+    query.addBindValue(ruleVersion);
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to finish reflag job:" << query.lastError().text();
+        return false;
+    }
+    
+    logAuditEvent("RESULTS_REFLAGGED", "SYSTEM", QVariantMap{{"ruleVersion", ruleVersion}});
+    return true;
+}
+
+qint64 DatabaseManager::countResultsToReflag(int ruleVersion)
+{
+    if (!isConnected()) {
+        return 0;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare("SELECT COUNT(*) FROM results WHERE rule_version IS NULL OR rule_version <> ?");
+    query.addBindValue(ruleVersion);
+    
+    if (!query.exec() || !query.next()) {
+        qWarning() << "Failed to count results to reflag:" << query.lastError().text();
+        return 0;
+    }
+    
+    return query.value(0).toLongLong();
+}
+
+bool DatabaseManager::readResultColumns(qint64 afterId, int limit, int ruleVersion, ResultRules::ResultColumns &columns)
+{
+    columns.clear();
+    if (!isConnected()) {
+        return false;
+    }
+    
+    // Keyset paging on the primary key: every chunk is an index range
+    // scan, however far into the table the job is
+    QStringList fields;
+    for (const char *field : ResultRules::ANALYTE_FIELDS) {
+        fields.append(field);
+    }
+    QSqlQuery query(m_database);
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT id, specimen, patient_sex, patient_age_days, %1 FROM results "
+                          "WHERE id > ? AND (rule_version IS NULL OR rule_version <> ?) "
+                          "ORDER BY id LIMIT ?").arg(fields.join(", ")));
+    query.addBindValue(afterId);
+    query.addBindValue(ruleVersion);
+    query.addBindValue(limit);
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to read results:" << query.lastError().text();
+        return false;
+    }
+    
+    const float missing = std::numeric_limits<float>::quiet_NaN();
+    while (query.next()) {
+        columns.ids.append(query.value(0).toLongLong());
+        columns.patients.append(ResultRules::demographics(query.value(1).toString(), query.value(2).toString(),
+                                                          query.value(3)));
+        for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+            const QVariant value = query.value(analyte + 4);
+            columns.values[analyte].append(value.isNull() ? missing : value.toFloat());
+        }
+    }
+    
+    return true;
+}
+
+bool DatabaseManager::updateResultFlags(int ruleVersion, const ResultRules::ResultColumns &columns,
+                                        const ResultRules::FlagColumns &flags)
+{
+    if (!isConnected() || columns.size() == 0) {
+        return false;
+    }
+    
+    QVariantList acidBase;
+    QVariantList critical;
+    QVariantList low;
+    QVariantList high;
+    QVariantList versions;
+    QVariantList ids;
+    acidBase.reserve(columns.size());
+    critical.reserve(columns.size());
+    low.reserve(columns.size());
+    high.reserve(columns.size());
+    versions.reserve(columns.size());
+    ids.reserve(columns.size());
+    for (qsizetype i = 0; i < columns.size(); ++i) {
+        acidBase.append(int(flags.acidBase.at(i)));
+        critical.append(int(flags.critical.at(i)));
+        low.append(int(flags.low.at(i)));
+        high.append(int(flags.high.at(i)));
+        versions.append(ruleVersion);
+        ids.append(columns.ids.at(i));
+    }
+    
+    if (!m_database.transaction()) {
+        qWarning() << "Failed to begin transaction:" << m_database.lastError().text();
+        return false;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare("UPDATE results SET acid_base_flags = ?, critical_flags = ?, low_flags = ?, high_flags = ?, "
+                  "rule_version = ? WHERE id = ?");
+    query.addBindValue(acidBase);
+    query.addBindValue(critical);
+    query.addBindValue(low);
+    query.addBindValue(high);
+    query.addBindValue(versions);
+    query.addBindValue(ids);
+    bool ok = query.execBatch();
+    
+    QSqlQuery progressQuery(m_database);
+    progressQuery.prepare("UPDATE reflag_jobs SET last_id = ?, processed = processed + ? WHERE rule_version = ?");
+    progressQuery.addBindValue(columns.ids.last());
+    progressQuery.addBindValue(columns.size());
+    progressQuery.addBindValue(ruleVersion);
+    ok = ok && progressQuery.exec();
+    
+    if (!ok || !m_database.commit()) {
+        qWarning() << "Failed to update result flags:" << query.lastError().text() << progressQuery.lastError().text();
+        m_database.rollback();
+        return false;
+    }
+    
+    return true;
+}
+
+bool DatabaseManager::loadReferenceRanges(QList<ResultRules::RangeRule> &rules, int &revision)
+{
+    rules.clear();
+    revision = 0;
+    if (!isConnected()) {
+        return false;
+    }
+    
+    // The latest set is the one in force; 0 when none was ever saved
+    QSqlQuery query(m_database);
+    if (!query.exec("SELECT COALESCE(MAX(revision), 0) FROM reference_range_sets") || !query.next()) {
+        qWarning() << "Failed to read reference range sets:" << query.lastError().text();
+        return false;
+    }
+    const int latest = query.value(0).toInt();
+    
+    query.setForwardOnly(true);
+    query.prepare(R"(
+        SELECT analyte, specimen, sex, min_age_days, max_age_days, low, high, critical_low, critical_high
+        FROM reference_ranges WHERE revision = ? ORDER BY id
+    )");
+    query.addBindValue(latest);
+    if (!query.exec()) {
+        qWarning() << "Failed to load reference ranges:" << query.lastError().text();
+        return false;
+    }
+    
+    auto limit = [&query](int column) {
+        return query.isNull(column) ? std::numeric_limits<float>::quiet_NaN() : query.value(column).toFloat();
+    };
+    while (query.next()) {
+        const QString analyte = query.value(0).toString();
+        const auto field = std::find_if(std::begin(ResultRules::ANALYTE_FIELDS), std::end(ResultRules::ANALYTE_FIELDS),
+                                        [&analyte](const char *name) { return analyte == QLatin1String(name); });
+        if (field == std::end(ResultRules::ANALYTE_FIELDS)) {
+            qWarning() << "Skipping reference range for unknown analyte" << analyte;
+            continue;
+        }
+        
+        ResultRules::RangeRule rule;
+        rule.analyte = ResultRules::Analyte(field - std::begin(ResultRules::ANALYTE_FIELDS));
+        rule.specimen = ResultRules::specimenFromString(query.value(1).toString());
+        rule.sex = ResultRules::sexFromString(query.value(2).toString());
+        if (!query.isNull(3)) {
+            rule.minAgeDays = query.value(3).toInt();
+        }
+        if (!query.isNull(4)) {
+            rule.maxAgeDays = query.value(4).toInt();
+        }
+        rule.limits = {limit(5), limit(6), limit(7), limit(8)};
+        rules.append(rule);
+    }
+    revision = latest;
+    
+    return true;
+}
+
+int DatabaseManager::saveReferenceRanges(const QList<ResultRules::RangeRule> &rules, const QString &username)
+{
+    if (!isConnected()) {
+        return -1;
+    }
+    
+    if (!m_database.transaction()) {
+        qWarning() << "Failed to begin transaction:" << m_database.lastError().text();
+        return -1;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare("INSERT INTO reference_range_sets (created_by) VALUES (?)");
+    query.addBindValue(username);
+    if (!query.exec()) {
+        qWarning() << "Failed to save reference range set:" << query.lastError().text();
+        m_database.rollback();
+        return -1;
+    }
+    const int revision = query.lastInsertId().toInt();
+    
+    auto limit = [](float value) { return std::isnan(value) ? QVariant() : QVariant(double(value)); };
+    auto text = [](const char *value) { return *value ? QVariant(QString::fromLatin1(value)) : QVariant(); };
+    query.prepare(R"(
+        INSERT INTO reference_ranges (
+            revision, analyte, specimen, sex, min_age_days, max_age_days, low, high, critical_low, critical_high
+        ) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
+    )");
+    for (const ResultRules::RangeRule &rule : rules) {
+        query.addBindValue(revision);
+        query.addBindValue(QString::fromLatin1(ResultRules::ANALYTE_FIELDS[rule.analyte]));
+        query.addBindValue(text(ResultRules::specimenName(rule.specimen)));
+        query.addBindValue(text(ResultRules::sexName(rule.sex)));
+        query.addBindValue(rule.minAgeDays == std::numeric_limits<qint32>::min() ? QVariant() : QVariant(rule.minAgeDays));
+        query.addBindValue(rule.maxAgeDays == std::numeric_limits<qint32>::max() ? QVariant() : QVariant(rule.maxAgeDays));
+        query.addBindValue(limit(rule.limits.low));
+        query.addBindValue(limit(rule.limits.high));
+        query.addBindValue(limit(rule.limits.criticalLow));
+        query.addBindValue(limit(rule.limits.criticalHigh));
+        if (!query.exec()) {
+            qWarning() << "Failed to save reference range:" << query.lastError().text();
+            m_database.rollback();
+            return -1;
+        }
+    }
+    
+    if (!m_database.commit()) {
+        qWarning() << "Failed to save reference ranges:" << m_database.lastError().text();
+        m_database.rollback();
+        return -1;
+    }
+    
+    logAuditEvent("REFERENCE_RANGES_SAVED", username, QVariantMap{{"revision", revision}, {"rules", rules.size()}});
+    return revision;
+}
+
+bool DatabaseManager::saveQuantileSketches(const QVariantList &sketches)
+{
+    if (!isConnected()) {
+        return false;
+    }
+    if (sketches.isEmpty()) {
+        return true;
+    }
+    
+    QVariantList dimensions;
+    QVariantList keys;
+    QVariantList analytes;
+    QVariantList counts;
+    QVariantList blobs;
+    for (const QVariant &item : sketches) {
+        const QVariantMap sketch = item.toMap();
+        dimensions.append(sketch.value("dimension"));
+        keys.append(sketch.value("key"));
+        analytes.append(sketch.value("analyte"));
+        counts.append(sketch.value("count"));
+        blobs.append(sketch.value("sketch"));
+    }
+    
+    if (!m_database.transaction()) {
+        qWarning() << "Failed to begin transaction:" << m_database.lastError().text();
+        return false;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare("INSERT OR REPLACE INTO quantile_sketches (dimension, key, analyte, count, sketch, updated_at) "
+                  "VALUES (?, ?, ?, ?, ?, CURRENT_TIMESTAMP)");
+    query.addBindValue(dimensions);
+    query.addBindValue(keys);
+    query.addBindValue(analytes);
+    query.addBindValue(counts);
+    query.addBindValue(blobs);
+    
+    if (!query.execBatch() || !m_database.commit()) {
+        qWarning() << "Failed to save quantile sketches:" << query.lastError().text();
+        m_database.rollback();
+        return false;
+    }
+    
+    return true;
+}
+
+QVariantList DatabaseManager::loadQuantileSketches(const QString &dimension, const QString &fromKey,
+                                                   const QString &toKey)
+{
+    QVariantList sketches;
+    if (!isConnected()) {
+        return sketches;
+    }
+    
+    QString sql = "SELECT dimension, key, analyte, count, sketch FROM quantile_sketches WHERE dimension = ?";
+    if (!fromKey.isEmpty()) {
+        sql += " AND key >= ?";
+    }
+    if (!toKey.isEmpty()) {
+        sql += " AND key <= ?";
+    }
+    QSqlQuery query(m_database);
+    query.setForwardOnly(true);
+    query.prepare(sql);
+    query.addBindValue(dimension);
+    if (!fromKey.isEmpty()) {
+        query.addBindValue(fromKey);
+    }
+    if (!toKey.isEmpty()) {
+        query.addBindValue(toKey);
+    }
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to load quantile sketches:" << query.lastError().text();
+        return sketches;
+    }
+    
+    while (query.next()) {
+        QVariantMap sketch;
+        sketch["dimension"] = query.value(0);
+        sketch["key"] = query.value(1);
+        sketch["analyte"] = query.value(2);
+        sketch["count"] = query.value(3);
+        sketch["sketch"] = query.value(4);
+        sketches.append(sketch);
+    }
+    
+    return sketches;
+}
+
+QStringList DatabaseManager::getQuantileSketchKeys(const QString &dimension)
+{
+    QStringList keys;
+    if (!isConnected()) {
+        return keys;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare("SELECT DISTINCT key FROM quantile_sketches WHERE dimension = ? ORDER BY key");
+    query.addBindValue(dimension);
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to get quantile sketch keys:" << query.lastError().text();
+        return keys;
+    }
+    
+    while (query.next()) {
+        keys.append(query.value(0).toString());
+    }
+    
+    return keys;
+}
+
+bool DatabaseManager::clearQuantileSketches()
+{
+    if (!isConnected()) {
+        return false;
+    }
+    
+    QSqlQuery query(m_database);
+    if (!query.exec("DELETE FROM quantile_sketches")) {
+        qWarning() << "Failed to clear quantile sketches:" << query.lastError().text();
+        return false;
+    }
+    
+    return true;
+}
+
+QVariantList DatabaseManager::getQcTargets()
+{
+    QVariantList targets;
+    if (!isConnected()) {
+        return targets;
+    }
+    
+    QSqlQuery query(m_database);
+    if (!query.exec("SELECT level, analyte, mean, sd FROM qc_targets ORDER BY level, analyte")) {
+        qWarning() << "Failed to get QC targets:" << query.lastError().text();
+        return targets;
+    }
+    
+    while (query.next()) {
+        QVariantMap target;
+        target["level"] = query.value(0);
+        target["analyte"] = query.value(1);
+        target["mean"] = query.value(2);
+        target["sd"] = query.value(3);
+        targets.append(target);
+    }
+    
+    return targets;
+}
+
+bool DatabaseManager::saveQcTargets(const QVariantList &targets, const QString &username)
+{
+    if (!isConnected()) {
+        return false;
+    }
+    
+    if (!m_database.transaction()) {
+        qWarning() << "Failed to begin transaction:" << m_database.lastError().text();
+        return false;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare("INSERT OR REPLACE INTO qc_targets (level, analyte, mean, sd, updated_by, updated_at) "
+                  "VALUES (?, ?, ?, ?, ?, CURRENT_TIMESTAMP)");
+    for (const QVariant &item : targets) {
+        const QVariantMap target = item.toMap();
+        query.addBindValue(target.value("level"));
+        query.addBindValue(target.value("analyte"));
+        query.addBindValue(target.value("mean"));
+        query.addBindValue(target.value("sd"));
+        query.addBindValue(username);
+        if (!query.exec()) {
+            qWarning() << "Failed to save QC target:" << query.lastError().text();
+            m_database.rollback();
+            return false;
+        }
+    }
+    
+    if (!m_database.commit()) {
+        qWarning() << "Failed to save QC targets:" << m_database.lastError().text();
+        m_database.rollback();
+        return false;
+    }
+    
+    logAuditEvent("QC_TARGETS_SAVED", username, QVariantMap{{"targets", targets.size()}});
+    return true;
+}
+
+int DatabaseManager::saveQcRun(const QVariantMap &run)
+{
+    if (!isConnected()) {
+        return -1;
+    }
+    
+    if (!m_database.transaction()) {
+        qWarning() << "Failed to begin transaction:" << m_database.lastError().text();
+        return -1;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare("INSERT INTO qc_runs (timestamp, operator, rejected) VALUES (?, ?, ?)");
+    query.addBindValue(run.value("timestamp"));
+    query.addBindValue(run.value("operator"));
+    query.addBindValue(run.value("rejected").toBool() ? 1 : 0);
+    if (!query.exec()) {
+        qWarning() << "Failed to save QC run:" << query.lastError().text();
+        m_database.rollback();
+        return -1;
+    }
+    const int runId = query.lastInsertId().toInt();
+    
+    query.prepare("INSERT INTO qc_results (run_id, level, analyte, value, z, rules) VALUES (?, ?, ?, ?, ?, ?)");
+    for (const QVariant &item : run.value("values").toList()) {
+        const QVariantMap value = item.toMap();
+        query.addBindValue(runId);
+        query.addBindValue(value.value("level"));
+        query.addBindValue(value.value("analyte"));
+        query.addBindValue(value.value("value"));
+        query.addBindValue(value.value("z"));
+        query.addBindValue(value.value("rules"));
+        if (!query.exec()) {
+            qWarning() << "Failed to save QC result:" << query.lastError().text();
+            m_database.rollback();
+            return -1;
+        }
+    }
+    
+    query.prepare("INSERT INTO qc_violations (run_id, level, analyte, rule, value, z, reject) VALUES (?, ?, ?, ?, ?, ?, ?)");
+    for (const QVariant &item : run.value("violations").toList()) {
+        const QVariantMap violation = item.toMap();
+        query.addBindValue(runId);
+        query.addBindValue(violation.value("level"));
+        query.addBindValue(violation.value("analyte"));
+        query.addBindValue(violation.value("rule"));
+        query.addBindValue(violation.value("value"));
+        query.addBindValue(violation.value("z"));
+        query.addBindValue(violation.value("reject").toBool() ? 1 : 0);
+        if (!query.exec()) {
+            qWarning() << "Failed to save QC violation:" << query.lastError().text();
+            m_database.rollback();
+            return -1;
+        }
+    }
+    
+    if (!m_database.commit()) {
+        qWarning() << "Failed to save QC run:" << m_database.lastError().text();
+        m_database.rollback();
+        return -1;
+    }
+    
+    if (run.value("rejected").toBool()) {
+        logAuditEvent("QC_RUN_REJECTED", run.value("operator").toString(), QVariantMap{{"runId", runId}});
+    }
+    return runId;
+}
+
+bool DatabaseManager::getRecentQcValues(int perChannel, QVariantList &values)
+{
+    values.clear();
+    if (!isConnected()) {
+        return false;
+    }
+    
+    QSqlQuery query(m_database);
+    query.setForwardOnly(true);
+    query.prepare(R"(
+        SELECT level, analyte, value, run_id FROM (
+            SELECT qc_results.*, ROW_NUMBER() OVER (PARTITION BY level, analyte ORDER BY run_id DESC) AS position
+            FROM qc_results JOIN qc_runs ON qc_runs.id = qc_results.run_id
+            WHERE qc_runs.rejected = 0
+        ) WHERE position <= ? ORDER BY run_id
+    )");
+    query.addBindValue(perChannel);
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to get recent QC values:" << query.lastError().text();
+        return false;
+    }
+    
+    while (query.next()) {
+        QVariantMap value;
+        value["level"] = query.value(0);
+        value["analyte"] = query.value(1);
+        value["value"] = query.value(2);
+        value["runId"] = query.value(3);
+        values.append(value);
+    }
+    
+    return true;
+}
+
+bool DatabaseManager::getOpenQcViolations(QVariantList &violations)
+{
+    violations.clear();
+    if (!isConnected()) {
+        return false;
+    }
+    
+    QSqlQuery query(m_database);
+    if (!query.exec(R"(
+            SELECT qc_violations.id, run_id, timestamp, level, analyte, rule, value, z
+            FROM qc_violations JOIN qc_runs ON qc_runs.id = qc_violations.run_id
+            WHERE reject = 1 AND acknowledged_at IS NULL
+            ORDER BY qc_violations.id
+        )")) {
+        qWarning() << "Failed to get open QC violations:" << query.lastError().text();
+        return false;
+    }
+    
+    while (query.next()) {
+        QVariantMap violation;
+        violation["id"] = query.value(0);
+        violation["runId"] = query.value(1);
+        violation["timestamp"] = query.value(2);
+        violation["level"] = query.value(3);
+        violation["analyte"] = query.value(4);
+        violation["rule"] = query.value(5);
+        violation["value"] = query.value(6);
+        violation["z"] = query.value(7);
+        violation["reject"] = true;
+        violations.append(violation);
+    }
+    
+    return true;
+}
+
+bool DatabaseManager::getAcknowledgedQcRuns(QVariantList &runs)
+{
+    runs.clear();
+    if (!isConnected()) {
+        return false;
+    }
+    
+    QSqlQuery query(m_database);
+    if (!query.exec("SELECT level, analyte, MAX(run_id) FROM qc_violations "
+                    "WHERE reject = 1 AND acknowledged_at IS NOT NULL GROUP BY level, analyte")) {
+        qWarning() << "Failed to get acknowledged QC runs:" << query.lastError().text();
+        return false;
+    }
+    
+    while (query.next()) {
+        QVariantMap run;
+        run["level"] = query.value(0);
+        run["analyte"] = query.value(1);
+        run["runId"] = query.value(2);
+        runs.append(run);
+    }
+    
+    return true;
+}
+
+bool DatabaseManager::acknowledgeQcViolations(const QString &username, const QString &correctiveAction)
+{
+    if (!isConnected()) {
+        return false;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare("UPDATE qc_violations SET acknowledged_by = ?, acknowledged_at = CURRENT_TIMESTAMP, "
+                  "corrective_action = ? WHERE acknowledged_at IS NULL");
+    query.addBindValue(username);
+    query.addBindValue(correctiveAction);
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to acknowledge QC violations:" << query.lastError().text();
+        return false;
+    }
+    
+    logAuditEvent("QC_VIOLATIONS_ACKNOWLEDGED", username,
+                  QVariantMap{{"violations", query.numRowsAffected()}, {"correctiveAction", correctiveAction}});
+    return true;
+}
+
+QVariantList DatabaseManager::loadDriftState()
+{
+    QVariantList states;
+    if (!isConnected()) {
+        return states;
+    }
+    
+    QSqlQuery query(m_database);
+    if (!query.exec("SELECT analyte, baseline_mean, baseline_sd, ewma, cusum_high, cusum_low, "
+                    "result_count, truncated_count, drift FROM patient_drift_state")) {
+        qWarning() << "Failed to load drift state:" << query.lastError().text();
+        return states;
+    }
+    
+    while (query.next()) {
+        QVariantMap state;
+        state["analyte"] = query.value(0);
+        state["baselineMean"] = query.value(1);
+        state["baselineSd"] = query.value(2);
+        state["ewma"] = query.value(3);
+        state["cusumHigh"] = query.value(4);
+        state["cusumLow"] = query.value(5);
+        state["count"] = query.value(6);
+        state["truncated"] = query.value(7);
+        state["drift"] = query.value(8);
+        states.append(state);
+    }
+    
+    return states;
+}
+
+bool DatabaseManager::saveDriftState(const QVariantList &states)
+{
+    if (!isConnected()) {
+        return false;
+    }
+    
+    if (!m_database.transaction()) {
+        qWarning() << "Failed to begin transaction:" << m_database.lastError().text();
+        return false;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare(R"(
+        INSERT OR REPLACE INTO patient_drift_state (
+            analyte, baseline_mean, baseline_sd, ewma, cusum_high, cusum_low,
+            result_count, truncated_count, drift, updated_at
+        ) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, CURRENT_TIMESTAMP)
+    )");
+    for (const QVariant &item : states) {
+        const QVariantMap state = item.toMap();
+        query.addBindValue(state.value("analyte"));
+        query.addBindValue(state.value("baselineMean"));
+        query.addBindValue(state.value("baselineSd"));
+        query.addBindValue(state.value("ewma"));
+        query.addBindValue(state.value("cusumHigh"));
+        query.addBindValue(state.value("cusumLow"));
+        query.addBindValue(state.value("count"));
+        query.addBindValue(state.value("truncated"));
+        query.addBindValue(state.value("drift"));
+        if (!query.exec()) {
+            qWarning() << "Failed to save drift state:" << query.lastError().text();
+            m_database.rollback();
+            return false;
+        }
+    }
+    
+    if (!m_database.commit()) {
+        qWarning() << "Failed to save drift state:" << m_database.lastError().text();
+        m_database.rollback();
+        return false;
+    }
+    
+    return true;
+}
+
+bool DatabaseManager::saveWorklistOrder(const QVariantMap &order)
+{
+    if (!isConnected()) {
+        return false;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare(R"(
+        INSERT OR REPLACE INTO worklist (accession, barcode, patient_id, order_data, updated_at)
+        VALUES (?, ?, ?, ?, ?)
+    )");
+    query.addBindValue(order.value("accession"));
+    query.addBindValue(order.value("barcode"));
+    query.addBindValue(order.value("patientId"));
+    query.addBindValue(QJsonDocument::fromVariant(order).toJson(QJsonDocument::Compact));
+    query.addBindValue(QDateTime::currentDateTime());
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to save worklist order:" << query.lastError().text();
+        return false;
+    }
+    
+    return true;
+}
+
+bool DatabaseManager::removeWorklistOrder(const QString &accession)
+{
+    if (!isConnected() || accession.isEmpty()) {
+        return false;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare("DELETE FROM worklist WHERE accession = ?");
+    query.addBindValue(accession);
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to remove worklist order:" << query.lastError().text();
+        return false;
+    }
+    
+    return query.numRowsAffected() > 0;
+}
+
+bool DatabaseManager::saveWorklistPatient(const QVariantMap &patient)
+{
+    if (!isConnected()) {
+        return false;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare("INSERT OR REPLACE INTO worklist_patients (patient_id, patient_data, updated_at) VALUES (?, ?, ?)");
+    query.addBindValue(patient.value("patientId"));
+    query.addBindValue(QJsonDocument::fromVariant(patient).toJson(QJsonDocument::Compact));
+    query.addBindValue(QDateTime::currentDateTime());
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to save worklist patient:" << query.lastError().text();
+        return false;
+    }
+    
+    return true;
+}
+
+QVariantList DatabaseManager::getWorklistOrders(const QDateTime &since)
+{
+    QVariantList orders;
+    if (!isConnected()) {
+        return orders;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare("SELECT order_data, updated_at FROM worklist WHERE updated_at >= ?");
+    query.addBindValue(since);
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to get worklist orders:" << query.lastError().text();
+        return orders;
+    }
+    
+    while (query.next()) {
+        QVariantMap order = QJsonDocument::fromJson(query.value(0).toByteArray()).object().toVariantMap();
+        order["updatedAt"] = query.value(1).toDateTime();
+        orders.append(order);
+    }
+    
+    return orders;
+}
+
+QVariantList DatabaseManager::getWorklistPatients(const QDateTime &since)
+{
+    QVariantList patients;
+    if (!isConnected()) {
+        return patients;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare("SELECT patient_data, updated_at FROM worklist_patients WHERE updated_at >= ?");
+    query.addBindValue(since);
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to get worklist patients:" << query.lastError().text();
+        return patients;
+    }
+    
+    while (query.next()) {
+        QVariantMap patient = QJsonDocument::fromJson(query.value(0).toByteArray()).object().toVariantMap();
+        patient["updatedAt"] = query.value(1).toDateTime();
+        patients.append(patient);
+    }
+    
+    return patients;
+}
+
+bool DatabaseManager::purgeWorklist(const QDateTime &before)
+{
+    if (!isConnected()) {
+        return false;
+    }
+    
+    QSqlQuery query(m_database);
+    query.prepare("DELETE FROM worklist WHERE updated_at < ?");
+    query.addBindValue(before);
+    bool ok = query.exec();
+    
+    QSqlQuery patientQuery(m_database);
+    patientQuery.prepare("DELETE FROM worklist_patients WHERE updated_at < ?");
+    patientQuery.addBindValue(before);
+    ok = patientQuery.exec() && ok;
+    
+    if (!ok) {
+        qWarning() << "Failed to purge worklist";
+    }
+    
+    return ok;
+}
+
+void DatabaseManager::logAuditEvent(const QString& event, const QString& username, const QVariantMap& details)
+{
+    if (!isConnected()) {
+        return;
     }
     
     QSqlQuery query(m_database);
@@ -516,10 +2198,157 @@ QVariantList DatabaseManager::getResultsByOperator(const QString &operatorName)
     return QVariantList(); // Placeholder
 }
 
-QVariantList DatabaseManager::getResultsByPatient(const QString &patientId)
+QVariantList DatabaseManager::getRecentPatientResults(int perPatient, int limit)
 {
-    Q_UNUSED(patientId)
-    return QVariantList(); // Placeholder
+    QVariantList results;
+    if (!isConnected()) {
+        return results;
+    }
+    
+    QStringList fields;
+    for (const char *field : ResultRules::ANALYTE_FIELDS) {
+        fields.append(field);
+    }
+    QSqlQuery query(m_database);
+    query.setForwardOnly(true);
+    query.prepare(QString(R"(
+        SELECT patient_id, timestamp, %1 FROM (
+            SELECT *, ROW_NUMBER() OVER (PARTITION BY patient_id ORDER BY timestamp DESC) AS position
+            FROM results WHERE patient_id IS NOT NULL AND patient_id <> ''
+        ) WHERE position <= ? ORDER BY timestamp DESC LIMIT ?
+    )").arg(fields.join(", ")));
+    query.addBindValue(perPatient);
+    query.addBindValue(limit);
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to get recent patient results:" << query.lastError().text();
+        return results;
+    }
+    
+    while (query.next()) {
+        QVariantMap result;
+        result["patientId"] = query.value(0);
+        result["timestamp"] = query.value(1);
+        for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+            result[ResultRules::ANALYTE_FIELDS[analyte]] = query.value(analyte + 2);
+        }
+        results.append(result);
+    }
+    
+    return results;
+}
+
+QVariantList DatabaseManager::getResultsByPatient(const QString &patientId, int limit)
+{
+    QVariantList results;
+    if (!isConnected()) {
+        return results;
+    }
+    
+    QStringList fields;
+    for (const char *field : ResultRules::ANALYTE_FIELDS) {
+        fields.append(field);
+    }
+    // Served by idx_results_patient
+    QSqlQuery query(m_database);
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT patient_id, timestamp, %1 FROM results WHERE patient_id = ? "
+                          "ORDER BY timestamp DESC LIMIT ?").arg(fields.join(", ")));
+    query.addBindValue(patientId);
+    query.addBindValue(limit);
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to get patient results:" << query.lastError().text();
+        return results;
+    }
+    
+    while (query.next()) {
+        QVariantMap result;
+        result["patientId"] = query.value(0);
+        result["timestamp"] = query.value(1);
+        for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+            result[ResultRules::ANALYTE_FIELDS[analyte]] = query.value(analyte + 2);
+        }
+        results.append(result);
+    }
+    
+    return results;
+}
+
+bool DatabaseManager::getAnalyteSeries(int analyte, const QString &patientId,
+                                       QList<double> &times, QList<float> &values)
+{
+    times.clear();
+    values.clear();
+    if (!isConnected() || analyte < 0 || analyte >= ResultRules::ANALYTE_COUNT) {
+        return false;
+    }
+    
+    const QString field = ResultRules::ANALYTE_FIELDS[analyte];
+    QSqlQuery query(m_database);
+    query.setForwardOnly(true);
+    if (patientId.isEmpty()) {
+        query.prepare(QString("SELECT timestamp, %1 FROM results WHERE %1 IS NOT NULL "
+                              "ORDER BY timestamp").arg(field));
+    } else {
+        query.prepare(QString("SELECT timestamp, %1 FROM results WHERE patient_id = ? AND %1 IS NOT NULL "
+                              "ORDER BY timestamp").arg(field));
+        query.addBindValue(patientId);
+    }
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to get analyte series:" << query.lastError().text();
+        return false;
+    }
+    
+    while (query.next()) {
+        // Parsed here rather than in SQL, which would read local times as UTC
+        const QDateTime timestamp = QDateTime::fromString(query.value(0).toString(), Qt::ISODateWithMs);
+        if (!timestamp.isValid()) {
+            continue;
+        }
+        times.append(double(timestamp.toMSecsSinceEpoch()));
+        values.append(query.value(1).toFloat());
+    }
+    
+    return true;
+}
+
+QVariantList DatabaseManager::getResultsAfter(qint64 afterId, int limit)
+{
+    QVariantList results;
+    if (!isConnected()) {
+        return results;
+    }
+    
+    QStringList fields;
+    for (const char *field : ResultRules::ANALYTE_FIELDS) {
+        fields.append(field);
+    }
+    QSqlQuery query(m_database);
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT id, timestamp, operator, %1 FROM results WHERE id > ? ORDER BY id LIMIT ?")
+                      .arg(fields.join(", ")));
+    query.addBindValue(afterId);
+    query.addBindValue(limit);
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to read results:" << query.lastError().text();
+        return results;
+    }
+    
+    while (query.next()) {
+        QVariantMap result;
+        result["id"] = query.value(0);
+        result["timestamp"] = query.value(1);
+        result["operator"] = query.value(2);
+        for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+            result[ResultRules::ANALYTE_FIELDS[analyte]] = query.value(analyte + 3);
+        }
+        results.append(result);
+    }
+    
+    return results;
 }
 
 bool DatabaseManager::saveCalibrationData(const QVariantMap &calibrationData)
@@ -538,6 +2367,18 @@ QVariantList DatabaseManager::getCalibrationHistory()
     return QVariantList(); // Placeholder
 }
 
+bool DatabaseManager::executeBatch(const QStringList &queries)
+{
+    QSqlQuery query(m_database);
+    for (const QString &sql : queries) {
+        if (!query.exec(sql)) {
+            qWarning() << "Failed to execute query:" << query.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
 void DatabaseManager::encryptData(QByteArray &data) const
 {
     Q_UNUSED(data)
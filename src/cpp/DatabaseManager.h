@@ -7,6 +7,8 @@
 #include <QVariantMap>
 #include <QVariantList>
 
+namespace ResultRules { struct ResultColumns; struct FlagColumns; struct RangeRule; }
+
 class DatabaseManager : public QObject
 {
     Q_OBJECT
@@ -15,7 +17,12 @@ public:
     explicit DatabaseManager(QObject *parent = nullptr);
     ~DatabaseManager();
     
-    bool initializeDatabase();
+    // Opens the connection and sets up the schema, migrations and seed data;
+    // done once, on the main connection
+    bool initializeDatabase(const QString &connectionName = QString());
+    // Only opens a named connection to an initialized database, for use
+    // from another thread
+    bool openConnection(const QString &connectionName);
     bool isConnected() const;
     
     // User management
@@ -27,18 +34,100 @@ public:
     
     // Results management
     bool saveResult(const QVariantMap &result);
+    int insertResult(const QVariantMap &result); // returns the new row id, or -1
     QVariantList getAllResults();
     QVariantList getResultsByDateRange(const QDateTime &start, const QDateTime &end);
     QVariantList getResultsByOperator(const QString &operatorName);
-    QVariantList getResultsByPatient(const QString &patientId);
+    // The patient's latest results, newest first; this and
+    // getRecentPatientResults return only the fields a comparison needs
+    QVariantList getResultsByPatient(const QString &patientId, int limit);
+    // The latest perPatient results of each patient, newest first
+    QVariantList getRecentPatientResults(int perPatient, int limit);
+    // Stored values of one ResultRules::Analyte in time order, times in ms
+    // since the epoch; every patient's when patientId is empty
+    bool getAnalyteSeries(int analyte, const QString &patientId,
+                          QList<double> &times, QList<float> &values);
+    // Next results after afterId by id, with only the fields statistics
+    // are kept by
+    QVariantList getResultsAfter(qint64 afterId, int limit);
     bool removeResult(int id);
     bool clearAllResults();
     
+    // Count, sum, sum of squares, min and max of each analyte per operator
+    // and hour or day ("hour", "day"), kept in the same transaction as each
+    // result insert or removal. from and to pick the buckets they fall in,
+    // either end open when invalid; without byOperator the operators of a
+    // bucket are combined. Rows add mean and sd.
+    QVariantList getRollups(const QString &granularity, const QDateTime &from, const QDateTime &to,
+                            bool byOperator = true);
+    // Recomputes the rollups from the stored results, for repair
+    bool rebuildRollups();
+    
+    // Raw electrode traces, as WaveformCodec blobs keyed by result id
+    bool saveWaveform(int resultId, const QByteArray &waveform);
+    QByteArray getWaveform(int resultId);
+    
+    // Re-flagging stored results under a new rule version. Progress is
+    // kept per rule version in reflag_jobs, so an interrupted job resumes.
+    QVariantMap getReflagJob(int ruleVersion);
+    bool beginReflagJob(int ruleVersion);
+    bool finishReflagJob(int ruleVersion);
+    qint64 countResultsToReflag(int ruleVersion);
+    // Next rows after afterId not yet flagged under ruleVersion, by id
+    bool readResultColumns(qint64 afterId, int limit, int ruleVersion, ResultRules::ResultColumns &columns);
+    // Writes a chunk's flags and the job's progress in one transaction
+    bool updateResultFlags(int ruleVersion, const ResultRules::ResultColumns &columns,
+                           const ResultRules::FlagColumns &flags);
+    
+    // Reference ranges and critical limits. Each save adds a new range set,
+    // so the ranges a result was flagged under stay on record.
+    bool loadReferenceRanges(QList<ResultRules::RangeRule> &rules, int &revision);
+    int saveReferenceRanges(const QList<ResultRules::RangeRule> &rules, const QString &username); // new revision, or -1
+    
+    // Quantile sketches (QuantileSketch blobs) by dimension, key and
+    // analyte. Saving replaces the stored sketch; loading reads the keys
+    // of a dimension between fromKey and toKey, either end open when empty.
+    bool saveQuantileSketches(const QVariantList &sketches);
+    QVariantList loadQuantileSketches(const QString &dimension, const QString &fromKey = QString(),
+                                      const QString &toKey = QString());
+    QStringList getQuantileSketchKeys(const QString &dimension);
+    bool clearQuantileSketches();
+    
+    // Westgard QC. Targets are per control level and analyte; a run is
+    // stored with its values and violations in one transaction, and its
+    // rejections stay open until a corrective action is recorded.
+    QVariantList getQcTargets();
+    bool saveQcTargets(const QVariantList &targets, const QString &username);
+    // run: timestamp, operator, rejected, values and violations (maps by
+    // level and analyte); returns the run id, or -1
+    int saveQcRun(const QVariantMap &run);
+    // The last perChannel values (level, analyte, value, runId) of each
+    // level and analyte from accepted runs, oldest first
+    bool getRecentQcValues(int perChannel, QVariantList &values);
+    bool getOpenQcViolations(QVariantList &violations);
+    // Per level and analyte, the last run whose rejection was acknowledged
+    // (level, analyte, runId)
+    bool getAcknowledgedQcRuns(QVariantList &runs);
+    bool acknowledgeQcViolations(const QString &username, const QString &correctiveAction);
+    
+    // Patient-based QC state per analyte (PatientDriftMonitor::status rows)
+    QVariantList loadDriftState();
+    bool saveDriftState(const QVariantList &states);
+    
     // Calibration data
     bool saveCalibrationData(const QVariantMap &calibrationData);
     QVariantMap getLatestCalibrationData();
     QVariantList getCalibrationHistory();
     
+    // Order worklist
+    bool saveWorklistOrder(const QVariantMap &order);
+    bool removeWorklistOrder(const QString &accession);
+    bool saveWorklistPatient(const QVariantMap &patient);
+    // Each with updatedAt, when it was last written
+    QVariantList getWorklistOrders(const QDateTime &since);
+    QVariantList getWorklistPatients(const QDateTime &since);
+    bool purgeWorklist(const QDateTime &before);
+    
     // Audit trail
     void logAuditEvent(const QString &event, const QString &username, const QVariantMap &details = QVariantMap());
     QVariantList getAuditTrail(const QDateTime &start = QDateTime(), const QDateTime &end = QDateTime());
@@ -48,11 +137,23 @@ signals:
     void connectionStatusChanged(bool connected);
     
 private:
+    bool openDatabase(const QString &connectionName);
     bool createTables();
     bool createUsersTable();
     bool createResultsTable();
     bool createCalibrationTable();
     bool createAuditTable();
+    bool createWorklistTables();
+    bool createWaveformTable();
+    bool createReflagTable();
+    bool createReferenceRangeTables();
+    bool createQuantileSketchTable();
+    bool createRollupTables();
+    bool createQcTables();
+    bool createDriftStateTable();
+    // Result bucket's rows from the stored results, after a removal
+    bool recomputeRollups(const QDateTime &time, const QString &operatorName);
+    bool addMissingColumns(const QString &table, const QList<QPair<QString, QString>> &columns);
     
     QString hashPassword(const QString &password, const QString &salt) const;
     QString generateSalt() const;
@@ -61,6 +162,7 @@ private:
     void decryptData(QByteArray &data) const;
     
     QSqlDatabase m_database;
+    QString m_connectionName;
     QString m_databasePath;
     bool m_isConnected;
     QByteArray m_encryptionKey;
@@ -0,0 +1,270 @@
+#include "DerivedParameters.h"
+
+#include <cmath>
+#include <limits>
+
+namespace {
+const float NaN = std::numeric_limits<float>::quiet_NaN();
+
+// Sample input defaults
+const float BODY_TEMPERATURE = 37.0f;
+const float ROOM_AIR_FIO2 = 0.21f;
+const float DEFAULT_HB = 15.0f; // g/dL
+
+const float BAROMETRIC_PRESSURE = 760.0f; // mmHg
+const float WATER_VAPOUR_PRESSURE = 47.0f; // mmHg at 37 °C
+const float RESPIRATORY_QUOTIENT = 0.8f;
+const float NORMAL_ALBUMIN = 4.0f; // g/dL
+const float HB_GDL_TO_MMOL = 0.6206f;
+
+constexpr quint32 bit(int n) { return 1u << n; }
+
+using namespace DerivedParameters;
+
+// The formulas, shared by the per-record and the column-wise paths. A NaN
+// input propagates to the result.
+
+inline float anionGap(float na, float cl, float hco3)
+{
+    return na - (cl + hco3);
+}
+
+// Figge: each g/dL of albumin below normal hides about 2.5 mmol/L of gap
+inline float anionGapAlbumin(float anionGap, float albumin)
+{
+    return anionGap + 2.5f * (NORMAL_ALBUMIN - albumin);
+}
+
+// Alveolar gas equation
+inline float aaGradient(float pCO2, float pO2, float fiO2)
+{
+    const float alveolarO2 = fiO2 * (BAROMETRIC_PRESSURE - WATER_VAPOUR_PRESSURE) - pCO2 / RESPIRATORY_QUOTIENT;
+    return alveolarO2 - pO2;
+}
+
+inline float pfRatio(float pO2, float fiO2)
+{
+    return pO2 / fiO2;
+}
+
+// CLSI C46: bicarbonate at pCO2 40 mmHg, 37 °C and full saturation
+inline float standardHCO3(float be, float sO2, float hb)
+{
+    const float ctHb = hb * HB_GDL_TO_MMOL;
+    const float z = be - 0.3062f * ctHb * (1.0f - sO2 / 100.0f);
+    const float a = 4.04e-3f + 4.25e-4f * ctHb;
+    return 24.47f + 0.919f * z + z * a * (z - 8.0f);
+}
+
+// Rosenthal and Severinghaus corrections from 37 °C to the patient
+inline float pHPatient(float pH, float temperature)
+{
+    return pH - 0.0147f * (temperature - BODY_TEMPERATURE);
+}
+
+inline float pCO2Patient(float pCO2, float temperature)
+{
+    return pCO2 * std::pow(10.0f, 0.019f * (temperature - BODY_TEMPERATURE));
+}
+
+inline float pO2Patient(float pO2, float temperature)
+{
+    const float p = std::pow(pO2, 3.88f);
+    const float factor = (5.49e-11f * p + 0.071f) / (9.72e-9f * p + 2.30f);
+    return pO2 * std::pow(10.0f, factor * (temperature - BODY_TEMPERATURE));
+}
+
+float readInput(const QVariantMap &result, Input input)
+{
+    const QVariant value = result.value(INPUT_FIELDS[input]);
+    if (!value.isValid() || value.isNull() || value.toString().isEmpty()) {
+        switch (input) {
+        case Temperature: return BODY_TEMPERATURE;
+        case FiO2: return ROOM_AIR_FIO2;
+        case Hb: return DEFAULT_HB;
+        default: return NaN;
+        }
+    }
+
+    float v = value.toFloat();
+    // Entered either as a fraction or as a percentage
+    if (input == FiO2 && v > 1.0f) {
+        v /= 100.0f;
+    }
+    return v;
+}
+
+float computeOne(Parameter parameter, const float *in, const float *values)
+{
+    switch (parameter) {
+    case AnionGap: return anionGap(in[Na], in[Cl], in[HCO3]);
+    case AnionGapAlbumin: return anionGapAlbumin(values[AnionGap], in[Albumin]);
+    case AaGradient: return aaGradient(in[PCO2], in[PO2], in[FiO2]);
+    case PFRatio: return pfRatio(in[PO2], in[FiO2]);
+    case StandardHCO3: return standardHCO3(in[BE], in[SO2], in[Hb]);
+    case PHPatient: return pHPatient(in[PH], in[Temperature]);
+    case PCO2Patient: return pCO2Patient(in[PCO2], in[Temperature]);
+    case PO2Patient: return pO2Patient(in[PO2], in[Temperature]);
+    case PARAMETER_COUNT: break;
+    }
+    return NaN;
+}
+}
+
+namespace DerivedParameters {
+
+const char *const INPUT_FIELDS[INPUT_COUNT] = {
+    "pH", "pCO2", "pO2", "HCO3", "SO2", "BE",
+    "Na", "Cl",
+    "temperature", "FiO2", "albumin", "Hb"
+};
+
+const ParameterInfo PARAMETERS[PARAMETER_COUNT] = {
+    {"anionGap", "Anion Gap", "mmol/L", 1, bit(Na) | bit(Cl) | bit(HCO3), 0},
+    {"anionGapAlbumin", "Anion Gap (alb.)", "mmol/L", 1, bit(Albumin), bit(AnionGap)},
+    {"aaGradient", "A-a Gradient", "mmHg", 1, bit(PCO2) | bit(PO2) | bit(FiO2), 0},
+    {"pfRatio", "P/F Ratio", "mmHg", 0, bit(PO2) | bit(FiO2), 0},
+    {"standardHCO3", "Std HCO3", "mmol/L", 1, bit(BE) | bit(SO2) | bit(Hb), 0},
+    {"pHPatient", "pH (T)", "", 3, bit(PH) | bit(Temperature), 0},
+    {"pCO2Patient", "pCO2 (T)", "mmHg", 1, bit(PCO2) | bit(Temperature), 0},
+    {"pO2Patient", "pO2 (T)", "mmHg", 1, bit(PO2) | bit(Temperature), 0},
+};
+
+std::array<float, INPUT_COUNT> readInputs(const QVariantMap &result)
+{
+    std::array<float, INPUT_COUNT> inputs;
+    for (int input = 0; input < INPUT_COUNT; ++input) {
+        inputs[input] = readInput(result, Input(input));
+    }
+    return inputs;
+}
+
+Record::Record()
+    : m_computed(0)
+{
+    m_inputs.fill(NaN);
+    m_values.fill(NaN);
+}
+
+Record::Record(const QVariantMap &result)
+    : m_inputs(readInputs(result))
+    , m_computed(0)
+{
+    m_values.fill(NaN);
+}
+
+float Record::value(Parameter parameter)
+{
+    if (m_computed & bit(parameter)) {
+        return m_values[parameter];
+    }
+
+    const quint32 dependencies = PARAMETERS[parameter].parameters;
+    for (int dependency = 0; dependency < parameter; ++dependency) {
+        if (dependencies & bit(dependency)) {
+            value(Parameter(dependency));
+        }
+    }
+    m_values[parameter] = computeOne(parameter, m_inputs.data(), m_values.data());
+    m_computed |= bit(parameter);
+    return m_values[parameter];
+}
+
+QVariant Record::variant(Parameter parameter)
+{
+    const float v = value(parameter);
+    return std::isfinite(v) ? QVariant(double(v)) : QVariant();
+}
+
+QVariantMap Record::toMap()
+{
+    QVariantMap map;
+    for (int parameter = 0; parameter < PARAMETER_COUNT; ++parameter) {
+        const QVariant v = variant(Parameter(parameter));
+        if (v.isValid()) {
+            map[PARAMETERS[parameter].field] = v;
+        }
+    }
+    return map;
+}
+
+void Columns::append(const QVariantMap &result)
+{
+    const std::array<float, INPUT_COUNT> row = readInputs(result);
+    for (int input = 0; input < INPUT_COUNT; ++input) {
+        inputs[input].append(row[input]);
+    }
+}
+
+void computeBatch(Columns &columns, quint32 parameters)
+{
+    // Close the requested set over its dependencies; walking backwards
+    // reaches every dependency, since each one comes earlier
+    for (int parameter = PARAMETER_COUNT - 1; parameter >= 0; --parameter) {
+        if (parameters & bit(parameter)) {
+            parameters |= PARAMETERS[parameter].parameters;
+        }
+    }
+
+    const qsizetype rows = columns.size();
+    const auto in = [&columns](Input input) { return columns.inputs[input].constData(); };
+
+    // One loop per parameter over plain float columns, which the compiler
+    // vectorises; pow() calls stay scalar
+    for (int parameter = 0; parameter < PARAMETER_COUNT; ++parameter) {
+        QList<float> &column = columns.values[parameter];
+        if (!(parameters & bit(parameter))) {
+            column.clear();
+            continue;
+        }
+        column.resize(rows);
+        float *out = column.data();
+
+        switch (Parameter(parameter)) {
+        case AnionGap: {
+            const float *na = in(Na), *cl = in(Cl), *hco3 = in(HCO3);
+            for (qsizetype i = 0; i < rows; ++i) out[i] = anionGap(na[i], cl[i], hco3[i]);
+            break;
+        }
+        case AnionGapAlbumin: {
+            const float *ag = columns.values[AnionGap].constData(), *albumin = in(Albumin);
+            for (qsizetype i = 0; i < rows; ++i) out[i] = anionGapAlbumin(ag[i], albumin[i]);
+            break;
+        }
+        case AaGradient: {
+            const float *pCO2 = in(PCO2), *pO2 = in(PO2), *fiO2 = in(FiO2);
+            for (qsizetype i = 0; i < rows; ++i) out[i] = aaGradient(pCO2[i], pO2[i], fiO2[i]);
+            break;
+        }
+        case PFRatio: {
+            const float *pO2 = in(PO2), *fiO2 = in(FiO2);
+            for (qsizetype i = 0; i < rows; ++i) out[i] = pfRatio(pO2[i], fiO2[i]);
+            break;
+        }
+        case StandardHCO3: {
+            const float *be = in(BE), *sO2 = in(SO2), *hb = in(Hb);
+            for (qsizetype i = 0; i < rows; ++i) out[i] = standardHCO3(be[i], sO2[i], hb[i]);
+            break;
+        }
+        case PHPatient: {
+            const float *pH = in(PH), *t = in(Temperature);
+            for (qsizetype i = 0; i < rows; ++i) out[i] = pHPatient(pH[i], t[i]);
+            break;
+        }
+        case PCO2Patient: {
+            const float *pCO2 = in(PCO2), *t = in(Temperature);
+            for (qsizetype i = 0; i < rows; ++i) out[i] = pCO2Patient(pCO2[i], t[i]);
+            break;
+        }
+        case PO2Patient: {
+            const float *pO2 = in(PO2), *t = in(Temperature);
+            for (qsizetype i = 0; i < rows; ++i) out[i] = pO2Patient(pO2[i], t[i]);
+            break;
+        }
+        case PARAMETER_COUNT:
+            break;
+        }
+    }
+}
+
+} // namespace DerivedParameters
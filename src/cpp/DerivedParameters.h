@@ -0,0 +1,89 @@
+#ifndef DERIVEDPARAMETERS_H
+#define DERIVEDPARAMETERS_H
+
+#include <QList>
+#include <QVariantMap>
+
+#include <array>
+
+// Clinically standard values derived from a result's measured analytes
+// and the sample's inputs (patient temperature, FiO2, albumin). Each
+// parameter lists the inputs and other parameters it depends on; the
+// graph is evaluated lazily per record, or column-wise for many records.
+namespace DerivedParameters {
+
+enum Input {
+    PH, PCO2, PO2, HCO3, SO2, BE,
+    Na, Cl,
+    Temperature, // °C
+    FiO2,        // fraction
+    Albumin,     // g/dL
+    Hb,          // g/dL
+    INPUT_COUNT
+};
+
+// In dependency order: a parameter only depends on those before it
+enum Parameter {
+    AnionGap,
+    AnionGapAlbumin,
+    AaGradient,
+    PFRatio,
+    StandardHCO3,
+    PHPatient,
+    PCO2Patient,
+    PO2Patient,
+    PARAMETER_COUNT
+};
+
+struct ParameterInfo {
+    const char *field;
+    const char *label;
+    const char *unit;
+    int decimals;
+    quint32 inputs;     // bit per Input
+    quint32 parameters; // bit per Parameter
+};
+
+extern const char *const INPUT_FIELDS[INPUT_COUNT];
+extern const ParameterInfo PARAMETERS[PARAMETER_COUNT];
+
+// The inputs of one result, read once. Missing analytes are NaN; missing
+// sample inputs take their defaults (37 °C, room air, Hb 15 g/dL), except
+// albumin, which has none.
+std::array<float, INPUT_COUNT> readInputs(const QVariantMap &result);
+
+// Derived values of one result, each computed the first time it is read
+class Record
+{
+public:
+    Record();
+    explicit Record(const QVariantMap &result);
+
+    // NaN when an input it needs is missing
+    float value(Parameter parameter);
+    // Invalid when the value is NaN, so QML shows it as missing
+    QVariant variant(Parameter parameter);
+    QVariantMap toMap();
+
+private:
+    std::array<float, INPUT_COUNT> m_inputs;
+    std::array<float, PARAMETER_COUNT> m_values;
+    quint32 m_computed;
+};
+
+// Column-wise evaluation over many records, for exports and trends
+struct Columns {
+    std::array<QList<float>, INPUT_COUNT> inputs;
+    std::array<QList<float>, PARAMETER_COUNT> values;
+
+    qsizetype size() const { return inputs[PH].size(); }
+    void append(const QVariantMap &result);
+};
+
+// Fills values[] for the requested parameters (bit per Parameter) and
+// everything they depend on
+void computeBatch(Columns &columns, quint32 parameters);
+
+} // namespace DerivedParameters
+
+#endif // DERIVEDPARAMETERS_H
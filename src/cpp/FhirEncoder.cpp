@@ -0,0 +1,312 @@
+#include "FhirEncoder.h"
+
+#include <QDateTime>
+#include <QStringList>
+#include <QUuid>
+#include <QVarLengthArray>
+
+#include <atomic>
+#include <cmath>
+
+// Minimal streaming JSON writer; tracks only whether a separator is needed
+class FhirEncoder::Writer
+{
+public:
+    explicit Writer(QByteArray &out) : m_out(out), m_afterKey(false) {}
+
+    void beginObject() { separate(); m_out.append('{'); m_first.append(true); }
+    void endObject() { m_out.append('}'); m_first.removeLast(); }
+    void beginArray() { separate(); m_out.append('['); m_first.append(true); }
+    void endArray() { m_out.append(']'); m_first.removeLast(); }
+
+    void key(const char *name)
+    {
+        separate();
+        m_out.append('"').append(name).append("\":");
+        m_afterKey = true;
+    }
+
+    void string(const QString &value)
+    {
+        separate();
+        m_out.append('"');
+        appendEscaped(value.toUtf8());
+        m_out.append('"');
+    }
+
+    // JSON has no NaN or infinity; callers leave those out (see
+    // dataAbsentReason()), null keeps the document valid if one slips by
+    void number(double value)
+    {
+        separate();
+        m_out.append(std::isfinite(value) ? QByteArray::number(value, 'g', 10) : QByteArray("null"));
+    }
+
+    // Prebuilt "key":value members, written as-is
+    void members(const QByteArray &fragment)
+    {
+        separate();
+        m_out.append(fragment);
+    }
+
+private:
+    void separate()
+    {
+        if (m_afterKey) {
+            m_afterKey = false;
+            return;
+        }
+        if (!m_first.isEmpty()) {
+            if (!m_first.last()) {
+                m_out.append(',');
+            }
+            m_first.last() = false;
+        }
+    }
+
+    void appendEscaped(const QByteArray &utf8)
+    {
+        for (const char c : utf8) {
+            switch (c) {
+            case '"': m_out.append("\\\""); break;
+            case '\\': m_out.append("\\\\"); break;
+            case '\n': m_out.append("\\n"); break;
+            case '\r': m_out.append("\\r"); break;
+            case '\t': m_out.append("\\t"); break;
+            default:
+                if (uchar(c) < 0x20) {
+                    m_out.append("\\u00").append(QByteArray::number(uchar(c), 16).rightJustified(2, '0'));
+                } else {
+                    m_out.append(c);
+                }
+            }
+        }
+    }
+
+    QByteArray &m_out;
+    QVarLengthArray<bool, 16> m_first;
+    bool m_afterKey;
+};
+
+namespace {
+struct AnalyteTemplate {
+    const char *field;
+    QByteArray code;  // "code":{...}
+    QByteArray unit;  // "unit":...,"system":...,"code":...
+};
+
+AnalyteTemplate analyte(const char *field, const char *loinc, const char *display,
+                        const char *unit, const char *ucum)
+{
+    return AnalyteTemplate{
+        field,
+        QByteArray("\"code\":{\"coding\":[{\"system\":\"http://loinc.org\",\"code\":\"") + loinc +
+            "\",\"display\":\"" + display + "\"}],\"text\":\"" + field + "\"}",
+        QByteArray("\"unit\":\"") + unit + "\",\"system\":\"http://unitsofmeasure.org\",\"code\":\"" + ucum + "\""
+    };
+}
+
+// Built once; fields without a LOINC mapping are not sent
+const QList<AnalyteTemplate> &analyteTemplates()
+{
+    static const QList<AnalyteTemplate> templates = {
+        analyte("pH", "2744-1", "pH of Arterial blood", "pH", "[pH]"),
+        analyte("pCO2", "2019-8", "Carbon dioxide [Partial pressure] in Arterial blood", "mmHg", "mm[Hg]"),
+        analyte("pO2", "2703-7", "Oxygen [Partial pressure] in Arterial blood", "mmHg", "mm[Hg]"),
+        analyte("HCO3", "1960-4", "Bicarbonate [Moles/volume] in Arterial blood", "mmol/L", "mmol/L"),
+        analyte("SO2", "2708-6", "Oxygen saturation in Arterial blood", "%", "%"),
+        analyte("BE", "1925-7", "Base excess in Arterial blood by calculation", "mmol/L", "mmol/L"),
+        analyte("Na", "2947-0", "Sodium [Moles/volume] in Blood", "mmol/L", "mmol/L"),
+        analyte("K", "6298-4", "Potassium [Moles/volume] in Blood", "mmol/L", "mmol/L"),
+        analyte("Cl", "2069-3", "Chloride [Moles/volume] in Blood", "mmol/L", "mmol/L"),
+        analyte("Ca", "29265-6", "Calcium [Moles/volume] in Serum or Plasma", "mmol/L", "mmol/L"),
+        analyte("Glucose", "2339-0", "Glucose [Mass/volume] in Blood", "mg/dL", "mg/dL"),
+        analyte("Lactate", "2518-9", "Lactate [Moles/volume] in Arterial blood", "mmol/L", "mmol/L")
+    };
+    return templates;
+}
+
+const QByteArray OBSERVATION_HEADER =
+    "\"resourceType\":\"Observation\",\"status\":\"final\","
+    "\"category\":[{\"coding\":[{\"system\":\"http://terminology.hl7.org/CodeSystem/observation-category\","
+    "\"code\":\"laboratory\"}]}]";
+
+const QByteArray REPORT_HEADER =
+    "\"resourceType\":\"DiagnosticReport\",\"status\":\"final\","
+    "\"category\":[{\"coding\":[{\"system\":\"http://terminology.hl7.org/CodeSystem/v2-0074\",\"code\":\"LAB\"}]}],"
+    "\"code\":{\"coding\":[{\"system\":\"http://loinc.org\",\"code\":\"24336-0\","
+    "\"display\":\"Gas panel - Arterial blood\"}]}";
+
+const QByteArray CRITICAL_INTERPRETATION =
+    "\"interpretation\":[{\"coding\":[{\"system\":\"http://terminology.hl7.org/CodeSystem/v3-ObservationInterpretation\","
+    "\"code\":\"AA\",\"display\":\"Critical abnormal\"}]}]";
+
+// A value that is not a finite number is reported as absent, with the reason
+QByteArray dataAbsentReason(double value)
+{
+    const char *code = std::isnan(value) ? "not-a-number" : value > 0 ? "positive-infinity" : "negative-infinity";
+    const char *display = std::isnan(value) ? "Not a Number (NaN)"
+                        : value > 0 ? "Positive Infinity (PINF)" : "Negative Infinity (NINF)";
+    return QByteArray("\"dataAbsentReason\":{\"coding\":[{\"system\":"
+                      "\"http://terminology.hl7.org/CodeSystem/data-absent-reason\",\"code\":\"")
+        + code + "\",\"display\":\"" + display + "\"}]}";
+}
+
+const QByteArray POST_OBSERVATION = "\"request\":{\"method\":\"POST\",\"url\":\"Observation\"}";
+const QByteArray POST_REPORT = "\"request\":{\"method\":\"POST\",\"url\":\"DiagnosticReport\"}";
+
+// FHIR dateTime values with a time part must carry a UTC offset
+QString fhirDateTime(const QVariant &timestamp)
+{
+    QDateTime dateTime = QDateTime::fromString(timestamp.toString(), Qt::ISODate);
+    if (!dateTime.isValid()) {
+        dateTime = QDateTime::currentDateTime();
+    }
+    return dateTime.toOffsetFromUtc(dateTime.offsetFromUtc()).toString(Qt::ISODate);
+}
+
+QString newUrn()
+{
+    return "urn:uuid:" + QUuid::createUuid().toString(QUuid::WithoutBraces);
+}
+
+// Encoded bytes per result of the last bundle, so the next one's buffer is
+// reserved about once; past it the buffer grows geometrically. Starts low,
+// as a first bundle only grows a few times.
+std::atomic<qsizetype> bytesPerResult{2048};
+}
+
+QByteArray FhirEncoder::encodeBundle(const QVariantMap &result) const
+{
+    return encodeBundle(QList<QVariantMap>{result});
+}
+
+QByteArray FhirEncoder::encodeBundle(const QList<QVariantMap> &results) const
+{
+    QByteArray out;
+    out.reserve(256 + results.size() * bytesPerResult.load(std::memory_order_relaxed));
+
+    Writer writer(out);
+    writer.beginObject();
+    writer.members("\"resourceType\":\"Bundle\"");
+    writer.key("id");
+    writer.string(QUuid::createUuid().toString(QUuid::WithoutBraces));
+    writer.members("\"type\":\"transaction\"");
+    writer.key("entry");
+    writer.beginArray();
+    for (const QVariantMap &result : results) {
+        writeResultEntries(writer, result);
+    }
+    writer.endArray();
+    writer.endObject();
+
+    if (!results.isEmpty()) {
+        bytesPerResult.store(out.size() / results.size(), std::memory_order_relaxed);
+    }
+    return out;
+}
+
+void FhirEncoder::writeResultEntries(Writer &writer, const QVariantMap &result) const
+{
+    const QString patientId = result.value("patientId").toString();
+    const QString effective = fhirDateTime(result.value("timestamp"));
+    const QStringList criticalFields = result.value("criticalFields").toStringList();
+
+    auto writeSubject = [&]() {
+        if (patientId.isEmpty()) {
+            return;
+        }
+        writer.key("subject");
+        writer.beginObject();
+        writer.key("identifier");
+        writer.beginObject();
+        writer.key("value");
+        writer.string(patientId);
+        writer.endObject();
+        writer.endObject();
+    };
+
+    // Observations first; the report references them by their bundle URNs
+    QStringList observationUrns;
+    for (const AnalyteTemplate &analyte : analyteTemplates()) {
+        const QVariant value = result.value(analyte.field);
+        if (!value.isValid() || value.isNull()) {
+            continue;
+        }
+
+        const QString urn = newUrn();
+        observationUrns.append(urn);
+
+        writer.beginObject();
+        writer.key("fullUrl");
+        writer.string(urn);
+        writer.key("resource");
+        writer.beginObject();
+        writer.members(OBSERVATION_HEADER);
+        writer.members(analyte.code);
+        writeSubject();
+        writer.key("effectiveDateTime");
+        writer.string(effective);
+        const double number = value.toDouble();
+        if (std::isfinite(number)) {
+            writer.key("valueQuantity");
+            writer.beginObject();
+            writer.key("value");
+            writer.number(number);
+            writer.members(analyte.unit);
+            writer.endObject();
+        } else {
+            writer.members(dataAbsentReason(number));
+        }
+        if (criticalFields.contains(QLatin1String(analyte.field))) {
+            writer.members(CRITICAL_INTERPRETATION);
+        }
+        writer.endObject();
+        writer.members(POST_OBSERVATION);
+        writer.endObject();
+    }
+
+    writer.beginObject();
+    writer.key("fullUrl");
+    writer.string(newUrn());
+    writer.key("resource");
+    writer.beginObject();
+    writer.members(REPORT_HEADER);
+    writer.key("identifier");
+    writer.beginArray();
+    writer.beginObject();
+    writer.key("value");
+    writer.string(result.value("sampleId").toString());
+    writer.endObject();
+    writer.endArray();
+    writeSubject();
+    writer.key("effectiveDateTime");
+    writer.string(effective);
+    writer.key("issued");
+    writer.string(fhirDateTime(QVariant()));
+    writer.key("result");
+    writer.beginArray();
+    for (const QString &urn : observationUrns) {
+        writer.beginObject();
+        writer.key("reference");
+        writer.string(urn);
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.endObject();
+    writer.members(POST_REPORT);
+    writer.endObject();
+}
+
+QString FhirEncoder::bundleId(const QByteArray &bundle)
+{
+    // The id is always the second member of the bundle
+    static const QByteArray marker = "\"id\":\"";
+    const qsizetype start = bundle.indexOf(marker);
+    if (start < 0) {
+        return QString();
+    }
+    const qsizetype valueStart = start + marker.size();
+    const qsizetype end = bundle.indexOf('"', valueStart);
+    return QString::fromLatin1(bundle.mid(valueStart, end - valueStart));
+}
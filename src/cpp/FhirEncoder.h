@@ -0,0 +1,30 @@
+#ifndef FHIRENCODER_H
+#define FHIRENCODER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QVariantMap>
+
+// Builds FHIR R4 JSON from result maps: one Observation per analyte and a
+// DiagnosticReport (arterial blood gas panel) referencing them, wrapped in a
+// transaction Bundle. Output is streamed straight into a byte buffer; the
+// static parts of each resource (LOINC coding, UCUM units) are prebuilt
+// fragments, so no QJsonObject tree is ever built.
+// Holds no state beyond a shared estimate of the encoded size of a result,
+// so it can be used from any thread.
+class FhirEncoder
+{
+public:
+    // Transaction bundle for any number of results
+    QByteArray encodeBundle(const QList<QVariantMap> &results) const;
+    QByteArray encodeBundle(const QVariantMap &result) const;
+
+    // Bundle id of an encoded bundle, used as its control ID in the message log
+    static QString bundleId(const QByteArray &bundle);
+
+private:
+    class Writer;
+    void writeResultEntries(Writer &writer, const QVariantMap &result) const;
+};
+
+#endif // FHIRENCODER_H
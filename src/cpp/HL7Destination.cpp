@@ -0,0 +1,308 @@
+#include "HL7Destination.h"
+
+#include <QDebug>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QTimer>
+#include <QUrl>
+
+HL7DestinationConfig HL7DestinationConfig::fromVariantMap(const QVariantMap &map)
+{
+    HL7DestinationConfig config;
+    config.name = map.value("name").toString();
+    config.url = map.value("url").toString();
+    config.receivingApplication = map.value("receivingApplication", "HIS").toString();
+    config.receivingFacility = map.value("receivingFacility", "HOSPITAL").toString();
+    config.format = map.value("format", config.format).toString();
+    config.bulkOnly = map.value("bulkOnly", config.bulkOnly).toBool();
+    config.maxInFlight = qMax(1, map.value("maxInFlight", config.maxInFlight).toInt());
+    config.maxQueueDepth = qMax(1, map.value("maxQueueDepth", config.maxQueueDepth).toInt());
+    config.maxCriticalQueueDepth = qMax(1, map.value("maxCriticalQueueDepth", config.maxCriticalQueueDepth).toInt());
+    return config;
+}
+
+QVariantMap HL7DestinationConfig::toVariantMap() const
+{
+    QVariantMap map;
+    map["name"] = name;
+    map["url"] = url;
+    map["receivingApplication"] = receivingApplication;
+    map["receivingFacility"] = receivingFacility;
+    map["format"] = format;
+    map["bulkOnly"] = bulkOnly;
+    map["maxInFlight"] = maxInFlight;
+    map["maxQueueDepth"] = maxQueueDepth;
+    map["maxCriticalQueueDepth"] = maxCriticalQueueDepth;
+    return map;
+}
+
+HL7Destination::HL7Destination(const HL7DestinationConfig &config, QObject *parent)
+    : QObject(parent)
+    , m_config(config)
+    , m_networkManager(new QNetworkAccessManager(this))
+    , m_queue(config.maxQueueDepth, config.maxCriticalQueueDepth)
+    , m_retryTimer(new QTimer(this))
+    , m_keepalive(nullptr)
+    , m_keepaliveSentNs(0)
+    , m_timeoutMs(TRANSFER_TIMEOUT_MS)
+    , m_healthy(true)
+    , m_consecutiveFailures(0)
+    , m_delivered(0)
+    , m_failed(0)
+    , m_dropped(0)
+    , m_criticalDropped(0)
+    , m_reconnects(0)
+    , m_retries(0)
+{
+    m_clock.start();
+    m_retryTimer->setSingleShot(true);
+    connect(m_retryTimer, &QTimer::timeout, this, &HL7Destination::retry);
+}
+
+void HL7Destination::setConfig(const HL7DestinationConfig &config)
+{
+    const bool urlChanged = config.url != m_config.url;
+    m_config = config;
+    m_queue.setLimits(m_config.maxQueueDepth, m_config.maxCriticalQueueDepth);
+
+    // Drop pooled connections and RTTs measured against the old endpoint
+    if (urlChanged) {
+        m_networkManager->clearConnectionCache();
+        m_rtt.reset();
+        m_rttPrevious.reset();
+        m_timeoutMs = TRANSFER_TIMEOUT_MS;
+        m_consecutiveFailures = 0;
+        m_retryTimer->stop();
+        if (!m_healthy) {
+            m_healthy = true;
+            emit healthChanged(m_config.name, m_healthy);
+        }
+    }
+    pump();
+}
+
+bool HL7Destination::enqueue(const HL7OutboundMessage &message)
+{
+    if (!m_queue.push(message)) {
+        if (message.critical) {
+            m_criticalDropped++;
+        } else {
+            m_dropped++;
+        }
+        emit backpressure(m_config.name, message.critical ? m_queue.criticalSize() : m_queue.routineSize(), message.critical);
+        emit statsChanged();
+        return false;
+    }
+
+    pump();
+    emit statsChanged();
+    return true;
+}
+
+void HL7Destination::pump()
+{
+    if (m_retryTimer->isActive()) {
+        return;
+    }
+
+    // An unhealthy link gets one message at a time until one is ACKed.
+    // Routine traffic never takes the last in-flight slot, so a critical
+    // message does not have to wait for a routine ACK to come back.
+    const int limit = m_healthy ? m_config.maxInFlight : 1;
+    const int routineLimit = limit > 1 ? limit - 1 : 1;
+
+    HL7OutboundMessage message;
+    while (m_inFlight.size() < limit && m_queue.take(m_inFlight.size() < routineLimit, message)) {
+        dispatch(message);
+    }
+}
+
+void HL7Destination::dispatch(const HL7OutboundMessage &message)
+{
+    QNetworkRequest request{QUrl(m_config.url)};
+    request.setHeader(QNetworkRequest::ContentTypeHeader, contentType());
+    request.setTransferTimeout(m_timeoutMs);
+    if (message.critical) {
+        request.setPriority(QNetworkRequest::HighPriority);
+    }
+
+    QNetworkReply *reply = m_networkManager->post(request, message.message);
+    connect(reply, &QNetworkReply::finished, this, &HL7Destination::onNetworkReply);
+    HL7OutboundMessage sent = message;
+    sent.sentNs = m_clock.nsecsElapsed();
+    sent.attempts++;
+    m_inFlight.insert(reply, sent);
+
+    emit dispatched(m_config.name, message.message);
+}
+
+QByteArray HL7Destination::contentType() const
+{
+    return m_config.format == "fhir" ? "application/fhir+json" : "x-application/hl7-v2+er7";
+}
+
+void HL7Destination::onNetworkReply()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply) {
+        return;
+    }
+
+    const HL7OutboundMessage message = m_inFlight.take(reply);
+    if (reply->error() == QNetworkReply::NoError) {
+        m_delivered++;
+        recordRoundTrip(message.sentNs);
+        noteSuccess();
+        emit delivered(m_config.name, message, QString::fromUtf8(reply->readAll()));
+    } else {
+        // Back to the head of its lane; nothing more goes out until the
+        // retry delay has passed
+        m_failed++;
+        m_queue.putBack(message);
+        noteFailure();
+        m_retryTimer->start(retryDelayMs());
+        emit failed(m_config.name, message, reply->errorString());
+    }
+    reply->deleteLater();
+
+    // A slot has freed up for the next queued message
+    pump();
+    emit statsChanged();
+}
+
+void HL7Destination::sendKeepalive(const QString &message)
+{
+    if (m_keepalive || m_config.url.isEmpty()) {
+        return;
+    }
+
+    m_keepaliveSentNs = m_clock.nsecsElapsed();
+
+    // A FHIR server has no ACK-only exchange; its capability statement is the cheapest round trip
+    if (m_config.format == "fhir") {
+        QNetworkRequest request{QUrl(m_config.url + "/metadata")};
+        request.setTransferTimeout(m_timeoutMs);
+        m_keepalive = m_networkManager->get(request);
+    } else {
+        QNetworkRequest request{QUrl(m_config.url)};
+        request.setHeader(QNetworkRequest::ContentTypeHeader, contentType());
+        request.setTransferTimeout(m_timeoutMs);
+        m_keepalive = m_networkManager->post(request, message.toUtf8());
+    }
+    connect(m_keepalive, &QNetworkReply::finished, this, &HL7Destination::onKeepaliveReply);
+}
+
+void HL7Destination::onKeepaliveReply()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply || reply != m_keepalive) {
+        return;
+    }
+    m_keepalive = nullptr;
+
+    if (reply->error() == QNetworkReply::NoError) {
+        recordRoundTrip(m_keepaliveSentNs);
+        noteSuccess();
+        // The link is back; the backlog need not wait out the retry delay
+        if (m_retryTimer->isActive()) {
+            m_retryTimer->stop();
+            pump();
+        }
+    } else {
+        qWarning() << "HL7 keepalive to" << m_config.name << "failed:" << reply->errorString();
+        noteFailure();
+    }
+    reply->deleteLater();
+    emit statsChanged();
+}
+
+void HL7Destination::retry()
+{
+    m_retries++;
+    pump();
+    emit statsChanged();
+}
+
+int HL7Destination::retryDelayMs() const
+{
+    const int doublings = qBound(0, m_consecutiveFailures - 1, 16);
+    return int(qMin<qint64>(qint64(MIN_RETRY_DELAY_MS) << doublings, MAX_RETRY_DELAY_MS));
+}
+
+void HL7Destination::recordRoundTrip(qint64 sentNs)
+{
+    m_rtt.record((m_clock.nsecsElapsed() - sentNs) / 1.0e6);
+    if (m_rtt.count() >= RTT_WINDOW_SAMPLES) {
+        m_rttPrevious = m_rtt;
+        m_rtt.reset();
+    }
+
+    // Generous multiple of p99 so that normal jitter never times out, while
+    // a stalled peer is detected long before the fixed default would
+    const LatencyHistogram &window = rttWindow();
+    if (window.count() >= RTT_MIN_SAMPLES) {
+        m_timeoutMs = qBound(MIN_TIMEOUT_MS, int(window.percentile(99) * TIMEOUT_RTT_FACTOR), MAX_TIMEOUT_MS);
+    }
+}
+
+const LatencyHistogram &HL7Destination::rttWindow() const
+{
+    return m_rtt.count() >= RTT_MIN_SAMPLES || m_rttPrevious.count() == 0 ? m_rtt : m_rttPrevious;
+}
+
+void HL7Destination::noteSuccess()
+{
+    m_consecutiveFailures = 0;
+    if (!m_healthy) {
+        m_healthy = true;
+        qDebug() << "HL7 destination" << m_config.name << "recovered";
+        emit healthChanged(m_config.name, m_healthy);
+    }
+}
+
+void HL7Destination::noteFailure()
+{
+    m_consecutiveFailures++;
+    if (m_consecutiveFailures % DEGRADED_FAILURES != 0) {
+        return;
+    }
+
+    if (m_healthy) {
+        m_healthy = false;
+        emit healthChanged(m_config.name, m_healthy);
+    }
+    reconnect();
+}
+
+void HL7Destination::reconnect()
+{
+    // Pooled sockets may be half-open after a network change; the next
+    // request opens a fresh connection
+    qWarning() << "HL7 destination" << m_config.name << "degraded after"
+               << m_consecutiveFailures << "failures, reconnecting";
+    m_networkManager->clearConnectionCache();
+    m_reconnects++;
+}
+
+QVariantMap HL7Destination::stats() const
+{
+    const LatencyHistogram &window = rttWindow();
+
+    QVariantMap stats = m_config.toVariantMap();
+    stats["queueDepth"] = queueDepth();
+    stats["criticalQueueDepth"] = m_queue.criticalSize();
+    stats["inFlight"] = m_inFlight.size();
+    stats["delivered"] = m_delivered;
+    stats["failed"] = m_failed;
+    stats["dropped"] = m_dropped;
+    stats["criticalDropped"] = m_criticalDropped;
+    stats["rttP50Ms"] = window.percentile(50);
+    stats["rttP99Ms"] = window.percentile(99);
+    stats["timeoutMs"] = m_timeoutMs;
+    stats["healthy"] = m_healthy;
+    stats["reconnects"] = m_reconnects;
+    stats["retries"] = m_retries;
+    stats["retryDelayMs"] = m_retryTimer->isActive() ? m_retryTimer->remainingTime() : 0;
+    return stats;
+}
@@ -0,0 +1,129 @@
+#ifndef HL7DESTINATION_H
+#define HL7DESTINATION_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QVariantMap>
+
+#include "HL7OutboundQueue.h"
+#include "LatencyHistogram.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTimer;
+
+struct HL7DestinationConfig {
+    QString name;
+    QString url;
+    QString receivingApplication;
+    QString receivingFacility;
+    QString format = "hl7v2"; // or "fhir"
+    bool bulkOnly = false; // takes explicit bundle transfers, not the live results
+    int maxInFlight = 4;
+    int maxQueueDepth = 1000;
+    int maxCriticalQueueDepth = 200;
+
+    static HL7DestinationConfig fromVariantMap(const QVariantMap &map);
+    QVariantMap toVariantMap() const;
+};
+
+// One receiving system (LIS, EMR, FHIR server, ...). Owns its queue, its own connection
+// pool and its concurrency limit, so a slow or unreachable destination only
+// ever backs up its own queue. Lives on the HL7 I/O thread.
+//
+// Every ACK and keepalive round trip feeds an RTT histogram; the transfer
+// timeout follows the observed p99, and repeated failures mark the link
+// unhealthy and drop its pooled connections so the next request reconnects.
+//
+// A message stays queued until it is ACKed. A failed one goes back to the
+// head of its lane and nothing is sent until a retry delay has passed,
+// doubling with each consecutive failure; while the link is unhealthy only
+// one message at a time goes out, as a probe, so an outage builds a backlog
+// instead of burning through the queue.
+class HL7Destination : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HL7Destination(const HL7DestinationConfig &config, QObject *parent = nullptr);
+
+    const HL7DestinationConfig &config() const { return m_config; }
+    void setConfig(const HL7DestinationConfig &config);
+
+    // Critical messages go to a separate lane that is dispatched ahead of
+    // routine traffic, retries included. Returns false (and counts a drop)
+    // when the message's lane is at its depth limit.
+    bool enqueue(const HL7OutboundMessage &message);
+
+    // Sends an ACK-only exchange outside the queues; skipped while the
+    // previous keepalive is still outstanding
+    void sendKeepalive(const QString &message);
+
+    int queueDepth() const { return m_queue.size(); }
+    int inFlight() const { return m_inFlight.size(); }
+    bool isHealthy() const { return m_healthy; }
+    int transferTimeoutMs() const { return m_timeoutMs; }
+    QVariantMap stats() const;
+
+signals:
+    void dispatched(const QString &destination, const QByteArray &message);
+    void delivered(const QString &destination, const HL7OutboundMessage &message, const QString &response);
+    // The message is still queued and will be retried
+    void failed(const QString &destination, const HL7OutboundMessage &message, const QString &error);
+    void backpressure(const QString &destination, int queueDepth, bool critical);
+    void healthChanged(const QString &destination, bool healthy);
+    void statsChanged();
+
+private slots:
+    void onNetworkReply();
+    void onKeepaliveReply();
+    void retry();
+
+private:
+    void pump();
+    void dispatch(const HL7OutboundMessage &message);
+    QByteArray contentType() const;
+    void recordRoundTrip(qint64 sentNs);
+    void noteSuccess();
+    void noteFailure();
+    void reconnect();
+    int retryDelayMs() const;
+    const LatencyHistogram &rttWindow() const;
+
+    HL7DestinationConfig m_config;
+    QNetworkAccessManager *m_networkManager;
+    HL7OutboundQueue m_queue;
+    QHash<QNetworkReply*, HL7OutboundMessage> m_inFlight;
+    QTimer *m_retryTimer; // running while sending is held off
+    QNetworkReply *m_keepalive;
+    qint64 m_keepaliveSentNs;
+
+    // Round-trip times; the previous window is kept until the current one
+    // has enough samples to be trusted
+    QElapsedTimer m_clock;
+    LatencyHistogram m_rtt;
+    LatencyHistogram m_rttPrevious;
+    int m_timeoutMs;
+    bool m_healthy;
+    int m_consecutiveFailures;
+
+    int m_delivered;
+    int m_failed;
+    int m_dropped;
+    int m_criticalDropped;
+    int m_reconnects;
+    int m_retries;
+
+    static const int TRANSFER_TIMEOUT_MS = 10000; // 10 seconds, until RTTs are known
+    static const int MIN_TIMEOUT_MS = 1000;
+    static const int MAX_TIMEOUT_MS = 30000;
+    static const int TIMEOUT_RTT_FACTOR = 4;
+    static const int RTT_MIN_SAMPLES = 20;
+    static const int RTT_WINDOW_SAMPLES = 1000;
+    static const int DEGRADED_FAILURES = 3;
+    static const int MIN_RETRY_DELAY_MS = 500;
+    static const int MAX_RETRY_DELAY_MS = 60000; // 1 minute
+};
+
+#endif // HL7DESTINATION_H
@@ -0,0 +1,270 @@
+#include "HL7Encoder.h"
+
+#include <QDateTime>
+#include <QMap>
+#include <QRandomGenerator>
+#include <QStringList>
+
+HL7Encoder::HL7Encoder()
+    : m_sendingApplication("BloodGasAnalyzer")
+    , m_sendingFacility("LAB")
+    , m_receivingApplication("HIS")
+    , m_receivingFacility("HOSPITAL")
+{
+}
+
+void HL7Encoder::setReceiver(const QString &application, const QString &facility)
+{
+    m_receivingApplication = application;
+    m_receivingFacility = facility;
+}
+
+QString HL7Encoder::generateMessage(const QVariantMap &data, const QString &messageType) const
+{
+    QStringList segments;
+    QString controlId = generateControlId();
+    QString timestamp = QDateTime::currentDateTime().toString("yyyyMMddhhmmss");
+    
+    // MSH - Message Header
+    QStringList mshFields = {
+        "MSH",
+        "^~\\&",
+        m_sendingApplication,
+        m_sendingFacility,
+        m_receivingApplication,
+        m_receivingFacility,
+        timestamp,
+        "",
+        messageType,
+        controlId,
+        "P", // Processing ID
+        "2.5" // Version ID
+    };
+    segments.append(mshFields.join("|"));
+    
+    if (messageType == "ORU^R01") {
+        // Lab results message
+        
+        // PID - Patient Identification
+        QString patientId = data.value("patientId", "UNKNOWN").toString();
+        QStringList pidFields = {
+            "PID",
+            "1",
+            patientId,
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            ""
+        };
+        segments.append(pidFields.join("|"));
+        
+        // OBR - Observation Request
+        QString sampleId = data.value("sampleId", "AUTO").toString();
+        QStringList obrFields = {
+            "OBR",
+            "1",
+            sampleId,
+            escapeText(data.value("accession").toString()), // Filler order number from the worklist
+            "BGA^Blood Gas Analysis^LOCAL",
+            "",
+            timestamp,
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "",
+            ""
+        };
+        segments.append(obrFields.join("|"));
+        
+        // OBX - Observation/Result segments
+        int seqNum = 1;
+        QStringList resultFields = {"pH", "pCO2", "pO2", "HCO3", "SO2", "BE", "Na", "K", "Cl", "Ca", "Glucose", "Lactate"};
+        
+        const QStringList criticalFields = data.value("criticalFields").toStringList();
+        const QStringList lowFields = data.value("lowFields").toStringList();
+        const QStringList highFields = data.value("highFields").toStringList();
+        
+        for (const QString &field : resultFields) {
+            if (data.contains(field)) {
+                // OBX-8 abnormal flags: L/H against the reference range, LL/HH when critical
+                QString abnormalFlag;
+                if (lowFields.contains(field)) {
+                    abnormalFlag = criticalFields.contains(field) ? "LL" : "L";
+                } else if (highFields.contains(field)) {
+                    abnormalFlag = criticalFields.contains(field) ? "HH" : "H";
+                }
+                
+                QStringList obxFields = {
+                    "OBX",
+                    QString::number(seqNum++),
+                    "NM", // Numeric
+                    field + "^" + field + "^LOCAL",
+                    "",
+                    data.value(field).toString(),
+                    unitForField(field),
+                    "",
+                    abnormalFlag,
+                    "F", // Final
+                    "",
+                    "",
+                    timestamp,
+                    "",
+                    ""
+                };
+                segments.append(obxFields.join("|"));
+            }
+        }
+    } else if (messageType == "NMD^N02") {
+        // Application management keepalive; the ACK is all the peer returns
+        
+        // NST - Application control-level statistics
+        QStringList nstFields = {
+            "NST",
+            "Y" // Statistics available
+        };
+        segments.append(nstFields.join("|"));
+    }
+    
+    return segments.join("\r");
+}
+
+QString HL7Encoder::generateAck(const QString &message, const QString &ackCode) const
+{
+    const QStringList inbound = message.section('\r', 0, 0).split('|');
+    auto inboundField = [&inbound](int index) {
+        return index < inbound.size() ? inbound.at(index) : QString();
+    };
+    
+    // ACK^<trigger> echoes the trigger event of the message being acknowledged
+    const QString trigger = inboundField(8).section('^', 1, 1);
+    
+    QStringList mshFields = {
+        "MSH",
+        "^~\\&",
+        m_sendingApplication,
+        m_sendingFacility,
+        inboundField(2),
+        inboundField(3),
+        QDateTime::currentDateTime().toString("yyyyMMddhhmmss"),
+        "",
+        trigger.isEmpty() ? QString("ACK") : "ACK^" + trigger,
+        generateControlId(),
+        "P", // Processing ID
+        "2.5" // Version ID
+    };
+    
+    QStringList msaFields = {
+        "MSA",
+        ackCode,
+        inboundField(9)
+    };
+    
+    return mshFields.join("|") + "\r" + msaFields.join("|");
+}
+
+QString HL7Encoder::unitForField(const QString &field)
+{
+    static QMap<QString, QString> units = {
+        {"pH", "pH"},
+        {"pCO2", "mmHg"},
+        {"pO2", "mmHg"},
+        {"HCO3", "mmol/L"},
+        {"SO2", "%"},
+        {"BE", "mmol/L"},
+        {"Na", "mmol/L"},
+        {"K", "mmol/L"},
+        {"Cl", "mmol/L"},
+        {"Ca", "mmol/L"},
+        {"Glucose", "mg/dL"},
+        {"Lactate", "mmol/L"}
+    };
+    
+    return units.value(field, "");
+}
+
+QString HL7Encoder::generateControlId()
+{
+    return QString::number(QDateTime::currentSecsSinceEpoch()) + 
+           QString::number(QRandomGenerator::global()->bounded(1000));
+}
+
+bool HL7Encoder::validateMessage(const QString &message)
+{
+    // Basic validation - check if message starts with MSH
+    return message.startsWith("MSH|") && message.contains("\r");
+}
+
+QString HL7Encoder::messageControlId(const QString &message)
+{
+    // MSH-10 is the tenth field of the first segment (MSH-1 is the separator itself)
+    const QString msh = message.section('\r', 0, 0);
+    return msh.section('|', 9, 9);
+}
+
+QString HL7Encoder::rewriteReceiver(const QString &message, const QString &application, const QString &facility)
+{
+    const qsizetype mshEnd = message.indexOf('\r');
+    QStringList mshFields = message.left(mshEnd < 0 ? message.size() : mshEnd).split('|');
+    if (mshFields.size() < 6) {
+        return message;
+    }
+    
+    mshFields[4] = application;
+    mshFields[5] = facility;
+    
+    QString rewritten = mshFields.join('|');
+    if (mshEnd >= 0) {
+        rewritten += QStringView(message).mid(mshEnd);
+    }
+    return rewritten;
+}
+
+QString HL7Encoder::escapeText(const QString &text)
+{
+    QString escaped = text;
+    escaped.replace("\\", "\\E\\");
+    escaped.replace("|", "\\F\\");
+    escaped.replace("^", "\\S\\");
+    escaped.replace("&", "\\T\\");
+    escaped.replace("\r", "\\X0D\\");
+    return escaped;
+}
+
+QString HL7Encoder::unescapeText(const QString &text)
+{
+    if (!text.contains('\\')) {
+        return text;
+    }
+    
+    QString unescaped = text;
+    unescaped.replace("\\F\\", "|");
+    unescaped.replace("\\S\\", "^");
+    unescaped.replace("\\T\\", "&");
+    unescaped.replace("\\R\\", "~");
+    unescaped.replace("\\X0D\\", "\r");
+    unescaped.replace("\\E\\", "\\");
+    return unescaped;
+}
@@ -0,0 +1,42 @@
+#ifndef HL7ENCODER_H
+#define HL7ENCODER_H
+
+#include <QString>
+#include <QVariantMap>
+
+// Builds HL7 v2.5 messages from result and patient maps.
+// Holds no shared state, so each thread keeps its own instance.
+class HL7Encoder
+{
+public:
+    HL7Encoder();
+
+    QString sendingApplication() const { return m_sendingApplication; }
+    QString sendingFacility() const { return m_sendingFacility; }
+    QString receivingApplication() const { return m_receivingApplication; }
+    QString receivingFacility() const { return m_receivingFacility; }
+    void setReceiver(const QString &application, const QString &facility);
+
+    QString generateMessage(const QVariantMap &data, const QString &messageType = "ORU^R01") const;
+
+    // Original-mode acknowledgement (AA, AE or AR) addressed back to the sender
+    QString generateAck(const QString &message, const QString &ackCode) const;
+
+    // Returns the message with MSH-5/MSH-6 replaced; the remaining segments are reused as-is
+    static QString rewriteReceiver(const QString &message, const QString &application, const QString &facility);
+
+    static bool validateMessage(const QString &message);
+    static QString messageControlId(const QString &message);
+    static QString escapeText(const QString &text);
+    static QString unescapeText(const QString &text);
+    static QString unitForField(const QString &field);
+    static QString generateControlId();
+
+private:
+    QString m_sendingApplication;
+    QString m_sendingFacility;
+    QString m_receivingApplication;
+    QString m_receivingFacility;
+};
+
+#endif // HL7ENCODER_H
@@ -0,0 +1,285 @@
+#include "HL7Listener.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QHostAddress>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include <iterator>
+
+namespace {
+QString field(const QStringList &fields, int index)
+{
+    return index < fields.size() ? fields.at(index) : QString();
+}
+
+QString component(const QStringList &fields, int index, int componentIndex)
+{
+    return HL7Encoder::unescapeText(field(fields, index).section('^', componentIndex, componentIndex));
+}
+
+// HL7 timestamps are YYYYMMDD[HHMM[SS]]; keep whatever precision was sent
+QDateTime parseTimestamp(const QString &value)
+{
+    const QString digits = value.left(14);
+    switch (digits.size()) {
+    case 14: return QDateTime::fromString(digits, "yyyyMMddhhmmss");
+    case 12: return QDateTime::fromString(digits, "yyyyMMddhhmm");
+    case 8: return QDateTime(QDate::fromString(digits, "yyyyMMdd"), QTime());
+    default: return QDateTime();
+    }
+}
+}
+
+HL7Listener::HL7Listener(QObject *parent)
+    : QObject(parent)
+    , m_server(new QTcpServer(this))
+    , m_nextInboundId(0)
+{
+    connect(m_server, &QTcpServer::newConnection, this, &HL7Listener::onNewConnection);
+}
+
+bool HL7Listener::listen(const QHostAddress &address, quint16 port)
+{
+    if (m_server->isListening()) {
+        m_server->close();
+    }
+    if (address.isNull()) {
+        qWarning() << "HL7 listener needs an address to bind to";
+        return false;
+    }
+    if (!m_server->listen(address, port)) {
+        qWarning() << "HL7 listener failed on" << address.toString() << "port" << port << ":" << m_server->errorString();
+        return false;
+    }
+    qDebug() << "HL7 listener accepting MLLP connections on" << address.toString() << "port" << port
+             << "from" << (m_allowedPeers.isEmpty() ? 1 : m_allowedPeers.size()) << "allowed peers";
+    return true;
+}
+
+void HL7Listener::setAllowedPeers(const QStringList &peers)
+{
+    m_allowedPeers.clear();
+    for (const QString &peer : peers) {
+        const QPair<QHostAddress, int> subnet = QHostAddress::parseSubnet(peer.trimmed());
+        if (subnet.first.isNull()) {
+            qWarning() << "HL7 listener ignoring invalid allowed peer" << peer;
+            continue;
+        }
+        m_allowedPeers.append(subnet);
+    }
+}
+
+bool HL7Listener::isAllowed(const QHostAddress &peer) const
+{
+    if (m_allowedPeers.isEmpty()) {
+        return peer.isLoopback();
+    }
+    // IPv4 peers of a dual-stack socket arrive IPv4-mapped
+    bool isIPv4 = false;
+    const QHostAddress ipv4(peer.toIPv4Address(&isIPv4));
+    for (const QPair<QHostAddress, int> &subnet : m_allowedPeers) {
+        if (peer.isInSubnet(subnet) || (isIPv4 && ipv4.isInSubnet(subnet))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void HL7Listener::close()
+{
+    m_server->close();
+    for (QTcpSocket *socket : m_buffers.keys()) {
+        socket->disconnectFromHost();
+    }
+}
+
+bool HL7Listener::isListening() const
+{
+    return m_server->isListening();
+}
+
+void HL7Listener::onNewConnection()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+        if (!isAllowed(socket->peerAddress())) {
+            qWarning() << "HL7 listener refusing connection from" << socket->peerAddress().toString();
+            socket->abort();
+            socket->deleteLater();
+            continue;
+        }
+        m_buffers.insert(socket, QByteArray());
+        connect(socket, &QTcpSocket::readyRead, this, &HL7Listener::onReadyRead);
+        connect(socket, &QTcpSocket::disconnected, this, &HL7Listener::onDisconnected);
+    }
+}
+
+void HL7Listener::onReadyRead()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket) {
+        return;
+    }
+
+    QByteArray &buffer = m_buffers[socket];
+    buffer.append(socket->readAll());
+
+    // A read may carry several frames, or only part of one
+    while (true) {
+        const qsizetype start = buffer.indexOf(START_BLOCK);
+        if (start < 0) {
+            buffer.clear();
+            break;
+        }
+        const qsizetype end = buffer.indexOf(END_BLOCK, start + 1);
+        if (end < 0) {
+            if (start > 0) {
+                buffer.remove(0, start);
+            }
+            if (buffer.size() > MAX_FRAME_BYTES) {
+                qWarning() << "HL7 listener dropping oversized frame from" << socket->peerAddress().toString();
+                buffer.clear();
+                socket->abort();
+            }
+            break;
+        }
+
+        const QByteArray frame = buffer.mid(start + 1, end - start - 1);
+        qsizetype next = end + 1;
+        if (next < buffer.size() && buffer.at(next) == CARRIAGE_RETURN) {
+            next++;
+        }
+        buffer.remove(0, next);
+        handleFrame(socket, frame);
+    }
+}
+
+void HL7Listener::onDisconnected()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket) {
+        return;
+    }
+    m_buffers.remove(socket);
+    // Its held ACKs can no longer be sent
+    for (auto it = m_pendingAcks.begin(); it != m_pendingAcks.end();) {
+        it = it.value().socket == socket ? m_pendingAcks.erase(it) : std::next(it);
+    }
+    socket->deleteLater();
+}
+
+void HL7Listener::handleFrame(QTcpSocket *socket, const QByteArray &frame)
+{
+    const QString message = QString::fromUtf8(frame);
+    const QVariantMap decoded = decodeMessage(message);
+    if (!decoded.contains("messageType")) {
+        writeAck(socket, message, "AR");
+        return;
+    }
+
+    // The ACK waits until the message is stored
+    const quint64 inboundId = ++m_nextInboundId;
+    m_pendingAcks.insert(inboundId, PendingAck{socket, message});
+    emit messageReceived(inboundId, decoded, message);
+}
+
+void HL7Listener::acknowledge(quint64 inboundId, bool stored)
+{
+    const PendingAck pending = m_pendingAcks.take(inboundId);
+    if (!pending.socket || pending.socket->state() != QAbstractSocket::ConnectedState) {
+        qWarning() << "HL7 listener: sender of inbound message" << inboundId << "disconnected before its ACK";
+        return;
+    }
+    writeAck(pending.socket, pending.message, stored ? "AA" : "AE");
+}
+
+void HL7Listener::writeAck(QTcpSocket *socket, const QString &message, const QString &ackCode)
+{
+    const QString ack = m_encoder.generateAck(message, ackCode);
+
+    QByteArray framed;
+    framed.reserve(ack.size() + 3);
+    framed.append(START_BLOCK);
+    framed.append(ack.toUtf8());
+    framed.append(END_BLOCK);
+    framed.append(CARRIAGE_RETURN);
+    socket->write(framed);
+}
+
+QVariantMap HL7Listener::decodeMessage(const QString &message)
+{
+    QVariantMap decoded;
+    QVariantMap patient;
+    QVariantList orders;
+    QVariantMap order;
+    QString orderControl;
+
+    // Some senders terminate segments with LF or CRLF instead of CR
+    QString normalized = message;
+    normalized.replace("\r\n", "\r").replace('\n', '\r');
+
+    for (const QString &segment : normalized.split('\r', Qt::SkipEmptyParts)) {
+        const QStringList fields = segment.split('|');
+        const QString id = fields.first();
+
+        if (id == "MSH") {
+            // MSH-1 is the separator itself, so MSH-n is at index n - 1
+            if (fields.size() < 10) {
+                return QVariantMap();
+            }
+            decoded["messageType"] = field(fields, 8);
+            decoded["controlId"] = field(fields, 9);
+            decoded["sendingApplication"] = component(fields, 2, 0);
+        } else if (id == "PID") {
+            patient["patientId"] = component(fields, 3, 0);
+            patient["lastName"] = component(fields, 5, 0);
+            patient["firstName"] = component(fields, 5, 1);
+            patient["birthDate"] = parseTimestamp(field(fields, 7)).date().toString(Qt::ISODate);
+            patient["sex"] = field(fields, 8);
+        } else if (id == "PV1") {
+            patient["location"] = component(fields, 3, 0);
+            patient["bed"] = component(fields, 3, 2);
+        } else if (id == "ORC") {
+            if (!order.isEmpty()) {
+                orders.append(order);
+                order.clear();
+            }
+            orderControl = field(fields, 1);
+            order["orderControl"] = orderControl;
+            order["placerOrder"] = component(fields, 2, 0);
+            order["accession"] = component(fields, 3, 0);
+        } else if (id == "OBR") {
+            // A new OBR without its own ORC inherits the previous order control
+            if (order.contains("testCode")) {
+                orders.append(order);
+                order.clear();
+                order["orderControl"] = orderControl;
+            }
+            if (!field(fields, 2).isEmpty()) {
+                order["placerOrder"] = component(fields, 2, 0);
+            }
+            if (!field(fields, 3).isEmpty()) {
+                order["accession"] = component(fields, 3, 0);
+            }
+            order["testCode"] = component(fields, 4, 0);
+            order["testName"] = component(fields, 4, 1);
+            order["orderedAt"] = parseTimestamp(field(fields, 6));
+            order["priority"] = field(fields, 5);
+        } else if (id == "SPM") {
+            order["barcode"] = component(fields, 2, 0);
+        }
+    }
+
+    if (!decoded.contains("messageType")) {
+        return QVariantMap();
+    }
+
+    if (!order.isEmpty()) {
+        orders.append(order);
+    }
+    decoded["patient"] = patient;
+    decoded["orders"] = orders;
+    return decoded;
+}
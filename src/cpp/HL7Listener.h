@@ -0,0 +1,81 @@
+#ifndef HL7LISTENER_H
+#define HL7LISTENER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QPair>
+#include <QPointer>
+#include <QVariantMap>
+
+#include "HL7Encoder.h"
+
+class QTcpServer;
+class QTcpSocket;
+
+// Inbound MLLP listener for order (ORM^O01) and patient (ADT) feeds.
+// Frames are <VT> message <FS><CR>; every complete frame is decoded and
+// acknowledged on the same connection. A message that decodes is only
+// acknowledged (AA, or AE when it could not be stored) once acknowledge()
+// says the worklist has applied and saved it, so an ACK never goes out for
+// an order that a crash could still lose; one that does not decode gets AR
+// straight away. Lives on the HL7 I/O thread.
+// Binds to one configured address only, and accepts connections from the
+// allowed peers only: loopback when none are configured.
+class HL7Listener : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HL7Listener(QObject *parent = nullptr);
+
+    bool listen(const QHostAddress &address, quint16 port);
+    // Addresses or subnets ("10.1.2.3", "10.1.0.0/16"); invalid ones are
+    // skipped with a warning
+    void setAllowedPeers(const QStringList &peers);
+    void close();
+    bool isListening() const;
+
+    // Sends the held ACK of a message reported by messageReceived(); AA when
+    // it was stored, AE otherwise. Nothing is sent if the sender has gone,
+    // and it will send the message again.
+    void acknowledge(quint64 inboundId, bool stored);
+
+    // Flattens an ORM or ADT message into a patient map and a list of
+    // order maps; unknown message types come back with only the header
+    static QVariantMap decodeMessage(const QString &message);
+
+signals:
+    void messageReceived(quint64 inboundId, const QVariantMap &decoded, const QString &message);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+
+private:
+    struct PendingAck {
+        QPointer<QTcpSocket> socket;
+        QString message;
+    };
+
+    void handleFrame(QTcpSocket *socket, const QByteArray &frame);
+    void writeAck(QTcpSocket *socket, const QString &message, const QString &ackCode);
+    bool isAllowed(const QHostAddress &peer) const;
+
+    QTcpServer *m_server;
+    QHash<QTcpSocket*, QByteArray> m_buffers;
+    QList<QPair<QHostAddress, int>> m_allowedPeers;
+    QHash<quint64, PendingAck> m_pendingAcks;
+    quint64 m_nextInboundId;
+    HL7Encoder m_encoder;
+
+    static const char START_BLOCK = 0x0b;
+    static const char END_BLOCK = 0x1c;
+    static const char CARRIAGE_RETURN = 0x0d;
+    static const int MAX_FRAME_BYTES = 1024 * 1024; // 1 MB
+};
+
+#endif // HL7LISTENER_H
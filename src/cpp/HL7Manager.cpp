@@ -1,43 +1,66 @@
 #include "HL7Manager.h"
+#include "HL7Worker.h"
 
 #include <QDebug>
-#include <QNetworkRequest>
-#include <QNetworkReply>
-#include <QJsonDocument>
-#include <QJsonObject>
 #include <QDateTime>
-#include <QRandomGenerator>
+#include <QStandardPaths>
+#include <QDir>
 
 HL7Manager::HL7Manager(QObject *parent)
     : QObject(parent)
-    , m_networkManager(new QNetworkAccessManager(this))
     , m_isConnected(false)
     , m_messagesSent(0)
     , m_messagesReceived(0)
+    , m_rttP50Ms(0.0)
+    , m_rttP99Ms(0.0)
+    , m_inFlightCount(0)
+    , m_linkHealthy(true)
     , m_connectionTimer(new QTimer(this))
-    , m_heartbeatTimer(new QTimer(this))
+    , m_messageLog(QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath("hl7log"))
+    , m_historyCacheValid(false)
+    , m_nextQueryId(0)
+    , m_worker(new HL7Worker(&m_messageLog))
 {
-    // Initialize HL7 configuration
-    m_sendingApplication = "BloodGasAnalyzer";
-    m_sendingFacility = "LAB";
-    m_receivingApplication = "HIS";
-    m_receivingFacility = "HOSPITAL";
-    
     // Setup timers
     m_connectionTimer->setSingleShot(true);
     connect(m_connectionTimer, &QTimer::timeout, this, &HL7Manager::onConnectionTimeout);
     
-    m_heartbeatTimer->setSingleShot(false);
-    connect(m_heartbeatTimer, &QTimer::timeout, this, &HL7Manager::onHeartbeatTimeout);
+    // Message history lookups, one at a time
+    m_lookupPool.setMaxThreadCount(1);
     
     // Default server URL (for demonstration)
     m_serverUrl = "http://localhost:8080/hl7";
+    m_fhirServerUrl = "http://localhost:8080/fhir";
+    
+    // Setup I/O thread; worker signals arrive here as queued connections
+    m_worker->moveToThread(&m_ioThread);
+    connect(&m_ioThread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(m_worker, &HL7Worker::messageSent, this, &HL7Manager::onWorkerMessageSent);
+    connect(m_worker, &HL7Worker::messageReceived, this, &HL7Manager::onWorkerMessageReceived);
+    connect(m_worker, &HL7Worker::transmissionFailed, this, &HL7Manager::hl7Error);
+    connect(m_worker, &HL7Worker::messageLogged, this, &HL7Manager::onWorkerMessageLogged);
+    connect(m_worker, &HL7Worker::destinationStatsChanged, this, &HL7Manager::onDestinationStatsChanged);
+    connect(m_worker, &HL7Worker::latencyStatsChanged, this, &HL7Manager::onLatencyStatsChanged);
+    connect(m_worker, &HL7Worker::inboundReceived, this, &HL7Manager::inboundMessageReceived);
+    m_ioThread.setObjectName("HL7 I/O");
+    m_ioThread.start();
+    
+    QString url = m_serverUrl;
+    QMetaObject::invokeMethod(m_worker, [worker = m_worker, url]() { worker->setServerUrl(url); });
+}
+
+HL7Manager::~HL7Manager()
+{
+    m_lookupPool.waitForDone();
+    m_ioThread.quit();
+    m_ioThread.wait();
 }
 
 void HL7Manager::setServerUrl(const QString &url)
 {
     if (m_serverUrl != url) {
         m_serverUrl = url;
+        QMetaObject::invokeMethod(m_worker, [worker = m_worker, url]() { worker->setServerUrl(url); });
         emit serverUrlChanged();
         
         // Reconnect if we were connected
@@ -48,6 +71,14 @@ void HL7Manager::setServerUrl(const QString &url)
     }
 }
 
+void HL7Manager::setFhirServerUrl(const QString &url)
+{
+    if (m_fhirServerUrl != url) {
+        m_fhirServerUrl = url;
+        emit fhirServerUrlChanged();
+    }
+}
+
 void HL7Manager::connectToServer(const QString &url)
 {
     if (!url.isEmpty()) {
@@ -87,204 +118,155 @@ void HL7Manager::disconnectFromServer()
 }
 
 bool HL7Manager::sendResults(const QVariantMap &results)
+{
+    // Generate HL7 ORU^R01 message for lab results; results flagged critical
+    // at creation take the priority lane
+    return submit("ORU^R01", results, results.value("critical").toBool());
+}
+
+bool HL7Manager::sendPatientInfo(const QVariantMap &patientInfo)
+{
+    // Generate HL7 ADT^A04 message for patient registration
+    return submit("ADT^A04", patientInfo);
+}
+
+void HL7Manager::addDestination(const QVariantMap &config)
+{
+    QMetaObject::invokeMethod(m_worker, [worker = m_worker, config]() { worker->addDestination(config); });
+}
+
+void HL7Manager::removeDestination(const QString &name)
+{
+    QMetaObject::invokeMethod(m_worker, [worker = m_worker, name]() { worker->removeDestination(name); });
+}
+
+void HL7Manager::startListener(const QString &address, int port, const QStringList &allowedPeers)
+{
+    QMetaObject::invokeMethod(m_worker, [worker = m_worker, address, port, allowedPeers]() {
+        worker->startListener(address, port, allowedPeers);
+    });
+}
+
+void HL7Manager::stopListener()
+{
+    QMetaObject::invokeMethod(m_worker, [worker = m_worker]() { worker->stopListener(); });
+}
+
+void HL7Manager::acknowledgeInbound(quint64 inboundId, bool stored)
+{
+    QMetaObject::invokeMethod(m_worker, [worker = m_worker, inboundId, stored]() {
+        worker->acknowledgeInbound(inboundId, stored);
+    });
+}
+
+bool HL7Manager::submit(const QString &messageType, const QVariantMap &data, bool critical)
 {
     if (!m_isConnected) {
         emit hl7Error("Not connected to HL7 server");
         return false;
     }
     
-    // Generate HL7 ORU^R01 message for lab results
-    QString hl7Message = generateHL7Message(results, "ORU^R01");
-    
-    if (!validateHL7Message(hl7Message)) {
-        emit hl7Error("Invalid HL7 message generated");
+    // Encoding, validation and transmission happen on the I/O thread
+    if (!m_worker->enqueue(HL7Record{messageType, data, critical, HL7Worker::monotonicNs()})) {
+        emit hl7Error("HL7 outbound queue is full");
         return false;
     }
     
-    // Store message in history
-    HL7Message message;
-    message.type = "ORU^R01";
-    message.content = hl7Message;
-    message.timestamp = QDateTime::currentDateTime();
-    message.status = "SENT";
-    m_messageHistory.append(message);
-    
-    m_messagesSent++;
-    emit messagesSentChanged();
-    emit messageSent(hl7Message);
-    
-    qDebug() << "Sent HL7 results message";
     return true;
 }
 
-bool HL7Manager::sendPatientInfo(const QVariantMap &patientInfo)
+QString HL7Manager::generateHL7Message(const QVariantMap &data, const QString &messageType)
 {
-    if (!m_isConnected) {
-        emit hl7Error("Not connected to HL7 server");
+    return m_encoder.generateMessage(data, messageType);
+}
+
+bool HL7Manager::sendFhirBundle(const QVariantList &results)
+{
+    if (results.isEmpty()) {
+        return false;
+    }
+    if (m_fhirServerUrl.isEmpty()) {
+        emit hl7Error("No FHIR server URL specified");
         return false;
     }
     
-    // Generate HL7 ADT^A04 message for patient registration
-    QString hl7Message = generateHL7Message(patientInfo, "ADT^A04");
-    
-    // Store message in history
-    HL7Message message;
-    message.type = "ADT^A04";
-    message.content = hl7Message;
-    message.timestamp = QDateTime::currentDateTime();
-    message.status = "SENT";
-    m_messageHistory.append(message);
-    
-    m_messagesSent++;
-    emit messagesSentChanged();
-    emit messageSent(hl7Message);
-    
-    qDebug() << "Sent HL7 patient info message";
+    // The bundle is encoded on the I/O thread, not here
+    QMetaObject::invokeMethod(m_worker, [worker = m_worker, results, url = m_fhirServerUrl]() {
+        worker->sendFhirBundle(results, url);
+    });
     return true;
 }
 
-QString HL7Manager::generateHL7Message(const QVariantMap &data, const QString &messageType)
+QString HL7Manager::generateFhirBundle(const QVariantList &results)
 {
-    QStringList segments;
-    QString controlId = generateMessageControlId();
-    QString timestamp = QDateTime::currentDateTime().toString("yyyyMMddhhmmss");
-    
-    // MSH - Message Header
-    QStringList mshFields = {
-        "MSH",
-        "^~\\&",
-        m_sendingApplication,
-        m_sendingFacility,
-        m_receivingApplication,
-        m_receivingFacility,
-        timestamp,
-        "",
-        messageType,
-        controlId,
-        "P", // Processing ID
-        "2.5" // Version ID
-    };
-    segments.append(mshFields.join("|"));
-    
-    if (messageType == "ORU^R01") {
-        // Lab results message
-        
-        // PID - Patient Identification
-        QString patientId = data.value("patientId", "UNKNOWN").toString();
-        QStringList pidFields = {
-            "PID",
-            "1",
-            patientId,
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            ""
-        };
-        segments.append(pidFields.join("|"));
-        
-        // OBR - Observation Request
-        QString sampleId = data.value("sampleId", "AUTO").toString();
-        QStringList obrFields = {
-            "OBR",
-            "1",
-            sampleId,
-            "",
-            "BGA^Blood Gas Analysis^LOCAL",
-            "",
-            timestamp,
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            "",
-            ""
-        };
-        segments.append(obrFields.join("|"));
-        
-        // OBX - Observation/Result segments
-        int seqNum = 1;
-        QStringList resultFields = {"pH", "pCO2", "pO2", "HCO3", "SO2", "BE", "Na", "K", "Cl", "Ca", "Glucose", "Lactate"};
-        
-        for (const QString &field : resultFields) {
-            if (data.contains(field)) {
-                QStringList obxFields = {
-                    "OBX",
-                    QString::number(seqNum++),
-                    "NM", // Numeric
-                    field + "^" + field + "^LOCAL",
-                    "",
-                    data.value(field).toString(),
-                    getUnitForField(field),
-                    "",
-                    "",
-                    "F", // Final
-                    "",
-                    "",
-                    timestamp,
-                    "",
-                    ""
-                };
-                segments.append(obxFields.join("|"));
-            }
-        }
+    QList<QVariantMap> batch;
+    batch.reserve(results.size());
+    for (const QVariant &result : results) {
+        batch.append(result.toMap());
+    }
+    return QString::fromUtf8(m_fhirEncoder.encodeBundle(batch));
+}
+
+QStringList HL7Manager::getMessageHistory()
+{
+    // Only the bounded set of recent entries is formatted, and only once per change
+    if (m_historyCacheValid) {
+        return m_historyCache;
     }
     
-    return segments.join("\r");
+    m_historyCache.clear();
+    for (const HL7MessageLog::Entry &entry : m_messageLog.recent()) {
+        QString line = QString("[%1] %2 - %3")
+                       .arg(entry.timestamp.toString("yyyy-MM-dd hh:mm:ss"))
+                       .arg(entry.type)
+                       .arg(entry.status);
+        m_historyCache.append(line);
+    }
+    m_historyCacheValid = true;
+    return m_historyCache;
 }
 
-QString HL7Manager::getUnitForField(const QString &field)
+int HL7Manager::queryMessageHistory(const QVariantMap &filter, int offset, int limit)
 {
-    static QMap<QString, QString> units = {
-        {"pH", "pH"},
-        {"pCO2", "mmHg"},
-        {"pO2", "mmHg"},
-        {"HCO3", "mmol/L"},
-        {"SO2", "%"},
-        {"BE", "mmol/L"},
-        {"Na", "mmol/L"},
-        {"K", "mmol/L"},
-        {"Cl", "mmol/L"},
-        {"Ca", "mmol/L"},
-        {"Glucose", "mg/dL"},
-        {"Lactate", "mmol/L"}
-    };
+    HL7MessageLog::Query query;
+    query.from = filter.value("from").toDateTime();
+    query.to = filter.value("to").toDateTime();
+    query.type = filter.value("type").toString();
+    query.controlId = filter.value("controlId").toString();
+    query.sampleId = filter.value("sampleId").toString();
+    query.destination = filter.value("destination").toString();
     
-    return units.value(field, "");
+    const int requestId = ++m_nextQueryId;
+    offset = qMax(0, offset);
+    limit = qBound(0, limit, 500);
+    m_lookupPool.start([this, requestId, query, offset, limit]() {
+        QVariantList page;
+        for (const HL7MessageLog::Entry &entry : m_messageLog.query(query, offset, limit)) {
+            QVariantMap item;
+            item["timestamp"] = entry.timestamp;
+            item["type"] = entry.type;
+            item["controlId"] = entry.controlId;
+            item["sampleId"] = entry.sampleId;
+            item["status"] = entry.status;
+            item["destination"] = entry.destination;
+            item["size"] = entry.length;
+            page.append(item);
+        }
+        QMetaObject::invokeMethod(this, [this, requestId, page]() {
+            emit messageHistoryQueried(requestId, page);
+        }, Qt::QueuedConnection);
+    });
+    return requestId;
 }
 
-QStringList HL7Manager::getMessageHistory()
+void HL7Manager::requestMessageContent(const QString &controlId)
 {
-    QStringList history;
-    for (const HL7Message &msg : m_messageHistory) {
-        QString entry = QString("[%1] %2 - %3")
-                       .arg(msg.timestamp.toString("yyyy-MM-dd hh:mm:ss"))
-                       .arg(msg.type)
-                       .arg(msg.status);
-        history.append(entry);
-    }
-    return history;
+    m_lookupPool.start([this, controlId]() {
+        const QString content = QString::fromUtf8(m_messageLog.readContent(controlId));
+        QMetaObject::invokeMethod(this, [this, controlId, content]() {
+            emit messageContentReady(controlId, content);
+        }, Qt::QueuedConnection);
+    });
 }
 
 void HL7Manager::testConnection()
@@ -294,76 +276,67 @@ void HL7Manager::testConnection()
         return;
     }
     
-    // Send a simple test message
-    QVariantMap testData;
-    testData["test"] = "connection";
-    testData["timestamp"] = QDateTime::currentDateTime().toString(Qt::ISODate);
-    
-    // For demonstration, just log the test
+    // Probe every destination now; results show up in the link statistics
+    QMetaObject::invokeMethod(m_worker, [worker = m_worker]() { worker->sendKeepalives(); });
     qDebug() << "HL7 connection test performed";
 }
 
-QString HL7Manager::generateMessageControlId()
+void HL7Manager::setupHeartbeat()
 {
-    return QString::number(QDateTime::currentSecsSinceEpoch()) + 
-           QString::number(QRandomGenerator::global()->bounded(1000));
+    QMetaObject::invokeMethod(m_worker, [worker = m_worker]() { worker->startHeartbeat(HEARTBEAT_INTERVAL_MS); });
 }
 
-bool HL7Manager::validateHL7Message(const QString &message)
+void HL7Manager::stopHeartbeat()
 {
-    // Basic validation - check if message starts with MSH
-    return message.startsWith("MSH|") && message.contains("\r");
+    QMetaObject::invokeMethod(m_worker, [worker = m_worker]() { worker->stopHeartbeat(); });
 }
 
-QString HL7Manager::escapeHL7Text(const QString &text)
+void HL7Manager::onConnectionTimeout()
 {
-    QString escaped = text;
-    escaped.replace("\\", "\\E\\");
-    escaped.replace("|", "\\F\\");
-    escaped.replace("^", "\\S\\");
-    escaped.replace("&", "\\T\\");
-    escaped.replace("\r", "\\X0D\\");
-    return escaped;
+    emit connectionFailed("Connection timeout");
 }
 
-void HL7Manager::setupHeartbeat()
+void HL7Manager::onWorkerMessageSent(const QString &message)
 {
-    m_heartbeatTimer->start(HEARTBEAT_INTERVAL_MS);
+    m_messagesSent++;
+    emit messagesSentChanged();
+    emit messageSent(message);
 }
 
-void HL7Manager::stopHeartbeat()
+void HL7Manager::onWorkerMessageReceived(const QString &message)
 {
-    m_heartbeatTimer->stop();
+    m_messagesReceived++;
+    emit messagesReceivedChanged();
+    emit messageReceived(message);
 }
 
-void HL7Manager::onConnectionTimeout()
+void HL7Manager::onWorkerMessageLogged()
 {
-    emit connectionFailed("Connection timeout");
+    m_historyCacheValid = false;
+    emit messageHistoryChanged();
 }
 
-void HL7Manager::onHeartbeatTimeout()
+void HL7Manager::onDestinationStatsChanged(const QVariantList &stats)
 {
-    if (m_isConnected) {
-        // Send keepalive message
-        qDebug() << "HL7 heartbeat sent";
+    m_destinations = stats;
+    emit destinationsChanged();
+    
+    m_rttP50Ms = 0.0;
+    m_rttP99Ms = 0.0;
+    m_inFlightCount = 0;
+    m_linkHealthy = true;
+    for (const QVariant &item : stats) {
+        const QVariantMap destination = item.toMap();
+        m_rttP50Ms = qMax(m_rttP50Ms, destination.value("rttP50Ms").toDouble());
+        m_rttP99Ms = qMax(m_rttP99Ms, destination.value("rttP99Ms").toDouble());
+        m_inFlightCount += destination.value("inFlight").toInt();
+        m_linkHealthy = m_linkHealthy && destination.value("healthy", true).toBool();
     }
+    emit linkStatsChanged();
 }
 
-void HL7Manager::onNetworkReply()
+void HL7Manager::onLatencyStatsChanged(const QVariantMap &stats)
 {
-    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
-    if (!reply) {
-        return;
-    }
-    
-    if (reply->error() == QNetworkReply::NoError) {
-        QByteArray response = reply->readAll();
-        m_messagesReceived++;
-        emit messagesReceivedChanged();
-        emit messageReceived(QString::fromUtf8(response));
-    } else {
-        emit hl7Error(reply->errorString());
-    }
-    
-    reply->deleteLater();
-}
\ No newline at end of file
+    m_latencyStats = stats;
+    emit latencyStatsChanged();
+}
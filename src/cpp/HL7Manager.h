@@ -3,86 +3,140 @@
 
 #include <QObject>
 #include <QVariantMap>
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
+#include <QThread>
+#include <QThreadPool>
 #include <QTimer>
 
+#include <atomic>
+
+#include "FhirEncoder.h"
+#include "HL7Encoder.h"
+#include "HL7MessageLog.h"
+
+class HL7Worker;
+
 class HL7Manager : public QObject
 {
     Q_OBJECT
     Q_PROPERTY(bool isConnected READ isConnected NOTIFY connectionStatusChanged)
     Q_PROPERTY(QString serverUrl READ serverUrl WRITE setServerUrl NOTIFY serverUrlChanged)
+    Q_PROPERTY(QString fhirServerUrl READ fhirServerUrl WRITE setFhirServerUrl NOTIFY fhirServerUrlChanged)
     Q_PROPERTY(int messagesSent READ messagesSent NOTIFY messagesSentChanged)
     Q_PROPERTY(int messagesReceived READ messagesReceived NOTIFY messagesReceivedChanged)
+    Q_PROPERTY(QVariantList destinations READ destinations NOTIFY destinationsChanged)
+    Q_PROPERTY(QVariantMap latencyStats READ latencyStats NOTIFY latencyStatsChanged)
+    Q_PROPERTY(double rttP50Ms READ rttP50Ms NOTIFY linkStatsChanged)
+    Q_PROPERTY(double rttP99Ms READ rttP99Ms NOTIFY linkStatsChanged)
+    Q_PROPERTY(int inFlightCount READ inFlightCount NOTIFY linkStatsChanged)
+    Q_PROPERTY(bool linkHealthy READ linkHealthy NOTIFY linkStatsChanged)
     
 public:
     explicit HL7Manager(QObject *parent = nullptr);
+    ~HL7Manager();
     
     bool isConnected() const { return m_isConnected; }
     QString serverUrl() const { return m_serverUrl; }
     void setServerUrl(const QString &url);
+    QString fhirServerUrl() const { return m_fhirServerUrl; }
+    void setFhirServerUrl(const QString &url);
     int messagesSent() const { return m_messagesSent; }
     int messagesReceived() const { return m_messagesReceived; }
+    QVariantList destinations() const { return m_destinations; }
+    QVariantMap latencyStats() const { return m_latencyStats; }
+    double rttP50Ms() const { return m_rttP50Ms; }
+    double rttP99Ms() const { return m_rttP99Ms; }
+    int inFlightCount() const { return m_inFlightCount; }
+    bool linkHealthy() const { return m_linkHealthy; }
+    
+    static const int DEFAULT_LISTENER_PORT = 2575; // IANA port for HL7 over MLLP
     
 public slots:
     Q_INVOKABLE void connectToServer(const QString &url = QString());
     Q_INVOKABLE void disconnectFromServer();
     Q_INVOKABLE bool sendResults(const QVariantMap &results);
     Q_INVOKABLE bool sendPatientInfo(const QVariantMap &patientInfo);
+    Q_INVOKABLE void addDestination(const QVariantMap &config);
+    Q_INVOKABLE void removeDestination(const QString &name);
+    // Inbound orders on the given local address, from the allowed peers
+    // (addresses or subnets; loopback only when empty)
+    Q_INVOKABLE void startListener(const QString &address, int port = DEFAULT_LISTENER_PORT,
+                                   const QStringList &allowedPeers = QStringList());
+    Q_INVOKABLE void stopListener();
+    // Sends the ACK held for an inboundMessageReceived() message: AA when it
+    // was stored, AE otherwise
+    void acknowledgeInbound(quint64 inboundId, bool stored);
     Q_INVOKABLE QStringList getMessageHistory();
+    // Run on a lookup thread; the page arrives through messageHistoryQueried()
+    // with the returned request ID, and the content through messageContentReady()
+    Q_INVOKABLE int queryMessageHistory(const QVariantMap &filter, int offset = 0, int limit = 50);
+    Q_INVOKABLE void requestMessageContent(const QString &controlId);
     Q_INVOKABLE void testConnection();
     Q_INVOKABLE QString generateHL7Message(const QVariantMap &data, const QString &messageType = "ORU^R01");
+    Q_INVOKABLE bool sendFhirBundle(const QVariantList &results);
+    Q_INVOKABLE QString generateFhirBundle(const QVariantList &results);
     
 signals:
     void connectionStatusChanged();
     void serverUrlChanged();
+    void fhirServerUrlChanged();
     void messagesSentChanged();
     void messagesReceivedChanged();
     void messageReceived(const QString &message);
     void messageSent(const QString &message);
     void connectionFailed(const QString &error);
     void hl7Error(const QString &error);
+    void messageHistoryChanged();
+    void messageHistoryQueried(int requestId, const QVariantList &page);
+    void messageContentReady(const QString &controlId, const QString &content);
+    void destinationsChanged();
+    void latencyStatsChanged();
+    void linkStatsChanged();
+    // The sender gets no ACK until acknowledgeInbound()
+    void inboundMessageReceived(quint64 inboundId, const QVariantMap &decoded);
     
 private slots:
-    void onNetworkReply();
     void onConnectionTimeout();
-    void onHeartbeatTimeout();
+    void onWorkerMessageSent(const QString &message);
+    void onWorkerMessageReceived(const QString &message);
+    void onWorkerMessageLogged();
+    void onDestinationStatsChanged(const QVariantList &stats);
+    void onLatencyStatsChanged(const QVariantMap &stats);
     
 private:
-    struct HL7Message {
-        QString type;
-        QString content;
-        QDateTime timestamp;
-        QString status;
-    };
-    
     void setupHeartbeat();
     void stopHeartbeat();
-    QString formatHL7Segment(const QString &segmentType, const QStringList &fields);
-    QString escapeHL7Text(const QString &text);
-    QString generateMessageControlId();
-    QString getUnitForField(const QString &field);
-    QDateTime parseHL7DateTime(const QString &hl7DateTime);
-    bool validateHL7Message(const QString &message);
+    bool submit(const QString &messageType, const QVariantMap &data, bool critical = false);
     
-    QNetworkAccessManager *m_networkManager;
-    bool m_isConnected;
+    // Read by sendResults(), which may be called from the result pipeline thread
+    std::atomic<bool> m_isConnected;
     QString m_serverUrl;
+    QString m_fhirServerUrl;
     int m_messagesSent;
     int m_messagesReceived;
+    QVariantList m_destinations;
+    QVariantMap m_latencyStats;
+    
+    // Link health, worst case across destinations
+    double m_rttP50Ms;
+    double m_rttP99Ms;
+    int m_inFlightCount;
+    bool m_linkHealthy;
     
     QTimer *m_connectionTimer;
-    QTimer *m_heartbeatTimer;
-    QList<HL7Message> m_messageHistory;
+    HL7MessageLog m_messageLog;
+    QStringList m_historyCache;
+    bool m_historyCacheValid;
+    int m_nextQueryId;
+    QThreadPool m_lookupPool;
     
-    // HL7 Configuration
-    QString m_sendingApplication;
-    QString m_sendingFacility;
-    QString m_receivingApplication;
-    QString m_receivingFacility;
+    // Encoding and transmission run on the I/O thread
+    QThread m_ioThread;
+    HL7Worker *m_worker;
+    HL7Encoder m_encoder;
+    FhirEncoder m_fhirEncoder;
     
     static const int CONNECTION_TIMEOUT_MS = 10000; // 10 seconds
-    static const int HEARTBEAT_INTERVAL_MS = 60000; // 1 minute
+    static const int HEARTBEAT_INTERVAL_MS = 15000; // 15 seconds
 };
 
 #endif // HL7MANAGER_H
\ No newline at end of file
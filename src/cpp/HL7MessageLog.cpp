@@ -0,0 +1,396 @@
+#include "HL7MessageLog.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+
+HL7MessageLog::HL7MessageLog(const QString &directory)
+    : m_directory(directory)
+    , m_isOpen(false)
+    , m_recentHead(0)
+    , m_recentCount(0)
+{
+    m_recent.resize(RECENT_CAPACITY);
+    ensureOpen();
+}
+
+HL7MessageLog::~HL7MessageLog()
+{
+    m_dataFile.close();
+    m_indexFile.close();
+}
+
+bool HL7MessageLog::ensureOpen()
+{
+    if (m_isOpen) {
+        return true;
+    }
+
+    QDir dir(m_directory);
+    if (!dir.exists() && !dir.mkpath(m_directory)) {
+        qWarning() << "Failed to create HL7 log directory:" << m_directory;
+        return false;
+    }
+
+    // Discover existing segments so that queries span previous runs. Built
+    // aside and only kept once the newest segment opens, so a retry does
+    // not count them twice.
+    QList<Segment> segments;
+    const QStringList indexFiles = dir.entryList(QStringList() << "*.idx", QDir::Files, QDir::Name);
+    for (const QString &fileName : indexFiles) {
+        bool ok = false;
+        int seq = QFileInfo(fileName).baseName().toInt(&ok);
+        if (!ok) {
+            continue;
+        }
+        Segment segment{seq, 0, 0};
+        readTimeSpan(segment);
+        segments.append(segment);
+    }
+
+    if (segments.isEmpty()) {
+        segments.append(Segment{1, 0, 0});
+    }
+    if (!openSegment(segments.last().seq)) {
+        return false;
+    }
+
+    m_segments = segments;
+    m_recentHead = 0;
+    m_recentCount = 0;
+
+    // Warm the recent ring buffer from the newest segment
+    const QList<Entry> lastEntries = readIndex(segments.last());
+    for (int i = qMax(0, lastEntries.size() - RECENT_CAPACITY); i < lastEntries.size(); ++i) {
+        pushRecent(lastEntries.at(i));
+    }
+
+    m_isOpen = true;
+    if (m_dataFile.size() >= SEGMENT_MAX_BYTES) {
+        rollSegment();
+    }
+    return true;
+}
+
+bool HL7MessageLog::openSegment(int seq)
+{
+    m_dataFile.close();
+    m_indexFile.close();
+
+    m_dataFile.setFileName(dataPath(seq));
+    m_indexFile.setFileName(indexPath(seq));
+
+    if (!m_dataFile.open(QIODevice::Append) || !m_indexFile.open(QIODevice::Append | QIODevice::Text)) {
+        qWarning() << "Failed to open HL7 log segment:" << seq;
+        return false;
+    }
+    return true;
+}
+
+void HL7MessageLog::rollSegment()
+{
+    int seq = m_segments.last().seq + 1;
+    m_segments.append(Segment{seq, 0, 0});
+    openSegment(seq);
+    enforceRetention();
+}
+
+void HL7MessageLog::enforceRetention()
+{
+    while (m_segments.size() > MAX_SEGMENTS) {
+        const Segment oldest = m_segments.takeFirst();
+        QFile::remove(dataPath(oldest.seq));
+        QFile::remove(indexPath(oldest.seq));
+
+        // Drop recent entries that point into the removed segment
+        for (int i = 0; i < m_recentCount; ++i) {
+            Entry &entry = m_recent[(m_recentHead - 1 - i + RECENT_CAPACITY) % RECENT_CAPACITY];
+            if (entry.segment == oldest.seq) {
+                entry.segment = -1;
+            }
+        }
+    }
+}
+
+bool HL7MessageLog::append(const QString &type, const QString &controlId, const QString &sampleId,
+                           const QString &status, const QByteArray &content,
+                           const QString &destination)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!ensureOpen()) {
+        return false;
+    }
+
+    if (m_dataFile.size() + content.size() > SEGMENT_MAX_BYTES && m_dataFile.size() > 0) {
+        rollSegment();
+    }
+
+    Entry entry;
+    entry.timestamp = QDateTime::currentDateTime();
+    entry.type = sanitize(type);
+    entry.controlId = sanitize(controlId);
+    entry.sampleId = sanitize(sampleId);
+    entry.status = sanitize(status);
+    entry.destination = sanitize(destination);
+    entry.segment = m_segments.last().seq;
+    entry.offset = m_dataFile.size();
+    entry.length = content.size();
+
+    if (m_dataFile.write(content) != content.size()) {
+        qWarning() << "Failed to write HL7 message body:" << m_dataFile.errorString();
+        return false;
+    }
+    m_dataFile.flush();
+
+    const qint64 msecs = entry.timestamp.toMSecsSinceEpoch();
+    QByteArray line = QByteArray::number(msecs) + '\t'
+                    + QByteArray::number(entry.offset) + '\t'
+                    + QByteArray::number(entry.length) + '\t'
+                    + entry.type.toUtf8() + '\t'
+                    + entry.controlId.toUtf8() + '\t'
+                    + entry.sampleId.toUtf8() + '\t'
+                    + entry.status.toUtf8() + '\t'
+                    + entry.destination.toUtf8() + '\n';
+    m_indexFile.write(line);
+    m_indexFile.flush();
+
+    Segment &segment = m_segments.last();
+    if (segment.firstMsecs == 0) {
+        segment.firstMsecs = msecs;
+    }
+    segment.lastMsecs = msecs;
+
+    pushRecent(entry);
+    return true;
+}
+
+void HL7MessageLog::pushRecent(const Entry &entry)
+{
+    m_recent[m_recentHead] = entry;
+    m_recentHead = (m_recentHead + 1) % RECENT_CAPACITY;
+    m_recentCount = qMin(m_recentCount + 1, int(RECENT_CAPACITY));
+}
+
+QList<HL7MessageLog::Entry> HL7MessageLog::recent() const
+{
+    QMutexLocker locker(&m_mutex);
+    return recentEntries();
+}
+
+QList<HL7MessageLog::Entry> HL7MessageLog::query(const Query &query, int offset, int limit) const
+{
+    return findEntries(query, offset, limit);
+}
+
+QList<HL7MessageLog::Entry> HL7MessageLog::recentEntries() const
+{
+    QList<Entry> entries;
+    entries.reserve(m_recentCount);
+    for (int i = 0; i < m_recentCount; ++i) {
+        entries.append(m_recent.at((m_recentHead - 1 - i + RECENT_CAPACITY) % RECENT_CAPACITY));
+    }
+    return entries;
+}
+
+QList<HL7MessageLog::Entry> HL7MessageLog::findEntries(const Query &query, int offset, int limit) const
+{
+    QList<Entry> page;
+    if (limit <= 0) {
+        return page;
+    }
+
+    // Only what the lookup needs is taken under the lock; closed segments
+    // never change, and the current one is read up to its present size
+    QList<Segment> segments;
+    qint64 currentIndexSize = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_isOpen) {
+            return page;
+        }
+        segments = m_segments;
+        currentIndexSize = m_indexFile.size();
+    }
+    // A lookup by ID only parses the index lines that contain it
+    const QByteArray id = (!query.controlId.isEmpty() ? query.controlId : query.sampleId).toUtf8();
+
+    int skipped = 0;
+    auto collect = [&](const QList<Entry> &entries) {
+        for (int i = entries.size() - 1; i >= 0 && page.size() < limit; --i) {
+            const Entry &entry = entries.at(i);
+            if (!matches(entry, query)) {
+                continue;
+            }
+            if (skipped < offset) {
+                ++skipped;
+                continue;
+            }
+            page.append(entry);
+        }
+    };
+
+    const qint64 fromMsecs = query.from.isValid() ? query.from.toMSecsSinceEpoch() : 0;
+    const qint64 toMsecs = query.to.isValid() ? query.to.toMSecsSinceEpoch() : Q_INT64_C(0x7fffffffffffffff);
+
+    // Walk segments newest first, skipping those outside the time range
+    for (int s = segments.size() - 1; s >= 0 && page.size() < limit; --s) {
+        const Segment &segment = segments.at(s);
+        if (segment.lastMsecs != 0 && (segment.lastMsecs < fromMsecs || segment.firstMsecs > toMsecs)) {
+            continue;
+        }
+        collect(readIndex(segment, s == segments.size() - 1 ? currentIndexSize : -1, id));
+    }
+    return page;
+}
+
+QByteArray HL7MessageLog::readContent(const QString &controlId) const
+{
+    if (controlId.isEmpty()) {
+        return QByteArray();
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+
+        // Recent messages can be located without touching the index files
+        for (const Entry &entry : recentEntries()) {
+            if (entry.controlId == controlId && entry.segment >= 0) {
+                locker.unlock();
+                return readBody(entry);
+            }
+        }
+    }
+
+    // The latest message with the ID
+    Query query;
+    query.controlId = controlId;
+    const QList<Entry> found = findEntries(query, 0, 1);
+    return found.isEmpty() ? QByteArray() : readBody(found.first());
+}
+
+QList<HL7MessageLog::Entry> HL7MessageLog::readIndex(const Segment &segment, qint64 maxBytes,
+                                                     const QByteArray &containing) const
+{
+    QList<Entry> entries;
+    QFile file(indexPath(segment.seq));
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return entries;
+    }
+
+    while (!file.atEnd() && (maxBytes < 0 || file.pos() < maxBytes)) {
+        const QByteArray line = file.readLine();
+        Entry entry;
+        if ((!containing.isEmpty() && !line.contains(containing)) || !parseIndexLine(line, segment.seq, entry)) {
+            continue;
+        }
+        entries.append(entry);
+    }
+    return entries;
+}
+
+void HL7MessageLog::readTimeSpan(Segment &segment) const
+{
+    QFile file(indexPath(segment.seq));
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return;
+    }
+    Entry first;
+    const bool hasFirst = parseIndexLine(file.readLine(), segment.seq, first);
+
+    // The last line is the one after the last line break of the tail
+    const qint64 firstEnd = file.pos();
+    const qint64 tailStart = qMax(firstEnd, file.size() - MAX_INDEX_LINE_BYTES);
+    QByteArray tail;
+    if (file.seek(tailStart)) {
+        tail = file.readAll();
+    }
+    if (tail.endsWith('\n')) {
+        tail.chop(1);
+    }
+    const qsizetype lastStart = tail.lastIndexOf('\n') + 1;
+    Entry last = first;
+    if (!hasFirst || (!tail.isEmpty() && ((lastStart == 0 && tailStart > firstEnd) ||
+                                          !parseIndexLine(tail.mid(lastStart), segment.seq, last)))) {
+        // A malformed or overlong line; read the whole index instead
+        const QList<Entry> entries = readIndex(segment);
+        if (!entries.isEmpty()) {
+            segment.firstMsecs = entries.first().timestamp.toMSecsSinceEpoch();
+            segment.lastMsecs = entries.last().timestamp.toMSecsSinceEpoch();
+        }
+        return;
+    }
+    segment.firstMsecs = first.timestamp.toMSecsSinceEpoch();
+    segment.lastMsecs = last.timestamp.toMSecsSinceEpoch();
+}
+
+bool HL7MessageLog::parseIndexLine(QByteArray line, int segment, Entry &entry)
+{
+    if (line.endsWith('\n')) {
+        line.chop(1);
+    }
+    const QList<QByteArray> fields = line.split('\t');
+    if (fields.size() < 7) {
+        return false;
+    }
+    entry.timestamp = QDateTime::fromMSecsSinceEpoch(fields.at(0).toLongLong());
+    entry.offset = fields.at(1).toLongLong();
+    entry.length = fields.at(2).toInt();
+    entry.type = QString::fromUtf8(fields.at(3));
+    entry.controlId = QString::fromUtf8(fields.at(4));
+    entry.sampleId = QString::fromUtf8(fields.at(5));
+    entry.status = QString::fromUtf8(fields.at(6));
+    entry.destination = fields.size() > 7 ? QString::fromUtf8(fields.at(7)) : QString();
+    entry.segment = segment;
+    return true;
+}
+
+QByteArray HL7MessageLog::readBody(const Entry &entry) const
+{
+    QFile file(dataPath(entry.segment));
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(entry.offset)) {
+        return QByteArray();
+    }
+    return file.read(entry.length);
+}
+
+bool HL7MessageLog::matches(const Entry &entry, const Query &query)
+{
+    if (query.from.isValid() && entry.timestamp < query.from) {
+        return false;
+    }
+    if (query.to.isValid() && entry.timestamp > query.to) {
+        return false;
+    }
+    if (!query.type.isEmpty() && entry.type != query.type) {
+        return false;
+    }
+    if (!query.controlId.isEmpty() && entry.controlId != query.controlId) {
+        return false;
+    }
+    if (!query.sampleId.isEmpty() && entry.sampleId != query.sampleId) {
+        return false;
+    }
+    if (!query.destination.isEmpty() && entry.destination != query.destination) {
+        return false;
+    }
+    return true;
+}
+
+QString HL7MessageLog::sanitize(const QString &field)
+{
+    QString clean = field;
+    clean.replace('\t', ' ');
+    clean.replace('\n', ' ');
+    clean.replace('\r', ' ');
+    return clean;
+}
+
+QString HL7MessageLog::dataPath(int seq) const
+{
+    return QDir(m_directory).filePath(QString("%1.dat").arg(seq, 6, 10, QChar('0')));
+}
+
+QString HL7MessageLog::indexPath(int seq) const
+{
+    return QDir(m_directory).filePath(QString("%1.idx").arg(seq, 6, 10, QChar('0')));
+}
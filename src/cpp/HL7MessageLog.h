@@ -0,0 +1,105 @@
+#ifndef HL7MESSAGELOG_H
+#define HL7MESSAGELOG_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+// Append-only, segmented on-disk log of HL7 messages.
+// Message bodies live in <seq>.dat files, one tab separated index line per
+// message lives in the matching <seq>.idx file. Only the metadata of the most
+// recent messages is kept in memory, in a fixed-size ring buffer, and the
+// time span of each segment; anything older is looked up in the index
+// files, newest segment first. Opening reads the first and last index line
+// of each segment, and the newest segment's index for the ring.
+// All public methods are thread-safe; queries read the files outside the
+// lock, so they do not hold up append().
+class HL7MessageLog
+{
+public:
+    struct Entry {
+        QDateTime timestamp;
+        QString type;
+        QString controlId;
+        QString sampleId;
+        QString status;
+        QString destination;
+        int segment = -1;
+        qint64 offset = 0;
+        qint32 length = 0;
+    };
+
+    struct Query {
+        QDateTime from;
+        QDateTime to;
+        QString type;
+        QString controlId;
+        QString sampleId;
+        QString destination;
+    };
+
+    explicit HL7MessageLog(const QString &directory);
+    ~HL7MessageLog();
+
+    bool append(const QString &type, const QString &controlId, const QString &sampleId,
+                const QString &status, const QByteArray &content,
+                const QString &destination = QString());
+
+    // Newest first
+    QList<Entry> recent() const;
+    QList<Entry> query(const Query &query, int offset, int limit) const;
+    QByteArray readContent(const QString &controlId) const;
+
+    QString directory() const { return m_directory; }
+
+    static const int RECENT_CAPACITY = 200;
+    static const qint64 SEGMENT_MAX_BYTES = 4 * 1024 * 1024; // 4 MB
+    static const int MAX_SEGMENTS = 64;
+
+private:
+    struct Segment {
+        int seq;
+        qint64 firstMsecs;
+        qint64 lastMsecs;
+    };
+
+    bool ensureOpen();
+    QList<Entry> recentEntries() const;
+    QList<Entry> findEntries(const Query &query, int offset, int limit) const;
+    bool openSegment(int seq);
+    void rollSegment();
+    void enforceRetention();
+    void pushRecent(const Entry &entry);
+    // Up to maxBytes of the segment's index, or all of it; only the lines
+    // containing the given bytes, when there are any
+    QList<Entry> readIndex(const Segment &segment, qint64 maxBytes = -1,
+                           const QByteArray &containing = QByteArray()) const;
+    // From the first and last index lines
+    void readTimeSpan(Segment &segment) const;
+    static bool parseIndexLine(QByteArray line, int segment, Entry &entry);
+    QByteArray readBody(const Entry &entry) const;
+    QString dataPath(int seq) const;
+    QString indexPath(int seq) const;
+    static bool matches(const Entry &entry, const Query &query);
+    static QString sanitize(const QString &field);
+
+    mutable QMutex m_mutex;
+    QString m_directory;
+    bool m_isOpen;
+    QList<Segment> m_segments; // oldest first
+    QFile m_dataFile;
+    QFile m_indexFile;
+
+    // Ring buffer of recent message metadata
+    QList<Entry> m_recent;
+    int m_recentHead;
+    int m_recentCount;
+
+    // Longest index line expected when reading a segment's last line
+    static const qint64 MAX_INDEX_LINE_BYTES = 4096;
+};
+
+#endif // HL7MESSAGELOG_H
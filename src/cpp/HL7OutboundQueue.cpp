@@ -0,0 +1,57 @@
+#include "HL7OutboundQueue.h"
+
+#include <algorithm>
+
+HL7OutboundQueue::HL7OutboundQueue(int maxRoutine, int maxCritical)
+    : m_maxRoutine(qMax(1, maxRoutine))
+    , m_maxCritical(qMax(1, maxCritical))
+    , m_nextSequence(1)
+{
+}
+
+void HL7OutboundQueue::setLimits(int maxRoutine, int maxCritical)
+{
+    // Messages already queued stay even if the new limits are lower
+    m_maxRoutine = qMax(1, maxRoutine);
+    m_maxCritical = qMax(1, maxCritical);
+}
+
+bool HL7OutboundQueue::push(HL7OutboundMessage message)
+{
+    QList<HL7OutboundMessage> &lane = message.critical ? m_critical : m_routine;
+    if (lane.size() >= (message.critical ? m_maxCritical : m_maxRoutine)) {
+        return false;
+    }
+    message.sequence = m_nextSequence++;
+    lane.append(message);
+    return true;
+}
+
+void HL7OutboundQueue::putBack(const HL7OutboundMessage &message)
+{
+    insertInOrder(message.critical ? m_critical : m_routine, message);
+}
+
+bool HL7OutboundQueue::take(bool routineAllowed, HL7OutboundMessage &message)
+{
+    if (!m_critical.isEmpty()) {
+        message = m_critical.takeFirst();
+        return true;
+    }
+    if (routineAllowed && !m_routine.isEmpty()) {
+        message = m_routine.takeFirst();
+        return true;
+    }
+    return false;
+}
+
+void HL7OutboundQueue::insertInOrder(QList<HL7OutboundMessage> &lane, const HL7OutboundMessage &message)
+{
+    // Failures come back in any order while several messages are in flight;
+    // each one goes back to where it was queued. Usually that is the head.
+    const auto position = std::upper_bound(lane.begin(), lane.end(), message.sequence,
+                                           [](quint64 sequence, const HL7OutboundMessage &queued) {
+                                               return sequence < queued.sequence;
+                                           });
+    lane.insert(position, message);
+}
@@ -0,0 +1,58 @@
+#ifndef HL7OUTBOUNDQUEUE_H
+#define HL7OUTBOUNDQUEUE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+struct HL7OutboundMessage {
+    QString type;
+    QString sampleId;
+    QString controlId;
+    QByteArray message; // encoded body, HL7 v2 or FHIR JSON
+    bool critical = false;
+    qint64 enqueuedNs = 0;
+    qint64 sentNs = 0; // destination clock, set on dispatch
+    quint64 sequence = 0; // queue order, set by HL7OutboundQueue::push()
+    int attempts = 0;
+};
+
+// A destination's outbound messages in two lanes, critical and routine.
+// A message belongs to the queue until its ACK: take() lends it out, and
+// after a failure putBack() returns it to the head of its lane, ahead of
+// everything that was queued after it. Critical messages always come out
+// first, so after an outage they go ahead of the routine backlog.
+// Both lanes are bounded for new messages, the critical one so that a
+// flood of critical values cannot grow without limit either; messages put
+// back always fit.
+// Not thread-safe.
+class HL7OutboundQueue
+{
+public:
+    HL7OutboundQueue(int maxRoutine, int maxCritical);
+
+    void setLimits(int maxRoutine, int maxCritical);
+
+    // Returns false when the message's lane is at its limit
+    bool push(HL7OutboundMessage message);
+    void putBack(const HL7OutboundMessage &message);
+    // The next message, critical first; routine ones only when allowed
+    bool take(bool routineAllowed, HL7OutboundMessage &message);
+
+    int criticalSize() const { return int(m_critical.size()); }
+    int routineSize() const { return int(m_routine.size()); }
+    int size() const { return criticalSize() + routineSize(); }
+    bool hasCritical() const { return !m_critical.isEmpty(); }
+    bool isEmpty() const { return size() == 0; }
+
+private:
+    static void insertInOrder(QList<HL7OutboundMessage> &lane, const HL7OutboundMessage &message);
+
+    QList<HL7OutboundMessage> m_critical;
+    QList<HL7OutboundMessage> m_routine;
+    int m_maxRoutine;
+    int m_maxCritical;
+    quint64 m_nextSequence;
+};
+
+#endif // HL7OUTBOUNDQUEUE_H
@@ -0,0 +1,382 @@
+#include "HL7Worker.h"
+#include "HL7Listener.h"
+#include "HL7MessageLog.h"
+
+#include <QDebug>
+#include <QMetaObject>
+#include <QTimer>
+
+#include <chrono>
+
+HL7Worker::HL7Worker(HL7MessageLog *messageLog, QObject *parent)
+    : QObject(parent)
+    , m_messageLog(messageLog)
+    , m_statsTimer(new QTimer(this))
+    , m_batchTimer(new QTimer(this))
+    , m_heartbeatTimer(new QTimer(this))
+    , m_listener(new HL7Listener(this))
+    , m_intake(INTAKE_CAPACITY)
+    , m_criticalIntake(CRITICAL_INTAKE_CAPACITY)
+    , m_routineScheduled(false)
+    , m_criticalScheduled(false)
+    , m_criticalSloMisses(0)
+{
+    // Stats are coalesced so that a burst of deliveries produces one update
+    m_statsTimer->setSingleShot(true);
+    connect(m_statsTimer, &QTimer::timeout, this, &HL7Worker::publishStats);
+
+    m_batchTimer->setSingleShot(true);
+    connect(m_batchTimer, &QTimer::timeout, this, &HL7Worker::drainRoutine);
+
+    connect(m_heartbeatTimer, &QTimer::timeout, this, &HL7Worker::sendKeepalives);
+    connect(m_listener, &HL7Listener::messageReceived, this, &HL7Worker::onInboundMessage);
+
+    // Primary LIS destination, its URL follows HL7Manager::serverUrl
+    HL7DestinationConfig lis;
+    lis.name = "LIS";
+    lis.receivingApplication = m_encoder.receivingApplication();
+    lis.receivingFacility = m_encoder.receivingFacility();
+    createDestination(lis);
+}
+
+bool HL7Worker::enqueue(const HL7Record &record)
+{
+    // Only one drain per lane needs to be pending at a time; the drain clears
+    // the flag before popping, so a record pushed after that point schedules
+    // another one.
+    if (record.critical) {
+        if (!m_criticalIntake.tryPush(record)) {
+            return false;
+        }
+        if (!m_criticalScheduled.exchange(true)) {
+            QMetaObject::invokeMethod(this, &HL7Worker::drainCritical, Qt::QueuedConnection);
+        }
+        return true;
+    }
+
+    if (!m_intake.tryPush(record)) {
+        return false;
+    }
+    if (!m_routineScheduled.exchange(true)) {
+        QMetaObject::invokeMethod(this, &HL7Worker::startRoutineBatch, Qt::QueuedConnection);
+    }
+    return true;
+}
+
+qint64 HL7Worker::monotonicNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void HL7Worker::setServerUrl(const QString &url)
+{
+    HL7Destination *lis = findDestination("LIS");
+    if (!lis) {
+        return;
+    }
+    HL7DestinationConfig config = lis->config();
+    config.url = url;
+    lis->setConfig(config);
+}
+
+void HL7Worker::addDestination(const QVariantMap &map)
+{
+    HL7DestinationConfig config = HL7DestinationConfig::fromVariantMap(map);
+    if (config.name.isEmpty() || config.url.isEmpty()) {
+        emit transmissionFailed("HL7 destination requires a name and a URL");
+        return;
+    }
+
+    // Re-adding an existing name updates it in place and keeps its queue
+    if (HL7Destination *existing = findDestination(config.name)) {
+        existing->setConfig(config);
+    } else {
+        createDestination(config);
+    }
+    publishStats();
+}
+
+void HL7Worker::removeDestination(const QString &name)
+{
+    HL7Destination *destination = findDestination(name);
+    if (!destination) {
+        return;
+    }
+    m_destinations.removeOne(destination);
+    destination->deleteLater();
+    publishStats();
+}
+
+void HL7Worker::startHeartbeat(int intervalMs)
+{
+    m_heartbeatTimer->start(intervalMs);
+    sendKeepalives();
+}
+
+void HL7Worker::stopHeartbeat()
+{
+    m_heartbeatTimer->stop();
+}
+
+void HL7Worker::sendKeepalives()
+{
+    const QString keepalive = m_encoder.generateMessage(QVariantMap(), "NMD^N02");
+    for (HL7Destination *destination : m_destinations) {
+        const HL7DestinationConfig &config = destination->config();
+        destination->sendKeepalive(HL7Encoder::rewriteReceiver(keepalive, config.receivingApplication, config.receivingFacility));
+    }
+}
+
+void HL7Worker::startListener(const QString &address, int port, const QStringList &allowedPeers)
+{
+    m_listener->setAllowedPeers(allowedPeers);
+    if (!m_listener->listen(QHostAddress(address), quint16(port))) {
+        emit transmissionFailed(QString("Cannot listen for inbound HL7 on %1 port %2").arg(address).arg(port));
+    }
+}
+
+void HL7Worker::stopListener()
+{
+    m_listener->close();
+}
+
+void HL7Worker::acknowledgeInbound(quint64 inboundId, bool stored)
+{
+    m_listener->acknowledge(inboundId, stored);
+}
+
+HL7Destination *HL7Worker::createDestination(const HL7DestinationConfig &config)
+{
+    HL7Destination *destination = new HL7Destination(config, this);
+    connect(destination, &HL7Destination::dispatched, this, [this](const QString &, const QByteArray &message) {
+        emit messageSent(QString::fromUtf8(message));
+    });
+    connect(destination, &HL7Destination::delivered, this, &HL7Worker::onDelivered);
+    connect(destination, &HL7Destination::failed, this, &HL7Worker::onFailed);
+    connect(destination, &HL7Destination::backpressure, this, &HL7Worker::onBackpressure);
+    connect(destination, &HL7Destination::healthChanged, this, &HL7Worker::onHealthChanged);
+    connect(destination, &HL7Destination::statsChanged, this, [this]() {
+        if (!m_statsTimer->isActive()) {
+            m_statsTimer->start(STATS_INTERVAL_MS);
+        }
+    });
+    m_destinations.append(destination);
+    return destination;
+}
+
+HL7Destination *HL7Worker::findDestination(const QString &name) const
+{
+    for (HL7Destination *destination : m_destinations) {
+        if (destination->config().name == name) {
+            return destination;
+        }
+    }
+    return nullptr;
+}
+
+void HL7Worker::startRoutineBatch()
+{
+    if (!m_batchTimer->isActive()) {
+        m_batchTimer->start(ROUTINE_BATCH_WINDOW_MS);
+    }
+}
+
+void HL7Worker::drainCritical()
+{
+    m_criticalScheduled.store(false);
+
+    HL7Record record;
+    while (m_criticalIntake.tryPop(record)) {
+        process(record);
+    }
+}
+
+void HL7Worker::drainRoutine()
+{
+    m_routineScheduled.store(false);
+
+    HL7Record record;
+    while (m_intake.tryPop(record)) {
+        // Critical records that arrived meanwhile jump ahead of the batch
+        if (m_criticalIntake.sizeApprox() > 0) {
+            drainCritical();
+        }
+        process(record);
+    }
+}
+
+void HL7Worker::process(const HL7Record &record)
+{
+    // Encode at most once per format; v2 destinations only differ in their
+    // MSH receiver fields, FHIR destinations all get the same bundle
+    QString message;
+    QByteArray bundle;
+    bool encoded = false;
+    bool valid = false;
+
+    HL7OutboundMessage outbound;
+    outbound.type = record.type;
+    outbound.sampleId = record.data.value("sampleId").toString();
+    outbound.critical = record.critical;
+    outbound.enqueuedNs = record.enqueuedNs;
+
+    for (HL7Destination *destination : m_destinations) {
+        const HL7DestinationConfig &config = destination->config();
+        if (config.url.isEmpty() || config.bulkOnly) {
+            continue;
+        }
+
+        if (config.format == "fhir") {
+            // FHIR receivers only take results
+            if (record.type != "ORU^R01") {
+                continue;
+            }
+            if (bundle.isEmpty()) {
+                bundle = m_fhirEncoder.encodeBundle(record.data);
+            }
+            outbound.controlId = FhirEncoder::bundleId(bundle);
+            outbound.message = bundle;
+        } else {
+            if (!encoded) {
+                message = m_encoder.generateMessage(record.data, record.type);
+                encoded = true;
+                valid = HL7Encoder::validateMessage(message);
+                if (!valid) {
+                    emit transmissionFailed("Invalid HL7 message generated");
+                }
+            }
+            if (!valid) {
+                continue;
+            }
+            outbound.controlId = HL7Encoder::messageControlId(message);
+            outbound.message = HL7Encoder::rewriteReceiver(message, config.receivingApplication, config.receivingFacility).toUtf8();
+        }
+
+        enqueueTo(destination, outbound);
+    }
+}
+
+void HL7Worker::enqueueTo(HL7Destination *destination, const HL7OutboundMessage &outbound)
+{
+    if (!destination->enqueue(outbound)) {
+        m_messageLog->append(outbound.type, outbound.controlId, outbound.sampleId, "DROPPED",
+                             outbound.message, destination->config().name);
+        emit messageLogged();
+    }
+}
+
+void HL7Worker::sendFhirBundle(const QVariantList &results, const QString &url)
+{
+    // Bulk transfers go to the FHIR destination, created on first use and
+    // left out of the live result fan-out
+    HL7Destination *fhir = findDestination("FHIR");
+    if (!fhir) {
+        HL7DestinationConfig config;
+        config.name = "FHIR";
+        config.url = url;
+        config.format = "fhir";
+        config.bulkOnly = true;
+        fhir = createDestination(config);
+    } else if (fhir->config().url != url) {
+        HL7DestinationConfig config = fhir->config();
+        config.url = url;
+        fhir->setConfig(config);
+    }
+
+    QList<QVariantMap> batch;
+    batch.reserve(results.size());
+    for (const QVariant &result : results) {
+        batch.append(result.toMap());
+    }
+
+    HL7OutboundMessage outbound;
+    outbound.type = "Bundle";
+    outbound.sampleId = batch.size() == 1 ? batch.first().value("sampleId").toString() : QString();
+    outbound.message = m_fhirEncoder.encodeBundle(batch);
+    outbound.controlId = FhirEncoder::bundleId(outbound.message);
+    outbound.enqueuedNs = monotonicNs();
+    enqueueTo(fhir, outbound);
+}
+
+void HL7Worker::onDelivered(const QString &destination, const HL7OutboundMessage &message, const QString &response)
+{
+    m_messageLog->append(message.type, message.controlId, message.sampleId, "ACKED",
+                         message.message, destination);
+    emit messageLogged();
+    emit messageReceived(response);
+
+    if (message.enqueuedNs > 0) {
+        const double latencyMs = (monotonicNs() - message.enqueuedNs) / 1.0e6;
+        if (message.critical) {
+            m_criticalLatency.record(latencyMs);
+            if (latencyMs > CRITICAL_SLO_MS) {
+                m_criticalSloMisses++;
+                qWarning() << "Critical HL7 result to" << destination << "missed SLO:" << latencyMs << "ms";
+            }
+        } else {
+            m_routineLatency.record(latencyMs);
+        }
+    }
+}
+
+void HL7Worker::onFailed(const QString &destination, const HL7OutboundMessage &message, const QString &error)
+{
+    // The destination keeps the message and retries it; each failed
+    // attempt is logged
+    m_messageLog->append(message.type, message.controlId, message.sampleId, "FAILED",
+                         message.message, destination);
+    emit messageLogged();
+    emit transmissionFailed(QString("%1: %2 (attempt %3, will retry)").arg(destination, error).arg(message.attempts));
+}
+
+void HL7Worker::onInboundMessage(quint64 inboundId, const QVariantMap &decoded, const QString &message)
+{
+    const QVariantList orders = decoded.value("orders").toList();
+    const QString accession = orders.isEmpty() ? QString() : orders.first().toMap().value("accession").toString();
+    m_messageLog->append(decoded.value("messageType").toString(), decoded.value("controlId").toString(),
+                         accession, "RECEIVED", message.toUtf8(), decoded.value("sendingApplication").toString());
+    emit messageLogged();
+    emit inboundReceived(inboundId, decoded);
+}
+
+void HL7Worker::onBackpressure(const QString &destination, int queueDepth, bool critical)
+{
+    if (critical) {
+        // Someone has to phone this result through
+        const QString error = QString("%1: critical result queue full at %2 messages, critical result not sent")
+                                  .arg(destination).arg(queueDepth);
+        qWarning() << error;
+        emit transmissionFailed(error);
+        return;
+    }
+    qWarning() << "HL7 destination" << destination << "queue full at" << queueDepth << "messages";
+}
+
+void HL7Worker::onHealthChanged(const QString &destination, bool healthy)
+{
+    if (!healthy) {
+        emit transmissionFailed(destination + ": link degraded, reconnecting");
+    }
+}
+
+void HL7Worker::publishStats()
+{
+    QVariantList stats;
+    for (const HL7Destination *destination : m_destinations) {
+        stats.append(destination->stats());
+    }
+    emit destinationStatsChanged(stats);
+
+    QVariantMap latency;
+    latency["criticalCount"] = m_criticalLatency.count();
+    latency["criticalP50Ms"] = m_criticalLatency.percentile(50);
+    latency["criticalP99Ms"] = m_criticalLatency.percentile(99);
+    latency["criticalMaxMs"] = m_criticalLatency.max();
+    latency["criticalSloMs"] = CRITICAL_SLO_MS;
+    latency["criticalSloMisses"] = m_criticalSloMisses;
+    latency["routineCount"] = m_routineLatency.count();
+    latency["routineP50Ms"] = m_routineLatency.percentile(50);
+    latency["routineP99Ms"] = m_routineLatency.percentile(99);
+    emit latencyStatsChanged(latency);
+}
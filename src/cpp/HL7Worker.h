@@ -0,0 +1,116 @@
+#ifndef HL7WORKER_H
+#define HL7WORKER_H
+
+#include <QObject>
+#include <QList>
+#include <QVariantMap>
+
+#include <atomic>
+
+#include "HL7Destination.h"
+#include "FhirEncoder.h"
+#include "HL7Encoder.h"
+#include "LatencyHistogram.h"
+#include "LockFreeQueue.h"
+
+class QTimer;
+class HL7Listener;
+class HL7MessageLog;
+
+struct HL7Record {
+    QString type;
+    QVariantMap data;
+    bool critical = false;
+    qint64 enqueuedNs = 0;
+};
+
+// Lives on the HL7 I/O thread. Records are handed over through a lock-free
+// queue, encoded once per format (HL7 v2 or FHIR) and fanned out to every
+// configured destination, v2 ones with their own MSH receiver fields.
+// Routine records are drained in short batches; critical records have their
+// own intake queue and are processed immediately, ahead of any routine
+// work. Outcomes are reported back through signals, which reach the GUI
+// thread as queued connections.
+// The worker also owns the heartbeat: an NMD^N02 keepalive per destination
+// whose round trips drive each link's RTT statistics and timeouts, and the
+// inbound MLLP listener that feeds the order worklist.
+class HL7Worker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HL7Worker(HL7MessageLog *messageLog, QObject *parent = nullptr);
+
+    // Thread-safe, never blocks. Returns false when the intake queue is full.
+    bool enqueue(const HL7Record &record);
+    int queueDepth() const { return int(m_intake.sizeApprox() + m_criticalIntake.sizeApprox()); }
+
+    static qint64 monotonicNs();
+
+public slots:
+    void setServerUrl(const QString &url);
+    void addDestination(const QVariantMap &config);
+    void removeDestination(const QString &name);
+    void startHeartbeat(int intervalMs);
+    void stopHeartbeat();
+    void sendKeepalives();
+    void startListener(const QString &address, int port, const QStringList &allowedPeers);
+    void stopListener();
+    // Once the worklist has applied an inboundReceived() message
+    void acknowledgeInbound(quint64 inboundId, bool stored);
+    void sendFhirBundle(const QVariantList &results, const QString &url);
+    void drainCritical();
+    void drainRoutine();
+
+signals:
+    void messageSent(const QString &message);
+    void messageReceived(const QString &message);
+    void transmissionFailed(const QString &error);
+    void messageLogged();
+    void destinationStatsChanged(const QVariantList &stats);
+    void latencyStatsChanged(const QVariantMap &stats);
+    // Acknowledged to the sender only through acknowledgeInbound()
+    void inboundReceived(quint64 inboundId, const QVariantMap &decoded);
+
+private slots:
+    void onDelivered(const QString &destination, const HL7OutboundMessage &message, const QString &response);
+    void onFailed(const QString &destination, const HL7OutboundMessage &message, const QString &error);
+    void onBackpressure(const QString &destination, int queueDepth, bool critical);
+    void onHealthChanged(const QString &destination, bool healthy);
+    void onInboundMessage(quint64 inboundId, const QVariantMap &decoded, const QString &message);
+    void publishStats();
+    void startRoutineBatch();
+
+private:
+    void process(const HL7Record &record);
+    void enqueueTo(HL7Destination *destination, const HL7OutboundMessage &outbound);
+    HL7Destination *findDestination(const QString &name) const;
+    HL7Destination *createDestination(const HL7DestinationConfig &config);
+
+    HL7MessageLog *m_messageLog;
+    HL7Encoder m_encoder;
+    FhirEncoder m_fhirEncoder;
+    QList<HL7Destination*> m_destinations;
+    QTimer *m_statsTimer;
+    QTimer *m_batchTimer;
+    QTimer *m_heartbeatTimer;
+    HL7Listener *m_listener;
+
+    LockFreeQueue<HL7Record> m_intake;
+    LockFreeQueue<HL7Record> m_criticalIntake;
+    std::atomic<bool> m_routineScheduled;
+    std::atomic<bool> m_criticalScheduled;
+
+    // End-to-end latency, from hand-off to ACK
+    LatencyHistogram m_criticalLatency;
+    LatencyHistogram m_routineLatency;
+    int m_criticalSloMisses;
+
+    static const int INTAKE_CAPACITY = 1024;
+    static const int CRITICAL_INTAKE_CAPACITY = 256;
+    static const int STATS_INTERVAL_MS = 500;
+    static const int ROUTINE_BATCH_WINDOW_MS = 50;
+    static const int CRITICAL_SLO_MS = 2000; // 2 seconds
+};
+
+#endif // HL7WORKER_H
@@ -1,8 +1,10 @@
 #include "HistoricalDataModel.h"
 #include "DatabaseManager.h"
+#include "WaveformCodec.h"
 
 #include <thread>
 #include <chrono>
+#include <cmath>
 #include <QDebug>
 #include <QDateTime>
 #include <QFile>
@@ -68,6 +70,15 @@ QVariant HistoricalDataModel::data(const QModelIndex &index, int role) const
         return item.value("temperature");
     case FullDataRole:
         return item;
+    case AnionGapRole:
+    case AnionGapAlbuminRole:
+    case AaGradientRole:
+    case PFRatioRole:
+    case StandardHCO3Role:
+    case PHPatientRole:
+    case PCO2PatientRole:
+    case PO2PatientRole:
+        return derivedRecord(index.row()).variant(DerivedParameters::Parameter(role - AnionGapRole));
     default:
         return QVariant();
     }
@@ -94,6 +105,9 @@ QHash<int, QByteArray> HistoricalDataModel::roleNames() const
     roles[LactateRole] = "Lactate";
     roles[TemperatureRole] = "temperature";
     roles[FullDataRole] = "fullData";
+    for (int parameter = 0; parameter < DerivedParameters::PARAMETER_COUNT; ++parameter) {
+        roles[AnionGapRole + parameter] = DerivedParameters::PARAMETERS[parameter].field;
+    }
     return roles;
 }
 
@@ -137,11 +151,19 @@ void HistoricalDataModel::addResult(const QVariantMap &result)
         return;
     }
     
+    insertResult(result);
+}
+
+void HistoricalDataModel::insertResult(const QVariantMap &result)
+{
     // Add to model
     QVariantMap processedResult = createResultMap(result);
     
     beginInsertRows(QModelIndex(), 0, 0);
     m_data.prepend(processedResult);
+    if (!m_hasFilters) {
+        m_derived.prepend(std::nullopt);
+    }
     endInsertRows();
     
     // Update filtered data if filters are active
@@ -155,6 +177,28 @@ void HistoricalDataModel::addResult(const QVariantMap &result)
     qDebug() << "Added result to historical data:" << processedResult.value("sampleId");
 }
 
+void HistoricalDataModel::setResultId(const QString &sampleId, int id)
+{
+    // Rows shown ahead of persistence have no id yet; newest rows come first
+    auto assignId = [&](QList<QVariantMap> &dataList) {
+        for (int i = 0; i < dataList.size(); ++i) {
+            if (!dataList.at(i).contains("id") && dataList.at(i).value("sampleId").toString() == sampleId) {
+                dataList[i]["id"] = id;
+                return i;
+            }
+        }
+        return -1;
+    };
+    
+    int row = assignId(m_data);
+    if (m_hasFilters) {
+        row = assignId(m_filteredData);
+    }
+    if (row >= 0) {
+        emit dataChanged(index(row), index(row), {FullDataRole});
+    }
+}
+
 void HistoricalDataModel::removeResult(int index)
 {
     if (index < 0 || index >= rowCount())
@@ -184,6 +228,7 @@ void HistoricalDataModel::removeResult(int index)
     } else {
         m_data.removeAt(index);
     }
+    m_derived.removeAt(index);
     
     endRemoveRows();
     
@@ -209,6 +254,7 @@ void HistoricalDataModel::clearAll()
     m_hasFilters = false;
     
     _endResetModel();
+    emit cleared();
 }
 
 QVariantMap HistoricalDataModel::getResult(int index) const
@@ -220,6 +266,36 @@ QVariantMap HistoricalDataModel::getResult(int index) const
     return dataList.at(index);
 }
 
+QVariantMap HistoricalDataModel::getDerived(int index) const
+{
+    if (index < 0 || index >= rowCount())
+        return QVariantMap();
+    
+    return derivedRecord(index).toMap();
+}
+
+QVariantMap HistoricalDataModel::getWaveform(int index) const
+{
+    const int id = getResult(index).value("id").toInt();
+    Waveform waveform;
+    if (id <= 0 || !WaveformCodec::decode(m_dbManager->getWaveform(id), waveform)) {
+        return QVariantMap();
+    }
+    
+    QVariantList channels;
+    for (const Waveform::Channel &channel : waveform.channels) {
+        QVariantList millivolts;
+        millivolts.reserve(channel.microvolts.size());
+        for (const qint32 microvolts : channel.microvolts) {
+            millivolts.append(microvolts / 1000.0);
+        }
+        channels.append(QVariantMap{{"name", channel.name}, {"millivolts", millivolts}});
+    }
+    
+    return QVariantMap{{"samplePeriodMs", waveform.samplePeriodUs / 1000.0},
+                       {"channels", channels}};
+}
+
 void HistoricalDataModel::filterByDate(const QDateTime &startDate, const QDateTime &endDate)
 {
     m_startDateFilter = startDate;
@@ -316,11 +392,23 @@ void HistoricalDataModel::exportToCSV(const QString &filePath)
     QTextStream stream(&file);
     
     // Write header
-    stream << "Timestamp,Operator,Sample ID,Patient ID,pH,pCO2,pO2,HCO3,SO2,BE,Na,K,Cl,Ca,Glucose,Lactate,Temperature\n";
+    stream << "Timestamp,Operator,Sample ID,Patient ID,pH,pCO2,pO2,HCO3,SO2,BE,Na,K,Cl,Ca,Glucose,Lactate,Temperature";
+    for (const DerivedParameters::ParameterInfo &parameter : DerivedParameters::PARAMETERS) {
+        stream << "," << parameter.label;
+    }
+    stream << "\n";
     
-    // Write data
+    // Derived parameters for every row at once, in columns
     const QList<QVariantMap> &dataList = m_hasFilters ? m_filteredData : m_data;
+    DerivedParameters::Columns derived;
     for (const QVariantMap &item : dataList) {
+        derived.append(item);
+    }
+    DerivedParameters::computeBatch(derived, (1u << DerivedParameters::PARAMETER_COUNT) - 1);
+    
+    // Write data
+    for (qsizetype row = 0; row < dataList.size(); ++row) {
+        const QVariantMap &item = dataList.at(row);
         stream << item.value("timestamp").toString() << ","
                << item.value("operator").toString() << ","
                << item.value("sampleId").toString() << ","
@@ -337,13 +425,39 @@ void HistoricalDataModel::exportToCSV(const QString &filePath)
                << item.value("Ca").toString() << ","
                << item.value("Glucose").toString() << ","
                << item.value("Lactate").toString() << ","
-               << item.value("temperature").toString() << "\n";
+               << item.value("temperature").toString();
+        for (int parameter = 0; parameter < DerivedParameters::PARAMETER_COUNT; ++parameter) {
+            const float value = derived.values[parameter].at(row);
+            stream << ",";
+            if (std::isfinite(value)) {
+                stream << QString::number(value, 'f', DerivedParameters::PARAMETERS[parameter].decimals);
+            }
+        }
+        stream << "\n";
     }
     
     file.close();
     qDebug() << "Exported" << dataList.size() << "results to" << actualPath;
 }
 
+QVariantList HistoricalDataModel::getRollups(const QString &granularity, const QDateTime &from,
+                                             const QDateTime &to, bool byOperator) const
+{
+    if (!m_dbManager) {
+        return QVariantList();
+    }
+    return m_dbManager->getRollups(granularity, from, to, byOperator);
+}
+
+bool HistoricalDataModel::rebuildRollups()
+{
+    if (!m_dbManager) {
+        qWarning() << "No database manager available";
+        return false;
+    }
+    return m_dbManager->rebuildRollups();
+}
+
 QVariantMap HistoricalDataModel::createResultMap(const QVariantMap &data) const
 {
     QVariantMap result = data;
@@ -364,8 +478,19 @@ QVariantMap HistoricalDataModel::createResultMap(const QVariantMap &data) const
     
     return result;
 }
+DerivedParameters::Record &HistoricalDataModel::derivedRecord(int row) const
+{
+    std::optional<DerivedParameters::Record> &record = m_derived[row];
+    if (!record) {
+        const QList<QVariantMap> &dataList = m_hasFilters ? m_filteredData : m_data;
+        record.emplace(dataList.at(row));
+    }
+    return *record;
+}
+
 void HistoricalDataModel::_endResetModel()
 {
+    m_derived = QList<std::optional<DerivedParameters::Record>>(rowCount());
     endResetModel();
     std::this_thread::sleep_for(100ms);
     emit countChanged();
@@ -5,6 +5,10 @@
 #include <QVariantMap>
 #include <QDateTime>
 
+#include <optional>
+
+#include "DerivedParameters.h"
+
 class DatabaseManager;
 
 class HistoricalDataModel : public QAbstractListModel
@@ -31,7 +35,16 @@ public:
         GlucoseRole,
         LactateRole,
         TemperatureRole,
-        FullDataRole
+        FullDataRole,
+        // Derived parameters, in DerivedParameters::Parameter order
+        AnionGapRole,
+        AnionGapAlbuminRole,
+        AaGradientRole,
+        PFRatioRole,
+        StandardHCO3Role,
+        PHPatientRole,
+        PCO2PatientRole,
+        PO2PatientRole
     };
     
     explicit HistoricalDataModel(DatabaseManager* dbManager, QObject* parent = nullptr);
@@ -46,29 +59,47 @@ public:
 public slots:
     Q_INVOKABLE void loadData();
     Q_INVOKABLE void addResult(const QVariantMap& result);
+    // Shows a result already saved (or being saved) elsewhere
+    void insertResult(const QVariantMap& result);
+    void setResultId(const QString& sampleId, int id);
     Q_INVOKABLE void removeResult(int index);
     Q_INVOKABLE void clearAll();
     Q_INVOKABLE QVariantMap getResult(int index) const;
+    // Derived parameters of a result, keyed by their role names
+    Q_INVOKABLE QVariantMap getDerived(int index) const;
+    // Raw electrode traces of a result, read and decoded on request;
+    // empty when none were archived
+    Q_INVOKABLE QVariantMap getWaveform(int index) const;
     Q_INVOKABLE void filterByDate(const QDateTime& startDate, const QDateTime& endDate);
     Q_INVOKABLE void filterByOperator(const QString& operatorName);
     Q_INVOKABLE void filterByPatient(const QString& patientId);
     Q_INVOKABLE void clearFilters();
     Q_INVOKABLE void exportToCSV(const QString& filePath);
+    // Per-analyte aggregates by "hour" or "day", for workload and quality
+    // reports; see DatabaseManager::getRollups
+    Q_INVOKABLE QVariantList getRollups(const QString& granularity, const QDateTime& from,
+                                        const QDateTime& to, bool byOperator = true) const;
+    Q_INVOKABLE bool rebuildRollups();
 
 signals:
     void countChanged();
     void dataLoaded();
     void resultAdded(const QVariantMap& result);
     void resultRemoved(int index);
+    // Every result was deleted
+    void cleared();
     
 private:
     void applyFilters();
     QVariantMap createResultMap(const QVariantMap& data) const;
+    DerivedParameters::Record& derivedRecord(int row) const;
     void _endResetModel();
 
     DatabaseManager* m_dbManager;
     QList<QVariantMap> m_data;
     QList<QVariantMap> m_filteredData;
+    // Derived values of the shown rows, created when a row is first read
+    mutable QList<std::optional<DerivedParameters::Record>> m_derived;
     
     // Filter criteria
     QString m_operatorFilter;
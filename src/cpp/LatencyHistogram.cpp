@@ -0,0 +1,64 @@
+#include "LatencyHistogram.h"
+
+#include <cmath>
+
+namespace {
+const double BASE_MS = 0.1;
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::reset()
+{
+    m_buckets.fill(0);
+    m_count = 0;
+    m_sum = 0.0;
+    m_max = 0.0;
+}
+
+void LatencyHistogram::record(double milliseconds)
+{
+    if (milliseconds < 0.0) {
+        milliseconds = 0.0;
+    }
+    m_buckets[bucketFor(milliseconds)]++;
+    m_count++;
+    m_sum += milliseconds;
+    if (milliseconds > m_max) {
+        m_max = milliseconds;
+    }
+}
+
+double LatencyHistogram::percentile(double p) const
+{
+    if (m_count == 0) {
+        return 0.0;
+    }
+
+    const quint64 rank = quint64(std::ceil(qBound(0.0, p, 100.0) / 100.0 * m_count));
+    quint64 seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        seen += m_buckets[i];
+        if (seen >= rank && seen > 0) {
+            return qMin(bucketUpperBound(i), m_max);
+        }
+    }
+    return m_max;
+}
+
+int LatencyHistogram::bucketFor(double milliseconds)
+{
+    if (milliseconds <= BASE_MS) {
+        return 0;
+    }
+    const int index = int(std::log2(milliseconds / BASE_MS) * SUB_BUCKETS);
+    return qBound(0, index, BUCKET_COUNT - 1);
+}
+
+double LatencyHistogram::bucketUpperBound(int index)
+{
+    return BASE_MS * std::exp2(double(index + 1) / SUB_BUCKETS);
+}
@@ -0,0 +1,39 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QtGlobal>
+
+#include <array>
+
+// Fixed-size log-linear latency histogram covering 0.1 ms to ~200 s.
+// Each power of two is split into SUB_BUCKETS buckets, so percentiles are
+// accurate to about 9% with no allocation on record().
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(double milliseconds);
+    void reset();
+
+    // p in [0, 100]; returns the upper bound of the bucket holding the percentile
+    double percentile(double p) const;
+    quint64 count() const { return m_count; }
+    double max() const { return m_max; }
+    double mean() const { return m_count ? m_sum / m_count : 0.0; }
+
+    static const int SUB_BUCKETS = 8;
+    static const int OCTAVES = 21;
+    static const int BUCKET_COUNT = SUB_BUCKETS * OCTAVES;
+
+private:
+    static int bucketFor(double milliseconds);
+    static double bucketUpperBound(int index);
+
+    std::array<quint32, BUCKET_COUNT> m_buckets;
+    quint64 m_count;
+    double m_sum;
+    double m_max;
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -0,0 +1,254 @@
+#include "OrderWorklist.h"
+#include "DatabaseManager.h"
+
+#include <QDateTime>
+#include <QDebug>
+
+OrderWorklist::OrderWorklist(DatabaseManager *dbManager, QObject *parent)
+    : QObject(parent)
+    , m_dbManager(dbManager)
+    , m_purgeTimer(new QTimer(this))
+{
+    connect(m_purgeTimer, &QTimer::timeout, this, &OrderWorklist::purgeExpired);
+}
+
+void OrderWorklist::loadWorklist()
+{
+    m_orders.clear();
+    m_patients.clear();
+    m_byBarcode.clear();
+    m_byPatient.clear();
+    m_orderUpdated.clear();
+    m_patientUpdated.clear();
+    m_purgeTimer->start(PURGE_INTERVAL_MS);
+
+    if (!m_dbManager) {
+        return;
+    }
+
+    // Orders the HIS sent more than a few days ago are stale
+    const QDateTime cutoff = QDateTime::currentDateTime().addSecs(-RETENTION_HOURS * 3600);
+    m_dbManager->purgeWorklist(cutoff);
+
+    const QVariantList patients = m_dbManager->getWorklistPatients(cutoff);
+    m_patients.reserve(patients.size());
+    for (const QVariant &patient : patients) {
+        QVariantMap map = patient.toMap();
+        const QString patientId = map.value("patientId").toString();
+        m_patientUpdated.insert(patientId, map.take("updatedAt").toDateTime());
+        m_patients.insert(patientId, map);
+    }
+
+    const QVariantList orders = m_dbManager->getWorklistOrders(cutoff);
+    m_orders.reserve(orders.size());
+    for (const QVariant &order : orders) {
+        QVariantMap map = order.toMap();
+        const QString accession = map.value("accession").toString();
+        m_orderUpdated.insert(accession, map.take("updatedAt").toDateTime());
+        m_orders.insert(accession, map);
+        if (!map.value("barcode").toString().isEmpty()) {
+            m_byBarcode.insert(map.value("barcode").toString(), accession);
+        }
+        if (!map.value("patientId").toString().isEmpty()) {
+            m_byPatient.insert(map.value("patientId").toString(), accession);
+        }
+    }
+
+    qDebug() << "Order worklist loaded:" << m_orders.size() << "orders," << m_patients.size() << "patients";
+    emit worklistChanged();
+}
+
+bool OrderWorklist::applyMessage(const QVariantMap &decoded)
+{
+    const QString messageType = decoded.value("messageType").toString();
+    const QVariantMap patient = decoded.value("patient").toMap();
+    const QString patientId = patient.value("patientId").toString();
+
+    bool stored = true;
+    if (!patientId.isEmpty()) {
+        stored = upsertPatient(patient) && stored;
+    }
+
+    if (messageType.startsWith("ORM")) {
+        for (const QVariant &item : decoded.value("orders").toList()) {
+            QVariantMap order = item.toMap();
+            const QString control = order.value("orderControl").toString();
+            const QString accession = order.value("accession").toString();
+            if (accession.isEmpty()) {
+                continue;
+            }
+
+            // CA/OC cancel, DC discontinue; everything else (NW, XO, SC) is a new or changed order
+            if (control == "CA" || control == "OC" || control == "DC") {
+                stored = removeOrder(accession) && stored;
+            } else {
+                order["patientId"] = patientId;
+                stored = upsertOrder(order) && stored;
+                emit orderReceived(withDemographics(order));
+            }
+        }
+    }
+
+    emit worklistChanged();
+    return stored;
+}
+
+QVariantMap OrderWorklist::lookup(const QString &code) const
+{
+    const QString key = code.trimmed();
+    if (key.isEmpty()) {
+        return QVariantMap();
+    }
+
+    QVariantMap result = lookupBarcode(key);
+    if (result.isEmpty()) {
+        result = lookupAccession(key);
+    }
+    if (result.isEmpty()) {
+        result = lookupPatient(key);
+    }
+    return result;
+}
+
+QVariantMap OrderWorklist::lookupAccession(const QString &accession) const
+{
+    const auto it = m_orders.constFind(accession);
+    return it != m_orders.constEnd() ? withDemographics(it.value()) : QVariantMap();
+}
+
+QVariantMap OrderWorklist::lookupBarcode(const QString &barcode) const
+{
+    const auto it = m_byBarcode.constFind(barcode);
+    return it != m_byBarcode.constEnd() ? lookupAccession(it.value()) : QVariantMap();
+}
+
+QVariantMap OrderWorklist::lookupPatient(const QString &patientId) const
+{
+    // A patient with a single pending order resolves straight to that order
+    const QList<QString> accessions = m_byPatient.values(patientId);
+    if (accessions.size() == 1) {
+        return lookupAccession(accessions.first());
+    }
+    return m_patients.value(patientId);
+}
+
+QVariantList OrderWorklist::ordersForPatient(const QString &patientId) const
+{
+    QVariantList orders;
+    for (auto it = m_byPatient.constFind(patientId); it != m_byPatient.constEnd() && it.key() == patientId; ++it) {
+        orders.append(lookupAccession(it.value()));
+    }
+    return orders;
+}
+
+void OrderWorklist::completeOrder(const QString &accession)
+{
+    if (accession.isEmpty() || !m_orders.contains(accession)) {
+        return;
+    }
+    removeOrder(accession);
+    emit worklistChanged();
+}
+
+bool OrderWorklist::upsertPatient(const QVariantMap &patient)
+{
+    // ADT updates may carry only some fields; keep what we already know
+    const QString patientId = patient.value("patientId").toString();
+    QVariantMap &existing = m_patients[patientId];
+    for (auto it = patient.constBegin(); it != patient.constEnd(); ++it) {
+        if (!it.value().toString().isEmpty()) {
+            existing.insert(it.key(), it.value());
+        }
+    }
+    m_patientUpdated.insert(patientId, QDateTime::currentDateTime());
+
+    return m_dbManager && m_dbManager->saveWorklistPatient(existing);
+}
+
+bool OrderWorklist::upsertOrder(const QVariantMap &order)
+{
+    const QString accession = order.value("accession").toString();
+
+    // Drop index entries that point at the previous version of this order
+    if (m_orders.contains(accession)) {
+        const QVariantMap previous = m_orders.value(accession);
+        m_byBarcode.remove(previous.value("barcode").toString());
+        m_byPatient.remove(previous.value("patientId").toString(), accession);
+    }
+
+    m_orders.insert(accession, order);
+    m_orderUpdated.insert(accession, QDateTime::currentDateTime());
+    if (!order.value("barcode").toString().isEmpty()) {
+        m_byBarcode.insert(order.value("barcode").toString(), accession);
+    }
+    if (!order.value("patientId").toString().isEmpty()) {
+        m_byPatient.insert(order.value("patientId").toString(), accession);
+    }
+
+    return m_dbManager && m_dbManager->saveWorklistOrder(order);
+}
+
+bool OrderWorklist::removeOrder(const QString &accession)
+{
+    // An order that is not in the worklist is not in the database either
+    if (!dropOrder(accession)) {
+        return true;
+    }
+    return m_dbManager && m_dbManager->removeWorklistOrder(accession);
+}
+
+bool OrderWorklist::dropOrder(const QString &accession)
+{
+    const QVariantMap order = m_orders.take(accession);
+    if (order.isEmpty()) {
+        return false;
+    }
+    m_orderUpdated.remove(accession);
+    m_byBarcode.remove(order.value("barcode").toString());
+    m_byPatient.remove(order.value("patientId").toString(), accession);
+    return true;
+}
+
+void OrderWorklist::purgeExpired()
+{
+    // The same rule loadWorklist() applies
+    const QDateTime cutoff = QDateTime::currentDateTime().addSecs(-RETENTION_HOURS * 3600);
+
+    QStringList expiredOrders;
+    for (auto it = m_orderUpdated.cbegin(); it != m_orderUpdated.cend(); ++it) {
+        if (it.value() < cutoff) {
+            expiredOrders.append(it.key());
+        }
+    }
+    for (const QString &accession : std::as_const(expiredOrders)) {
+        dropOrder(accession);
+    }
+
+    qsizetype expiredPatients = 0;
+    for (auto it = m_patientUpdated.begin(); it != m_patientUpdated.end();) {
+        if (it.value() < cutoff) {
+            m_patients.remove(it.key());
+            it = m_patientUpdated.erase(it);
+            ++expiredPatients;
+        } else {
+            ++it;
+        }
+    }
+
+    if (m_dbManager) {
+        m_dbManager->purgeWorklist(cutoff);
+    }
+    if (!expiredOrders.isEmpty() || expiredPatients > 0) {
+        qDebug() << "Order worklist purged" << expiredOrders.size() << "orders," << expiredPatients << "patients";
+        emit worklistChanged();
+    }
+}
+
+QVariantMap OrderWorklist::withDemographics(const QVariantMap &order) const
+{
+    QVariantMap result = m_patients.value(order.value("patientId").toString());
+    for (auto it = order.constBegin(); it != order.constEnd(); ++it) {
+        result.insert(it.key(), it.value());
+    }
+    return result;
+}
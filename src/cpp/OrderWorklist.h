@@ -0,0 +1,74 @@
+#ifndef ORDERWORKLIST_H
+#define ORDERWORKLIST_H
+
+#include <QObject>
+#include <QHash>
+#include <QDateTime>
+#include <QMultiHash>
+#include <QTimer>
+#include <QVariantMap>
+
+class DatabaseManager;
+
+// In-memory cache of pending orders and patient demographics received from
+// the HIS (ORM^O01 and ADT feeds). Lookups by accession number, barcode or
+// patient ID are hash lookups with no database or network round trip.
+// Every change is written through to SQLite, and the cache is reloaded from
+// there on startup so a restart does not lose the worklist. Orders and
+// patients not updated for RETENTION_HOURS are dropped, at startup and
+// hourly after that.
+class OrderWorklist : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int orderCount READ orderCount NOTIFY worklistChanged)
+    Q_PROPERTY(int patientCount READ patientCount NOTIFY worklistChanged)
+
+public:
+    explicit OrderWorklist(DatabaseManager *dbManager, QObject *parent = nullptr);
+
+    int orderCount() const { return m_orders.size(); }
+    int patientCount() const { return m_patients.size(); }
+
+public slots:
+    // Tries barcode, then accession, then patient ID. Returns an order merged
+    // with its patient's demographics, or an empty map.
+    Q_INVOKABLE QVariantMap lookup(const QString &code) const;
+    Q_INVOKABLE QVariantMap lookupAccession(const QString &accession) const;
+    Q_INVOKABLE QVariantMap lookupBarcode(const QString &barcode) const;
+    Q_INVOKABLE QVariantMap lookupPatient(const QString &patientId) const;
+    Q_INVOKABLE QVariantList ordersForPatient(const QString &patientId) const;
+    Q_INVOKABLE void completeOrder(const QString &accession);
+
+    void loadWorklist();
+    // False when any of the message's changes could not be saved
+    bool applyMessage(const QVariantMap &decoded);
+
+signals:
+    void worklistChanged();
+    void orderReceived(const QVariantMap &order);
+
+private:
+    // Each returns whether the change was saved
+    bool upsertPatient(const QVariantMap &patient);
+    bool upsertOrder(const QVariantMap &order);
+    bool removeOrder(const QString &accession);
+    // From the cache and its indexes only
+    bool dropOrder(const QString &accession);
+    void purgeExpired();
+    QVariantMap withDemographics(const QVariantMap &order) const;
+
+    DatabaseManager *m_dbManager;
+
+    QHash<QString, QVariantMap> m_orders;      // by accession
+    QHash<QString, QVariantMap> m_patients;    // by patient ID
+    QHash<QString, QString> m_byBarcode;       // barcode -> accession
+    QMultiHash<QString, QString> m_byPatient;  // patient ID -> accession
+    QHash<QString, QDateTime> m_orderUpdated;   // by accession
+    QHash<QString, QDateTime> m_patientUpdated; // by patient ID
+    QTimer *m_purgeTimer;
+
+    static const int RETENTION_HOURS = 72;
+    static const int PURGE_INTERVAL_MS = 60 * 60 * 1000;
+};
+
+#endif // ORDERWORKLIST_H
@@ -0,0 +1,317 @@
+#include "PatientDriftMonitor.h"
+#include "DatabaseManager.h"
+
+#include <QDateTime>
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Patient population mean and SD in ResultRules::Analyte order, until
+// there are enough stored results to take them from; SD 0 is not watched
+const double DEFAULT_BASELINES[ResultRules::ANALYTE_COUNT][2] = {
+    {7.38, 0.08}, {42.0, 10.0}, {90.0, 40.0}, {0.0, 0.0}, {0.0, 0.0},
+    {139.0, 5.0}, {4.1, 0.6}, {104.0, 5.0}, {1.15, 0.12},
+    {130.0, 50.0}, {2.0, 1.8}
+};
+
+int analyteIndex(const QString &field)
+{
+    for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+        if (field == QLatin1String(ResultRules::ANALYTE_FIELDS[analyte])) {
+            return analyte;
+        }
+    }
+    return -1;
+}
+}
+
+PatientDriftMonitor::PatientDriftMonitor(DatabaseManager *dbManager, QObject *parent)
+    : QObject(parent)
+    , m_dbManager(dbManager)
+    , m_dirty(false)
+    , m_saveTimer(new QTimer(this))
+    , m_baselineTimer(new QTimer(this))
+{
+    for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+        State &state = m_states[analyte];
+        state.watched = DEFAULT_BASELINES[analyte][1] > 0.0;
+        state.baselineMean = DEFAULT_BASELINES[analyte][0];
+        state.baselineSd = DEFAULT_BASELINES[analyte][1];
+        restart(state);
+    }
+
+    connect(m_saveTimer, &QTimer::timeout, this, &PatientDriftMonitor::save);
+    m_saveTimer->start(SAVE_INTERVAL_MS);
+    connect(m_baselineTimer, &QTimer::timeout, this, &PatientDriftMonitor::adoptStoredBaselines);
+    m_baselineTimer->start(BASELINE_CHECK_INTERVAL_MS);
+}
+
+void PatientDriftMonitor::load()
+{
+    const QVariantList rows = m_dbManager->loadDriftState();
+    if (rows.isEmpty()) {
+        rebaseline();
+        return;
+    }
+
+    for (const QVariant &item : rows) {
+        const QVariantMap row = item.toMap();
+        const int analyte = analyteIndex(row.value("analyte").toString());
+        if (analyte < 0 || !m_states[analyte].watched || row.value("baselineSd").toDouble() <= 0.0) {
+            continue;
+        }
+        State &state = m_states[analyte];
+        state.baselineMean = row.value("baselineMean").toDouble();
+        state.baselineSd = row.value("baselineSd").toDouble();
+        state.ewma = row.value("ewma").toDouble();
+        state.cusumHigh = row.value("cusumHigh").toDouble();
+        state.cusumLow = row.value("cusumLow").toDouble();
+        state.count = row.value("count").toLongLong();
+        state.truncated = row.value("truncated").toLongLong();
+        state.drift = row.value("drift").toInt();
+    }
+    emit statusChanged();
+
+    // A drift found before the restart still wants its recalibration
+    for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+        if (m_states[analyte].watched && m_states[analyte].drift != 0) {
+            reportDrift(analyte);
+        }
+    }
+
+    adoptStoredBaselines();
+}
+
+void PatientDriftMonitor::addResult(const QVariantMap &result)
+{
+    // The EWMA's SD once it has settled, relative to the baseline SD
+    static const double ewmaSd = std::sqrt(EWMA_LAMBDA / (2.0 - EWMA_LAMBDA));
+
+    bool changed = false;
+    for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+        State &state = m_states[analyte];
+        const QVariant value = result.value(ResultRules::ANALYTE_FIELDS[analyte]);
+        if (!state.watched || !value.isValid() || value.isNull()) {
+            continue;
+        }
+        changed = true;
+
+        // Winsorized: one wild result moves the statistics no further than
+        // TRUNCATION_SD would, but an electrode that puts every result out
+        // there still drives them over their limits
+        double z = (value.toDouble() - state.baselineMean) / state.baselineSd;
+        if (std::abs(z) > TRUNCATION_SD) {
+            ++state.truncated;
+            z = std::clamp(z, -TRUNCATION_SD, TRUNCATION_SD);
+        }
+        ++state.count;
+        state.ewma = EWMA_LAMBDA * (state.baselineMean + z * state.baselineSd) + (1.0 - EWMA_LAMBDA) * state.ewma;
+        state.cusumHigh = std::max(0.0, state.cusumHigh + z - CUSUM_SLACK_SD);
+        state.cusumLow = std::max(0.0, state.cusumLow - z - CUSUM_SLACK_SD);
+
+        const double ewmaZ = (state.ewma - state.baselineMean) / (state.baselineSd * ewmaSd);
+        int drift = 0;
+        if (ewmaZ > EWMA_LIMIT_SD || state.cusumHigh > CUSUM_LIMIT_SD) {
+            drift = 1;
+        } else if (ewmaZ < -EWMA_LIMIT_SD || state.cusumLow > CUSUM_LIMIT_SD) {
+            drift = -1;
+        }
+        if (drift == 0 || state.drift != 0) {
+            continue;
+        }
+
+        state.drift = drift;
+        reportDrift(analyte);
+    }
+
+    if (changed) {
+        m_dirty = true;
+        emit statusChanged();
+    }
+}
+
+void PatientDriftMonitor::reportDrift(int analyte)
+{
+    const State &state = m_states[analyte];
+    const QString field = ResultRules::ANALYTE_FIELDS[analyte];
+    const QString reason = QString("%1 patient results drifting %2: moving average %3 against a baseline of %4 (SD %5)")
+                               .arg(field)
+                               .arg(state.drift > 0 ? "high" : "low")
+                               .arg(state.ewma, 0, 'g', 4)
+                               .arg(state.baselineMean, 0, 'g', 4)
+                               .arg(state.baselineSd, 0, 'g', 3);
+    qWarning() << reason;
+    emit driftDetected(field, state.drift, calibrationType(analyte), reason);
+}
+
+QVariantList PatientDriftMonitor::status() const
+{
+    QVariantList status;
+    for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+        const State &state = m_states[analyte];
+        if (!state.watched) {
+            continue;
+        }
+        QVariantMap row;
+        row["analyte"] = ResultRules::ANALYTE_FIELDS[analyte];
+        row["baselineMean"] = state.baselineMean;
+        row["baselineSd"] = state.baselineSd;
+        row["defaultBaseline"] = isDefaultBaseline(analyte);
+        row["ewma"] = state.ewma;
+        row["cusumHigh"] = state.cusumHigh;
+        row["cusumLow"] = state.cusumLow;
+        row["count"] = state.count;
+        row["truncated"] = state.truncated;
+        row["drift"] = state.drift;
+        status.append(row);
+    }
+    return status;
+}
+
+QString PatientDriftMonitor::calibrationType(int analyte)
+{
+    switch (analyte) {
+    case ResultRules::PH:
+        return "ph_only";
+    case ResultRules::PCO2:
+    case ResultRules::PO2:
+        return "gas_only";
+    case ResultRules::Na:
+    case ResultRules::K:
+    case ResultRules::Cl:
+    case ResultRules::Ca:
+        return "electrolytes";
+    default:
+        return "full";
+    }
+}
+
+bool PatientDriftMonitor::save()
+{
+    if (!m_dirty) {
+        return true;
+    }
+    if (!m_dbManager->saveDriftState(status())) {
+        return false;
+    }
+    m_dirty = false;
+    return true;
+}
+
+void PatientDriftMonitor::reset(const QString &calibrationType)
+{
+    for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+        if (calibrationType == "full" || calibrationType == PatientDriftMonitor::calibrationType(analyte)) {
+            restart(m_states[analyte]);
+        }
+    }
+    m_dirty = true;
+    save();
+    emit statusChanged();
+}
+
+void PatientDriftMonitor::rebaseline()
+{
+    const std::array<Baseline, ResultRules::ANALYTE_COUNT> baselines = storedBaselines();
+    for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+        State &state = m_states[analyte];
+        if (!state.watched) {
+            continue;
+        }
+        if (isUsable(baselines[analyte])) {
+            state.baselineMean = baselines[analyte].mean;
+            state.baselineSd = baselines[analyte].sd;
+        } else {
+            state.baselineMean = DEFAULT_BASELINES[analyte][0];
+            state.baselineSd = DEFAULT_BASELINES[analyte][1];
+        }
+        restart(state);
+    }
+
+    m_dirty = true;
+    save();
+    emit statusChanged();
+}
+
+void PatientDriftMonitor::adoptStoredBaselines()
+{
+    bool pending = false;
+    for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+        pending = pending || (m_states[analyte].watched && isDefaultBaseline(analyte));
+    }
+    if (!pending) {
+        return;
+    }
+
+    const std::array<Baseline, ResultRules::ANALYTE_COUNT> baselines = storedBaselines();
+    bool changed = false;
+    for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+        State &state = m_states[analyte];
+        if (!state.watched || !isDefaultBaseline(analyte) || !isUsable(baselines[analyte])) {
+            continue;
+        }
+        qDebug() << "Patient QC baseline for" << ResultRules::ANALYTE_FIELDS[analyte] << "taken from"
+                 << baselines[analyte].count << "results";
+        state.baselineMean = baselines[analyte].mean;
+        state.baselineSd = baselines[analyte].sd;
+        restart(state);
+        changed = true;
+    }
+
+    if (changed) {
+        m_dirty = true;
+        save();
+        emit statusChanged();
+    }
+}
+
+std::array<PatientDriftMonitor::Baseline, ResultRules::ANALYTE_COUNT> PatientDriftMonitor::storedBaselines() const
+{
+    std::array<double, ResultRules::ANALYTE_COUNT> sums{};
+    std::array<double, ResultRules::ANALYTE_COUNT> sumSquares{};
+    std::array<Baseline, ResultRules::ANALYTE_COUNT> baselines{};
+    const QDateTime now = QDateTime::currentDateTime();
+    const QVariantList rollups = m_dbManager->getRollups("day", now.addDays(-BASELINE_DAYS), now, false);
+    for (const QVariant &item : rollups) {
+        const QVariantMap rollup = item.toMap();
+        const int analyte = analyteIndex(rollup.value("analyte").toString());
+        if (analyte < 0) {
+            continue;
+        }
+        baselines[analyte].count += rollup.value("count").toLongLong();
+        sums[analyte] += rollup.value("sum").toDouble();
+        sumSquares[analyte] += rollup.value("sumSquares").toDouble();
+    }
+
+    for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+        Baseline &baseline = baselines[analyte];
+        const qint64 n = baseline.count;
+        baseline.mean = n > 0 ? sums[analyte] / n : 0.0;
+        baseline.sd = n > 1 ? std::sqrt(std::max(0.0, (sumSquares[analyte] - sums[analyte] * baseline.mean) / (n - 1))) : 0.0;
+    }
+    return baselines;
+}
+
+bool PatientDriftMonitor::isUsable(const Baseline &baseline)
+{
+    return baseline.count >= MIN_BASELINE_COUNT && baseline.sd > 0.0;
+}
+
+bool PatientDriftMonitor::isDefaultBaseline(int analyte) const
+{
+    // Saved and restored through SQLite REALs, which keep doubles exactly
+    const State &state = m_states[analyte];
+    return state.baselineMean == DEFAULT_BASELINES[analyte][0] && state.baselineSd == DEFAULT_BASELINES[analyte][1];
+}
+
+void PatientDriftMonitor::restart(State &state)
+{
+    state.ewma = state.baselineMean;
+    state.cusumHigh = 0.0;
+    state.cusumLow = 0.0;
+    state.count = 0;
+    state.truncated = 0;
+    state.drift = 0;
+}
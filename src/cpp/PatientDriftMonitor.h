@@ -0,0 +1,109 @@
+#ifndef PATIENTDRIFTMONITOR_H
+#define PATIENTDRIFTMONITOR_H
+
+#include <QObject>
+#include <QTimer>
+#include <QVariantList>
+
+#include <array>
+
+#include "ResultRules.h"
+
+class DatabaseManager;
+
+// Patient-based real-time QC: watches each measured analyte's patient
+// results for drift from the population baseline, between control runs.
+// Values beyond TRUNCATION_SD of the baseline are clipped to it, then
+// feed an EWMA and a two-sided CUSUM in baseline SD units, updated per
+// result.
+// The state is saved periodically and restored at startup, so a slow
+// drift is followed across restarts. Built-in population baselines are
+// used until an analyte has MIN_BASELINE_COUNT stored results; that is
+// checked at startup and then hourly. Calculated analytes (HCO3, BE) are
+// not watched.
+class PatientDriftMonitor : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QVariantList status READ status NOTIFY statusChanged)
+
+public:
+    explicit PatientDriftMonitor(DatabaseManager *dbManager, QObject *parent = nullptr);
+
+    // Restores the saved state, or starts from baselines over the
+    // stored results; connect driftDetected first. Analytes still on built-in baselines take them from
+    // the stored results once there are enough
+    void load();
+    void addResult(const QVariantMap &result);
+
+    // Per watched analyte: analyte, baselineMean, baselineSd,
+    // defaultBaseline, ewma, cusumHigh, cusumLow, count, truncated (of
+    // count, the clipped ones) and drift (-1, 0, 1)
+    QVariantList status() const;
+
+    // The calibration that covers the analyte's electrode
+    static QString calibrationType(int analyte);
+
+    static constexpr double EWMA_LAMBDA = 0.05;
+    static constexpr double EWMA_LIMIT_SD = 3.0; // of the EWMA's own SD
+    static constexpr double CUSUM_SLACK_SD = 0.5;
+    static constexpr double CUSUM_LIMIT_SD = 5.0;
+    static constexpr double TRUNCATION_SD = 3.0;
+
+public slots:
+    Q_INVOKABLE bool save();
+    // After a recalibration of the given type: restarts the statistics of
+    // the analytes it covers, keeping the baselines
+    Q_INVOKABLE void reset(const QString &calibrationType = "full");
+    // Baselines from the last BASELINE_DAYS of results (see
+    // DatabaseManager::getRollups); also restarts the statistics
+    Q_INVOKABLE void rebaseline();
+    // Baselines from the stored results for the analytes still on the
+    // built-in ones, where there are enough results; restarts only those
+    Q_INVOKABLE void adoptStoredBaselines();
+
+signals:
+    void statusChanged();
+    // Once per drift, until reset(), and again by load() for a drift that
+    // was saved before a restart
+    void driftDetected(const QString &analyte, int direction, const QString &calibrationType,
+                       const QString &reason);
+
+private:
+    struct State {
+        bool watched = false;
+        double baselineMean = 0.0;
+        double baselineSd = 0.0;
+        double ewma = 0.0;
+        double cusumHigh = 0.0;
+        double cusumLow = 0.0;
+        qint64 count = 0;
+        qint64 truncated = 0;
+        int drift = 0;
+    };
+
+    struct Baseline {
+        qint64 count = 0;
+        double mean = 0.0;
+        double sd = 0.0;
+    };
+
+    // Over the last BASELINE_DAYS of results (see DatabaseManager::getRollups)
+    std::array<Baseline, ResultRules::ANALYTE_COUNT> storedBaselines() const;
+    static bool isUsable(const Baseline &baseline);
+    bool isDefaultBaseline(int analyte) const;
+    void reportDrift(int analyte);
+    void restart(State &state);
+
+    DatabaseManager *m_dbManager;
+    std::array<State, ResultRules::ANALYTE_COUNT> m_states;
+    bool m_dirty;
+    QTimer *m_saveTimer;
+    QTimer *m_baselineTimer;
+
+    static const int BASELINE_DAYS = 30;
+    static const int MIN_BASELINE_COUNT = 200;
+    static const int SAVE_INTERVAL_MS = 60 * 1000;
+    static const int BASELINE_CHECK_INTERVAL_MS = 60 * 60 * 1000; // 1 hour
+};
+
+#endif // PATIENTDRIFTMONITOR_H
@@ -0,0 +1,41 @@
+#include "PatientHistoryWorker.h"
+#include "DatabaseManager.h"
+#include "PatientResultCache.h"
+
+#include <QDebug>
+
+PatientHistoryWorker::PatientHistoryWorker(PatientResultCache *cache, QObject *parent)
+    : QObject(parent)
+    , m_cache(cache)
+{
+}
+
+PatientHistoryWorker::~PatientHistoryWorker() = default;
+
+void PatientHistoryWorker::fetch(const QString &patientId)
+{
+    // Cached by an earlier fetch or by a result computed meanwhile
+    if (m_cache->contains(patientId)) {
+        emit fetched(patientId, PatientResultCache::history(patientId, m_cache->recent(patientId)));
+        return;
+    }
+
+    // SQLite connections are per thread, so the worker opens its own; the
+    // schema is the main connection's business
+    if (!m_database) {
+        m_database = std::make_unique<DatabaseManager>();
+        if (!m_database->openConnection("history")) {
+            m_database.reset();
+            emit fetched(patientId, PatientResultCache::history(patientId, {}));
+            return;
+        }
+    }
+
+    QList<PatientResultCache::Entry> entries = PatientResultCache::entries(
+        m_database->getResultsByPatient(patientId, PatientResultCache::HISTORY_SIZE));
+    // Merged with any result of the patient computed while the query ran
+    m_cache->seed(patientId, entries);
+    entries = m_cache->recent(patientId);
+    qDebug() << "Prefetched" << entries.size() << "results of patient" << patientId;
+    emit fetched(patientId, PatientResultCache::history(patientId, entries));
+}
@@ -0,0 +1,37 @@
+#ifndef PATIENTHISTORYWORKER_H
+#define PATIENTHISTORYWORKER_H
+
+#include <QObject>
+#include <QString>
+#include <QVariantMap>
+
+#include <memory>
+
+class DatabaseManager;
+class PatientResultCache;
+
+// Lives on the patient history thread. Reads the recent results of a
+// patient the result cache does not know, on the worker's own database
+// connection, and seeds the cache with them, so the query is done while
+// the sample is still being measured.
+class PatientHistoryWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PatientHistoryWorker(PatientResultCache *cache, QObject *parent = nullptr);
+    ~PatientHistoryWorker();
+
+public slots:
+    void fetch(const QString &patientId);
+
+signals:
+    // PatientResultCache::history() of the patient
+    void fetched(const QString &patientId, const QVariantMap &history);
+
+private:
+    PatientResultCache *m_cache;
+    std::unique_ptr<DatabaseManager> m_database;
+};
+
+#endif // PATIENTHISTORYWORKER_H
@@ -0,0 +1,302 @@
+#include "PatientResultCache.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QStringList>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+
+namespace {
+using ResultRules::Analyte;
+
+// Largest plausible change between two results of one patient within the
+// window; a bigger jump points at a wrong patient, a contaminated sample
+// or a failing electrode. A second rule for an analyte needs a smaller
+// change over its shorter window, or the longer one flags everything first.
+struct DeltaRule {
+    Analyte analyte;
+    float maxChange;
+    int windowMinutes;
+};
+
+const DeltaRule DELTA_RULES[] = {
+    {ResultRules::PH, 0.2f, 60},
+    {ResultRules::PCO2, 20.0f, 60},
+    {ResultRules::HCO3, 8.0f, 24 * 60},
+    {ResultRules::Na, 10.0f, 24 * 60},
+    {ResultRules::K, 1.0f, 60},
+    {ResultRules::K, 1.5f, 24 * 60},
+    {ResultRules::Cl, 10.0f, 24 * 60},
+    {ResultRules::Ca, 0.5f, 24 * 60},
+    {ResultRules::Glucose, 200.0f, 60},
+    {ResultRules::Lactate, 4.0f, 60},
+};
+
+const qint64 MS_PER_MINUTE = 60 * 1000;
+}
+
+PatientResultCache::PatientResultCache(int capacity)
+    : m_capacity(qMax(1, capacity))
+{
+}
+
+int PatientResultCache::warm(const QVariantList &results)
+{
+    // Newest first; added oldest first, so the LRU order ends up right
+    for (auto it = results.crbegin(); it != results.crend(); ++it) {
+        const QVariantMap result = it->toMap();
+        add(result.value("patientId").toString(), entry(result));
+    }
+    qDebug() << "Patient result cache warmed with" << results.size() << "results of" << size() << "patients";
+    return int(results.size());
+}
+
+void PatientResultCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_lru.clear();
+    m_index.clear();
+}
+
+PatientResultCache::Entry PatientResultCache::entry(const QVariantMap &result)
+{
+    Entry entry;
+    entry.timestampMs = QDateTime::fromString(result.value("timestamp").toString(), Qt::ISODate).toMSecsSinceEpoch();
+    for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+        const QVariant value = result.value(ResultRules::ANALYTE_FIELDS[analyte]);
+        entry.values[analyte] = value.isValid() && !value.isNull() ? value.toFloat()
+                                                                  : std::numeric_limits<float>::quiet_NaN();
+    }
+    return entry;
+}
+
+QList<PatientResultCache::Entry> PatientResultCache::entries(const QVariantList &results)
+{
+    QList<Entry> entries;
+    entries.reserve(results.size());
+    for (const QVariant &result : results) {
+        entries.append(entry(result.toMap()));
+    }
+    return entries;
+}
+
+void PatientResultCache::add(const QString &patientId, const Entry &entry)
+{
+    if (patientId.isEmpty()) {
+        return;
+    }
+    QMutexLocker locker(&m_mutex);
+    History &history = touch(patientId);
+    history.entries[history.head] = entry;
+    history.head = (history.head + 1) % HISTORY_SIZE;
+    history.count = qMin(history.count + 1, HISTORY_SIZE);
+}
+
+bool PatientResultCache::seed(const QString &patientId, const QList<Entry> &entries)
+{
+    if (patientId.isEmpty()) {
+        return false;
+    }
+    QMutexLocker locker(&m_mutex);
+    History &history = touch(patientId);
+
+    QList<Entry> merged = entries;
+    for (int i = 0; i < history.count; ++i) {
+        const Entry &cached = history.entries[i];
+        // Bitwise, so missing (NaN) values match
+        const bool stored = std::any_of(entries.cbegin(), entries.cend(), [&cached](const Entry &entry) {
+            return entry.timestampMs == cached.timestampMs &&
+                   std::memcmp(entry.values.data(), cached.values.data(), sizeof(entry.values)) == 0;
+        });
+        if (!stored) {
+            merged.append(cached);
+        }
+    }
+    std::stable_sort(merged.begin(), merged.end(), [](const Entry &a, const Entry &b) {
+        return a.timestampMs > b.timestampMs;
+    });
+
+    const qsizetype count = qMin(merged.size(), qsizetype(HISTORY_SIZE));
+    history.head = 0;
+    for (qsizetype i = count - 1; i >= 0; --i) {
+        history.entries[history.head] = merged.at(i);
+        history.head = (history.head + 1) % HISTORY_SIZE;
+    }
+    history.count = int(count);
+    return true;
+}
+
+QList<PatientResultCache::Entry> PatientResultCache::recent(const QString &patientId) const
+{
+    QList<Entry> entries;
+    QMutexLocker locker(&m_mutex);
+    const auto found = m_index.constFind(patientId);
+    if (found == m_index.constEnd()) {
+        return entries;
+    }
+    const History &history = *found.value();
+    entries.reserve(history.count);
+    for (int i = 1; i <= history.count; ++i) {
+        entries.append(history.entries[(history.head - i + HISTORY_SIZE) % HISTORY_SIZE]);
+    }
+    return entries;
+}
+
+bool PatientResultCache::contains(const QString &patientId) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_index.contains(patientId);
+}
+
+int PatientResultCache::size() const
+{
+    QMutexLocker locker(&m_mutex);
+    return int(m_index.size());
+}
+
+quint16 PatientResultCache::checkAndAdd(QVariantMap &result)
+{
+    const QString patientId = result.value("patientId").toString();
+    if (patientId.isEmpty()) {
+        return 0;
+    }
+    const Entry current = entry(result);
+
+    quint16 flags = 0;
+    bool checked = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        // Without the patient's history there is nothing to compare with
+        checked = m_index.contains(patientId);
+        History &history = touch(patientId);
+        if (checked) {
+            flags = check(history, current);
+        }
+        history.entries[history.head] = current;
+        history.head = (history.head + 1) % HISTORY_SIZE;
+        history.count = qMin(history.count + 1, HISTORY_SIZE);
+    }
+
+    QStringList deltaFields;
+    for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+        if (flags & (1u << analyte)) {
+            deltaFields.append(ResultRules::ANALYTE_FIELDS[analyte]);
+        }
+    }
+    result["deltaFlags"] = int(flags);
+    result["deltaFields"] = deltaFields;
+    result["deltaChecked"] = checked;
+    return flags;
+}
+
+QVariantMap PatientResultCache::history(const QString &patientId, const QList<Entry> &entries)
+{
+    QVariantList results;
+    results.reserve(entries.size());
+    for (const Entry &entry : entries) {
+        QVariantMap result;
+        result["timestamp"] = QDateTime::fromMSecsSinceEpoch(entry.timestampMs).toString(Qt::ISODate);
+        for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+            if (!std::isnan(entry.values[analyte])) {
+                result[ResultRules::ANALYTE_FIELDS[analyte]] = entry.values[analyte];
+            }
+        }
+        results.append(result);
+    }
+
+    QVariantMap trends;
+    for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+        int count = 0;
+        double sum = 0.0;
+        double low = 0.0;
+        double high = 0.0;
+        const Entry *latest = nullptr;
+        const Entry *previous = nullptr;
+        const Entry *oldest = nullptr;
+        for (const Entry &entry : entries) {
+            const double value = entry.values[analyte];
+            if (std::isnan(value)) {
+                continue;
+            }
+            low = count == 0 ? value : qMin(low, value);
+            high = count == 0 ? value : qMax(high, value);
+            sum += value;
+            ++count;
+            if (!latest) {
+                latest = &entry;
+            } else if (!previous) {
+                previous = &entry;
+            }
+            oldest = &entry;
+        }
+        if (count == 0) {
+            continue;
+        }
+
+        QVariantMap trend;
+        trend["count"] = count;
+        trend["latest"] = latest->values[analyte];
+        trend["min"] = low;
+        trend["max"] = high;
+        trend["mean"] = sum / count;
+        if (previous) {
+            trend["previous"] = previous->values[analyte];
+        }
+        const double hours = double(latest->timestampMs - oldest->timestampMs) / (60 * MS_PER_MINUTE);
+        if (hours > 0.0) {
+            trend["changePerHour"] = (latest->values[analyte] - oldest->values[analyte]) / hours;
+        }
+        trends[ResultRules::ANALYTE_FIELDS[analyte]] = trend;
+    }
+
+    QVariantMap history;
+    history["patientId"] = patientId;
+    history["count"] = int(entries.size());
+    history["results"] = results;
+    history["trends"] = trends;
+    return history;
+}
+
+PatientResultCache::History &PatientResultCache::touch(const QString &patientId)
+{
+    const auto found = m_index.find(patientId);
+    if (found != m_index.end()) {
+        m_lru.splice(m_lru.begin(), m_lru, found.value());
+        return m_lru.front();
+    }
+
+    if (int(m_index.size()) >= m_capacity) {
+        // Reuse the least recently used patient's slot
+        m_index.remove(m_lru.back().patientId);
+        m_lru.splice(m_lru.begin(), m_lru, std::prev(m_lru.end()));
+    } else {
+        m_lru.emplace_front();
+    }
+    History &history = m_lru.front();
+    history.patientId = patientId;
+    history.head = 0;
+    history.count = 0;
+    m_index.insert(patientId, m_lru.begin());
+    return history;
+}
+
+quint16 PatientResultCache::check(const History &history, const Entry &entry) const
+{
+    // At most HISTORY_SIZE previous results per rule, whatever the cache size
+    quint16 flags = 0;
+    for (int i = 0; i < history.count; ++i) {
+        const Entry &previous = history.entries[i];
+        const qint64 elapsedMs = std::abs(entry.timestampMs - previous.timestampMs);
+        for (const DeltaRule &rule : DELTA_RULES) {
+            const bool inWindow = elapsedMs <= rule.windowMinutes * MS_PER_MINUTE;
+            const bool jumped = std::fabs(entry.values[rule.analyte] - previous.values[rule.analyte]) > rule.maxChange;
+            flags |= quint16((inWindow & jumped) << rule.analyte);
+        }
+    }
+    return flags;
+}
@@ -0,0 +1,82 @@
+#ifndef PATIENTRESULTCACHE_H
+#define PATIENTRESULTCACHE_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QVariantMap>
+
+#include <array>
+#include <list>
+
+#include "ResultRules.h"
+
+// The most recent results of the most recently seen patients, so a new
+// result can be compared with the patient's previous ones without a scan
+// or a query. Bounded by LRU, reusing the evicted patient's slot.
+// Thread-safe.
+class PatientResultCache
+{
+public:
+    struct Entry {
+        qint64 timestampMs = 0;
+        std::array<float, ResultRules::ANALYTE_COUNT> values; // NaN when missing
+    };
+
+    static const int HISTORY_SIZE = 8;
+    static const int MAX_PATIENTS = 4096;
+
+    explicit PatientResultCache(int capacity = MAX_PATIENTS);
+
+    // Fills the cache from stored results, the latest HISTORY_SIZE of each
+    // patient newest first (DatabaseManager::getRecentPatientResults() of
+    // up to capacity() patients); returns how many were read
+    int warm(const QVariantList &results);
+    void clear();
+    int capacity() const { return m_capacity; }
+
+    static Entry entry(const QVariantMap &result);
+    static QList<Entry> entries(const QVariantList &results);
+    void add(const QString &patientId, const Entry &entry);
+    // Fills in a patient read from the database (entries newest first).
+    // When the patient is already cached, the entries are merged with the
+    // cached ones, which may include results the database does not have
+    // yet; an entry in both is kept once.
+    bool seed(const QString &patientId, const QList<Entry> &entries);
+
+    // Newest first; empty when the patient is not cached
+    QList<Entry> recent(const QString &patientId) const;
+    bool contains(const QString &patientId) const;
+    int size() const;
+
+    // Delta check: compares the result with the patient's previous results
+    // and records it. Sets deltaFlags (bit per ResultRules::Analyte),
+    // deltaFields and deltaChecked on the result; returns the flags. A
+    // patient not in the cache cannot be checked: seed() it first, or the
+    // result is recorded with deltaChecked false.
+    quint16 checkAndAdd(QVariantMap &result);
+
+    // For the comparison panel: the entries (newest first) as results plus
+    // per analyte latest, previous, min, max, mean and change per hour
+    static QVariantMap history(const QString &patientId, const QList<Entry> &entries);
+
+private:
+    struct History {
+        QString patientId;
+        std::array<Entry, HISTORY_SIZE> entries;
+        int head = 0; // next slot to write
+        int count = 0;
+    };
+
+    // Caller holds m_mutex
+    History &touch(const QString &patientId);
+    quint16 check(const History &history, const Entry &entry) const;
+
+    mutable QMutex m_mutex;
+    std::list<History> m_lru; // most recently used first
+    QHash<QString, std::list<History>::iterator> m_index;
+    int m_capacity;
+};
+
+#endif // PATIENTRESULTCACHE_H
@@ -0,0 +1,234 @@
+#include "QcEngine.h"
+#include "DatabaseManager.h"
+
+#include <QDateTime>
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace QcRules;
+
+QcEngine::QcEngine(DatabaseManager *dbManager, QObject *parent)
+    : QObject(parent)
+    , m_dbManager(dbManager)
+    , m_loaded(false)
+{
+}
+
+bool QcEngine::load()
+{
+    m_loaded = false;
+    if (!m_dbManager->isConnected()) {
+        qWarning() << "QC history not loaded: no database connection";
+        emit lockedChanged();
+        return false;
+    }
+
+    QVariantList targets = m_dbManager->getQcTargets();
+    if (targets.isEmpty()) {
+        const Targets defaults = defaultTargets();
+        for (int level = 0; level < LEVEL_COUNT; ++level) {
+            for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+                if (defaults[level][analyte].sd > 0.0) {
+                    targets.append(QVariantMap{{"level", level + 1},
+                                               {"analyte", ResultRules::ANALYTE_FIELDS[analyte]},
+                                               {"mean", defaults[level][analyte].mean},
+                                               {"sd", defaults[level][analyte].sd}});
+                }
+            }
+        }
+        if (!m_dbManager->saveQcTargets(targets, "SYSTEM")) {
+            emit lockedChanged();
+            return false;
+        }
+    }
+
+    m_targets = {};
+    for (const QVariant &item : std::as_const(targets)) {
+        const QVariantMap row = item.toMap();
+        const int level = row.value("level").toInt() - 1;
+        const int analyte = analyteIndex(row.value("analyte").toString());
+        if (level < 0 || level >= LEVEL_COUNT || analyte < 0) {
+            continue;
+        }
+        m_targets[level][analyte] = {row.value("mean").toDouble(), row.value("sd").toDouble()};
+    }
+
+    // Acknowledged rejections restarted the runs of their channels
+    QVariantList acknowledged;
+    QVariantList history;
+    if (!m_dbManager->getAcknowledgedQcRuns(acknowledged) || !m_dbManager->getRecentQcValues(WINDOW, history)) {
+        emit lockedChanged();
+        return false;
+    }
+    m_channels = replay(history, acknowledged, m_targets);
+
+    if (!reloadOpenViolations()) {
+        emit lockedChanged();
+        return false;
+    }
+    m_loaded = true;
+    emit lockedChanged();
+    qDebug() << "Loaded QC history of" << history.size() << "control values;"
+             << m_openViolations.size() << "open violations";
+    return true;
+}
+
+QVariantMap QcEngine::addControlRun(const QVariantMap &run, const QString &operatorName)
+{
+    // Without the targets and history there is nothing to measure against
+    if (!m_loaded) {
+        const QString error = "QC history not loaded; the control run was not evaluated";
+        qWarning() << error;
+        QVariantMap outcome;
+        outcome["runId"] = -1;
+        outcome["rejected"] = true;
+        outcome["rules"] = QString();
+        outcome["violations"] = QVariantList();
+        outcome["error"] = error;
+        emit controlRunEvaluated(outcome);
+        return outcome;
+    }
+
+    // Evaluated on a copy, which only replaces the history when the run
+    // is accepted
+    Channels channels = m_channels;
+    const Evaluation evaluation = evaluate(run, m_targets, channels);
+
+    const int runRules = evaluation.runRules;
+    const auto &rules = evaluation.rules;
+    const auto &zScores = evaluation.zScores;
+    const auto &values = evaluation.values;
+    QVariantList runValues;
+    QVariantList violations;
+    for (int level = 0; level < LEVEL_COUNT; ++level) {
+        for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+            if (!evaluation.measured[level][analyte]) {
+                continue;
+            }
+            const QString field = ResultRules::ANALYTE_FIELDS[analyte];
+            runValues.append(QVariantMap{{"level", level + 1},
+                                         {"analyte", field},
+                                         {"value", values[level][analyte]},
+                                         {"z", zScores[level][analyte]},
+                                         {"rules", rules[level][analyte]}});
+            for (int bit = Rule12s; bit <= Rule10x; bit <<= 1) {
+                if (rules[level][analyte] & bit) {
+                    violations.append(QVariantMap{{"level", level + 1},
+                                                  {"analyte", field},
+                                                  {"rule", ruleName(bit)},
+                                                  {"value", values[level][analyte]},
+                                                  {"z", zScores[level][analyte]},
+                                                  {"reject", (bit & REJECTION_RULES) != 0}});
+                }
+            }
+        }
+    }
+
+    const bool rejected = evaluation.isRejected();
+    if (!rejected) {
+        m_channels = channels;
+    }
+
+    QVariantMap record;
+    record["timestamp"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    record["operator"] = operatorName;
+    record["rejected"] = rejected;
+    record["values"] = runValues;
+    record["violations"] = violations;
+    const int runId = m_dbManager->saveQcRun(record);
+
+    if (rejected) {
+        if (runId < 0 || !reloadOpenViolations()) {
+            // Still locked, even though the database missed the run
+            for (const QVariant &violation : std::as_const(violations)) {
+                if (violation.toMap().value("reject").toBool()) {
+                    m_openViolations.append(violation);
+                }
+            }
+        }
+        emit lockedChanged();
+        qWarning() << "QC run rejected:" << ruleNames(runRules & REJECTION_RULES);
+    }
+
+    QVariantMap outcome;
+    outcome["runId"] = runId;
+    outcome["rejected"] = rejected;
+    outcome["rules"] = ruleNames(runRules);
+    outcome["violations"] = violations;
+    emit controlRunEvaluated(outcome);
+    return outcome;
+}
+
+bool QcEngine::acknowledgeViolations(const QString &username, const QString &correctiveAction)
+{
+    if (!m_loaded) {
+        qWarning() << "QC history not loaded; there is nothing to acknowledge";
+        return false;
+    }
+    if (!isLocked()) {
+        return true;
+    }
+    if (correctiveAction.trimmed().isEmpty()) {
+        qWarning() << "A corrective action is required to clear QC violations";
+        return false;
+    }
+    if (!m_dbManager->acknowledgeQcViolations(username, correctiveAction.trimmed())) {
+        return false;
+    }
+
+    // Runs counted up to the rejection do not carry over the corrective action
+    for (const QVariant &item : std::as_const(m_openViolations)) {
+        const QVariantMap violation = item.toMap();
+        const int level = violation.value("level").toInt() - 1;
+        const int analyte = analyteIndex(violation.value("analyte").toString());
+        if (level >= 0 && level < LEVEL_COUNT && analyte >= 0) {
+            m_channels[level][analyte].restartRuns();
+        }
+    }
+    m_openViolations.clear();
+    emit lockedChanged();
+    return true;
+}
+
+QVariantMap QcEngine::levelStatistics(int level, const QString &analyte) const
+{
+    QVariantMap statistics;
+    const int index = analyteIndex(analyte);
+    if (level < 1 || level > LEVEL_COUNT || index < 0) {
+        return statistics;
+    }
+    const Target &target = m_targets[level - 1][index];
+    const Channel &channel = m_channels[level - 1][index];
+
+    QVariantList values;
+    for (int i = 0; i < channel.size; ++i) {
+        const int slot = (channel.head - channel.size + i + WINDOW) % WINDOW;
+        values.append(channel.values[slot]);
+    }
+    const int n = channel.size;
+    const double mean = n > 0 ? channel.sum / n : 0.0;
+    const double sd = n > 1 ? std::sqrt(std::max(0.0, (channel.sumSquares - channel.sum * mean) / (n - 1))) : 0.0;
+
+    statistics["level"] = level;
+    statistics["analyte"] = analyte;
+    statistics["targetMean"] = target.mean;
+    statistics["targetSd"] = target.sd;
+    statistics["count"] = n;
+    statistics["mean"] = mean;
+    statistics["sd"] = sd;
+    statistics["cv"] = mean != 0.0 ? 100.0 * sd / mean : 0.0;
+    statistics["values"] = values;
+    return statistics;
+}
+
+bool QcEngine::reloadOpenViolations()
+{
+    QVariantList violations;
+    if (!m_dbManager->getOpenQcViolations(violations)) {
+        return false;
+    }
+    m_openViolations = violations;
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef QCENGINE_H
+#define QCENGINE_H
+
+#include <QObject>
+#include <QVariantList>
+#include <QVariantMap>
+
+#include "QcRules.h"
+
+class DatabaseManager;
+
+// Westgard multirule QC over each control level's recent runs (see
+// QcRules). Rejected runs stay out of that history. A rejection locks
+// patient analysis until a corrective action is recorded against it, which
+// also restarts the run lengths of the rejected channels. Analysis is
+// locked as well until the history has been loaded, and control runs are
+// refused until then.
+class QcEngine : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool isLocked READ isLocked NOTIFY lockedChanged)
+    Q_PROPERTY(bool isLoaded READ isLoaded NOTIFY lockedChanged)
+    Q_PROPERTY(QVariantList openViolations READ openViolations NOTIFY lockedChanged)
+
+public:
+    static const int LEVEL_COUNT = QcRules::LEVEL_COUNT;
+    using Target = QcRules::Target;
+
+    explicit QcEngine(DatabaseManager *dbManager, QObject *parent = nullptr);
+
+    // Reads the targets (storing the defaults the first time), replays the
+    // recent accepted runs and reads the open rejections. Call once the
+    // database is initialized; false, staying locked, when it cannot be read.
+    bool load();
+    bool isLoaded() const { return m_loaded; }
+    bool isLocked() const { return !m_loaded || !m_openViolations.isEmpty(); }
+    QVariantList openViolations() const { return m_openViolations; }
+    // Levels count from 1
+    Target target(int level, int analyte) const { return m_targets[level - 1][analyte]; }
+
+public slots:
+    // Levels ("1" to "3") to their values by result field. Returns
+    // rejected, rules (all rules broken) and violations; the run and its
+    // violations are stored. Before load() has succeeded the run is not
+    // evaluated: it comes back rejected with an error.
+    Q_INVOKABLE QVariantMap addControlRun(const QVariantMap &run, const QString &operatorName);
+    // Clears the lock
+    Q_INVOKABLE bool acknowledgeViolations(const QString &username, const QString &correctiveAction);
+    // Target mean and SD against the observed ones over the window, with
+    // the values oldest first, for a Levey-Jennings chart
+    Q_INVOKABLE QVariantMap levelStatistics(int level, const QString &analyte) const;
+
+signals:
+    void lockedChanged();
+    void controlRunEvaluated(const QVariantMap &outcome);
+
+private:
+    bool reloadOpenViolations();
+
+    DatabaseManager *m_dbManager;
+    bool m_loaded;
+    QcRules::Targets m_targets;
+    QcRules::Channels m_channels;
+    QVariantList m_openViolations;
+};
+
+#endif // QCENGINE_H
@@ -0,0 +1,223 @@
+#include "QcRules.h"
+
+#include <QDebug>
+#include <QStringList>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace {
+const std::pair<int, const char *> RULE_NAMES[] = {
+    {QcRules::Rule12s, "1-2s"},
+    {QcRules::Rule13s, "1-3s"},
+    {QcRules::Rule22s, "2-2s"},
+    {QcRules::RuleR4s, "R-4s"},
+    {QcRules::Rule41s, "4-1s"},
+    {QcRules::Rule10x, "10-x"}
+};
+
+// Mean and SD of a three-level blood gas control, in ResultRules::Analyte
+// order. HCO3 and BE are calculated, so they are not controlled.
+const double DEFAULT_TARGETS[QcRules::LEVEL_COUNT][ResultRules::ANALYTE_COUNT][2] = {
+    // Level 1: acidosis, hypoxia
+    {{7.15, 0.012}, {65.0, 2.0}, {60.0, 3.0}, {0.0, 0.0}, {0.0, 0.0},
+     {120.0, 1.5}, {2.8, 0.08}, {80.0, 1.5}, {1.55, 0.03},
+     {40.0, 2.0}, {1.0, 0.1}},
+    // Level 2: normal
+    {{7.40, 0.010}, {40.0, 1.5}, {100.0, 3.5}, {0.0, 0.0}, {0.0, 0.0},
+     {140.0, 1.5}, {4.5, 0.08}, {105.0, 1.5}, {1.20, 0.02},
+     {100.0, 3.0}, {3.0, 0.15}},
+    // Level 3: alkalosis, hyperoxia
+    {{7.60, 0.010}, {22.0, 1.0}, {140.0, 4.5}, {0.0, 0.0}, {0.0, 0.0},
+     {160.0, 2.0}, {6.5, 0.12}, {125.0, 2.0}, {0.75, 0.02},
+     {270.0, 6.0}, {8.0, 0.3}}
+};
+}
+
+namespace QcRules {
+
+QString ruleName(int rule)
+{
+    for (const auto &[bit, name] : RULE_NAMES) {
+        if (bit == rule) {
+            return name;
+        }
+    }
+    return QString();
+}
+
+QString ruleNames(int rules)
+{
+    QStringList names;
+    for (const auto &[bit, name] : RULE_NAMES) {
+        if (rules & bit) {
+            names.append(name);
+        }
+    }
+    return names.join(", ");
+}
+
+Targets defaultTargets()
+{
+    Targets targets;
+    for (int level = 0; level < LEVEL_COUNT; ++level) {
+        for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+            targets[level][analyte] = {DEFAULT_TARGETS[level][analyte][0], DEFAULT_TARGETS[level][analyte][1]};
+        }
+    }
+    return targets;
+}
+
+int analyteIndex(const QString &field)
+{
+    for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+        if (field == QLatin1String(ResultRules::ANALYTE_FIELDS[analyte])) {
+            return analyte;
+        }
+    }
+    return -1;
+}
+
+Evaluation evaluate(const QVariantMap &run, const Targets &targets, Channels &channels)
+{
+    Evaluation evaluation;
+    for (auto it = run.cbegin(); it != run.cend(); ++it) {
+        const int level = it.key().toInt() - 1;
+        if (level < 0 || level >= LEVEL_COUNT) {
+            qWarning() << "Ignoring unknown control level" << it.key();
+            continue;
+        }
+        const QVariantMap levelValues = it.value().toMap();
+        for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+            const Target &target = targets[level][analyte];
+            const QVariant value = levelValues.value(ResultRules::ANALYTE_FIELDS[analyte]);
+            if (target.sd <= 0.0 || !value.isValid() || value.isNull()) {
+                continue;
+            }
+            evaluation.values[level][analyte] = value.toFloat();
+            evaluation.zScores[level][analyte] = (evaluation.values[level][analyte] - target.mean) / target.sd;
+            evaluation.rules[level][analyte] = channels[level][analyte].add(evaluation.values[level][analyte],
+                                                                            evaluation.zScores[level][analyte]);
+            evaluation.measured[level][analyte] = true;
+        }
+    }
+
+    // Within the run, across its levels
+    for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+        for (int first = 0; first < LEVEL_COUNT; ++first) {
+            for (int second = first + 1; second < LEVEL_COUNT; ++second) {
+                if (!evaluation.measured[first][analyte] || !evaluation.measured[second][analyte]) {
+                    continue;
+                }
+                const double a = evaluation.zScores[first][analyte];
+                const double b = evaluation.zScores[second][analyte];
+                int shared = 0;
+                if ((a > 2.0 && b > 2.0) || (a < -2.0 && b < -2.0)) {
+                    shared |= Rule22s;
+                }
+                if ((a > 2.0 && b < -2.0) || (a < -2.0 && b > 2.0)) {
+                    shared |= RuleR4s;
+                }
+                evaluation.rules[first][analyte] |= shared;
+                evaluation.rules[second][analyte] |= shared;
+            }
+        }
+    }
+
+    for (int level = 0; level < LEVEL_COUNT; ++level) {
+        for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+            evaluation.runRules |= evaluation.rules[level][analyte];
+        }
+    }
+    return evaluation;
+}
+
+Channels replay(const QVariantList &history, const QVariantList &acknowledged, const Targets &targets)
+{
+    std::array<std::array<qint64, ResultRules::ANALYTE_COUNT>, LEVEL_COUNT> restartAfter{};
+    for (const QVariant &item : acknowledged) {
+        const QVariantMap row = item.toMap();
+        const int level = row.value("level").toInt() - 1;
+        const int analyte = analyteIndex(row.value("analyte").toString());
+        if (level >= 0 && level < LEVEL_COUNT && analyte >= 0) {
+            restartAfter[level][analyte] = row.value("runId").toLongLong();
+        }
+    }
+
+    // The rules only look back over the window
+    Channels channels;
+    for (const QVariant &item : history) {
+        const QVariantMap row = item.toMap();
+        const int level = row.value("level").toInt() - 1;
+        const int analyte = analyteIndex(row.value("analyte").toString());
+        if (level < 0 || level >= LEVEL_COUNT || analyte < 0 || targets[level][analyte].sd <= 0.0) {
+            continue;
+        }
+        Channel &channel = channels[level][analyte];
+        if (restartAfter[level][analyte] > 0 && row.value("runId").toLongLong() > restartAfter[level][analyte]) {
+            channel.restartRuns();
+            restartAfter[level][analyte] = 0;
+        }
+        const Target &target = targets[level][analyte];
+        const float value = row.value("value").toFloat();
+        channel.add(value, (value - target.mean) / target.sd);
+    }
+    // Rejections acknowledged after the last accepted runs
+    for (int level = 0; level < LEVEL_COUNT; ++level) {
+        for (int analyte = 0; analyte < ResultRules::ANALYTE_COUNT; ++analyte) {
+            if (restartAfter[level][analyte] > 0) {
+                channels[level][analyte].restartRuns();
+            }
+        }
+    }
+    return channels;
+}
+
+int Channel::add(float value, double z)
+{
+    // Running sums over the ring, for the observed mean and SD
+    if (size == WINDOW) {
+        const double oldest = values[head];
+        sum -= oldest;
+        sumSquares -= oldest * oldest;
+    } else {
+        ++size;
+    }
+    values[head] = value;
+    head = (head + 1) % WINDOW;
+    sum += value;
+    sumSquares += double(value) * value;
+
+    int rules = 0;
+    if (std::abs(z) > 2.0) {
+        rules |= Rule12s;
+    }
+    if (std::abs(z) > 3.0) {
+        rules |= Rule13s;
+    }
+    if (hasLast && ((z > 2.0 && lastZ > 2.0) || (z < -2.0 && lastZ < -2.0))) {
+        rules |= Rule22s;
+    }
+    beyond1s = z > 1.0 ? qMax(beyond1s, 0) + 1 : z < -1.0 ? qMin(beyond1s, 0) - 1 : 0;
+    if (std::abs(beyond1s) >= 4) {
+        rules |= Rule41s;
+    }
+    sideOfMean = z > 0.0 ? qMax(sideOfMean, 0) + 1 : z < 0.0 ? qMin(sideOfMean, 0) - 1 : 0;
+    if (std::abs(sideOfMean) >= 10) {
+        rules |= Rule10x;
+    }
+    lastZ = z;
+    hasLast = true;
+    return rules;
+}
+
+void Channel::restartRuns()
+{
+    lastZ = 0.0;
+    hasLast = false;
+    beyond1s = 0;
+    sideOfMean = 0;
+}
+
+} // namespace QcRules
@@ -0,0 +1,86 @@
+#ifndef QCRULES_H
+#define QCRULES_H
+
+#include <QString>
+#include <QVariantList>
+#include <QVariantMap>
+
+#include <array>
+
+#include "ResultRules.h"
+
+// Westgard multirule evaluation of control runs, without storage; the
+// QcEngine keeps the state and the database records. Every level and
+// analyte keeps a ring of its last WINDOW accepted values with running
+// sums, and the run lengths the 2-2s, 4-1s and 10-x rules count, so a run
+// is evaluated in constant time without reading history.
+namespace QcRules {
+
+enum Rule {
+    Rule12s = 0x01, // warning only
+    Rule13s = 0x02,
+    Rule22s = 0x04, // two in a row, or two levels of a run
+    RuleR4s = 0x08, // two levels of a run 4 SD apart
+    Rule41s = 0x10,
+    Rule10x = 0x20
+};
+const int REJECTION_RULES = Rule13s | Rule22s | RuleR4s | Rule41s | Rule10x;
+const int LEVEL_COUNT = 3;
+const int WINDOW = 20;
+
+QString ruleName(int rule);
+// "1-3s, 2-2s"
+QString ruleNames(int rules);
+
+struct Target {
+    double mean = 0.0;
+    double sd = 0.0; // 0 when the analyte is not controlled at the level
+};
+using Targets = std::array<std::array<Target, ResultRules::ANALYTE_COUNT>, LEVEL_COUNT>;
+
+// The default targets of a three-level blood gas control
+Targets defaultTargets();
+
+struct Channel {
+    std::array<float, WINDOW> values{};
+    int head = 0;
+    int size = 0;
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    double lastZ = 0.0;
+    bool hasLast = false;
+    int beyond1s = 0;  // consecutive beyond 1 SD, signed by side
+    int sideOfMean = 0; // consecutive on one side of the mean, signed
+
+    // Records the value; returns the rules it breaks on this channel
+    int add(float value, double z);
+    // Forgets the runs across control runs (2-2s, 4-1s, 10-x)
+    void restartRuns();
+};
+using Channels = std::array<std::array<Channel, ResultRules::ANALYTE_COUNT>, LEVEL_COUNT>;
+
+struct Evaluation {
+    std::array<std::array<int, ResultRules::ANALYTE_COUNT>, LEVEL_COUNT> rules{};
+    std::array<std::array<double, ResultRules::ANALYTE_COUNT>, LEVEL_COUNT> zScores{};
+    std::array<std::array<float, ResultRules::ANALYTE_COUNT>, LEVEL_COUNT> values{};
+    std::array<std::array<bool, ResultRules::ANALYTE_COUNT>, LEVEL_COUNT> measured{};
+    int runRules = 0; // every rule broken by the run
+    bool isRejected() const { return runRules & REJECTION_RULES; }
+};
+
+// A run maps levels ("1" to "3") to their values by result field. The
+// channels are updated as if the run were accepted; callers keep a copy
+// when a rejected run must stay out of the history.
+Evaluation evaluate(const QVariantMap &run, const Targets &targets, Channels &channels);
+
+// Rebuilds the channels from accepted control values, oldest first (rows
+// of level, analyte, value and runId). Acknowledged rows (level, analyte
+// and runId of the last acknowledged rejection) restart the runs of their
+// channel from the first value after that run.
+Channels replay(const QVariantList &history, const QVariantList &acknowledged, const Targets &targets);
+
+int analyteIndex(const QString &field);
+
+} // namespace QcRules
+
+#endif // QCRULES_H
@@ -0,0 +1,225 @@
+#include "QuantileSketch.h"
+
+#include <QDataStream>
+#include <QIODevice>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+const quint8 FORMAT_VERSION = 1;
+// Lower levels never shrink below this, or they would compact on every
+// other value
+const int MIN_CAPACITY = 8;
+const double CAPACITY_RATIO = 2.0 / 3.0;
+}
+
+QuantileSketch::QuantileSketch(int k)
+    : m_k(qMax(MIN_CAPACITY, k))
+    , m_random(0x9E3779B9u)
+{
+    clear();
+}
+
+void QuantileSketch::clear()
+{
+    m_levels = {QList<float>()};
+    m_levels[0].reserve(m_k);
+    m_retained = 0;
+    m_count = 0;
+    m_min = std::numeric_limits<float>::quiet_NaN();
+    m_max = std::numeric_limits<float>::quiet_NaN();
+    m_sorted.clear();
+    m_sortedValid = false;
+}
+
+void QuantileSketch::add(float value)
+{
+    if (std::isnan(value)) {
+        return;
+    }
+    m_min = m_count == 0 ? value : qMin(m_min, value);
+    m_max = m_count == 0 ? value : qMax(m_max, value);
+    ++m_count;
+    m_levels[0].append(value);
+    ++m_retained;
+    m_sortedValid = false;
+    if (m_retained >= totalCapacity()) {
+        compress();
+    }
+}
+
+void QuantileSketch::merge(const QuantileSketch &other)
+{
+    if (other.isEmpty()) {
+        return;
+    }
+    m_min = isEmpty() ? other.m_min : qMin(m_min, other.m_min);
+    m_max = isEmpty() ? other.m_max : qMax(m_max, other.m_max);
+    m_count += other.m_count;
+    while (m_levels.size() < other.m_levels.size()) {
+        m_levels.append(QList<float>());
+    }
+    for (qsizetype level = 0; level < other.m_levels.size(); ++level) {
+        m_levels[level].append(other.m_levels.at(level));
+        m_retained += int(other.m_levels.at(level).size());
+    }
+    m_sortedValid = false;
+    while (m_retained >= totalCapacity()) {
+        compress();
+    }
+}
+
+float QuantileSketch::quantile(double q) const
+{
+    if (isEmpty()) {
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+    if (q <= 0.0) {
+        return m_min;
+    }
+    if (q >= 1.0) {
+        return m_max;
+    }
+
+    if (!m_sortedValid) {
+        m_sorted.clear();
+        m_sorted.reserve(m_retained);
+        for (qsizetype level = 0; level < m_levels.size(); ++level) {
+            for (float value : m_levels.at(level)) {
+                m_sorted.append({value, quint64(1) << level});
+            }
+        }
+        std::sort(m_sorted.begin(), m_sorted.end());
+        quint64 cumulative = 0;
+        for (auto &item : m_sorted) {
+            cumulative += item.second;
+            item.second = cumulative;
+        }
+        m_sortedValid = true;
+    }
+
+    // Compaction keeps the total weight, so this is the count
+    const quint64 total = m_sorted.last().second;
+    const quint64 rank = quint64(std::ceil(q * total));
+    const auto found = std::lower_bound(m_sorted.cbegin(), m_sorted.cend(), rank,
+                                        [](const std::pair<float, quint64> &item, quint64 rank) {
+                                            return item.second < rank;
+                                        });
+    return found == m_sorted.cend() ? m_max : found->first;
+}
+
+QByteArray QuantileSketch::serialize() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    stream << FORMAT_VERSION << qint32(m_k) << m_count << m_min << m_max << qint32(m_levels.size());
+    for (const QList<float> &level : m_levels) {
+        stream << qint32(level.size());
+        for (float value : level) {
+            stream << value;
+        }
+    }
+    return data;
+}
+
+bool QuantileSketch::deserialize(const QByteArray &data)
+{
+    QDataStream stream(data);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    quint8 version = 0;
+    qint32 k = 0;
+    qint32 levels = 0;
+    quint64 count = 0;
+    float low = 0.0f;
+    float high = 0.0f;
+    stream >> version >> k >> count >> low >> high >> levels;
+    if (stream.status() != QDataStream::Ok || version != FORMAT_VERSION || k < MIN_CAPACITY || levels < 1 || levels > 64) {
+        clear();
+        return false;
+    }
+
+    m_k = k;
+    clear();
+    m_levels.resize(levels);
+    for (qint32 level = 0; level < levels; ++level) {
+        qint32 size = 0;
+        stream >> size;
+        if (stream.status() != QDataStream::Ok || size < 0 || size > 16 * m_k) {
+            clear();
+            return false;
+        }
+        m_levels[level].resize(size);
+        for (qint32 i = 0; i < size; ++i) {
+            stream >> m_levels[level][i];
+        }
+        m_retained += size;
+    }
+    if (stream.status() != QDataStream::Ok) {
+        clear();
+        return false;
+    }
+    m_count = count;
+    m_min = low;
+    m_max = high;
+    return true;
+}
+
+int QuantileSketch::capacity(int level) const
+{
+    // The top level holds k items, each one below two thirds as many
+    const int depth = int(m_levels.size()) - 1 - level;
+    return qMax(MIN_CAPACITY, int(std::ceil(m_k * std::pow(CAPACITY_RATIO, depth))));
+}
+
+int QuantileSketch::totalCapacity() const
+{
+    int total = 0;
+    for (int level = 0; level < m_levels.size(); ++level) {
+        total += capacity(level);
+    }
+    return total;
+}
+
+void QuantileSketch::compress()
+{
+    // The lowest full level is halved into the one above it
+    for (int level = 0; level < m_levels.size(); ++level) {
+        if (m_levels.at(level).size() < capacity(level)) {
+            continue;
+        }
+        if (level + 1 == m_levels.size()) {
+            m_levels.append(QList<float>());
+        }
+        QList<float> &items = m_levels[level];
+        std::sort(items.begin(), items.end());
+
+        // An odd item out stays behind, so no weight is lost
+        float leftover = 0.0f;
+        const bool odd = items.size() % 2 != 0;
+        if (odd) {
+            leftover = items.takeLast();
+        }
+        QList<float> &above = m_levels[level + 1];
+        for (qsizetype i = nextBit() ? 1 : 0; i < items.size(); i += 2) {
+            above.append(items.at(i));
+        }
+        m_retained -= int(items.size() / 2);
+        items.clear();
+        if (odd) {
+            items.append(leftover);
+        }
+        return;
+    }
+}
+
+bool QuantileSketch::nextBit()
+{
+    // xorshift32: the promoted half only has to be unbiased, not secret
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 17;
+    m_random ^= m_random << 5;
+    return m_random & 1;
+}
@@ -0,0 +1,216 @@
+#include "ReflagJob.h"
+#include "DatabaseManager.h"
+
+#include <QDebug>
+#include <QTimer>
+
+ReflagWorker::ReflagWorker(QObject *parent)
+    : QObject(parent)
+    , m_cancelled(false)
+    , m_throttled(false)
+    , m_ruleVersion(0)
+    , m_lastId(0)
+    , m_processed(0)
+    , m_total(0)
+    , m_processedAtStart(0)
+    , m_failedWrites(0)
+{
+    // Leave a core for the GUI and the result pipeline
+    m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+    m_pool.setThreadPriority(QThread::LowPriority);
+}
+
+ReflagWorker::~ReflagWorker()
+{
+    m_pool.waitForDone();
+}
+
+void ReflagWorker::start(std::shared_ptr<const ResultRules::RangeTable> ranges)
+{
+    const int ruleVersion = ResultRules::ruleVersion(*ranges);
+
+    // SQLite connections are per thread, so the job opens its own; the
+    // schema is the main connection's business
+    if (!m_database) {
+        m_database = std::make_unique<DatabaseManager>();
+        if (!m_database->openConnection("reflag")) {
+            m_database.reset();
+            emit finished(ruleVersion, false);
+            return;
+        }
+    }
+
+    QVariantMap job = m_database->getReflagJob(ruleVersion);
+    if (!job.isEmpty() && !job.value("finished_at").isNull()) {
+        emit finished(ruleVersion, true);
+        return;
+    }
+    if (job.isEmpty()) {
+        m_database->beginReflagJob(ruleVersion);
+        job = m_database->getReflagJob(ruleVersion);
+    }
+
+    m_cancelled.store(false);
+    m_ranges = std::move(ranges);
+    m_ruleVersion = ruleVersion;
+    m_lastId = job.value("last_id").toLongLong();
+    m_processed = job.value("processed").toLongLong();
+    m_processedAtStart = m_processed;
+    m_failedWrites = 0;
+    m_total = m_processed + m_database->countResultsToReflag(ruleVersion);
+    m_elapsed.start();
+    m_sincePublished.start();
+    qDebug() << "Re-flagging results under rule version" << ruleVersion << "from id" << m_lastId
+             << "-" << (m_total - m_processed) << "to go";
+
+    publishProgress(true);
+    QMetaObject::invokeMethod(this, &ReflagWorker::processChunk, Qt::QueuedConnection);
+}
+
+void ReflagWorker::processChunk()
+{
+    if (m_cancelled.load()) {
+        publishProgress(true);
+        emit finished(m_ruleVersion, false);
+        return;
+    }
+
+    if (!m_database->readResultColumns(m_lastId, CHUNK_ROWS, m_ruleVersion, m_columns)) {
+        emit finished(m_ruleVersion, false);
+        return;
+    }
+    if (m_columns.size() == 0) {
+        m_database->finishReflagJob(m_ruleVersion);
+        publishProgress(true);
+        emit finished(m_ruleVersion, true);
+        return;
+    }
+
+    evaluateChunk();
+    if (!m_database->updateResultFlags(m_ruleVersion, m_columns, m_flags)) {
+        // Most likely the database stayed locked past the busy timeout;
+        // nothing of this chunk was committed, so it is retried
+        if (++m_failedWrites >= MAX_FAILED_WRITES) {
+            qWarning() << "Re-flagging stopped at id" << m_lastId << "after repeated write failures";
+            emit finished(m_ruleVersion, false);
+            return;
+        }
+        QTimer::singleShot(THROTTLE_PAUSE_MS, this, &ReflagWorker::processChunk);
+        return;
+    }
+    m_failedWrites = 0;
+    m_lastId = m_columns.ids.last();
+    m_processed += m_columns.size();
+    publishProgress(false);
+
+    // Back to the event loop between chunks, so cancel() and quit() apply
+    QTimer::singleShot(m_throttled.load() ? THROTTLE_PAUSE_MS : 0, this, &ReflagWorker::processChunk);
+}
+
+void ReflagWorker::evaluateChunk()
+{
+    const qsizetype rows = m_columns.size();
+    m_flags.resize(rows);
+    // The outputs are detached here, before any pool thread writes to them
+    const ResultRules::FlagOutput out = ResultRules::output(m_flags);
+    const ResultRules::RangeTable &ranges = *m_ranges;
+
+    const int slices = m_throttled.load() ? 1 : int(qBound(qsizetype(1), rows / MIN_SLICE_ROWS,
+                                                          qsizetype(m_pool.maxThreadCount())));
+    if (slices == 1) {
+        ResultRules::evaluate(ranges, m_columns, 0, rows, out);
+        return;
+    }
+
+    // Disjoint row ranges
+    const ResultRules::ResultColumns &columns = m_columns;
+    const qsizetype sliceRows = (rows + slices - 1) / slices;
+    for (qsizetype begin = 0; begin < rows; begin += sliceRows) {
+        const qsizetype end = qMin(rows, begin + sliceRows);
+        m_pool.start([&ranges, &columns, out, begin, end]() {
+            ResultRules::evaluate(ranges, columns, begin, end, out);
+        });
+    }
+    m_pool.waitForDone();
+}
+
+void ReflagWorker::publishProgress(bool force)
+{
+    if (!force && m_sincePublished.elapsed() < PROGRESS_INTERVAL_MS) {
+        return;
+    }
+    m_sincePublished.restart();
+
+    const double seconds = m_elapsed.elapsed() / 1000.0;
+    QVariantMap progress;
+    progress["ruleVersion"] = m_ruleVersion;
+    progress["processed"] = m_processed;
+    progress["total"] = m_total;
+    progress["lastId"] = m_lastId;
+    progress["rowsPerSecond"] = seconds > 0.0 ? (m_processed - m_processedAtStart) / seconds : 0.0;
+    progress["throttled"] = m_throttled.load();
+    emit progressChanged(progress);
+}
+
+ReflagJob::ReflagJob(QObject *parent)
+    : QObject(parent)
+    , m_worker(new ReflagWorker)
+    , m_running(false)
+{
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(m_worker, &ReflagWorker::progressChanged, this, [this](const QVariantMap &progress) {
+        m_progress = progress;
+        emit progressChanged();
+    });
+    connect(m_worker, &ReflagWorker::finished, this, &ReflagJob::onWorkerFinished);
+    m_thread.setObjectName("Reflag");
+    m_thread.start(QThread::LowPriority);
+}
+
+ReflagJob::~ReflagJob()
+{
+    m_worker->cancel();
+    m_thread.quit();
+    m_thread.wait();
+}
+
+void ReflagJob::start()
+{
+    if (m_running) {
+        return;
+    }
+    m_running = true;
+    emit runningChanged();
+
+    QMetaObject::invokeMethod(m_worker, [worker = m_worker, ranges = ResultRules::ranges()]() {
+        worker->start(ranges);
+    });
+}
+
+void ReflagJob::cancel()
+{
+    // Takes effect between chunks; progress so far is kept
+    m_worker->cancel();
+}
+
+void ReflagJob::setThrottled(bool throttled)
+{
+    m_worker->setThrottled(throttled);
+}
+
+void ReflagJob::onWorkerFinished(int ruleVersion, bool completed)
+{
+    m_running = false;
+    emit runningChanged();
+    emit finished(ruleVersion, completed);
+
+    if (completed) {
+        qDebug() << "Results re-flagged under rule version" << ruleVersion;
+    }
+
+    // Ranges installed while the job ran
+    if (ruleVersion != ResultRules::ruleVersion()) {
+        start();
+    }
+}
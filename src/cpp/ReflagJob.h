@@ -0,0 +1,114 @@
+#ifndef REFLAGJOB_H
+#define REFLAGJOB_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QThreadPool>
+#include <QVariantMap>
+
+#include <atomic>
+#include <memory>
+
+#include "ResultRules.h"
+
+class DatabaseManager;
+
+// Re-flags stored results on the job thread. Results are read in keyset
+// chunks on the worker's own database connection, evaluated in parallel
+// slices on a low-priority pool and written back one transaction per
+// chunk, together with the job's progress, so a restart resumes from the
+// last committed chunk.
+class ReflagWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ReflagWorker(QObject *parent = nullptr);
+    ~ReflagWorker();
+
+    // Thread-safe
+    void cancel() { m_cancelled.store(true); }
+    void setThrottled(bool throttled) { m_throttled.store(throttled); }
+
+public slots:
+    // Flags with the given table, under its rule version
+    void start(std::shared_ptr<const ResultRules::RangeTable> ranges);
+
+signals:
+    void progressChanged(const QVariantMap &progress);
+    void finished(int ruleVersion, bool completed);
+
+private slots:
+    void processChunk();
+
+private:
+    void evaluateChunk();
+    void publishProgress(bool force);
+
+    std::unique_ptr<DatabaseManager> m_database;
+    QThreadPool m_pool;
+    std::atomic<bool> m_cancelled;
+    std::atomic<bool> m_throttled;
+
+    std::shared_ptr<const ResultRules::RangeTable> m_ranges;
+    int m_ruleVersion;
+    qint64 m_lastId;
+    qint64 m_processed;
+    qint64 m_total;
+    ResultRules::ResultColumns m_columns;
+    ResultRules::FlagColumns m_flags;
+    QElapsedTimer m_elapsed;
+    QElapsedTimer m_sincePublished;
+    qint64 m_processedAtStart;
+    int m_failedWrites;
+
+    static const int CHUNK_ROWS = 4096;
+    static const int MIN_SLICE_ROWS = 512;
+    // While samples are being analysed the job runs on one core with a
+    // pause between chunks, so it never competes with the result pipeline
+    static const int THROTTLE_PAUSE_MS = 50;
+    static const int PROGRESS_INTERVAL_MS = 500;
+    static const int MAX_FAILED_WRITES = 20;
+};
+
+// Runs the re-flagging job for the installed rule set (ResultRules) in the
+// background. start() resumes an interrupted job, or starts one when the
+// rule version has never been applied; it does nothing once the job for
+// this version has finished. A job overtaken by newly installed ranges is
+// followed by one for them.
+class ReflagJob : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool running READ isRunning NOTIFY runningChanged)
+    Q_PROPERTY(QVariantMap progress READ progress NOTIFY progressChanged)
+
+public:
+    explicit ReflagJob(QObject *parent = nullptr);
+    ~ReflagJob();
+
+    bool isRunning() const { return m_running; }
+    QVariantMap progress() const { return m_progress; }
+
+public slots:
+    Q_INVOKABLE void start();
+    Q_INVOKABLE void cancel();
+    // Live analysis in progress; thread-safe
+    void setThrottled(bool throttled);
+
+signals:
+    void runningChanged();
+    void progressChanged();
+    void finished(int ruleVersion, bool completed);
+
+private slots:
+    void onWorkerFinished(int ruleVersion, bool completed);
+
+private:
+    QThread m_thread;
+    ReflagWorker *m_worker;
+    bool m_running;
+    QVariantMap m_progress;
+};
+
+#endif // REFLAGJOB_H
@@ -0,0 +1,226 @@
+#include "ResultPipeline.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QTimer>
+
+#include <chrono>
+
+PipelineStage::PipelineStage(const QString &name, Handler handler, std::size_t capacity, QObject *parent)
+    : QObject(parent)
+    , m_name(name)
+    , m_handler(std::move(handler))
+    , m_input(capacity)
+    , m_next(nullptr)
+    , m_scheduled(false)
+    , m_retryTimer(new QTimer(this))
+    , m_processed(0)
+    , m_failed(0)
+    , m_backpressure(0)
+{
+    m_retryTimer->setSingleShot(true);
+    m_retryTimer->setInterval(RETRY_INTERVAL_MS);
+    connect(m_retryTimer, &QTimer::timeout, this, &PipelineStage::drain);
+}
+
+bool PipelineStage::push(const PipelineItem &item)
+{
+    if (!m_input.tryPush(item)) {
+        return false;
+    }
+
+    // One queued drain covers any number of pushes
+    if (!m_scheduled.exchange(true)) {
+        QMetaObject::invokeMethod(this, &PipelineStage::drain, Qt::QueuedConnection);
+    }
+    return true;
+}
+
+void PipelineStage::drain()
+{
+    // Cleared first: a push racing with this drain schedules another one
+    m_scheduled.store(false);
+
+    // An item held back by a full downstream queue goes before anything new
+    if (m_blocked) {
+        if (!forward(*m_blocked)) {
+            m_retryTimer->start();
+            publishStats();
+            return;
+        }
+        m_blocked.reset();
+    }
+
+    PipelineItem item;
+    while (m_input.tryPop(item)) {
+        const qint64 startNs = ResultPipeline::monotonicNs();
+        const bool ok = m_handler(item);
+        const qint64 endNs = ResultPipeline::monotonicNs();
+        m_serviceTime.record((endNs - startNs) / 1e6);
+
+        if (!ok) {
+            m_failed++;
+            emit itemFailed(m_name, item.queueId);
+            continue;
+        }
+
+        m_processed++;
+        m_latency.record((endNs - item.submittedNs) / 1e6);
+        if (m_serviceTime.count() >= STATS_WINDOW) {
+            m_serviceTime.reset();
+            m_latency.reset();
+        }
+
+        if (!forward(item)) {
+            // Stop pulling work; our own queue filling up pushes back on the stage before us
+            m_backpressure++;
+            m_blocked = std::move(item);
+            m_retryTimer->start();
+            break;
+        }
+    }
+
+    publishStats();
+}
+
+QList<int> PipelineStage::flush(int timeoutMs)
+{
+    // The next stage is still running, so a held item gets through once it
+    // makes room
+    QElapsedTimer timer;
+    timer.start();
+    drain();
+    while (m_blocked && !timer.hasExpired(timeoutMs)) {
+        QThread::msleep(RETRY_INTERVAL_MS);
+        drain();
+    }
+    m_retryTimer->stop();
+
+    QList<int> lost;
+    if (m_blocked) {
+        lost.append(m_blocked->queueId);
+        m_blocked.reset();
+    }
+    PipelineItem item;
+    while (m_input.tryPop(item)) {
+        lost.append(item.queueId);
+    }
+    m_failed += lost.size();
+    publishStats();
+    return lost;
+}
+
+bool PipelineStage::forward(PipelineItem &item)
+{
+    return !m_next || m_next->push(item);
+}
+
+void PipelineStage::publishStats()
+{
+    QVariantMap stats;
+    stats["name"] = m_name;
+    stats["queueDepth"] = qulonglong(m_input.sizeApprox());
+    stats["capacity"] = qulonglong(m_input.capacity());
+    stats["processed"] = m_processed;
+    stats["failed"] = m_failed;
+    stats["backpressure"] = m_backpressure;
+    stats["blocked"] = m_blocked.has_value();
+    stats["serviceP50Ms"] = m_serviceTime.percentile(50);
+    stats["serviceP99Ms"] = m_serviceTime.percentile(99);
+    stats["latencyP99Ms"] = m_latency.percentile(99);
+    emit statsChanged(stats);
+}
+
+ResultPipeline::ResultPipeline(QObject *parent)
+    : QObject(parent)
+{
+}
+
+ResultPipeline::~ResultPipeline()
+{
+    stop();
+}
+
+void ResultPipeline::addStage(const QString &name, PipelineStage::Handler handler, std::size_t capacity)
+{
+    auto *stage = new PipelineStage(name, std::move(handler), capacity);
+    if (!m_stages.empty()) {
+        m_stages.back().stage->setNext(stage);
+    }
+
+    connect(stage, &PipelineStage::itemFailed, this, &ResultPipeline::itemFailed);
+    connect(stage, &PipelineStage::statsChanged, this, &ResultPipeline::onStageStatsChanged);
+
+    auto thread = std::make_unique<QThread>();
+    thread->setObjectName("Pipeline " + name);
+    stage->moveToThread(thread.get());
+    connect(thread.get(), &QThread::finished, stage, &QObject::deleteLater);
+    m_stages.push_back(Stage{stage, std::move(thread)});
+
+    m_stageStats.append(QVariantMap{{"name", name}, {"queueDepth", 0}, {"capacity", qulonglong(capacity)}});
+    emit stageStatsChanged();
+}
+
+void ResultPipeline::start()
+{
+    for (Stage &stage : m_stages) {
+        stage.thread->start();
+    }
+}
+
+void ResultPipeline::stop()
+{
+    // Upstream first, so whatever it still holds reaches a running stage
+    for (Stage &stage : m_stages) {
+        if (!stage.stage) {
+            continue;
+        }
+        if (stage.thread->isRunning()) {
+            QList<int> lost;
+            QMetaObject::invokeMethod(stage.stage, [pipelineStage = stage.stage]() {
+                return pipelineStage->flush(FLUSH_TIMEOUT_MS);
+            }, Qt::BlockingQueuedConnection, &lost);
+            // Emitted here: a queued report would not outlive the pipeline
+            const QString name = stage.stage->name();
+            for (const int queueId : std::as_const(lost)) {
+                qWarning() << "Result pipeline stopped with sample" << queueId << "held in" << name;
+                emit itemFailed(name, queueId);
+            }
+            stage.thread->quit();
+            stage.thread->wait(); // the stage is deleted as its thread finishes
+        } else {
+            delete stage.stage; // never started
+        }
+        stage.stage = nullptr;
+    }
+}
+
+bool ResultPipeline::submit(const PipelineItem &item)
+{
+    if (m_stages.empty() || !m_stages.front().stage) {
+        return false;
+    }
+    if (!m_stages.front().stage->push(item)) {
+        qWarning() << "Result pipeline full, rejected sample" << item.queueId;
+        return false;
+    }
+    return true;
+}
+
+qint64 ResultPipeline::monotonicNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void ResultPipeline::onStageStatsChanged(const QVariantMap &stats)
+{
+    const QString name = stats.value("name").toString();
+    for (int i = 0; i < m_stageStats.size(); ++i) {
+        if (m_stageStats.at(i).toMap().value("name").toString() == name) {
+            m_stageStats[i] = stats;
+            emit stageStatsChanged();
+            return;
+        }
+    }
+}
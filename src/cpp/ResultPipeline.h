@@ -0,0 +1,134 @@
+#ifndef RESULTPIPELINE_H
+#define RESULTPIPELINE_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QList>
+#include <QThread>
+#include <QVariantList>
+#include <QVariantMap>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "LatencyHistogram.h"
+#include "LockFreeQueue.h"
+
+class QTimer;
+
+struct PipelineItem {
+    int queueId = 0;
+    QVariantMap sampleData;
+    QVariantMap results;
+    QByteArray waveform; // encoded raw traces, may be empty
+    qint64 submittedNs = 0;
+};
+
+// One pipeline stage on its own thread. Pops items from its input queue,
+// runs the handler and pushes them to the next stage's input. When the
+// next stage is full the item is held and retried, so backpressure
+// travels upstream instead of growing a queue.
+class PipelineStage : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Runs on the stage thread; returning false drops the item
+    using Handler = std::function<bool(PipelineItem &item)>;
+
+    PipelineStage(const QString &name, Handler handler, std::size_t capacity, QObject *parent = nullptr);
+
+    QString name() const { return m_name; }
+    void setNext(PipelineStage *next) { m_next = next; }
+
+    // Producer side; called only from the upstream stage's thread. The item
+    // is copied, so a rejected item stays with the caller.
+    bool push(const PipelineItem &item);
+
+    // Drains until nothing is held back or timeoutMs passes. Returns the
+    // queue IDs of the items still held then, which are dropped; for
+    // stopping the pipeline, called on the stage thread.
+    QList<int> flush(int timeoutMs);
+
+public slots:
+    void drain();
+
+signals:
+    void itemFailed(const QString &stage, int queueId);
+    void statsChanged(const QVariantMap &stats);
+
+private:
+    bool forward(PipelineItem &item);
+    void publishStats();
+
+    QString m_name;
+    Handler m_handler;
+    SpscQueue<PipelineItem> m_input;
+    PipelineStage *m_next;
+    std::atomic<bool> m_scheduled;
+    QTimer *m_retryTimer;
+    std::optional<PipelineItem> m_blocked;
+
+    // Stage thread only
+    LatencyHistogram m_serviceTime;
+    LatencyHistogram m_latency; // from submission to leaving this stage
+    quint64 m_processed;
+    quint64 m_failed;
+    quint64 m_backpressure;
+
+    static const int RETRY_INTERVAL_MS = 5;
+    static const quint64 STATS_WINDOW = 1000; // items per percentile window
+};
+
+// Result pipeline: acquisition -> compute -> persist, one thread per stage,
+// connected by bounded SPSC queues. Stages are configured by the owner
+// before start(); items are submitted from one thread (the GUI thread).
+// Per-stage queue depth, backpressure and latency are reported in
+// stageStats.
+class ResultPipeline : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QVariantList stageStats READ stageStats NOTIFY stageStatsChanged)
+
+public:
+    explicit ResultPipeline(QObject *parent = nullptr);
+    ~ResultPipeline();
+
+    void addStage(const QString &name, PipelineStage::Handler handler, std::size_t capacity = DEFAULT_CAPACITY);
+    void start();
+    // Drains each stage in order and joins its thread; safe to call twice.
+    // Items a stage cannot hand on within FLUSH_TIMEOUT_MS are reported
+    // through itemFailed before the stage goes.
+    void stop();
+
+    // Returns false when the first stage is full
+    bool submit(const PipelineItem &item);
+
+    QVariantList stageStats() const { return m_stageStats; }
+
+    static qint64 monotonicNs();
+
+signals:
+    void itemFailed(const QString &stage, int queueId);
+    void stageStatsChanged();
+
+private slots:
+    void onStageStatsChanged(const QVariantMap &stats);
+
+private:
+    struct Stage {
+        PipelineStage *stage;
+        std::unique_ptr<QThread> thread;
+    };
+
+    std::vector<Stage> m_stages;
+    QVariantList m_stageStats;
+
+    static const std::size_t DEFAULT_CAPACITY = 256;
+    static const int FLUSH_TIMEOUT_MS = 5000;
+};
+
+#endif // RESULTPIPELINE_H
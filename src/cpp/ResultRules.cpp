@@ -0,0 +1,408 @@
+#include "ResultRules.h"
+#include "AcidBaseInterpreter.h"
+
+#include <QDateTime>
+#include <QMutex>
+#include <QStringList>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+namespace {
+using namespace ResultRules;
+
+const float NONE = std::numeric_limits<float>::quiet_NaN();
+const qint32 OPEN_MIN = std::numeric_limits<qint32>::min();
+const qint32 OPEN_MAX = std::numeric_limits<qint32>::max();
+const qint32 NEONATE_DAYS = 28;
+
+const Limits NO_LIMITS = {NONE, NONE, NONE, NONE};
+
+QMutex rangesMutex;
+std::shared_ptr<const RangeTable> installedRanges = std::make_shared<const RangeTable>();
+
+// More specific rules override less specific ones, limit by limit
+int specificity(const RangeRule &rule)
+{
+    return (rule.specimen != AnySpecimen) * 4 + (rule.sex != AnySex) * 2 +
+           (rule.minAgeDays != OPEN_MIN || rule.maxAgeDays != OPEN_MAX);
+}
+
+bool covers(const RangeRule &rule, qint32 ageDays)
+{
+    return rule.minAgeDays <= ageDays && ageDays < rule.maxAgeDays;
+}
+
+bool sameLimits(const Limits &a, const Limits &b)
+{
+    // Bitwise, so NaN equals NaN
+    return std::memcmp(&a, &b, sizeof(Limits)) == 0;
+}
+
+// The limits at one age: each one from the most specific rule that sets
+// it, the narrower age band winning a tie
+Limits resolve(const QList<const RangeRule *> &candidates, qint32 ageDays)
+{
+    Limits limits = NO_LIMITS;
+    float Limits::*const fields[] = {&Limits::low, &Limits::high, &Limits::criticalLow, &Limits::criticalHigh};
+    for (float Limits::*field : fields) {
+        const RangeRule *best = nullptr;
+        for (const RangeRule *rule : candidates) {
+            if (!covers(*rule, ageDays) || std::isnan(rule->limits.*field)) {
+                continue;
+            }
+            if (!best || specificity(*rule) > specificity(*best) ||
+                (specificity(*rule) == specificity(*best) &&
+                 qint64(rule->maxAgeDays) - rule->minAgeDays <= qint64(best->maxAgeDays) - best->minAgeDays)) {
+                best = rule;
+            }
+        }
+        if (best) {
+            limits.*field = best->limits.*field;
+        }
+    }
+    return limits;
+}
+
+QStringList fieldsOf(quint16 bits)
+{
+    QStringList fields;
+    for (int analyte = 0; analyte < ANALYTE_COUNT; ++analyte) {
+        if (bits & (1u << analyte)) {
+            fields.append(ANALYTE_FIELDS[analyte]);
+        }
+    }
+    return fields;
+}
+}
+
+namespace ResultRules {
+
+const char *const ANALYTE_FIELDS[ANALYTE_COUNT] = {
+    "pH", "pCO2", "pO2", "HCO3", "BE",
+    "Na", "K", "Cl", "Ca",
+    "Glucose", "Lactate"
+};
+
+Specimen specimenFromString(const QString &specimen)
+{
+    const QString name = specimen.trimmed().toLower();
+    if (name.startsWith("art")) {
+        return Arterial;
+    }
+    if (name.startsWith("ven") || name.startsWith("mixed")) {
+        return Venous;
+    }
+    if (name.startsWith("cap")) {
+        return Capillary;
+    }
+    return AnySpecimen;
+}
+
+const char *specimenName(Specimen specimen)
+{
+    switch (specimen) {
+    case Arterial: return "arterial";
+    case Venous: return "venous";
+    case Capillary: return "capillary";
+    default: return "";
+    }
+}
+
+Sex sexFromString(const QString &sex)
+{
+    const QString name = sex.trimmed().toUpper();
+    if (name.startsWith('M')) {
+        return Male;
+    }
+    if (name.startsWith('F')) {
+        return Female;
+    }
+    return AnySex;
+}
+
+const char *sexName(Sex sex)
+{
+    switch (sex) {
+    case Male: return "M";
+    case Female: return "F";
+    default: return "";
+    }
+}
+
+Demographics demographics(const QString &specimen, const QString &sex, const QVariant &ageDays)
+{
+    Demographics patient;
+    patient.specimen = specimenFromString(specimen);
+    if (patient.specimen == AnySpecimen) {
+        patient.specimen = Arterial;
+    }
+    patient.sex = sexFromString(sex);
+    if (ageDays.isValid() && !ageDays.isNull()) {
+        patient.ageDays = ageDays.toInt();
+    }
+    return patient;
+}
+
+Demographics demographics(const QVariantMap &result)
+{
+    return demographics(result.value("specimen").toString(), result.value("sex").toString(),
+                        result.value("ageDays"));
+}
+
+void addDemographics(QVariantMap &result, const QVariantMap &sampleData)
+{
+    const Demographics patient = demographics(sampleData.value("specimen").toString(),
+                                              sampleData.value("sex").toString(), QVariant());
+    result["specimen"] = specimenName(patient.specimen);
+    if (patient.sex != AnySex) {
+        result["sex"] = sexName(patient.sex);
+    }
+
+    const QDate birthDate = QDate::fromString(sampleData.value("birthDate").toString(), Qt::ISODate);
+    if (birthDate.isValid()) {
+        QDate collected = QDateTime::fromString(sampleData.value("timestamp").toString(), Qt::ISODate).date();
+        if (!collected.isValid()) {
+            collected = QDate::currentDate();
+        }
+        result["ageDays"] = qMax(qint64(0), birthDate.daysTo(collected));
+    }
+}
+
+QList<RangeRule> defaultRules()
+{
+    auto rule = [](Analyte analyte, Specimen specimen, float low, float high, float criticalLow, float criticalHigh,
+                   qint32 minAgeDays = OPEN_MIN, qint32 maxAgeDays = OPEN_MAX) {
+        RangeRule rule;
+        rule.analyte = analyte;
+        rule.specimen = specimen;
+        rule.minAgeDays = minAgeDays;
+        rule.maxAgeDays = maxAgeDays;
+        rule.limits = {low, high, criticalLow, criticalHigh};
+        return rule;
+    };
+
+    return {
+        // Critical limits hold for every specimen, except pO2
+        rule(PH, AnySpecimen, NONE, NONE, 7.20f, 7.60f),
+        rule(PCO2, AnySpecimen, NONE, NONE, 20.0f, 70.0f),
+        rule(PH, Arterial, 7.35f, 7.45f, NONE, NONE),
+        rule(PCO2, Arterial, 35.0f, 45.0f, NONE, NONE),
+        rule(PO2, Arterial, 80.0f, 100.0f, 40.0f, 1000.0f),
+        rule(HCO3, Arterial, 22.0f, 26.0f, NONE, NONE),
+        rule(BE, Arterial, -2.0f, 2.0f, NONE, NONE),
+        rule(PH, Venous, 7.31f, 7.41f, NONE, NONE),
+        rule(PCO2, Venous, 41.0f, 51.0f, NONE, NONE),
+        rule(PO2, Venous, 30.0f, 50.0f, NONE, NONE),
+        rule(HCO3, Venous, 23.0f, 29.0f, NONE, NONE),
+        rule(PH, Capillary, 7.35f, 7.45f, NONE, NONE),
+        rule(PCO2, Capillary, 35.0f, 45.0f, NONE, NONE),
+        rule(PO2, Capillary, 60.0f, 80.0f, NONE, NONE),
+        rule(Na, AnySpecimen, 135.0f, 145.0f, 120.0f, 160.0f),
+        rule(K, AnySpecimen, 3.5f, 5.1f, 2.8f, 6.5f),
+        rule(Cl, AnySpecimen, 98.0f, 107.0f, NONE, NONE),
+        rule(Ca, AnySpecimen, 2.15f, 2.55f, 1.5f, 3.2f),
+        rule(Glucose, AnySpecimen, 70.0f, 99.0f, 40.0f, 450.0f),
+        rule(Lactate, AnySpecimen, 0.5f, 2.2f, 0.0f, 4.0f),
+        // Neonates
+        rule(PO2, Arterial, 50.0f, 70.0f, NONE, NONE, 0, NEONATE_DAYS),
+        rule(Glucose, AnySpecimen, 40.0f, 90.0f, 30.0f, NONE, 0, NEONATE_DAYS),
+        rule(K, AnySpecimen, 3.7f, 5.9f, NONE, 7.0f, 0, NEONATE_DAYS),
+    };
+}
+
+RangeTable::RangeTable()
+    : m_revision(0)
+    , m_ruleCount(0)
+{
+}
+
+RangeTable::RangeTable(const QList<RangeRule> &rules, int revision)
+    : m_revision(revision)
+    , m_ruleCount(int(rules.size()))
+{
+    QList<const RangeRule *> candidates;
+    QList<qint32> boundaries;
+    for (int analyte = 0; analyte < ANALYTE_COUNT; ++analyte) {
+        for (int specimen = 0; specimen < SPECIMEN_COUNT; ++specimen) {
+            for (int sex = 0; sex < SEX_COUNT; ++sex) {
+                candidates.clear();
+                boundaries = {OPEN_MIN};
+                for (const RangeRule &rule : rules) {
+                    if (rule.analyte == analyte &&
+                        (rule.specimen == AnySpecimen || rule.specimen == specimen) &&
+                        (rule.sex == AnySex || rule.sex == sex)) {
+                        candidates.append(&rule);
+                        boundaries << rule.minAgeDays << rule.maxAgeDays;
+                    }
+                }
+
+                Slice &slice = m_slices[sliceIndex(Analyte(analyte), Specimen(specimen), Sex(sex))];
+                slice.begin = quint32(m_limits.size());
+                if (!candidates.isEmpty()) {
+                    // One interval per distinct bound, merged where nothing changes
+                    std::sort(boundaries.begin(), boundaries.end());
+                    boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+                    for (const qint32 start : std::as_const(boundaries)) {
+                        if (start == OPEN_MAX) {
+                            break;
+                        }
+                        const Limits limits = resolve(candidates, start);
+                        if (m_limits.size() > slice.begin && sameLimits(m_limits.back(), limits)) {
+                            continue;
+                        }
+                        m_ageStarts.push_back(start);
+                        m_limits.push_back(limits);
+                    }
+                }
+                slice.end = quint32(m_limits.size());
+            }
+        }
+    }
+}
+
+const Limits &RangeTable::lookup(Analyte analyte, const Demographics &patient) const
+{
+    const Slice &slice = m_slices[sliceIndex(analyte, patient.specimen, patient.sex)];
+    if (slice.begin == slice.end) {
+        return NO_LIMITS;
+    }
+    // Every slice starts at the open lower bound, so this never lands before it
+    const auto first = m_ageStarts.begin() + slice.begin;
+    const auto it = std::upper_bound(first, m_ageStarts.begin() + slice.end, patient.ageDays);
+    return m_limits[(it - m_ageStarts.begin()) - 1];
+}
+
+std::shared_ptr<const RangeTable> ranges()
+{
+    QMutexLocker locker(&rangesMutex);
+    return installedRanges;
+}
+
+void install(std::shared_ptr<const RangeTable> table)
+{
+    QMutexLocker locker(&rangesMutex);
+    installedRanges = std::move(table);
+}
+
+int ruleVersion()
+{
+    return ruleVersion(*ranges());
+}
+
+void ResultColumns::clear()
+{
+    ids.clear();
+    for (QList<float> &column : values) {
+        column.clear();
+    }
+    patients.clear();
+}
+
+void FlagColumns::resize(qsizetype rows)
+{
+    acidBase.resize(rows);
+    critical.resize(rows);
+    low.resize(rows);
+    high.resize(rows);
+}
+
+FlagOutput output(FlagColumns &flags)
+{
+    return {flags.acidBase.data(), flags.critical.data(), flags.low.data(), flags.high.data()};
+}
+
+void evaluate(const RangeTable &table, const ResultColumns &columns, qsizetype begin, qsizetype end,
+              const FlagOutput &out)
+{
+    const qsizetype count = end - begin;
+    const AcidBaseInterpreter::Batch batch = {
+        columns.values[PH].constData() + begin,
+        columns.values[PCO2].constData() + begin,
+        columns.values[PO2].constData() + begin,
+        columns.values[HCO3].constData() + begin,
+        columns.values[BE].constData() + begin
+    };
+    AcidBaseInterpreter::classifyBatch(batch, out.acidBase + begin, count);
+
+    quint16 *critical = out.critical + begin;
+    quint16 *low = out.low + begin;
+    quint16 *high = out.high + begin;
+    std::fill(critical, critical + count, quint16(0));
+    std::fill(low, low + count, quint16(0));
+    std::fill(high, high + count, quint16(0));
+
+    // One pass per analyte; the compares are branch-free, and a NaN value
+    // or limit never flags
+    const Demographics *patients = columns.patients.constData() + begin;
+    for (int analyte = 0; analyte < ANALYTE_COUNT; ++analyte) {
+        const float *v = columns.values[analyte].constData() + begin;
+        const quint16 bit = quint16(1u << analyte);
+        for (qsizetype i = 0; i < count; ++i) {
+            const Limits &limits = table.lookup(Analyte(analyte), patients[i]);
+            critical[i] |= quint16(((v[i] < limits.criticalLow) | (v[i] > limits.criticalHigh)) * bit);
+            low[i] |= quint16((v[i] < limits.low) * bit);
+            high[i] |= quint16((v[i] > limits.high) * bit);
+        }
+    }
+}
+
+Flags evaluate(const RangeTable &table, const QVariantMap &result)
+{
+    float values[ANALYTE_COUNT];
+    for (int analyte = 0; analyte < ANALYTE_COUNT; ++analyte) {
+        const QVariant value = result.value(ANALYTE_FIELDS[analyte]);
+        values[analyte] = value.isValid() && !value.isNull() ? value.toFloat() : NONE;
+    }
+    const Demographics patient = demographics(result);
+
+    Flags flags;
+    flags.acidBase = AcidBaseInterpreter::detail::classify(values[PH], values[PCO2], values[PO2],
+                                                           values[HCO3], values[BE]);
+    for (int analyte = 0; analyte < ANALYTE_COUNT; ++analyte) {
+        const Limits &limits = table.lookup(Analyte(analyte), patient);
+        const float v = values[analyte];
+        const quint16 bit = quint16(1u << analyte);
+        if (v < limits.criticalLow || v > limits.criticalHigh) {
+            flags.critical |= bit;
+        }
+        if (v < limits.low) {
+            flags.low |= bit;
+        }
+        if (v > limits.high) {
+            flags.high |= bit;
+        }
+    }
+    return flags;
+}
+
+void annotate(QVariantMap &result, const Flags &flags, int ruleVersion)
+{
+    result["critical"] = flags.critical != 0;
+    result["criticalFields"] = fieldsOf(flags.critical);
+    result["lowFields"] = fieldsOf(flags.low);
+    result["highFields"] = fieldsOf(flags.high);
+    result["criticalFlags"] = int(flags.critical);
+    result["lowFlags"] = int(flags.low);
+    result["highFlags"] = int(flags.high);
+    result["acidBaseFlags"] = int(flags.acidBase);
+    result["ruleVersion"] = ruleVersion;
+
+    using namespace AcidBaseInterpreter;
+    if (flags.acidBase & Unclassified) {
+        result.remove("interpretation");
+    } else {
+        result["interpretation"] = QString::fromLatin1(primaryName(primary(flags.acidBase))) +
+                                   QLatin1String(compensationName(compensation(flags.acidBase)));
+    }
+}
+
+void apply(QVariantMap &result)
+{
+    const std::shared_ptr<const RangeTable> table = ranges();
+    annotate(result, evaluate(*table, result), ruleVersion(*table));
+}
+
+} // namespace ResultRules
@@ -0,0 +1,177 @@
+#ifndef RESULTRULES_H
+#define RESULTRULES_H
+
+#include <QList>
+#include <QVariantMap>
+
+#include <array>
+#include <limits>
+#include <memory>
+#include <vector>
+
+// The rule set that flags a result: reference ranges and critical (panic)
+// limits by patient demographics, and the acid-base interpretation. Live
+// results are flagged with it as they are computed, and stored results are
+// re-flagged in bulk when it changes.
+namespace ResultRules {
+
+// Bump whenever the evaluation itself changes; stored results flagged
+// under an older ruleVersion() are re-flagged in the background
+const int RULE_VERSION = 2;
+
+enum Analyte {
+    PH, PCO2, PO2, HCO3, BE,
+    Na, K, Cl, Ca,
+    Glucose, Lactate,
+    ANALYTE_COUNT
+};
+
+// Result map keys, which are also the results table columns
+extern const char *const ANALYTE_FIELDS[ANALYTE_COUNT];
+
+// Any* matches every patient in a rule, and means unknown in a result
+enum Specimen : quint8 { AnySpecimen, Arterial, Venous, Capillary, SPECIMEN_COUNT };
+enum Sex : quint8 { AnySex, Male, Female, SEX_COUNT };
+
+Specimen specimenFromString(const QString &specimen);
+const char *specimenName(Specimen specimen);
+// HL7 administrative sex (M, F) or the spelled-out word
+Sex sexFromString(const QString &sex);
+const char *sexName(Sex sex);
+
+struct Demographics {
+    Specimen specimen = AnySpecimen;
+    Sex sex = AnySex;
+    qint32 ageDays = -1; // unknown
+};
+
+// Samples of unknown specimen type are taken as arterial, which is what
+// the analyzer is set up for
+Demographics demographics(const QString &specimen, const QString &sex, const QVariant &ageDays);
+Demographics demographics(const QVariantMap &result);
+// Copies specimen and sex from a sample's data into its result, and the
+// patient's age in days at collection from the birth date
+void addDemographics(QVariantMap &result, const QVariantMap &sampleData);
+
+// A missing limit is NaN, which never flags
+struct Limits {
+    float low;
+    float high;
+    float criticalLow;
+    float criticalHigh;
+};
+
+// One row of reference_ranges. Ages are [minAgeDays, maxAgeDays) and a
+// missing bound is open.
+struct RangeRule {
+    Analyte analyte;
+    Specimen specimen = AnySpecimen;
+    Sex sex = AnySex;
+    qint32 minAgeDays = std::numeric_limits<qint32>::min();
+    qint32 maxAgeDays = std::numeric_limits<qint32>::max();
+    Limits limits;
+};
+
+// The ranges a new database starts with
+QList<RangeRule> defaultRules();
+
+// The rules compiled into a flat decision table: one slice of disjoint
+// age intervals per analyte, specimen and sex, each holding the limits of
+// the most specific rules that cover it. A lookup is an index and a short
+// binary search, with no allocation.
+class RangeTable
+{
+public:
+    RangeTable();
+    RangeTable(const QList<RangeRule> &rules, int revision);
+
+    // Revision of the stored range set it was compiled from
+    int revision() const { return m_revision; }
+    int ruleCount() const { return m_ruleCount; }
+
+    const Limits &lookup(Analyte analyte, const Demographics &patient) const;
+
+private:
+    struct Slice {
+        quint32 begin = 0;
+        quint32 end = 0;
+    };
+
+    static int sliceIndex(Analyte analyte, Specimen specimen, Sex sex)
+    {
+        return (int(analyte) * SPECIMEN_COUNT + specimen) * SEX_COUNT + sex;
+    }
+
+    std::array<Slice, int(ANALYTE_COUNT) * SPECIMEN_COUNT * SEX_COUNT> m_slices;
+    std::vector<qint32> m_ageStarts;
+    std::vector<Limits> m_limits;
+    int m_revision;
+    int m_ruleCount;
+};
+
+// The table results are flagged with; replaced when the ranges are
+// reloaded. Thread-safe.
+std::shared_ptr<const RangeTable> ranges();
+void install(std::shared_ptr<const RangeTable> table);
+
+// Stored with each result, so a change to either the code or the ranges
+// triggers re-flagging
+inline int ruleVersion(const RangeTable &table) { return (RULE_VERSION << 20) | table.revision(); }
+int ruleVersion();
+
+struct Flags {
+    quint16 acidBase = 0; // AcidBaseInterpreter::Flags
+    quint16 critical = 0; // bit per Analyte outside its critical limits
+    quint16 low = 0;      // bit per Analyte below its reference range
+    quint16 high = 0;     // bit per Analyte above its reference range
+};
+
+// A chunk of stored results in columns; missing values are NaN
+struct ResultColumns {
+    QList<qint64> ids;
+    std::array<QList<float>, ANALYTE_COUNT> values;
+    QList<Demographics> patients;
+
+    qsizetype size() const { return ids.size(); }
+    void clear();
+};
+
+// Flags of a chunk, one column per kind
+struct FlagColumns {
+    QList<quint16> acidBase;
+    QList<quint16> critical;
+    QList<quint16> low;
+    QList<quint16> high;
+
+    void resize(qsizetype rows);
+};
+
+// Where one evaluation writes; taken from FlagColumns before the rows are
+// split between threads
+struct FlagOutput {
+    quint16 *acidBase;
+    quint16 *critical;
+    quint16 *low;
+    quint16 *high;
+};
+
+FlagOutput output(FlagColumns &flags);
+
+// Flags rows [begin, end) of a chunk into out, indexed from begin. Safe to
+// run on disjoint ranges from several threads.
+void evaluate(const RangeTable &table, const ResultColumns &columns, qsizetype begin, qsizetype end,
+              const FlagOutput &out);
+
+Flags evaluate(const RangeTable &table, const QVariantMap &result);
+
+// Stores the flags in a result map: acidBaseFlags, criticalFlags, lowFlags,
+// highFlags and ruleVersion, plus the critical, criticalFields, lowFields,
+// highFields and interpretation keys the UI and the HL7/FHIR encoders read
+void annotate(QVariantMap &result, const Flags &flags, int ruleVersion);
+
+// Flags a result with the installed table
+void apply(QVariantMap &result);
+
+} // namespace ResultRules
+
+#endif // RESULTRULES_H
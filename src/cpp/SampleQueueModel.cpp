@@ -0,0 +1,264 @@
+#include "SampleQueueModel.h"
+
+SampleQueueModel::SampleQueueModel(QObject *parent)
+    : QAbstractListModel(parent)
+    , m_nextQueueId(1)
+{
+}
+
+int SampleQueueModel::rowCount(const QModelIndex &) const
+{
+    return m_samples.size();
+}
+
+QVariant SampleQueueModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_samples.size())
+        return QVariant();
+
+    const Sample &sample = m_samples.at(index.row());
+
+    switch (role) {
+    case QueueIdRole:
+        return sample.queueId;
+    case SampleIdRole:
+        return sample.sampleData.value("sampleId");
+    case PatientIdRole:
+        return sample.sampleData.value("patientId");
+    case StateRole:
+        return sample.state;
+    case StateNameRole:
+        return stateName(sample.state);
+    case ProgressRole:
+        return sample.progress;
+    case QueuedAtRole:
+        return sample.queuedAt;
+    case ErrorRole:
+        return sample.error;
+    case CriticalRole:
+        return sample.critical;
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> SampleQueueModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles[QueueIdRole] = "queueId";
+    roles[SampleIdRole] = "sampleId";
+    roles[PatientIdRole] = "patientId";
+    roles[StateRole] = "state";
+    roles[StateNameRole] = "stateName";
+    roles[ProgressRole] = "progress";
+    roles[QueuedAtRole] = "queuedAt";
+    roles[ErrorRole] = "error";
+    roles[CriticalRole] = "critical";
+    return roles;
+}
+
+int SampleQueueModel::pendingCount() const
+{
+    int pending = 0;
+    for (const Sample &sample : m_samples) {
+        if (!isFinished(sample.state)) {
+            pending++;
+        }
+    }
+    return pending;
+}
+
+int SampleQueueModel::enqueue(const QVariantMap &sampleData)
+{
+    Sample sample;
+    sample.queueId = m_nextQueueId++;
+    sample.sampleData = sampleData;
+    sample.state = Queued;
+    sample.progress = 0;
+    sample.critical = false;
+    sample.queuedAt = QDateTime::currentDateTime();
+
+    beginInsertRows(QModelIndex(), m_samples.size(), m_samples.size());
+    m_samples.append(sample);
+    endInsertRows();
+
+    emit countChanged();
+    emit pendingCountChanged();
+    return sample.queueId;
+}
+
+int SampleQueueModel::nextQueued() const
+{
+    for (const Sample &sample : m_samples) {
+        if (sample.state == Queued) {
+            return sample.queueId;
+        }
+    }
+    return 0;
+}
+
+QVariantMap SampleQueueModel::sampleData(int queueId) const
+{
+    const int row = rowOf(queueId);
+    return row >= 0 ? m_samples.at(row).sampleData : QVariantMap();
+}
+
+SampleQueueModel::State SampleQueueModel::state(int queueId) const
+{
+    const int row = rowOf(queueId);
+    return row >= 0 ? m_samples.at(row).state : Cancelled;
+}
+
+void SampleQueueModel::setState(int queueId, State state, const QString &error)
+{
+    const int row = rowOf(queueId);
+    if (row < 0) {
+        return;
+    }
+
+    Sample &sample = m_samples[row];
+    const bool wasFinished = isFinished(sample.state);
+    sample.state = state;
+    sample.error = error;
+    if (state == Processing || state == Completed) {
+        sample.progress = 100;
+    }
+
+    const QModelIndex modelIndex = index(row);
+    emit dataChanged(modelIndex, modelIndex, {StateRole, StateNameRole, ProgressRole, ErrorRole});
+
+    if (wasFinished != isFinished(state)) {
+        emit pendingCountChanged();
+        trimFinished();
+    }
+}
+
+void SampleQueueModel::setProgress(int queueId, int progress)
+{
+    const int row = rowOf(queueId);
+    if (row < 0 || m_samples.at(row).progress == progress) {
+        return;
+    }
+
+    m_samples[row].progress = progress;
+    const QModelIndex modelIndex = index(row);
+    emit dataChanged(modelIndex, modelIndex, {ProgressRole});
+}
+
+void SampleQueueModel::setResults(int queueId, const QVariantMap &results)
+{
+    const int row = rowOf(queueId);
+    if (row < 0) {
+        return;
+    }
+
+    m_samples[row].critical = results.value("critical").toBool();
+    const QModelIndex modelIndex = index(row);
+    emit dataChanged(modelIndex, modelIndex, {CriticalRole});
+}
+
+bool SampleQueueModel::cancel(int queueId)
+{
+    // Samples already measured are past the point of no return
+    const State current = state(queueId);
+    if (current != Queued && current != Measuring) {
+        return false;
+    }
+
+    setState(queueId, Cancelled);
+    emit sampleCancelled(queueId);
+    return true;
+}
+
+void SampleQueueModel::cancelAll()
+{
+    // Queued samples first, so cancelling the measuring one does not start the next
+    QList<int> pending;
+    for (const Sample &sample : m_samples) {
+        if (sample.state == Queued) {
+            pending.append(sample.queueId);
+        }
+    }
+    for (const Sample &sample : m_samples) {
+        if (sample.state == Measuring) {
+            pending.append(sample.queueId);
+        }
+    }
+    for (int queueId : pending) {
+        cancel(queueId);
+    }
+}
+
+void SampleQueueModel::clearFinished()
+{
+    for (int row = m_samples.size() - 1; row >= 0; --row) {
+        if (isFinished(m_samples.at(row).state)) {
+            beginRemoveRows(QModelIndex(), row, row);
+            m_samples.removeAt(row);
+            endRemoveRows();
+        }
+    }
+    emit countChanged();
+}
+
+int SampleQueueModel::rowOf(int queueId) const
+{
+    for (int row = 0; row < m_samples.size(); ++row) {
+        if (m_samples.at(row).queueId == queueId) {
+            return row;
+        }
+    }
+    return -1;
+}
+
+void SampleQueueModel::trimFinished()
+{
+    int finished = 0;
+    for (const Sample &sample : m_samples) {
+        if (isFinished(sample.state)) {
+            finished++;
+        }
+    }
+
+    // Oldest finished samples go first
+    int row = 0;
+    bool removed = false;
+    while (finished > MAX_FINISHED && row < m_samples.size()) {
+        if (isFinished(m_samples.at(row).state)) {
+            beginRemoveRows(QModelIndex(), row, row);
+            m_samples.removeAt(row);
+            endRemoveRows();
+            finished--;
+            removed = true;
+        } else {
+            row++;
+        }
+    }
+    if (removed) {
+        emit countChanged();
+    }
+}
+
+bool SampleQueueModel::isFinished(State state)
+{
+    return state == Completed || state == Failed || state == Cancelled;
+}
+
+QString SampleQueueModel::stateName(State state)
+{
+    switch (state) {
+    case Queued:
+        return "Queued";
+    case Measuring:
+        return "Measuring";
+    case Processing:
+        return "Processing";
+    case Completed:
+        return "Completed";
+    case Failed:
+        return "Failed";
+    case Cancelled:
+        return "Cancelled";
+    }
+    return QString();
+}
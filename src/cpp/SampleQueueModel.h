@@ -0,0 +1,92 @@
+#ifndef SAMPLEQUEUEMODEL_H
+#define SAMPLEQUEUEMODEL_H
+
+#include <QAbstractListModel>
+#include <QDateTime>
+#include <QVariantMap>
+
+// Samples loaded on the analyzer, in arrival order. Each sample gets a
+// queue ID and moves Queued -> Measuring -> Processing -> Completed (or
+// Failed / Cancelled). Only one sample is measured at a time, but the
+// previous one may still be processing. Finished samples are kept for
+// display up to a fixed limit.
+class SampleQueueModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+    Q_PROPERTY(int pendingCount READ pendingCount NOTIFY pendingCountChanged)
+
+public:
+    enum State {
+        Queued,
+        Measuring,
+        Processing,
+        Completed,
+        Failed,
+        Cancelled
+    };
+    Q_ENUM(State)
+
+    enum Roles {
+        QueueIdRole = Qt::UserRole + 1,
+        SampleIdRole,
+        PatientIdRole,
+        StateRole,
+        StateNameRole,
+        ProgressRole,
+        QueuedAtRole,
+        ErrorRole,
+        CriticalRole
+    };
+
+    explicit SampleQueueModel(QObject *parent = nullptr);
+
+    // QAbstractListModel interface
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    int count() const { return m_samples.size(); }
+    int pendingCount() const;
+
+    int enqueue(const QVariantMap &sampleData);
+    int nextQueued() const;
+    QVariantMap sampleData(int queueId) const;
+    State state(int queueId) const;
+    void setState(int queueId, State state, const QString &error = QString());
+    void setProgress(int queueId, int progress);
+    void setResults(int queueId, const QVariantMap &results);
+
+public slots:
+    Q_INVOKABLE bool cancel(int queueId);
+    Q_INVOKABLE void cancelAll();
+    Q_INVOKABLE void clearFinished();
+
+signals:
+    void countChanged();
+    void pendingCountChanged();
+    void sampleCancelled(int queueId);
+
+private:
+    struct Sample {
+        int queueId;
+        QVariantMap sampleData;
+        State state;
+        int progress;
+        QString error;
+        bool critical;
+        QDateTime queuedAt;
+    };
+
+    int rowOf(int queueId) const;
+    void trimFinished();
+    static bool isFinished(State state);
+    static QString stateName(State state);
+
+    QList<Sample> m_samples;
+    int m_nextQueueId;
+
+    static const int MAX_FINISHED = 50;
+};
+
+#endif // SAMPLEQUEUEMODEL_H
@@ -0,0 +1,254 @@
+#include "SensorDevice.h"
+#include "SignalProcessor.h"
+
+#include <QDebug>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include <chrono>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+SensorDevice::SensorDevice(SignalProcessor *processor, QObject *parent)
+    : QObject(parent)
+    , m_fd(-1)
+    , m_notifier(nullptr)
+    , m_statsTimer(new QTimer(this))
+    , m_processor(processor)
+    , m_lastSequence(0)
+    , m_haveSequence(false)
+    , m_frames(0)
+    , m_bytes(0)
+    , m_droppedFrames(0)
+    , m_lostSamples(0)
+{
+    m_statsTimer->setInterval(STATS_INTERVAL_MS);
+    connect(m_statsTimer, &QTimer::timeout, this, &SensorDevice::publishStats);
+}
+
+SensorDevice::~SensorDevice()
+{
+    // The signal processor may already be gone at shutdown
+    closeDescriptor();
+}
+
+qint64 SensorDevice::monotonicUs()
+{
+    // Same clock as the simulator's deviceTimeUs when both run on one host
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool SensorDevice::open(const QString &path)
+{
+    close();
+
+#ifdef Q_OS_UNIX
+    m_fd = ::open(path.toLocal8Bit().constData(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (m_fd < 0) {
+        const QString error = QString("Failed to open sensor device %1: %2").arg(path, QString::fromLocal8Bit(std::strerror(errno)));
+        qWarning() << error;
+        emit deviceError(error);
+        return false;
+    }
+
+    // Raw 8-bit stream: no echo, no line discipline, no flow control
+    termios tio;
+    if (::tcgetattr(m_fd, &tio) == 0) {
+        ::cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cc[VMIN] = 0;
+        tio.c_cc[VTIME] = 0;
+#ifdef B921600
+        ::cfsetspeed(&tio, B921600);
+#endif
+        ::tcsetattr(m_fd, TCSANOW, &tio);
+    }
+    ::tcflush(m_fd, TCIOFLUSH);
+
+    m_path = path;
+    m_haveSequence = false;
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &SensorDevice::onReadable);
+    m_statsTimer->start();
+
+    qDebug() << "Sensor device opened:" << path;
+    return true;
+#else
+    const QString error = QString("Sensor device %1: serial links are only supported on Unix").arg(path);
+    qWarning() << error;
+    emit deviceError(error);
+    return false;
+#endif
+}
+
+void SensorDevice::close()
+{
+    if (m_fd < 0) {
+        return;
+    }
+
+    closeDescriptor();
+    QMetaObject::invokeMethod(m_processor, &SignalProcessor::resetLink, Qt::QueuedConnection);
+}
+
+void SensorDevice::closeDescriptor()
+{
+    if (m_fd < 0) {
+        return;
+    }
+
+    delete m_notifier;
+    m_notifier = nullptr;
+    m_statsTimer->stop();
+#ifdef Q_OS_UNIX
+    ::close(m_fd);
+#endif
+    m_fd = -1;
+    publishStats();
+}
+
+void SensorDevice::startMeasurement(int measurementId)
+{
+    QByteArray payload(4, Qt::Uninitialized);
+    qToLittleEndian<quint32>(quint32(measurementId), payload.data());
+    writeFrame(SensorProtocol::StartMeasurement, payload);
+}
+
+void SensorDevice::stopMeasurement()
+{
+    writeFrame(SensorProtocol::StopMeasurement);
+}
+
+void SensorDevice::onReadable()
+{
+#ifdef Q_OS_UNIX
+    const qint64 startUs = monotonicUs();
+
+    // Drain everything the driver has buffered, then parse once
+    char chunk[READ_CHUNK];
+    for (;;) {
+        const ssize_t n = ::read(m_fd, chunk, sizeof(chunk));
+        if (n > 0) {
+            m_parser.append(chunk, n);
+            m_bytes += quint64(n);
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        // EOF, or EIO once the other end of a pty has gone away
+        const QString error = QString("Sensor link %1 closed").arg(m_path);
+        qWarning() << error;
+        close();
+        emit deviceError(error);
+        return;
+    }
+
+    SensorProtocol::Frame frame;
+    while (m_parser.next(frame)) {
+        if (frame.type == SensorProtocol::Samples) {
+            handleSamples(frame.payload);
+        }
+    }
+
+    m_readTime.record((monotonicUs() - startUs) / 1000.0);
+#endif
+}
+
+void SensorDevice::handleSamples(const QByteArray &payload)
+{
+    if (payload.size() < SensorProtocol::SAMPLES_HEADER_SIZE) {
+        return;
+    }
+
+    const char *p = payload.constData();
+    const quint32 sequence = qFromLittleEndian<quint32>(p);
+    const qint64 deviceTimeUs = qint64(qFromLittleEndian<quint64>(p + 4));
+    const int channelCount = quint8(p[16]);
+    const int sampleCount = qFromLittleEndian<quint16>(p + 17);
+    if (channelCount == 0 || sampleCount == 0 ||
+        payload.size() < SensorProtocol::SAMPLES_HEADER_SIZE + channelCount * sampleCount * 4) {
+        return;
+    }
+
+    // Sequence gaps are frames the board dropped or the link lost
+    if (m_haveSequence && sequence != m_lastSequence + 1) {
+        m_droppedFrames += quint32(sequence - m_lastSequence - 1);
+    }
+    m_lastSequence = sequence;
+    m_haveSequence = true;
+    m_frames++;
+
+    // Deinterleave into blocks for the signal processor
+    const quint32 measurementId = qFromLittleEndian<quint32>(p + 12);
+    const char *sample = p + SensorProtocol::SAMPLES_HEADER_SIZE;
+    const int channels = qMin(channelCount, int(SensorProtocol::CHANNEL_COUNT));
+    SampleBlock block;
+    block.measurementId = measurementId;
+    block.deviceTimeUs = deviceTimeUs;
+    block.channelCount = channels;
+    for (int first = 0; first < sampleCount; first += SampleBlock::MAX_SAMPLES) {
+        block.count = qMin(int(SampleBlock::MAX_SAMPLES), sampleCount - first);
+        for (int i = 0; i < block.count; ++i) {
+            for (int channel = 0; channel < channels; ++channel) {
+                block.millivolts[channel][i] = qFromLittleEndian<qint32>(sample + channel * 4) / 1000.0f;
+            }
+            sample += channelCount * 4;
+        }
+        if (!m_processor->ingest(block)) {
+            m_lostSamples += quint64(block.count);
+        }
+    }
+
+    m_transportLatency.record((monotonicUs() - deviceTimeUs) / 1000.0);
+}
+
+bool SensorDevice::writeFrame(quint8 type, const QByteArray &payload)
+{
+    if (m_fd < 0) {
+        return false;
+    }
+
+    QByteArray frame;
+    SensorProtocol::appendFrame(frame, type, payload.constData(), payload.size());
+#ifdef Q_OS_UNIX
+    // Commands are a few bytes; a short write means the link is wedged
+    if (::write(m_fd, frame.constData(), size_t(frame.size())) != frame.size()) {
+        qWarning() << "Failed to write sensor command" << type;
+        return false;
+    }
+#endif
+    return true;
+}
+
+void SensorDevice::publishStats()
+{
+    QVariantMap stats;
+    stats["path"] = m_path;
+    stats["open"] = m_fd >= 0;
+    stats["frames"] = m_frames;
+    stats["bytes"] = m_bytes;
+    stats["droppedFrames"] = m_droppedFrames;
+    stats["lostSamples"] = m_lostSamples;
+    stats["crcErrors"] = m_parser.crcErrors();
+    stats["discardedBytes"] = m_parser.discardedBytes();
+    stats["readP99Ms"] = m_readTime.percentile(99);
+    stats["transportP50Ms"] = m_transportLatency.percentile(50);
+    stats["transportP99Ms"] = m_transportLatency.percentile(99);
+    emit statsChanged(stats);
+
+    // Percentiles cover the last interval only
+    m_readTime.reset();
+    m_transportLatency.reset();
+}
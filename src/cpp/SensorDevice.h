@@ -0,0 +1,68 @@
+#ifndef SENSORDEVICE_H
+#define SENSORDEVICE_H
+
+#include <QObject>
+#include <QVariantMap>
+
+#include "LatencyHistogram.h"
+#include "SensorProtocol.h"
+
+class QSocketNotifier;
+class QTimer;
+class SignalProcessor;
+
+// Sensor board link over a serial-style byte stream (a tty, or the pty of
+// the bundled simulator). Lives on its own thread: reads are driven by a
+// QSocketNotifier on the non-blocking descriptor and frames are parsed as
+// they arrive. Samples are handed to the SignalProcessor's ring and never
+// wait on any other thread.
+class SensorDevice : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SensorDevice(SignalProcessor *processor, QObject *parent = nullptr);
+    ~SensorDevice();
+
+    static qint64 monotonicUs();
+
+public slots:
+    bool open(const QString &path);
+    void close();
+    void startMeasurement(int measurementId);
+    void stopMeasurement();
+
+signals:
+    void deviceError(const QString &error);
+    void statsChanged(const QVariantMap &stats);
+
+private slots:
+    void onReadable();
+    void publishStats();
+
+private:
+    void closeDescriptor();
+    void handleSamples(const QByteArray &payload);
+    bool writeFrame(quint8 type, const QByteArray &payload = QByteArray());
+
+    int m_fd;
+    QString m_path;
+    QSocketNotifier *m_notifier;
+    QTimer *m_statsTimer;
+    SensorProtocol::FrameParser m_parser;
+    SignalProcessor *m_processor;
+
+    quint32 m_lastSequence;
+    bool m_haveSequence;
+    quint64 m_frames;
+    quint64 m_bytes;
+    quint64 m_droppedFrames;
+    quint64 m_lostSamples; // signal processor ring full
+    LatencyHistogram m_readTime;         // one notifier wake-up: read and parse
+    LatencyHistogram m_transportLatency; // device timestamp to parsed frame
+
+    static const int READ_CHUNK = 4096;
+    static const int STATS_INTERVAL_MS = 1000;
+};
+
+#endif // SENSORDEVICE_H
@@ -0,0 +1,184 @@
+#ifndef SENSORPROTOCOL_H
+#define SENSORPROTOCOL_H
+
+#include <QByteArray>
+#include <QtEndian>
+
+#include <cmath>
+#include <cstring>
+
+// Framing shared by SensorDevice and the sensor board simulator.
+//
+//   0xA5 0x5A | type (u8) | length (u16 LE) | payload | CRC-16 (u16 LE)
+//
+// The CRC (CCITT, init 0xFFFF) covers type, length and payload. All
+// payload integers are little-endian.
+namespace SensorProtocol {
+
+const quint8 SYNC0 = 0xA5;
+const quint8 SYNC1 = 0x5A;
+const int HEADER_SIZE = 5;
+const int TRAILER_SIZE = 2;
+const int MAX_PAYLOAD = 16384;
+
+enum FrameType : quint8 {
+    // Board -> host: sequence (u32), deviceTimeUs (u64, CLOCK_MONOTONIC),
+    // measurementId (u32, 0 when idle), channelCount (u8), sampleCount (u16),
+    // then sampleCount x channelCount electrode signals in microvolts (i32),
+    // interleaved by sample
+    Samples = 0x01,
+    // Host -> board: measurementId (u32); the sample is drawn into the sensor
+    StartMeasurement = 0x10,
+    // Host -> board: no payload; sensors are flushed with calibrant
+    StopMeasurement = 0x11
+};
+
+const int SAMPLES_HEADER_SIZE = 19;
+
+struct Frame {
+    quint8 type = 0;
+    QByteArray payload;
+};
+
+// Electrode channels on the sensor board. Signals are in millivolts:
+// potentiometric electrodes follow E = offset + slope * log10(value),
+// amperometric ones (read through a transimpedance stage) are linear.
+// group is the channel group the value is published with.
+struct Electrode {
+    const char *field;
+    int group;
+    double slope;
+    double offset;
+    bool logarithmic;
+    double calibrantValue;
+    double timeConstantMs;
+};
+
+const Electrode ELECTRODES[] = {
+    {"pH", 0, -59.16, 430.0, false, 7.40, 250.0},
+    {"pCO2", 0, 57.0, -60.0, true, 40.0, 300.0},
+    {"pO2", 0, 0.5, 5.0, false, 100.0, 300.0},
+    {"Na", 1, 58.5, -80.0, true, 140.0, 450.0},
+    {"K", 1, 58.0, 120.0, true, 4.0, 450.0},
+    {"Cl", 1, -57.0, 150.0, true, 100.0, 450.0},
+    {"Ca", 1, 28.5, 30.0, true, 2.5, 500.0},
+    {"Glucose", 2, 0.8, 12.0, false, 100.0, 650.0},
+    {"Lactate", 2, 20.0, 8.0, false, 1.0, 650.0}
+};
+
+const int CHANNEL_COUNT = int(sizeof(ELECTRODES) / sizeof(ELECTRODES[0]));
+
+inline double toMillivolts(const Electrode &electrode, double value)
+{
+    return electrode.offset + electrode.slope * (electrode.logarithmic ? std::log10(value) : value);
+}
+
+inline double fromMillivolts(const Electrode &electrode, double millivolts)
+{
+    const double x = (millivolts - electrode.offset) / electrode.slope;
+    return electrode.logarithmic ? std::pow(10.0, x) : x;
+}
+
+inline quint16 crc16(const char *data, qsizetype size)
+{
+    quint16 crc = 0xFFFF;
+    for (qsizetype i = 0; i < size; ++i) {
+        crc ^= quint16(quint8(data[i])) << 8;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) ? quint16((crc << 1) ^ 0x1021) : quint16(crc << 1);
+        }
+    }
+    return crc;
+}
+
+inline void appendFrame(QByteArray &out, quint8 type, const char *payload, qsizetype size)
+{
+    const qsizetype start = out.size();
+    out.resize(start + HEADER_SIZE + size + TRAILER_SIZE);
+    char *p = out.data() + start;
+    p[0] = char(SYNC0);
+    p[1] = char(SYNC1);
+    p[2] = char(type);
+    qToLittleEndian<quint16>(quint16(size), p + 3);
+    if (size > 0) {
+        std::memcpy(p + HEADER_SIZE, payload, size_t(size));
+    }
+    qToLittleEndian<quint16>(crc16(p + 2, 3 + size), p + HEADER_SIZE + size);
+}
+
+// Incremental frame parser for a byte stream. Resynchronises on the sync
+// bytes after garbage or a CRC error.
+class FrameParser
+{
+public:
+    FrameParser() : m_consumed(0), m_crcErrors(0), m_discardedBytes(0) { m_buffer.reserve(65536); }
+
+    void append(const char *data, qsizetype size) { m_buffer.append(data, size); }
+
+    bool next(Frame &frame)
+    {
+        for (;;) {
+            const qsizetype available = m_buffer.size() - m_consumed;
+            if (available < HEADER_SIZE + TRAILER_SIZE) {
+                compact();
+                return false;
+            }
+
+            const char *p = m_buffer.constData() + m_consumed;
+            if (quint8(p[0]) != SYNC0 || quint8(p[1]) != SYNC1) {
+                skip(1);
+                continue;
+            }
+
+            const quint16 length = qFromLittleEndian<quint16>(p + 3);
+            if (length > MAX_PAYLOAD) {
+                skip(1);
+                continue;
+            }
+            if (available < HEADER_SIZE + length + TRAILER_SIZE) {
+                compact();
+                return false;
+            }
+
+            const quint16 crc = qFromLittleEndian<quint16>(p + HEADER_SIZE + length);
+            if (crc != crc16(p + 2, 3 + length)) {
+                m_crcErrors++;
+                skip(1);
+                continue;
+            }
+
+            frame.type = quint8(p[2]);
+            frame.payload = QByteArray(p + HEADER_SIZE, length);
+            m_consumed += HEADER_SIZE + length + TRAILER_SIZE;
+            return true;
+        }
+    }
+
+    quint64 crcErrors() const { return m_crcErrors; }
+    quint64 discardedBytes() const { return m_discardedBytes; }
+
+private:
+    void skip(qsizetype bytes)
+    {
+        m_consumed += bytes;
+        m_discardedBytes += quint64(bytes);
+    }
+
+    // Drops parsed bytes once they make up most of the buffer, not per frame
+    void compact()
+    {
+        if (m_consumed > 0 && m_consumed >= m_buffer.size() / 2) {
+            m_buffer.remove(0, m_consumed);
+            m_consumed = 0;
+        }
+    }
+
+    QByteArray m_buffer;
+    qsizetype m_consumed;
+    quint64 m_crcErrors;
+    quint64 m_discardedBytes;
+};
+
+} // namespace SensorProtocol
+
+#endif // SENSORPROTOCOL_H
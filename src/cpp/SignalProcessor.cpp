@@ -0,0 +1,331 @@
+#include "SignalProcessor.h"
+#include "WaveformCodec.h"
+
+#include <QDebug>
+#include <QTimer>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace {
+// Normalised cutoff of the low-pass FIR, in cycles per sample
+// (20 Hz at 1 kHz); the plateau fit only needs the slow component
+const double FIR_CUTOFF = 0.02;
+const double PI = 3.14159265358979323846;
+
+inline float median3(float a, float b, float c)
+{
+    return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+// Branch-free, so the loop over a block vectorises
+inline float median5(float a, float b, float c, float d, float e)
+{
+    // The middle two of a..d, then the median of those and e
+    const float low = std::max(std::min(a, b), std::min(c, d));
+    const float high = std::min(std::max(a, b), std::max(c, d));
+    return median3(e, low, high);
+}
+
+qint64 monotonicNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}
+
+SignalProcessor::SignalProcessor(QObject *parent)
+    : QObject(parent)
+    , m_ring(RING_BLOCKS)
+    , m_scheduled(false)
+    , m_latestMeasurement(0)
+    , m_measurementId(0)
+    , m_samplesSinceStart(0)
+    , m_lastDeviceTimeUs(0)
+    , m_samplesSinceStamp(0)
+    , m_samplePeriodUs(1000.0)
+    , m_blocks(0)
+    , m_samples(0)
+    , m_plateaus(0)
+    , m_offsetUpdates(0)
+{
+    // Hamming-windowed sinc, normalised to unity gain at DC
+    double sum = 0.0;
+    for (int k = 0; k < FIR_TAPS; ++k) {
+        const double n = k - (FIR_TAPS - 1) / 2.0;
+        const double sinc = n == 0.0 ? 2.0 * FIR_CUTOFF : std::sin(2.0 * PI * FIR_CUTOFF * n) / (PI * n);
+        const double window = 0.54 - 0.46 * std::cos(2.0 * PI * k / (FIR_TAPS - 1));
+        m_fir[k] = float(sinc * window);
+        sum += m_fir[k];
+    }
+    for (float &tap : m_fir) {
+        tap = float(tap / sum);
+    }
+
+    for (int channel = 0; channel < SensorProtocol::CHANNEL_COUNT; ++channel) {
+        Channel &state = m_channels[channel];
+        state.windowCount = 0;
+        state.windowPos = 0;
+        state.decimationPhase = 0;
+        state.stableFits = 0;
+        state.settled = false;
+        state.primed = false;
+        state.slope = SensorProtocol::ELECTRODES[channel].slope;
+        state.offset = SensorProtocol::ELECTRODES[channel].offset;
+        m_latestValue[channel].store(std::numeric_limits<double>::quiet_NaN(), std::memory_order_relaxed);
+        m_calibrated[channel].store(false, std::memory_order_relaxed);
+        m_trace[channel].reserve(MAX_TRACE_POINTS);
+    }
+
+    auto *statsTimer = new QTimer(this);
+    statsTimer->setInterval(STATS_INTERVAL_MS);
+    connect(statsTimer, &QTimer::timeout, this, &SignalProcessor::publishStats);
+    statsTimer->start();
+}
+
+bool SignalProcessor::ingest(const SampleBlock &block)
+{
+    if (!m_ring.tryPush(block)) {
+        return false;
+    }
+    if (!m_scheduled.exchange(true)) {
+        QMetaObject::invokeMethod(this, &SignalProcessor::drain, Qt::QueuedConnection);
+    }
+    return true;
+}
+
+void SignalProcessor::setCalibration(int channel, double slope, double offset)
+{
+    if (channel < 0 || channel >= SensorProtocol::CHANNEL_COUNT || slope == 0.0) {
+        return;
+    }
+    m_channels[channel].slope = slope;
+    m_channels[channel].offset = offset;
+    m_calibrated[channel].store(true, std::memory_order_relaxed);
+}
+
+void SignalProcessor::finishTrace(int measurementId)
+{
+    // Blocks already in the ring belong to the trace
+    drain();
+
+    Waveform waveform;
+    if (m_measurementId == quint32(measurementId) && !m_trace[0].isEmpty()) {
+        waveform.samplePeriodUs = int(std::lround(DECIMATION * m_samplePeriodUs));
+        for (int channel = 0; channel < SensorProtocol::CHANNEL_COUNT; ++channel) {
+            if (!m_trace[channel].isEmpty()) {
+                waveform.channels.append({SensorProtocol::ELECTRODES[channel].field, m_trace[channel]});
+            }
+        }
+    }
+    for (QList<qint32> &trace : m_trace) {
+        trace.clear();
+    }
+    emit traceFinished(measurementId, waveform.isEmpty() ? QByteArray() : WaveformCodec::encode(waveform));
+}
+
+void SignalProcessor::resetLink()
+{
+    drain();
+    beginMeasurement(0);
+    for (Channel &state : m_channels) {
+        state.primed = false;
+        state.decimationPhase = 0;
+    }
+}
+
+void SignalProcessor::drain()
+{
+    m_scheduled.store(false);
+
+    SampleBlock block;
+    while (m_ring.tryPop(block)) {
+        const qint64 startNs = monotonicNs();
+        processBlock(block);
+        m_blockTime.record((monotonicNs() - startNs) / 1e6);
+    }
+}
+
+void SignalProcessor::processBlock(const SampleBlock &block)
+{
+    if (block.count <= 0 || block.count > SampleBlock::MAX_SAMPLES ||
+        block.channelCount <= 0 || block.channelCount > SensorProtocol::CHANNEL_COUNT) {
+        return;
+    }
+    if (block.measurementId != m_measurementId) {
+        beginMeasurement(block.measurementId);
+    }
+
+    // The sample rate is whatever the board runs at; follow it. Blocks cut
+    // from one frame share its timestamp.
+    m_samplesSinceStamp += block.count;
+    if (block.deviceTimeUs > m_lastDeviceTimeUs) {
+        if (m_lastDeviceTimeUs > 0) {
+            const double period = double(block.deviceTimeUs - m_lastDeviceTimeUs) / m_samplesSinceStamp;
+            m_samplePeriodUs += 0.05 * (period - m_samplePeriodUs);
+        }
+        m_lastDeviceTimeUs = block.deviceTimeUs;
+        m_samplesSinceStamp = 0;
+    }
+    m_samplesSinceStart += block.count;
+    m_blocks++;
+    m_samples += quint64(block.count);
+
+    const bool canSettle = m_samplesSinceStart * m_samplePeriodUs >= MIN_SETTLE_MS * 1000.0;
+    float filtered[SampleBlock::MAX_SAMPLES];
+    // Channels the board did not report are left alone: they never settle
+    for (int channel = 0; channel < block.channelCount; ++channel) {
+        Channel &state = m_channels[channel];
+        filterChannel(channel, block.millivolts[channel], block.count, filtered);
+        m_latestValue[channel].store(toValue(channel, filtered[block.count - 1]), std::memory_order_relaxed);
+
+        // Plateau detection runs on the decimated signal
+        for (int i = 0; i < block.count; ++i) {
+            if (++state.decimationPhase < DECIMATION) {
+                continue;
+            }
+            state.decimationPhase = 0;
+            state.window[state.windowPos] = filtered[i];
+            state.windowPos = (state.windowPos + 1) % WINDOW;
+            state.windowCount = qMin(state.windowCount + 1, int(WINDOW));
+            if (m_measurementId != 0 && m_trace[channel].size() < MAX_TRACE_POINTS) {
+                m_trace[channel].append(qint32(std::lround(filtered[i] * 1000.0f)));
+            }
+
+            if (state.settled || state.windowCount < WINDOW) {
+                continue;
+            }
+            state.stableFits = fitIsFlat(state) ? state.stableFits + 1 : 0;
+            if (canSettle && state.stableFits >= STABLE_FITS) {
+                state.settled = true;
+                onPlateau(channel, windowMean(state));
+            }
+        }
+    }
+}
+
+void SignalProcessor::filterChannel(int channel, const float *samples, int count, float *filtered)
+{
+    Channel &state = m_channels[channel];
+    if (!state.primed) {
+        // Start from the first sample rather than ringing up from zero
+        state.medianTail.fill(samples[0]);
+        state.firTail.fill(samples[0]);
+        state.primed = true;
+    }
+
+    // Median-5 spike rejection over [tail | block]
+    float medianIn[MEDIAN_TAPS - 1 + SampleBlock::MAX_SAMPLES];
+    std::copy(state.medianTail.begin(), state.medianTail.end(), medianIn);
+    std::copy(samples, samples + count, medianIn + MEDIAN_TAPS - 1);
+    float firIn[FIR_TAPS - 1 + SampleBlock::MAX_SAMPLES];
+    std::copy(state.firTail.begin(), state.firTail.end(), firIn);
+    float *median = firIn + FIR_TAPS - 1;
+    for (int i = 0; i < count; ++i) {
+        median[i] = median5(medianIn[i], medianIn[i + 1], medianIn[i + 2], medianIn[i + 3], medianIn[i + 4]);
+    }
+    std::copy(medianIn + count, medianIn + count + MEDIAN_TAPS - 1, state.medianTail.begin());
+
+    // Low-pass FIR. Taps in the outer loop: the inner loop is a plain
+    // multiply-add across the block, which the compiler vectorises without
+    // reassociating a reduction. The taps are symmetric, so no reversal.
+    std::fill(filtered, filtered + count, 0.0f);
+    for (int k = 0; k < FIR_TAPS; ++k) {
+        const float tap = m_fir[k];
+        const float *in = firIn + k;
+        for (int i = 0; i < count; ++i) {
+            filtered[i] += tap * in[i];
+        }
+    }
+    std::copy(firIn + count, firIn + count + FIR_TAPS - 1, state.firTail.begin());
+}
+
+bool SignalProcessor::fitIsFlat(const Channel &state) const
+{
+    // Least-squares slope over the window, oldest point first
+    const double meanX = (WINDOW - 1) / 2.0;
+    const double meanY = windowMean(state);
+    double sxy = 0.0;
+    double sxx = 0.0;
+    for (int x = 0; x < WINDOW; ++x) {
+        const double y = state.window[(state.windowPos + x) % WINDOW];
+        sxy += (x - meanX) * (y - meanY);
+        sxx += (x - meanX) * (x - meanX);
+    }
+    const double secondsPerPoint = DECIMATION * m_samplePeriodUs / 1e6;
+    const double millivoltsPerSecond = sxy / sxx / secondsPerPoint;
+    return std::abs(millivoltsPerSecond) < PLATEAU_SLOPE_MV_PER_S;
+}
+
+double SignalProcessor::windowMean(const Channel &state) const
+{
+    double sum = 0.0;
+    for (const float y : state.window) {
+        sum += y;
+    }
+    return sum / WINDOW;
+}
+
+void SignalProcessor::onPlateau(int channel, double millivolts)
+{
+    m_plateaus++;
+    if (m_measurementId != 0) {
+        emit channelSettled(int(m_measurementId), channel, toValue(channel, millivolts));
+        return;
+    }
+
+    // Calibrant plateau: re-fit the offset so it reads its nominal value
+    const SensorProtocol::Electrode &electrode = SensorProtocol::ELECTRODES[channel];
+    const double x = electrode.logarithmic ? std::log10(electrode.calibrantValue) : electrode.calibrantValue;
+    const double offset = millivolts - m_channels[channel].slope * x;
+    if (std::abs(offset - electrode.offset) > MAX_OFFSET_DRIFT_MV) {
+        qWarning() << "Electrode" << electrode.field << "drifted out of range, offset" << offset << "mV";
+        return;
+    }
+    m_channels[channel].offset = offset;
+    m_offsetUpdates++;
+}
+
+void SignalProcessor::beginMeasurement(quint32 measurementId)
+{
+    // The fluid in front of the sensors changed; wait for a fresh plateau.
+    // The previous fluid's values must not be read as this one's.
+    for (std::atomic<double> &value : m_latestValue) {
+        value.store(std::numeric_limits<double>::quiet_NaN(), std::memory_order_relaxed);
+    }
+    m_latestMeasurement.store(measurementId, std::memory_order_release);
+    m_measurementId = measurementId;
+    m_samplesSinceStart = 0;
+    for (QList<qint32> &trace : m_trace) {
+        trace.clear();
+    }
+    for (Channel &state : m_channels) {
+        state.windowCount = 0;
+        state.stableFits = 0;
+        state.settled = false;
+    }
+}
+
+double SignalProcessor::toValue(int channel, double millivolts) const
+{
+    const Channel &state = m_channels[channel];
+    const double x = (millivolts - state.offset) / state.slope;
+    return SensorProtocol::ELECTRODES[channel].logarithmic ? std::pow(10.0, x) : x;
+}
+
+void SignalProcessor::publishStats()
+{
+    QVariantMap stats;
+    stats["blocks"] = m_blocks;
+    stats["samples"] = m_samples;
+    stats["sampleRateHz"] = m_samplePeriodUs > 0.0 ? 1e6 / m_samplePeriodUs : 0.0;
+    stats["ringDepth"] = qulonglong(m_ring.sizeApprox());
+    stats["plateaus"] = m_plateaus;
+    stats["offsetUpdates"] = m_offsetUpdates;
+    stats["blockP99Ms"] = m_blockTime.percentile(99);
+    emit statsChanged(stats);
+
+    m_blockTime.reset();
+}
@@ -0,0 +1,140 @@
+#ifndef SIGNALPROCESSOR_H
+#define SIGNALPROCESSOR_H
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include <QVariantMap>
+
+#include <array>
+#include <atomic>
+#include <limits>
+
+#include "LatencyHistogram.h"
+#include "LockFreeQueue.h"
+#include "SensorProtocol.h"
+
+// A run of electrode samples for the channels the board reported,
+// deinterleaved so each channel's samples are contiguous for the filters
+struct SampleBlock {
+    static const int MAX_SAMPLES = 32;
+
+    quint32 measurementId = 0;
+    qint64 deviceTimeUs = 0; // of the frame the block was cut from
+    int count = 0;
+    int channelCount = 0; // the first channelCount rows hold samples
+    float millivolts[SensorProtocol::CHANNEL_COUNT][MAX_SAMPLES] = {};
+};
+
+// Raw electrode signal processing. The sensor I/O thread hands in sample
+// blocks through a preallocated SPSC ring; this object, on its own thread,
+// runs each channel through a median-5 spike filter and a low-pass FIR,
+// then watches the decimated signal for the endpoint plateau. Plateau
+// values are converted with the channel's calibrated slope and offset;
+// until setCalibration() the electrode's nominal ones, and isCalibrated()
+// says so.
+// While calibrant is in front of the sensors (no measurement) the plateau
+// is used to re-fit each channel's offset, as a one-point calibration.
+// The decimated signal of each measurement is kept as its raw trace.
+class SignalProcessor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SignalProcessor(QObject *parent = nullptr);
+
+    // Producer side; sensor I/O thread only. Returns false when the ring is
+    // full, which means samples are being lost.
+    bool ingest(const SampleBlock &block);
+
+    // Thread-safe; latest filtered value of a channel in analyte units, NaN
+    // until the measurement has data and once the link to the board closed
+    double latestValue(int measurementId, int channel) const
+    {
+        if (m_latestMeasurement.load(std::memory_order_acquire) != quint32(measurementId)) {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        return m_latestValue[channel].load(std::memory_order_relaxed);
+    }
+    // Thread-safe; whether the channel has had a two-point calibration
+    bool isCalibrated(int channel) const { return m_calibrated[channel].load(std::memory_order_relaxed); }
+
+public slots:
+    // Two-point calibration result for a channel; mV per unit (or per decade)
+    void setCalibration(int channel, double slope, double offset);
+    // Ends the measurement's trace and emits it encoded; empty when the
+    // measurement produced no samples
+    void finishTrace(int measurementId);
+    // The link to the board closed: what is still in the ring is the last
+    // of its data. The measurement is dropped so nothing stale is reported,
+    // and a reopened link starts from fresh filter state.
+    void resetLink();
+
+signals:
+    void channelSettled(int measurementId, int channel, double value);
+    void statsChanged(const QVariantMap &stats);
+    void traceFinished(int measurementId, const QByteArray &waveform);
+
+private slots:
+    void drain();
+    void publishStats();
+
+private:
+    static const int MEDIAN_TAPS = 5;
+    static const int FIR_TAPS = 32;
+    static const int DECIMATION = 10;
+    static const int WINDOW = 32;      // decimated points in the plateau fit
+    static const int STABLE_FITS = 3;  // consecutive flat fits for a plateau
+
+    struct Channel {
+        std::array<float, MEDIAN_TAPS - 1> medianTail;
+        std::array<float, FIR_TAPS - 1> firTail;
+        std::array<float, WINDOW> window;
+        int windowCount;
+        int windowPos;
+        int decimationPhase;
+        int stableFits;
+        bool settled;
+        bool primed;
+        double slope;
+        double offset;
+    };
+
+    void processBlock(const SampleBlock &block);
+    void filterChannel(int channel, const float *samples, int count, float *filtered);
+    bool fitIsFlat(const Channel &state) const;
+    double windowMean(const Channel &state) const;
+    void onPlateau(int channel, double millivolts);
+    void beginMeasurement(quint32 measurementId);
+    double toValue(int channel, double millivolts) const;
+
+    SpscQueue<SampleBlock> m_ring;
+    std::atomic<bool> m_scheduled;
+    std::array<std::atomic<double>, SensorProtocol::CHANNEL_COUNT> m_latestValue;
+    std::atomic<quint32> m_latestMeasurement; // the one m_latestValue belongs to
+    std::array<std::atomic<bool>, SensorProtocol::CHANNEL_COUNT> m_calibrated;
+
+    // Processing thread only
+    std::array<Channel, SensorProtocol::CHANNEL_COUNT> m_channels;
+    std::array<float, FIR_TAPS> m_fir;
+    std::array<QList<qint32>, SensorProtocol::CHANNEL_COUNT> m_trace; // microvolts
+    quint32 m_measurementId;
+    qint64 m_samplesSinceStart;
+    qint64 m_lastDeviceTimeUs;
+    qint64 m_samplesSinceStamp;
+    double m_samplePeriodUs;
+    quint64 m_blocks;
+    quint64 m_samples;
+    quint64 m_plateaus;
+    quint64 m_offsetUpdates;
+    LatencyHistogram m_blockTime;
+
+    static const int RING_BLOCKS = 1024;
+    static const int MIN_SETTLE_MS = 300;
+    static const int MAX_TRACE_POINTS = 2000; // decimated, per channel; 20 s at 1 kHz
+    static constexpr double PLATEAU_SLOPE_MV_PER_S = 0.25;
+    static constexpr double MAX_OFFSET_DRIFT_MV = 15.0;
+    static const int STATS_INTERVAL_MS = 1000;
+};
+
+#endif // SIGNALPROCESSOR_H
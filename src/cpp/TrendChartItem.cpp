@@ -0,0 +1,423 @@
+#include "TrendChartItem.h"
+#include "TrendModel.h"
+
+#include <QPainter>
+#include <QPolygonF>
+#include <QQuickWindow>
+#include <QSGFlatColorMaterial>
+#include <QSGNode>
+#include <QSGRenderNode>
+#include <QSGRendererInterface>
+#include <QtMath>
+
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace {
+const double MS_PER_SECOND = 1000.0;
+// Vertex capacity grows in powers of two from here, in points
+const int MIN_CAPACITY = 64;
+// Scatter markers are sized in data units; they are rebuilt once zooming
+// has made them this much larger or smaller than markerSize
+const qreal MARKER_SCALE_TOLERANCE = 1.25;
+// Vertices are rebuilt around the visible window once float rounding
+// could move them by this many pixels
+const qreal MAX_ROUNDING_PX = 0.25;
+
+// Vertices in seconds since origin and value. Floats cannot hold epoch
+// milliseconds, and even relative seconds round to about 2 s at a year
+// from the origin, so the origin is the middle of the window the vertices
+// were built for and moves when a pan or zoom would make the rounding
+// visible.
+class ChartGeometryNode : public QSGGeometryNode
+{
+public:
+    ChartGeometryNode()
+        : geometry(QSGGeometry::defaultAttributes_Point2D(), 0)
+    {
+        geometry.setVertexDataPattern(QSGGeometry::DynamicPattern);
+        setGeometry(&geometry);
+        setMaterial(&material);
+    }
+
+    QSGGeometry geometry;
+    QSGFlatColorMaterial material;
+    TrendChartItem::SeriesStyle style = TrendChartItem::Line;
+    double origin = 0.0;
+    int used = 0;      // points written
+    int capacity = 0;  // points the vertices have room for
+    // Pixels per data unit the scatter markers were sized for
+    qreal markerScaleX = 0.0;
+    qreal markerScaleY = 0.0;
+};
+
+int verticesPerPoint(TrendChartItem::SeriesStyle style)
+{
+    // A scatter marker is a square of two triangles
+    return style == TrendChartItem::Line ? 1 : 6;
+}
+
+void writePoints(ChartGeometryNode *node, const QList<QPointF> &points, int first, qreal markerSize)
+{
+    QSGGeometry::Point2D *vertices = node->geometry.vertexDataAsPoint2D();
+    const int count = int(points.size());
+    if (node->style == TrendChartItem::Line) {
+        for (int i = first; i < count; ++i) {
+            vertices[i].set(float((points.at(i).x() - node->origin) / MS_PER_SECOND), float(points.at(i).y()));
+        }
+    } else {
+        const float halfX = float(markerSize / 2 / node->markerScaleX);
+        const float halfY = float(markerSize / 2 / node->markerScaleY);
+        for (int i = first; i < count; ++i) {
+            const float x = float((points.at(i).x() - node->origin) / MS_PER_SECOND);
+            const float y = float(points.at(i).y());
+            QSGGeometry::Point2D *quad = vertices + i * 6;
+            quad[0].set(x - halfX, y - halfY);
+            quad[1].set(x + halfX, y - halfY);
+            quad[2].set(x + halfX, y + halfY);
+            quad[3].set(x - halfX, y - halfY);
+            quad[4].set(x + halfX, y + halfY);
+            quad[5].set(x - halfX, y + halfY);
+        }
+    }
+
+    // Spare capacity repeats the last vertex: a line strip does not move
+    // and the triangles have no area, so nothing extra is drawn
+    const int perPoint = verticesPerPoint(node->style);
+    const int end = node->capacity * perPoint;
+    const QSGGeometry::Point2D last = vertices[count * perPoint - 1];
+    for (int i = count * perPoint; i < end; ++i) {
+        vertices[i] = last;
+    }
+    node->used = count;
+}
+
+// The software backend has no geometry nodes; this paints the points in
+// item pixels instead
+class SoftwareChartNode : public QSGRenderNode
+{
+public:
+    explicit SoftwareChartNode(QQuickWindow *window)
+        : window(window)
+    {
+    }
+
+    void render(const RenderState *state) override
+    {
+        QSGRendererInterface *renderer = window->rendererInterface();
+        QPainter *painter = static_cast<QPainter *>(renderer->getResource(window, QSGRendererInterface::PainterResource));
+        if (!painter || points.isEmpty()) {
+            return;
+        }
+        const QRegion *clip = state->clipRegion();
+        if (clip && !clip->isEmpty()) {
+            painter->setClipRegion(*clip, Qt::ReplaceClip);
+        }
+        painter->setTransform(matrix()->toTransform());
+        painter->setOpacity(inheritedOpacity());
+        painter->setRenderHint(QPainter::Antialiasing);
+
+        mapped.resize(points.size());
+        for (qsizetype i = 0; i < points.size(); ++i) {
+            mapped[i] = dataToItem.map(points.at(i));
+        }
+        if (style == TrendChartItem::Line) {
+            painter->setPen(QPen(color, 1.5));
+            painter->drawPolyline(mapped);
+        } else {
+            painter->setPen(Qt::NoPen);
+            painter->setBrush(color);
+            const qreal half = markerSize / 2;
+            for (const QPointF &point : std::as_const(mapped)) {
+                painter->drawRect(QRectF(point.x() - half, point.y() - half, markerSize, markerSize));
+            }
+        }
+    }
+
+    StateFlags changedStates() const override { return {}; }
+    RenderingFlags flags() const override { return BoundedRectRendering; }
+    QRectF rect() const override { return bounds; }
+
+    QQuickWindow *window;
+    QList<QPointF> points; // shared with the model until it changes them
+    QTransform dataToItem;
+    TrendChartItem::SeriesStyle style = TrendChartItem::Line;
+    QColor color;
+    qreal markerSize = 0.0;
+    QRectF bounds;
+
+private:
+    QPolygonF mapped;
+};
+}
+
+TrendChartItem::TrendChartItem(QQuickItem *parent)
+    : QQuickItem(parent)
+    , m_style(Line)
+    , m_color(QColor("#2E86AB"))
+    , m_markerSize(4.0)
+    , m_xMin(0.0)
+    , m_xMax(1.0)
+    , m_yMin(0.0)
+    , m_yMax(1.0)
+    , m_followData(true)
+    , m_dirty(PointsDirty | ViewDirty | MaterialDirty)
+    , m_appendFrom(-1)
+{
+    setFlag(ItemHasContents, true);
+    setClip(true);
+}
+
+void TrendChartItem::setModel(TrendModel *model)
+{
+    if (model == m_model) {
+        return;
+    }
+    if (m_model) {
+        disconnect(m_model, nullptr, this, nullptr);
+    }
+    m_model = model;
+    if (m_model) {
+        connect(m_model, &QAbstractItemModel::rowsInserted, this, &TrendChartItem::onRowsInserted);
+        connect(m_model, &QAbstractItemModel::modelReset, this, &TrendChartItem::onModelReset);
+    }
+    emit modelChanged();
+    onModelReset();
+}
+
+void TrendChartItem::setSeriesStyle(SeriesStyle style)
+{
+    if (style == m_style) {
+        return;
+    }
+    m_style = style;
+    emit seriesStyleChanged();
+    markDirty(PointsDirty);
+}
+
+void TrendChartItem::setColor(const QColor &color)
+{
+    if (color == m_color) {
+        return;
+    }
+    m_color = color;
+    emit colorChanged();
+    markDirty(MaterialDirty);
+}
+
+void TrendChartItem::setMarkerSize(qreal size)
+{
+    if (qFuzzyCompare(size, m_markerSize)) {
+        return;
+    }
+    m_markerSize = size;
+    emit markerSizeChanged();
+    markDirty(PointsDirty);
+}
+
+void TrendChartItem::pan(qreal dx, qreal dy)
+{
+    if (width() <= 0 || height() <= 0) {
+        return;
+    }
+    const double shiftX = dx * (m_xMax - m_xMin) / width();
+    const double shiftY = dy * (m_yMax - m_yMin) / height();
+    m_xMin -= shiftX;
+    m_xMax -= shiftX;
+    m_yMin += shiftY;
+    m_yMax += shiftY;
+    m_followData = false;
+    emit viewChanged();
+    markDirty(ViewDirty);
+}
+
+void TrendChartItem::zoom(qreal factor, qreal x)
+{
+    if (width() <= 0 || factor <= 0) {
+        return;
+    }
+    const double fraction = qBound(0.0, x / width(), 1.0);
+    const double anchor = m_xMin + fraction * (m_xMax - m_xMin);
+    // Down to a minute across the chart
+    const double span = qMax((m_xMax - m_xMin) / factor, 60 * MS_PER_SECOND);
+    m_xMin = anchor - fraction * span;
+    m_xMax = m_xMin + span;
+    m_followData = false;
+    emit viewChanged();
+    markDirty(ViewDirty);
+}
+
+void TrendChartItem::resetView()
+{
+    m_followData = true;
+    fitToData();
+}
+
+QPointF TrendChartItem::valueAt(qreal x, qreal y) const
+{
+    return dataToItem().inverted().map(QPointF(x, y));
+}
+
+void TrendChartItem::geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChange(newGeometry, oldGeometry);
+    if (newGeometry.size() != oldGeometry.size()) {
+        markDirty(ViewDirty);
+    }
+}
+
+void TrendChartItem::onRowsInserted(const QModelIndex &, int first, int)
+{
+    m_appendFrom = m_appendFrom < 0 ? first : qMin(m_appendFrom, first);
+    if (m_followData) {
+        fitToData();
+    }
+    markDirty(AppendDirty);
+}
+
+void TrendChartItem::onModelReset()
+{
+    if (m_followData) {
+        fitToData();
+    }
+    markDirty(PointsDirty);
+}
+
+void TrendChartItem::fitToData()
+{
+    if (!m_model || m_model->count() == 0) {
+        return;
+    }
+
+    const QList<QPointF> &points = m_model->points();
+    m_xMin = m_model->from().isValid() ? double(m_model->from().toMSecsSinceEpoch()) : points.first().x();
+    m_xMax = m_model->to().isValid() ? double(m_model->to().toMSecsSinceEpoch()) : points.last().x();
+    if (m_xMax - m_xMin < 60 * MS_PER_SECOND) {
+        // A single result, in the middle of an hour
+        m_xMin -= 30 * 60 * MS_PER_SECOND;
+        m_xMax += 30 * 60 * MS_PER_SECOND;
+    }
+    const double margin = qMax((m_model->maxValue() - m_model->minValue()) * 0.05, 0.01);
+    m_yMin = m_model->minValue() - margin;
+    m_yMax = m_model->maxValue() + margin;
+    emit viewChanged();
+    markDirty(ViewDirty);
+}
+
+void TrendChartItem::markDirty(int dirty)
+{
+    m_dirty |= dirty;
+    update();
+}
+
+QTransform TrendChartItem::dataToItem() const
+{
+    const double scaleX = width() / qMax(m_xMax - m_xMin, 1.0);
+    const double scaleY = height() / qMax(m_yMax - m_yMin, 1e-9);
+    return QTransform(scaleX, 0, 0, -scaleY, -m_xMin * scaleX, height() + m_yMin * scaleY);
+}
+
+QSGNode *TrendChartItem::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
+{
+    QSGNode *node = window()->rendererInterface()->graphicsApi() == QSGRendererInterface::Software
+                        ? updateSoftwareNode(oldNode)
+                        : updateGeometryNode(oldNode);
+    m_dirty = 0;
+    m_appendFrom = -1;
+    return node;
+}
+
+QSGNode *TrendChartItem::updateGeometryNode(QSGNode *oldNode)
+{
+    auto *root = static_cast<QSGTransformNode *>(oldNode);
+    ChartGeometryNode *series = nullptr;
+    if (!root) {
+        root = new QSGTransformNode;
+        series = new ChartGeometryNode;
+        series->setFlag(QSGNode::OwnedByParent);
+        root->appendChildNode(series);
+        m_dirty |= PointsDirty | ViewDirty | MaterialDirty;
+    } else {
+        series = static_cast<ChartGeometryNode *>(root->firstChild());
+    }
+
+    // Pixels per second and per value unit
+    const qreal scaleX = width() / qMax((m_xMax - m_xMin) / MS_PER_SECOND, 1e-3);
+    const qreal scaleY = height() / qMax(m_yMax - m_yMin, 1e-9);
+
+    // Scatter markers only need new vertices when they are off size by
+    // more than the tolerance; a pan never changes the scale
+    const auto offSize = [](qreal built, qreal now) {
+        return built <= 0 || now / built > MARKER_SCALE_TOLERANCE || built / now > MARKER_SCALE_TOLERANCE;
+    };
+    bool rebuild = (m_dirty & PointsDirty) || series->style != m_style;
+    const double reach = qMax(std::abs(m_xMin - series->origin), std::abs(m_xMax - series->origin)) / MS_PER_SECOND;
+    if (reach * std::numeric_limits<float>::epsilon() * scaleX > MAX_ROUNDING_PX) {
+        rebuild = true;
+    }
+    if (m_style == Scatter && (offSize(series->markerScaleX, scaleX) || offSize(series->markerScaleY, scaleY))) {
+        rebuild = true;
+    }
+
+    static const QList<QPointF> NO_POINTS;
+    const QList<QPointF> &points = m_model ? m_model->points() : NO_POINTS;
+    const int count = int(points.size());
+    if (!rebuild && (m_dirty & AppendDirty)) {
+        // In place while the new points fit; the buffer is uploaded again,
+        // but nothing is reallocated or recomputed
+        if (count <= series->capacity && m_appendFrom >= 0 && m_appendFrom <= series->used) {
+            writePoints(series, points, m_appendFrom, m_markerSize);
+            series->markDirty(QSGNode::DirtyGeometry);
+        } else {
+            rebuild = true;
+        }
+    }
+
+    if (rebuild) {
+        series->style = m_style;
+        series->origin = (m_xMin + m_xMax) / 2;
+        series->markerScaleX = scaleX;
+        series->markerScaleY = scaleY;
+        series->capacity = count > 0 ? qMax(MIN_CAPACITY, int(qNextPowerOfTwo(quint32(count)))) : 0;
+        series->geometry.allocate(series->capacity * verticesPerPoint(m_style));
+        // RHI draws line strips one pixel wide, whatever the line width
+        series->geometry.setDrawingMode(m_style == Line ? QSGGeometry::DrawLineStrip : QSGGeometry::DrawTriangles);
+        series->used = 0;
+        if (count > 0) {
+            writePoints(series, points, 0, m_markerSize);
+        }
+        series->markDirty(QSGNode::DirtyGeometry);
+    }
+
+    if (m_dirty & MaterialDirty) {
+        series->material.setColor(m_color);
+        series->markDirty(QSGNode::DirtyMaterial);
+    }
+
+    // Relative seconds and values to item pixels; all a pan or zoom changes
+    const double left = (m_xMin - series->origin) / MS_PER_SECOND;
+    root->setMatrix(QMatrix4x4(float(scaleX), 0, 0, float(-left * scaleX),
+                               0, float(-scaleY), 0, float(height() + m_yMin * scaleY),
+                               0, 0, 1, 0,
+                               0, 0, 0, 1));
+    return root;
+}
+
+QSGNode *TrendChartItem::updateSoftwareNode(QSGNode *oldNode)
+{
+    auto *node = static_cast<SoftwareChartNode *>(oldNode);
+    if (!node) {
+        node = new SoftwareChartNode(window());
+    }
+    // The painter maps every point each frame anyway, so there is nothing
+    // to keep between updates beyond a shared copy of the points
+    node->points = m_model ? m_model->points() : QList<QPointF>();
+    node->dataToItem = dataToItem();
+    node->style = m_style;
+    node->color = m_color;
+    node->markerSize = m_markerSize;
+    node->bounds = boundingRect();
+    node->markDirty(QSGNode::DirtyMaterial);
+    return node;
+}
@@ -0,0 +1,112 @@
+#ifndef TRENDCHARTITEM_H
+#define TRENDCHARTITEM_H
+
+#include <QQuickItem>
+#include <QColor>
+#include <QPointer>
+#include <QTransform>
+
+#include "TrendModel.h"
+
+// Draws a TrendModel's points as a line or a scatter series in the scene
+// graph. Vertices are kept in data units, relative to the first point,
+// under a transform node: pan and zoom only change the node's matrix,
+// and points the model appends are written into spare vertex capacity
+// rather than rebuilding the buffer. Under the software backend, which
+// has no geometry nodes, a render node paints the same points with
+// QPainter.
+class TrendChartItem : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(TrendModel *model READ model WRITE setModel NOTIFY modelChanged)
+    Q_PROPERTY(SeriesStyle seriesStyle READ seriesStyle WRITE setSeriesStyle NOTIFY seriesStyleChanged)
+    Q_PROPERTY(QColor color READ color WRITE setColor NOTIFY colorChanged)
+    Q_PROPERTY(qreal markerSize READ markerSize WRITE setMarkerSize NOTIFY markerSizeChanged)
+    // Visible window, x in ms since the epoch. It follows the data until
+    // the chart is panned or zoomed, and again after resetView().
+    Q_PROPERTY(double xMin READ xMin NOTIFY viewChanged)
+    Q_PROPERTY(double xMax READ xMax NOTIFY viewChanged)
+    Q_PROPERTY(double yMin READ yMin NOTIFY viewChanged)
+    Q_PROPERTY(double yMax READ yMax NOTIFY viewChanged)
+    Q_PROPERTY(bool followData READ followData NOTIFY viewChanged)
+
+public:
+    enum SeriesStyle {
+        Line,
+        Scatter
+    };
+    Q_ENUM(SeriesStyle)
+
+    explicit TrendChartItem(QQuickItem *parent = nullptr);
+
+    TrendModel *model() const { return m_model; }
+    void setModel(TrendModel *model);
+    SeriesStyle seriesStyle() const { return m_style; }
+    void setSeriesStyle(SeriesStyle style);
+    QColor color() const { return m_color; }
+    void setColor(const QColor &color);
+    qreal markerSize() const { return m_markerSize; }
+    void setMarkerSize(qreal size);
+
+    double xMin() const { return m_xMin; }
+    double xMax() const { return m_xMax; }
+    double yMin() const { return m_yMin; }
+    double yMax() const { return m_yMax; }
+    bool followData() const { return m_followData; }
+
+public slots:
+    // By dx, dy pixels
+    Q_INVOKABLE void pan(qreal dx, qreal dy);
+    // Time axis only, keeping the time under pixel x in place
+    Q_INVOKABLE void zoom(qreal factor, qreal x);
+    Q_INVOKABLE void resetView();
+    // Time (ms since the epoch) and value under a pixel
+    Q_INVOKABLE QPointF valueAt(qreal x, qreal y) const;
+
+signals:
+    void modelChanged();
+    void seriesStyleChanged();
+    void colorChanged();
+    void markerSizeChanged();
+    void viewChanged();
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
+    void geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+
+private slots:
+    void onRowsInserted(const QModelIndex &parent, int first, int last);
+    void onModelReset();
+
+private:
+    enum Dirty {
+        PointsDirty = 0x1,   // rebuild the vertices
+        AppendDirty = 0x2,   // rows from m_appendFrom were added
+        ViewDirty = 0x4,     // window or item size changed
+        MaterialDirty = 0x8
+    };
+
+    void fitToData();
+    void markDirty(int dirty);
+    // Data coordinates, x in ms since the epoch, to item pixels
+    QTransform dataToItem() const;
+
+    QSGNode *updateGeometryNode(QSGNode *oldNode);
+    QSGNode *updateSoftwareNode(QSGNode *oldNode);
+
+    QPointer<TrendModel> m_model;
+    SeriesStyle m_style;
+    QColor m_color;
+    qreal m_markerSize;
+
+    double m_xMin;
+    double m_xMax;
+    double m_yMin;
+    double m_yMax;
+    bool m_followData;
+
+    int m_dirty;
+    int m_appendFrom;
+};
+
+#endif // TRENDCHARTITEM_H
@@ -0,0 +1,384 @@
+#include "TrendModel.h"
+#include "DatabaseManager.h"
+#include "ResultRules.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cmath>
+
+TrendModel::TrendModel(QObject *parent)
+    : QAbstractListModel(parent)
+    , m_analyte(ResultRules::PH)
+    , m_width(DEFAULT_WIDTH)
+    , m_generation(0)
+    , m_reductions(MAX_CACHED_POINTS)
+    , m_sourceCount(0)
+    , m_minValue(0.0)
+    , m_maxValue(0.0)
+{
+    m_loadPool.setMaxThreadCount(1);
+}
+
+TrendModel::~TrendModel()
+{
+    m_loadPool.waitForDone();
+}
+
+int TrendModel::rowCount(const QModelIndex &) const
+{
+    return int(m_points.size());
+}
+
+QVariant TrendModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_points.size()) {
+        return QVariant();
+    }
+
+    const QPointF &point = m_points.at(index.row());
+    switch (role) {
+    case TimeRole:
+        return qint64(point.x());
+    case ValueRole:
+        return point.y();
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> TrendModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles[TimeRole] = "time";
+    roles[ValueRole] = "value";
+    return roles;
+}
+
+QString TrendModel::analyte() const
+{
+    return m_analyte < 0 ? QString() : QString(ResultRules::ANALYTE_FIELDS[m_analyte]);
+}
+
+void TrendModel::setAnalyte(const QString &analyte)
+{
+    int index = -1;
+    for (int i = 0; i < ResultRules::ANALYTE_COUNT; ++i) {
+        if (analyte == QLatin1String(ResultRules::ANALYTE_FIELDS[i])) {
+            index = i;
+        }
+    }
+    if (index < 0) {
+        qWarning() << "No trend for" << analyte;
+    }
+    if (index == m_analyte) {
+        return;
+    }
+    m_analyte = index;
+    emit analyteChanged();
+    update();
+}
+
+void TrendModel::setPatientId(const QString &patientId)
+{
+    if (patientId == m_patientId) {
+        return;
+    }
+    m_patientId = patientId;
+    clearSeries();
+    emit patientIdChanged();
+    update();
+}
+
+void TrendModel::setFrom(const QDateTime &from)
+{
+    if (from == m_from) {
+        return;
+    }
+    m_from = from;
+    emit rangeChanged();
+    update();
+}
+
+void TrendModel::setTo(const QDateTime &to)
+{
+    if (to == m_to) {
+        return;
+    }
+    m_to = to;
+    emit rangeChanged();
+    update();
+}
+
+void TrendModel::setWidth(int width)
+{
+    // LTTB keeps the two ends plus at least one bucket
+    width = qMax(3, width);
+    if (width == m_width) {
+        return;
+    }
+    m_width = width;
+    emit widthChanged();
+    update();
+}
+
+void TrendModel::reload()
+{
+    clearSeries();
+    update();
+}
+
+void TrendModel::addResult(const QVariantMap &result)
+{
+    if (!m_patientId.isEmpty() && result.value("patientId").toString() != m_patientId) {
+        return;
+    }
+    const QDateTime timestamp = QDateTime::fromString(result.value("timestamp").toString(), Qt::ISODateWithMs);
+    if (!timestamp.isValid()) {
+        return;
+    }
+    const double time = double(timestamp.toMSecsSinceEpoch());
+    if (loading()) {
+        m_pendingResults.append(result);
+    }
+
+    // Only the series read so far; the others will include the result
+    // when they are read
+    bool shownChanged = false;
+    float shownValue = 0.0f;
+    for (auto it = m_series.begin(); it != m_series.end(); ++it) {
+        const QVariant value = result.value(ResultRules::ANALYTE_FIELDS[it.key()]);
+        if (!value.isValid() || value.isNull()) {
+            continue;
+        }
+        Series &data = it.value();
+        const qsizetype at = std::upper_bound(data.times.cbegin(), data.times.cend(), time) - data.times.cbegin();
+        data.times.insert(at, time);
+        data.values.insert(at, value.toFloat());
+        invalidate(it.key(), time);
+
+        const Key key = currentKey();
+        if (it.key() == m_analyte && time >= double(key.from) && time <= double(key.to)) {
+            shownChanged = true;
+            shownValue = value.toFloat();
+        }
+    }
+    if (!shownChanged) {
+        return;
+    }
+
+    // While the range holds fewer points than the chart is wide nothing is
+    // reduced, and a newest point only extends the rows
+    const bool newest = m_points.isEmpty() || time >= m_points.last().x();
+    if (m_sourceCount < m_width && newest) {
+        const int row = int(m_points.size());
+        beginInsertRows(QModelIndex(), row, row);
+        m_points.append(QPointF(time, shownValue));
+        m_minValue = m_sourceCount == 0 ? shownValue : qMin(m_minValue, double(shownValue));
+        m_maxValue = m_sourceCount == 0 ? shownValue : qMax(m_maxValue, double(shownValue));
+        ++m_sourceCount;
+        endInsertRows();
+
+        Reduction *reduction = new Reduction{m_points, m_sourceCount, m_minValue, m_maxValue};
+        m_reductions.insert(currentKey(), reduction, qMax(qsizetype(1), m_points.size()));
+        emit pointsChanged();
+        return;
+    }
+    update();
+}
+
+void TrendModel::downsample(const double *x, const float *y, qsizetype count, int threshold, QList<QPointF> &out)
+{
+    out.clear();
+    if (count <= threshold || threshold < 3) {
+        out.reserve(count);
+        for (qsizetype i = 0; i < count; ++i) {
+            out.append(QPointF(x[i], y[i]));
+        }
+        return;
+    }
+
+    out.reserve(threshold);
+    out.append(QPointF(x[0], y[0]));
+
+    // Relative to the first point; epoch milliseconds squared lose the
+    // precision the areas are compared at
+    const double origin = x[0];
+    const double bucketSize = double(count - 2) / (threshold - 2);
+    qsizetype selected = 0;
+    for (int bucket = 0; bucket < threshold - 2; ++bucket) {
+        // Average of the next bucket, the third point of the triangles
+        const qsizetype nextBegin = qsizetype(std::floor((bucket + 1) * bucketSize)) + 1;
+        const qsizetype nextEnd = qMin(qsizetype(std::floor((bucket + 2) * bucketSize)) + 1, count);
+        double averageX = 0.0;
+        double averageY = 0.0;
+        for (qsizetype i = nextBegin; i < nextEnd; ++i) {
+            averageX += x[i] - origin;
+            averageY += y[i];
+        }
+        const qsizetype nextCount = nextEnd - nextBegin;
+        averageX /= nextCount;
+        averageY /= nextCount;
+
+        // The point of this bucket with the largest triangle
+        const qsizetype begin = qsizetype(std::floor(bucket * bucketSize)) + 1;
+        const qsizetype end = nextBegin;
+        const double selectedX = x[selected] - origin;
+        const double selectedY = y[selected];
+        double largestArea = -1.0;
+        qsizetype largest = begin;
+        for (qsizetype i = begin; i < end; ++i) {
+            const double area = std::fabs((selectedX - averageX) * (y[i] - selectedY)
+                                          - (selectedX - (x[i] - origin)) * (averageY - selectedY));
+            if (area > largestArea) {
+                largestArea = area;
+                largest = i;
+            }
+        }
+        out.append(QPointF(x[largest], y[largest]));
+        selected = largest;
+    }
+
+    out.append(QPointF(x[count - 1], y[count - 1]));
+}
+
+const TrendModel::Series *TrendModel::series(int analyte)
+{
+    const auto found = m_series.constFind(analyte);
+    if (found != m_series.cend()) {
+        return &found.value();
+    }
+    if (m_loading.contains(analyte)) {
+        return nullptr;
+    }
+
+    const bool wasLoading = loading();
+    m_loading.insert(analyte);
+    if (!wasLoading) {
+        emit loadingChanged();
+    }
+    m_loadPool.start([this, generation = m_generation, analyte, patientId = m_patientId]() {
+        QElapsedTimer timer;
+        timer.start();
+        Series data;
+        {
+            // SQLite connections are per thread, so each read opens its own
+            DatabaseManager database;
+            if (!database.openConnection("trends") ||
+                !database.getAnalyteSeries(analyte, patientId, data.times, data.values)) {
+                qWarning() << "Could not read" << ResultRules::ANALYTE_FIELDS[analyte] << "values for trends";
+            }
+        }
+        qDebug() << "Read" << data.times.size() << ResultRules::ANALYTE_FIELDS[analyte] << "values for trends in"
+                 << timer.elapsed() << "ms";
+        QMetaObject::invokeMethod(this, [this, generation, analyte, data]() {
+            onSeriesLoaded(generation, analyte, data);
+        });
+    });
+    return nullptr;
+}
+
+void TrendModel::onSeriesLoaded(int generation, int analyte, Series data)
+{
+    // Read for a patient or for results that are no longer shown
+    if (generation != m_generation) {
+        return;
+    }
+
+    // Results computed during the read that it did not find stored
+    for (const QVariantMap &result : std::as_const(m_pendingResults)) {
+        const QVariant value = result.value(ResultRules::ANALYTE_FIELDS[analyte]);
+        const QDateTime timestamp = QDateTime::fromString(result.value("timestamp").toString(), Qt::ISODateWithMs);
+        if (!value.isValid() || value.isNull() || !timestamp.isValid()) {
+            continue;
+        }
+        const double time = double(timestamp.toMSecsSinceEpoch());
+        const auto [begin, end] = std::equal_range(data.times.cbegin(), data.times.cend(), time);
+        const qsizetype first = begin - data.times.cbegin();
+        const qsizetype last = end - data.times.cbegin();
+        if (std::find(data.values.cbegin() + first, data.values.cbegin() + last, value.toFloat()) !=
+            data.values.cbegin() + last) {
+            continue;
+        }
+        data.times.insert(last, time);
+        data.values.insert(last, value.toFloat());
+    }
+
+    m_series.insert(analyte, data);
+    m_loading.remove(analyte);
+    if (m_loading.isEmpty()) {
+        m_pendingResults.clear();
+        emit loadingChanged();
+    }
+    if (analyte == m_analyte) {
+        update();
+    }
+}
+
+void TrendModel::clearSeries()
+{
+    m_series.clear();
+    m_reductions.clear();
+    ++m_generation;
+    m_pendingResults.clear();
+    if (loading()) {
+        m_loading.clear();
+        emit loadingChanged();
+    }
+}
+
+TrendModel::Key TrendModel::currentKey() const
+{
+    return Key{m_analyte,
+               m_from.isValid() ? m_from.toMSecsSinceEpoch() : OPEN_FROM,
+               m_to.isValid() ? m_to.toMSecsSinceEpoch() : OPEN_TO,
+               m_width};
+}
+
+void TrendModel::update()
+{
+    Reduction reduction;
+    const Key key = currentKey();
+    if (const Reduction *cached = m_reductions.object(key)) {
+        reduction = *cached;
+    } else if (const Series *loaded = m_analyte >= 0 ? series(m_analyte) : nullptr) {
+        // No points until the series has been read
+        const Series &data = *loaded;
+        const auto begin = std::lower_bound(data.times.cbegin(), data.times.cend(), double(key.from));
+        const auto end = std::upper_bound(begin, data.times.cend(), double(key.to));
+        const qsizetype first = begin - data.times.cbegin();
+        const qsizetype count = end - begin;
+
+        downsample(data.times.constData() + first, data.values.constData() + first, count, key.width,
+                   reduction.points);
+        reduction.sourceCount = count;
+        // From every point in range, not only the kept ones, so the axis
+        // does not move as the chart is zoomed
+        if (count > 0) {
+            const auto [low, high] = std::minmax_element(data.values.cbegin() + first,
+                                                         data.values.cbegin() + first + count);
+            reduction.minValue = *low;
+            reduction.maxValue = *high;
+        }
+        m_reductions.insert(key, new Reduction(reduction), qMax(qsizetype(1), reduction.points.size()));
+    }
+
+    beginResetModel();
+    m_points = reduction.points;
+    m_sourceCount = reduction.sourceCount;
+    m_minValue = reduction.minValue;
+    m_maxValue = reduction.maxValue;
+    endResetModel();
+    emit pointsChanged();
+}
+
+void TrendModel::invalidate(int analyte, double time)
+{
+    const QList<Key> keys = m_reductions.keys();
+    for (const Key &key : keys) {
+        if (key.analyte == analyte && time >= double(key.from) && time <= double(key.to)) {
+            m_reductions.remove(key);
+        }
+    }
+}
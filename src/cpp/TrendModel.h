@@ -0,0 +1,158 @@
+#ifndef TRENDMODEL_H
+#define TRENDMODEL_H
+
+#include <QAbstractListModel>
+#include <QCache>
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QPointF>
+#include <QSet>
+#include <QThreadPool>
+#include <QVariantMap>
+
+#include <limits>
+
+// Time series of one analyte, for a patient or for every result of the
+// device, reduced with LTTB (largest triangle three buckets) to at most
+// one point per pixel of the chart, however long the series is.
+// Reductions are cached by (analyte, range, width), so switching back to
+// an analyte or a zoom level costs nothing. New results are appended to
+// the loaded series and drop only the cached reductions they fall into.
+// Series are read on a worker thread; the chart is empty, with loading
+// set, until the shown one arrives.
+class TrendModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(QString analyte READ analyte WRITE setAnalyte NOTIFY analyteChanged)
+    // Empty for the whole device
+    Q_PROPERTY(QString patientId READ patientId WRITE setPatientId NOTIFY patientIdChanged)
+    // Invalid for an open end
+    Q_PROPERTY(QDateTime from READ from WRITE setFrom NOTIFY rangeChanged)
+    Q_PROPERTY(QDateTime to READ to WRITE setTo NOTIFY rangeChanged)
+    // Chart width in pixels: the most points a reduction keeps
+    Q_PROPERTY(int width READ width WRITE setWidth NOTIFY widthChanged)
+    Q_PROPERTY(int count READ count NOTIFY pointsChanged)
+    // Points of the series within the range, before reduction
+    Q_PROPERTY(int sourceCount READ sourceCount NOTIFY pointsChanged)
+    Q_PROPERTY(double minValue READ minValue NOTIFY pointsChanged)
+    Q_PROPERTY(double maxValue READ maxValue NOTIFY pointsChanged)
+    // A series is being read
+    Q_PROPERTY(bool loading READ loading NOTIFY loadingChanged)
+
+public:
+    enum Roles {
+        TimeRole = Qt::UserRole + 1, // ms since the epoch
+        ValueRole
+    };
+
+    explicit TrendModel(QObject *parent = nullptr);
+    ~TrendModel();
+
+    // QAbstractListModel interface
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    QString analyte() const;
+    void setAnalyte(const QString &analyte);
+    QString patientId() const { return m_patientId; }
+    void setPatientId(const QString &patientId);
+    QDateTime from() const { return m_from; }
+    void setFrom(const QDateTime &from);
+    QDateTime to() const { return m_to; }
+    void setTo(const QDateTime &to);
+    int width() const { return m_width; }
+    void setWidth(int width);
+
+    int count() const { return int(m_points.size()); }
+    int sourceCount() const { return int(m_sourceCount); }
+    double minValue() const { return m_minValue; }
+    double maxValue() const { return m_maxValue; }
+    bool loading() const { return !m_loading.isEmpty(); }
+    // The shown points, x in ms since the epoch, for chart items
+    const QList<QPointF> &points() const { return m_points; }
+
+    // LTTB over count points (x ascending): keeps the first and last and
+    // one per bucket in between, at most threshold in all
+    static void downsample(const double *x, const float *y, qsizetype count, int threshold, QList<QPointF> &out);
+
+public slots:
+    // Reads the series again, e.g. after results were deleted
+    Q_INVOKABLE void reload();
+    // A result computed since the series were read
+    void addResult(const QVariantMap &result);
+
+signals:
+    void analyteChanged();
+    void patientIdChanged();
+    void rangeChanged();
+    void widthChanged();
+    void pointsChanged();
+    void loadingChanged();
+
+private:
+    // Time order; only results that have the analyte
+    struct Series {
+        QList<double> times;
+        QList<float> values;
+    };
+
+    struct Key {
+        int analyte;
+        qint64 from;
+        qint64 to;
+        int width;
+
+        friend bool operator==(const Key &a, const Key &b) = default;
+        friend size_t qHash(const Key &key, size_t seed = 0)
+        {
+            return qHashMulti(seed, key.analyte, key.from, key.to, key.width);
+        }
+    };
+
+    struct Reduction {
+        QList<QPointF> points;
+        qsizetype sourceCount = 0;
+        double minValue = 0.0;
+        double maxValue = 0.0;
+    };
+
+    // Null while the series is read
+    const Series *series(int analyte);
+    void onSeriesLoaded(int generation, int analyte, Series data);
+    // Drops the series, and ignores the reads in progress
+    void clearSeries();
+    Key currentKey() const;
+    void update();
+    void invalidate(int analyte, double time);
+
+    int m_analyte;
+    QString m_patientId;
+    QDateTime m_from;
+    QDateTime m_to;
+    int m_width;
+
+    // Read on first use, for m_patientId
+    QHash<int, Series> m_series;
+    // One read at a time, each on its own database connection
+    QThreadPool m_loadPool;
+    int m_generation;
+    QSet<int> m_loading;
+    // Results computed while series were read; the reads may miss them
+    QList<QVariantMap> m_pendingResults;
+    // Cost is the number of points
+    QCache<Key, Reduction> m_reductions;
+
+    QList<QPointF> m_points;
+    qsizetype m_sourceCount;
+    double m_minValue;
+    double m_maxValue;
+
+    static const int DEFAULT_WIDTH = 800;
+    static const int MAX_CACHED_POINTS = 256 * 1024;
+    static const qint64 OPEN_FROM = std::numeric_limits<qint64>::min();
+    static const qint64 OPEN_TO = std::numeric_limits<qint64>::max();
+};
+
+#endif // TRENDMODEL_H
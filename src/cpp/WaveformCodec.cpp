@@ -0,0 +1,141 @@
+#include "WaveformCodec.h"
+
+#include <QDebug>
+
+namespace {
+inline quint32 zigzag(qint32 value)
+{
+    return (quint32(value) << 1) ^ quint32(value >> 31);
+}
+
+inline qint32 unzigzag(quint32 value)
+{
+    return qint32(value >> 1) ^ -qint32(value & 1);
+}
+
+void putVarint(QByteArray &out, quint32 value)
+{
+    while (value >= 0x80) {
+        out.append(char(value | 0x80));
+        value >>= 7;
+    }
+    out.append(char(value));
+}
+
+bool getVarint(const char *&p, const char *end, quint32 &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        const quint8 byte = quint8(*p++);
+        value |= quint32(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+}
+
+namespace WaveformCodec {
+
+QByteArray encode(const Waveform &waveform, bool compress)
+{
+    QByteArray body;
+    qsizetype points = 0;
+    for (const Waveform::Channel &channel : waveform.channels) {
+        points += channel.microvolts.size();
+    }
+    body.reserve(16 + waveform.channels.size() * 16 + points * 2);
+
+    putVarint(body, quint32(qMax(0, waveform.samplePeriodUs)));
+    putVarint(body, quint32(waveform.channels.size()));
+    for (const Waveform::Channel &channel : waveform.channels) {
+        const QByteArray name = channel.name.toUtf8();
+        putVarint(body, quint32(name.size()));
+        body.append(name);
+        putVarint(body, quint32(channel.microvolts.size()));
+
+        qint32 previous = 0;
+        for (const qint32 value : channel.microvolts) {
+            // Wraps rather than overflows; decode wraps back
+            putVarint(body, zigzag(qint32(quint32(value) - quint32(previous))));
+            previous = value;
+        }
+    }
+
+    QByteArray blob;
+    if (compress) {
+        const QByteArray compressed = qCompress(body);
+        if (compressed.size() < body.size()) {
+            blob.reserve(1 + compressed.size());
+            blob.append(char(Version1 | Compressed));
+            blob.append(compressed);
+            return blob;
+        }
+    }
+    blob.reserve(1 + body.size());
+    blob.append(char(Version1));
+    blob.append(body);
+    return blob;
+}
+
+bool decode(const QByteArray &blob, Waveform &waveform)
+{
+    waveform = Waveform();
+    if (blob.isEmpty()) {
+        return false;
+    }
+
+    const quint8 flags = quint8(blob.at(0));
+    if ((flags & VersionMask) != Version1) {
+        qWarning() << "Unsupported waveform version" << (flags & VersionMask);
+        return false;
+    }
+
+    QByteArray body = blob.mid(1);
+    if (flags & Compressed) {
+        body = qUncompress(body);
+        if (body.isEmpty()) {
+            return false;
+        }
+    }
+
+    const char *p = body.constData();
+    const char *end = p + body.size();
+    quint32 periodUs;
+    quint32 channelCount;
+    if (!getVarint(p, end, periodUs) || !getVarint(p, end, channelCount)) {
+        return false;
+    }
+    waveform.samplePeriodUs = int(periodUs);
+
+    for (quint32 c = 0; c < channelCount; ++c) {
+        quint32 nameLength;
+        if (!getVarint(p, end, nameLength) || nameLength > quint32(end - p)) {
+            return false;
+        }
+        Waveform::Channel channel;
+        channel.name = QString::fromUtf8(p, qsizetype(nameLength));
+        p += nameLength;
+
+        // Every point takes at least a byte, which bounds a corrupt count
+        quint32 count;
+        if (!getVarint(p, end, count) || count > quint32(end - p)) {
+            return false;
+        }
+        channel.microvolts.reserve(qsizetype(count));
+        qint32 value = 0;
+        for (quint32 i = 0; i < count; ++i) {
+            quint32 delta;
+            if (!getVarint(p, end, delta)) {
+                return false;
+            }
+            value = qint32(quint32(value) + quint32(unzigzag(delta)));
+            channel.microvolts.append(value);
+        }
+        waveform.channels.append(channel);
+    }
+    return p == end;
+}
+
+} // namespace WaveformCodec
@@ -0,0 +1,44 @@
+#ifndef WAVEFORMCODEC_H
+#define WAVEFORMCODEC_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+// Raw electrode traces of one sample, in microvolts
+struct Waveform {
+    struct Channel {
+        QString name;
+        QList<qint32> microvolts;
+    };
+
+    int samplePeriodUs = 0;
+    QList<Channel> channels;
+
+    bool isEmpty() const { return channels.isEmpty(); }
+};
+
+// Compact blob encoding for archived waveforms.
+//
+//   flags (u8) | body, or qCompress(body) when flags & Compressed
+//   body: periodUs, channelCount, then per channel
+//         nameLength, name (UTF-8), count, first value, deltas...
+//
+// All integers are varints; values and deltas are zigzag-encoded first.
+// Electrode signals move slowly between decimated points, so most deltas
+// fit in one byte.
+namespace WaveformCodec {
+
+enum Flags : quint8 {
+    Version1 = 0x01,
+    VersionMask = 0x0F,
+    Compressed = 0x80
+};
+
+// qCompress is only kept when it actually makes the blob smaller
+QByteArray encode(const Waveform &waveform, bool compress = true);
+bool decode(const QByteArray &blob, Waveform &waveform);
+
+} // namespace WaveformCodec
+
+#endif // WAVEFORMCODEC_H
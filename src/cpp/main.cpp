@@ -4,7 +4,14 @@
 #include "DatabaseManager.h"
 #include "AuthenticationManager.h"
 #include "CalibrationManager.h"
+#include "QcEngine.h"
 #include "HL7Manager.h"
+#include "OrderWorklist.h"
+#include "SampleQueueModel.h"
+#include "ResultPipeline.h"
+#include "ReflagJob.h"
+#include "TrendModel.h"
+#include "TrendChartItem.h"
 
 #include <QApplication>
 #include <QQmlApplicationEngine>
@@ -30,6 +37,8 @@ int main(int argc, char *argv[])
     qmlRegisterType<AuthenticationManager>("AuthenticationManager", 1, 0, "AuthenticationManager");
     qmlRegisterType<CalibrationManager>("CalibrationManager", 1, 0, "CalibrationManager");
     qmlRegisterType<HL7Manager>("HL7Manager", 1, 0, "HL7Manager");
+    qmlRegisterUncreatableType<TrendModel>("TrendChart", 1, 0, "TrendModel", "Use the trendModel context property");
+    qmlRegisterType<TrendChartItem>("TrendChart", 1, 0, "TrendChart");
 
     // Create main controller
     BloodGasAnalyzer analyzer;
@@ -43,9 +52,17 @@ int main(int argc, char *argv[])
         // Expose C++ objects to QML
         eng.rootContext()->setContextProperty("bloodGasAnalyzer", &analyzer);
         eng.rootContext()->setContextProperty("historicalDataModel", analyzer.getHistoricalDataModel());
+        eng.rootContext()->setContextProperty("trendModel", analyzer.getTrendModel());
+        eng.rootContext()->setContextProperty("analyteDistributions", analyzer.getAnalyteDistributions());
+        eng.rootContext()->setContextProperty("patientDriftMonitor", analyzer.getPatientDriftMonitor());
         eng.rootContext()->setContextProperty("authManager", analyzer.getAuthenticationManager());
         eng.rootContext()->setContextProperty("calibrationManager", analyzer.getCalibrationManager());
+        eng.rootContext()->setContextProperty("qcEngine", analyzer.getCalibrationManager()->qcEngine());
         eng.rootContext()->setContextProperty("hl7Manager", analyzer.getHL7Manager());
+        eng.rootContext()->setContextProperty("orderWorklist", analyzer.getOrderWorklist());
+        eng.rootContext()->setContextProperty("sampleQueueModel", analyzer.getSampleQueueModel());
+        eng.rootContext()->setContextProperty("resultPipeline", analyzer.getResultPipeline());
+        eng.rootContext()->setContextProperty("reflagJob", analyzer.getReflagJob());
 
         Q_INIT_RESOURCE(qml);
         Q_INIT_RESOURCE(resources);
@@ -134,6 +134,46 @@ Rectangle {
                         }
                     }
                     
+                    // Recalibration recommended by patient-based QC
+                    Rectangle {
+                        visible: calibrationManager ? calibrationManager.recalibrationRecommended : false
+                        width: parent.width
+                        height: recommendationColumn.implicitHeight + 30
+                        color: "#FFF3E0"
+                        radius: 10
+                        border.color: window.accentColor
+                        border.width: 2
+                        
+                        Column {
+                            id: recommendationColumn
+                            anchors.centerIn: parent
+                            width: parent.width - 30
+                            spacing: 8
+                            
+                            Text {
+                                text: "Recalibration Recommended"
+                                font.pixelSize: 18
+                                font.bold: true
+                                color: window.primaryColor
+                            }
+                            
+                            Text {
+                                width: parent.width
+                                wrapMode: Text.WordWrap
+                                text: calibrationManager ? calibrationManager.recalibrationReason : ""
+                                font.pixelSize: 14
+                                color: "#666666"
+                            }
+                            
+                            TouchButton {
+                                text: "Calibrate Now"
+                                enabled: !calibrationInProgress
+                                useAccentColor: true
+                                onClicked: startCalibration(calibrationManager.recommendedCalibrationType)
+                            }
+                        }
+                    }
+                    
                     // Calibration controls
                     Rectangle {
                         width: parent.width
@@ -203,6 +243,150 @@ Rectangle {
                         }
                     }
                     
+                    // Quality control
+                    Rectangle {
+                        width: parent.width
+                        height: qcColumn.implicitHeight + 40
+                        color: "white"
+                        radius: 10
+                        border.color: qcEngine && qcEngine.isLocked ? window.errorColor : "#E0E0E0"
+                        border.width: qcEngine && qcEngine.isLocked ? 2 : 1
+                        
+                        Column {
+                            id: qcColumn
+                            anchors.centerIn: parent
+                            width: parent.width - 40
+                            spacing: 10
+                            
+                            RowLayout {
+                                width: parent.width
+                                
+                                Text {
+                                    Layout.fillWidth: true
+                                    text: "Quality Control"
+                                    font.pixelSize: 18
+                                    font.bold: true
+                                    color: window.primaryColor
+                                }
+                                
+                                Rectangle {
+                                    Layout.preferredWidth: 140
+                                    Layout.preferredHeight: 30
+                                    radius: 15
+                                    color: qcEngine && qcEngine.isLocked ? window.errorColor : window.successColor
+                                    
+                                    Text {
+                                        anchors.centerIn: parent
+                                        text: qcEngine && qcEngine.isLocked ? "Rejected" : "In Control"
+                                        color: "white"
+                                        font.pixelSize: 12
+                                        font.bold: true
+                                    }
+                                }
+                            }
+                            
+                            Text {
+                                visible: qcEngine ? qcEngine.isLocked : false
+                                width: parent.width
+                                wrapMode: Text.WordWrap
+                                text: qcEngine && !qcEngine.isLoaded
+                                      ? "Patient analysis is blocked: the QC history could not be read."
+                                      : "Patient analysis is blocked until a corrective action is recorded."
+                                font.pixelSize: 14
+                                color: window.errorColor
+                            }
+                            
+                            Repeater {
+                                model: qcEngine ? qcEngine.openViolations : []
+                                
+                                Text {
+                                    width: qcColumn.width
+                                    text: modelData.rule + "  Level " + modelData.level + "  " + modelData.analyte + 
+                                          "  " + Number(modelData.value).toFixed(2) + 
+                                          " (" + (modelData.z >= 0 ? "+" : "") + Number(modelData.z).toFixed(1) + " SD)"
+                                    font.pixelSize: 12
+                                    color: "#666666"
+                                }
+                            }
+                            
+                            RowLayout {
+                                visible: qcEngine ? qcEngine.isLocked && qcEngine.isLoaded : false
+                                width: parent.width
+                                spacing: 10
+                                
+                                TextField {
+                                    id: correctiveActionField
+                                    Layout.fillWidth: true
+                                    placeholderText: "Corrective action taken"
+                                    font.pixelSize: 14
+                                }
+                                
+                                TouchButton {
+                                    text: "Acknowledge"
+                                    enabled: correctiveActionField.text.trim().length > 0
+                                    onClicked: acknowledgeQc()
+                                }
+                            }
+                        }
+                    }
+                    
+                    // Patient-based QC: drift of patient results per analyte
+                    Rectangle {
+                        width: parent.width
+                        height: driftColumn.implicitHeight + 40
+                        color: "white"
+                        radius: 10
+                        border.color: "#E0E0E0"
+                        border.width: 1
+                        
+                        Column {
+                            id: driftColumn
+                            anchors.centerIn: parent
+                            width: parent.width - 40
+                            spacing: 10
+                            
+                            RowLayout {
+                                width: parent.width
+                                
+                                Text {
+                                    Layout.fillWidth: true
+                                    text: "Patient Result Drift"
+                                    font.pixelSize: 18
+                                    font.bold: true
+                                    color: window.primaryColor
+                                }
+                                
+                                TouchButton {
+                                    text: "Rebaseline"
+                                    enabled: !calibrationInProgress
+                                    onClicked: {
+                                        if (patientDriftMonitor) {
+                                            patientDriftMonitor.rebaseline()
+                                            window.showMessage("Patient QC baselines recalculated from stored results", "success")
+                                        }
+                                    }
+                                }
+                            }
+                            
+                            Repeater {
+                                model: patientDriftMonitor ? patientDriftMonitor.status : []
+                                
+                                Text {
+                                    width: driftColumn.width
+                                    text: modelData.analyte + "  baseline " + Number(modelData.baselineMean).toPrecision(4) +
+                                          " \u00B1 " + Number(modelData.baselineSd).toPrecision(3) +
+                                          (modelData.defaultBaseline ? " (built-in)" : "") +
+                                          "  moving average " + Number(modelData.ewma).toPrecision(4) +
+                                          "  n " + modelData.count +
+                                          (modelData.drift > 0 ? "  DRIFT HIGH" : modelData.drift < 0 ? "  DRIFT LOW" : "")
+                                    font.pixelSize: 12
+                                    font.bold: modelData.drift !== 0
+                                    color: modelData.drift !== 0 ? window.errorColor : "#666666"
+                                }
+                            }
+                        }
+                    }
+                    
                     // Calibration history
                     Rectangle {
                         width: parent.width
@@ -314,6 +498,13 @@ Rectangle {
         }
     }
     
+    function acknowledgeQc() {
+        if (qcEngine && qcEngine.acknowledgeViolations(bloodGasAnalyzer.currentUser, correctiveActionField.text)) {
+            correctiveActionField.text = ""
+            window.showMessage("QC violations acknowledged", "success")
+        }
+    }
+    
     // Handle calibration manager signals
     Connections {
         target: calibrationManager
@@ -175,6 +175,14 @@ Rectangle {
                             font.bold: true
                         }
                         
+                        Text {
+                            Layout.preferredWidth: 60
+                            text: "AG"
+                            color: "white"
+                            font.pixelSize: 12
+                            font.bold: true
+                        }
+                        
                         Text {
                             Layout.fillWidth: true
                             text: "Operator"
@@ -246,7 +254,7 @@ Rectangle {
                                 Layout.preferredWidth: 60
                                 text: pH ? pH.toFixed(2) : "N/A"
                                 font.pixelSize: 11
-                                color: getValueColor(pH, 7.35, 7.45)
+                                color: getFlagColor(fullData, "pH")
                                 horizontalAlignment: Text.AlignHCenter
                             }
                             
@@ -254,7 +262,7 @@ Rectangle {
                                 Layout.preferredWidth: 60
                                 text: pO2 ? pO2.toFixed(1) : "N/A"
                                 font.pixelSize: 11
-                                color: getValueColor(pO2, 80, 100)
+                                color: getFlagColor(fullData, "pO2")
                                 horizontalAlignment: Text.AlignHCenter
                             }
                             
@@ -262,7 +270,7 @@ Rectangle {
                                 Layout.preferredWidth: 60
                                 text: pCO2 ? pCO2.toFixed(1) : "N/A"
                                 font.pixelSize: 11
-                                color: getValueColor(pCO2, 35, 45)
+                                color: getFlagColor(fullData, "pCO2")
                                 horizontalAlignment: Text.AlignHCenter
                             }
                             
@@ -270,7 +278,16 @@ Rectangle {
                                 Layout.preferredWidth: 60
                                 text: HCO3 ? HCO3.toFixed(1) : "N/A"
                                 font.pixelSize: 11
-                                color: getValueColor(HCO3, 22, 28)
+                                color: getFlagColor(fullData, "HCO3")
+                                horizontalAlignment: Text.AlignHCenter
+                            }
+                            
+                            // Computed once per row by the model
+                            Text {
+                                Layout.preferredWidth: 60
+                                text: anionGap !== undefined ? anionGap.toFixed(1) : "N/A"
+                                font.pixelSize: 11
+                                color: getValueColor(anionGap, 8, 16)
                                 horizontalAlignment: Text.AlignHCenter
                             }
                             
@@ -370,7 +387,7 @@ Rectangle {
             // Details content
             ScrollView {
                 width: parent.width
-                height: parent.height - 100
+                height: parent.height - 100 - (waveformCanvas.visible ? waveformCanvas.height + 15 : 0)
                 clip: true
                 
                 Column {
@@ -383,10 +400,62 @@ Rectangle {
                     // This would be populated when showing details
                 }
             }
+            
+            // Raw electrode traces, each scaled to its own range
+            Canvas {
+                id: waveformCanvas
+                width: parent.width
+                height: 140
+                visible: waveform.channels !== undefined
+                
+                property var waveform: ({})
+                readonly property var colors: ["#1976D2", "#388E3C", "#F57C00", "#7B1FA2", "#C2185B",
+                                               "#0097A7", "#5D4037", "#FBC02D", "#455A64"]
+                
+                onWaveformChanged: requestPaint()
+                
+                onPaint: {
+                    var ctx = getContext("2d")
+                    ctx.reset()
+                    if (!waveform.channels) return
+                    
+                    ctx.font = "10px sans-serif"
+                    for (var c = 0; c < waveform.channels.length; c++) {
+                        var trace = waveform.channels[c].millivolts
+                        if (trace.length < 2) continue
+                        var low = Math.min.apply(null, trace)
+                        var high = Math.max.apply(null, trace)
+                        var span = Math.max(high - low, 0.001)
+                        
+                        ctx.strokeStyle = colors[c % colors.length]
+                        ctx.lineWidth = 1
+                        ctx.beginPath()
+                        for (var i = 0; i < trace.length; i++) {
+                            var x = i * width / (trace.length - 1)
+                            var y = height - 14 - (trace[i] - low) / span * (height - 18)
+                            if (i === 0) ctx.moveTo(x, y)
+                            else ctx.lineTo(x, y)
+                        }
+                        ctx.stroke()
+                        
+                        ctx.fillStyle = ctx.strokeStyle
+                        ctx.fillText(waveform.channels[c].name, c * width / waveform.channels.length, height - 2)
+                    }
+                }
+            }
         }
     }
     
     // Functions
+    // Flags stored with the result, from the patient's reference ranges
+    function getFlagColor(result, field) {
+        if (!result || !result[field]) return "#999999"
+        if ((result.lowFields || []).indexOf(field) >= 0 || (result.highFields || []).indexOf(field) >= 0) {
+            return window.errorColor
+        }
+        return "#333333"
+    }
+    
     function getValueColor(value, normalMin, normalMax) {
         if (!value) return "#999999"
         if (value < normalMin || value > normalMax) {
@@ -432,6 +501,7 @@ Rectangle {
         
         var result = historicalDataModel.getResult(index)
         if (!result) return
+        var derived = historicalDataModel.getDerived(index)
         
         // Clear previous content
         for (var i = detailsContent.children.length - 1; i >= 0; i--) {
@@ -456,7 +526,16 @@ Rectangle {
             {label: "Ca (mmol/L)", value: result.Ca ? result.Ca.toFixed(2) : "N/A"},
             {label: "Glucose (mg/dL)", value: result.Glucose ? result.Glucose.toFixed(1) : "N/A"},
             {label: "Lactate (mmol/L)", value: result.Lactate ? result.Lactate.toFixed(1) : "N/A"},
-            {label: "Temperature (°C)", value: result.temperature ? result.temperature.toFixed(1) : "N/A"}
+            {label: "Temperature (°C)", value: result.temperature ? result.temperature.toFixed(1) : "N/A"},
+            {label: "FiO₂ (%)", value: result.FiO2 ? (result.FiO2 > 1 ? result.FiO2 : result.FiO2 * 100).toFixed(0) : "21 (room air)"},
+            {label: "Anion Gap (mmol/L)", value: derived.anionGap !== undefined ? derived.anionGap.toFixed(1) : "N/A"},
+            {label: "AG alb. (mmol/L)", value: derived.anionGapAlbumin !== undefined ? derived.anionGapAlbumin.toFixed(1) : "N/A"},
+            {label: "A-a Gradient (mmHg)", value: derived.aaGradient !== undefined ? derived.aaGradient.toFixed(1) : "N/A"},
+            {label: "P/F Ratio", value: derived.pfRatio !== undefined ? derived.pfRatio.toFixed(0) : "N/A"},
+            {label: "Std HCO₃ (mmol/L)", value: derived.standardHCO3 !== undefined ? derived.standardHCO3.toFixed(1) : "N/A"},
+            {label: "pH (T)", value: derived.pHPatient !== undefined ? derived.pHPatient.toFixed(3) : "N/A"},
+            {label: "pCO₂ (T) (mmHg)", value: derived.pCO2Patient !== undefined ? derived.pCO2Patient.toFixed(1) : "N/A"},
+            {label: "pO₂ (T) (mmHg)", value: derived.pO2Patient !== undefined ? derived.pO2Patient.toFixed(1) : "N/A"}
         ]
         
         // Create UI elements for each detail
@@ -491,6 +570,9 @@ Rectangle {
                 }', detailsContent)
         }
         
+        // Traces are only read from the archive when a result is opened
+        waveformCanvas.waveform = historicalDataModel.getWaveform(index)
+        
         detailsDialog.visible = true
     }
     
@@ -56,6 +56,12 @@ Rectangle {
                     onClicked: window.navigateToView("history")
                 }
                 
+                TouchButton {
+                    width: parent.width
+                    text: "Trends"
+                    onClicked: window.navigateToView("trends")
+                }
+                
                 TouchButton {
                     width: parent.width
                     text: "Calibration"
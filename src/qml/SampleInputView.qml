@@ -9,6 +9,7 @@ Rectangle {
     color: "lightgrey" //window.backgroundColor
 
     property bool analysisInProgress: bloodGasAnalyzer ? bloodGasAnalyzer.isAnalyzing : false
+    property var currentOrder: ({})
     
     ColumnLayout {
         anchors.fill: parent
@@ -98,6 +99,36 @@ Rectangle {
                             opacity: 0.3
                         }
                         
+                        // Order lookup (barcode scan, accession or patient ID)
+                        Column {
+                            width: parent.width
+                            spacing: 5
+                            
+                            Text {
+                                text: "Order / Barcode"
+                                font.pixelSize: 14
+                                font.bold: true
+                                color: "#666666"
+                            }
+                            
+                            InputField {
+                                id: orderField
+                                width: parent.width
+                                placeholderText: "Scan or enter accession"
+                                icon: "🔍"
+                                onAccepted: lookupOrder(text)
+                            }
+                            
+                            Text {
+                                width: parent.width
+                                visible: orderField.text.length > 0
+                                text: describeOrder(currentOrder)
+                                font.pixelSize: 12
+                                color: currentOrder.accession || currentOrder.patientId ? "#333333" : window.errorColor
+                                wrapMode: Text.WordWrap
+                            }
+                        }
+                        
                         // Sample ID
                         Column {
                             width: parent.width
@@ -136,6 +167,32 @@ Rectangle {
                                 width: parent.width
                                 placeholderText: "Patient ID"
                                 icon: "👤"
+                                // Previous results are read while the sample is measured
+                                onEditingFinished: {
+                                    if (bloodGasAnalyzer && text.length > 0) {
+                                        bloodGasAnalyzer.prefetchPatientHistory(text)
+                                    }
+                                }
+                            }
+                        }
+                        
+                        // Specimen type picks the reference ranges
+                        Column {
+                            width: parent.width
+                            spacing: 5
+                            
+                            Text {
+                                text: "Specimen"
+                                font.pixelSize: 14
+                                font.bold: true
+                                color: "#666666"
+                            }
+                            
+                            ComboBox {
+                                id: specimenCombo
+                                width: parent.width
+                                model: ["Arterial", "Venous", "Capillary"]
+                                font.pixelSize: 14
                             }
                         }
                         
@@ -165,6 +222,59 @@ Rectangle {
                             }
                         }
                         
+                        // Inspired O2 and albumin, for the A-a gradient, P/F ratio and corrected anion gap
+                        Row {
+                            width: parent.width
+                            spacing: 10
+                            
+                            Column {
+                                width: (parent.width - parent.spacing) / 2
+                                spacing: 5
+                                
+                                Text {
+                                    text: "FiO₂ (%)"
+                                    font.pixelSize: 14
+                                    font.bold: true
+                                    color: "#666666"
+                                }
+                                
+                                InputField {
+                                    id: fiO2Field
+                                    width: parent.width
+                                    text: "21"
+                                    placeholderText: "21"
+                                    validator: DoubleValidator {
+                                        bottom: 21.0
+                                        top: 100.0
+                                        decimals: 0
+                                    }
+                                }
+                            }
+                            
+                            Column {
+                                width: (parent.width - parent.spacing) / 2
+                                spacing: 5
+                                
+                                Text {
+                                    text: "Albumin (g/dL)"
+                                    font.pixelSize: 14
+                                    font.bold: true
+                                    color: "#666666"
+                                }
+                                
+                                InputField {
+                                    id: albuminField
+                                    width: parent.width
+                                    placeholderText: "Optional"
+                                    validator: DoubleValidator {
+                                        bottom: 0.5
+                                        top: 7.0
+                                        decimals: 1
+                                    }
+                                }
+                            }
+                        }
+                        
                         Rectangle {
                             width: parent.width
                             height: 1
@@ -222,8 +332,8 @@ Rectangle {
                             
                             TouchButton {
                                 width: parent.width
-                                text: analysisInProgress ? "Analysis in Progress..." : "Start Analysis"
-                                enabled: !analysisInProgress && canStartAnalysis()
+                                text: analysisInProgress ? "Add to Queue" : "Start Analysis"
+                                enabled: canStartAnalysis()
                                 useAccentColor: true
                                 onClicked: startAnalysis()
                             }
@@ -238,10 +348,96 @@ Rectangle {
                             TouchButton {
                                 width: parent.width
                                 text: "Clear Form"
-                                enabled: !analysisInProgress
                                 onClicked: clearForm()
                             }
                         }
+                        
+                        Rectangle {
+                            visible: sampleQueueList.count > 0
+                            width: parent.width
+                            height: 1
+                            color: "#E0E0E0"
+                        }
+                        
+                        // Sample queue
+                        Column {
+                            visible: sampleQueueList.count > 0
+                            width: parent.width
+                            spacing: 5
+                            
+                            Text {
+                                text: "Sample Queue" + (sampleQueueModel && sampleQueueModel.pendingCount > 0 ?
+                                                        " (" + sampleQueueModel.pendingCount + " pending)" : "")
+                                font.pixelSize: 16
+                                font.bold: true
+                                color: "#666666"
+                            }
+                            
+                            ListView {
+                                id: sampleQueueList
+                                width: parent.width
+                                height: Math.min(contentHeight, 240)
+                                clip: true
+                                spacing: 4
+                                model: sampleQueueModel
+                                
+                                delegate: Rectangle {
+                                    width: sampleQueueList.width
+                                    height: 44
+                                    radius: 5
+                                    color: "white"
+                                    border.color: model.critical ? window.errorColor : "#E0E0E0"
+                                    border.width: model.critical ? 2 : 1
+                                    
+                                    // Measurement progress
+                                    Rectangle {
+                                        anchors.left: parent.left
+                                        anchors.top: parent.top
+                                        anchors.bottom: parent.bottom
+                                        anchors.margins: 1
+                                        width: (parent.width - 2) * model.progress / 100
+                                        radius: 5
+                                        color: window.primaryColor
+                                        opacity: model.stateName === "Measuring" ? 0.15 : 0
+                                    }
+                                    
+                                    RowLayout {
+                                        anchors.fill: parent
+                                        anchors.margins: 8
+                                        
+                                        Text {
+                                            Layout.fillWidth: true
+                                            text: model.sampleId + (model.patientId ? "  •  " + model.patientId : "")
+                                            font.pixelSize: 13
+                                            color: "#333333"
+                                            elide: Text.ElideRight
+                                        }
+                                        
+                                        Text {
+                                            text: model.stateName === "Measuring" ? model.progress + "%" : model.stateName
+                                            font.pixelSize: 12
+                                            font.bold: true
+                                            color: model.stateName === "Completed" ? window.successColor :
+                                                   (model.stateName === "Failed" || model.stateName === "Cancelled") ? window.errorColor :
+                                                   window.primaryColor
+                                        }
+                                        
+                                        Text {
+                                            visible: model.stateName === "Queued" || model.stateName === "Measuring"
+                                            text: "×"
+                                            font.pixelSize: 18
+                                            color: "#666666"
+                                            
+                                            MouseArea {
+                                                anchors.fill: parent
+                                                anchors.margins: -8
+                                                onClicked: sampleQueueModel.cancel(model.queueId)
+                                            }
+                                        }
+                                    }
+                                }
+                            }
+                        }
                     }
                 }
             }
@@ -348,22 +544,25 @@ Rectangle {
                             id: resultsColumn
                             width: parent.width
                             spacing: 15
-                            visible: !analysisInProgress && resultsAvailable
+                            visible: resultsAvailable
                             
                             property bool resultsAvailable: false
                             property var currentResults: null
+                            // The patient's results before this one, prefetched
+                            property var patientHistory: null
                             
                             // Blood Gas section
                             Rectangle {
                                 visible: bloodGasCheck.checked && parent.resultsAvailable
                                 width: parent.width
-                                height: bloodGasGrid.implicitHeight + 30
+                                height: bloodGasContent.implicitHeight + 30
                                 color: "#F8F9FA"
                                 radius: 8
                                 border.color: "#E0E0E0"
                                 border.width: 1
                                 
                                 Column {
+                                    id: bloodGasContent
                                     anchors.fill: parent
                                     anchors.margins: 15
                                     spacing: 10
@@ -375,6 +574,60 @@ Rectangle {
                                         color: window.primaryColor
                                     }
                                     
+                                    Text {
+                                        visible: text.length > 0
+                                        text: resultsColumn.currentResults && resultsColumn.currentResults.interpretation
+                                              ? resultsColumn.currentResults.interpretation : ""
+                                        font.pixelSize: 13
+                                        color: "#333333"
+                                    }
+                                    
+                                    // Implausible change since the patient's previous result
+                                    Text {
+                                        width: parent.width
+                                        visible: text.length > 0
+                                        text: resultsColumn.currentResults && resultsColumn.currentResults.deltaFields &&
+                                              resultsColumn.currentResults.deltaFields.length > 0
+                                              ? "Delta check failed: " + resultsColumn.currentResults.deltaFields.join(", ")
+                                              : ""
+                                        font.pixelSize: 13
+                                        font.bold: true
+                                        color: window.errorColor
+                                        wrapMode: Text.WordWrap
+                                    }
+                                    
+                                    // The patient's previous results could not be read
+                                    Text {
+                                        width: parent.width
+                                        visible: resultsColumn.currentResults ? resultsColumn.currentResults.deltaChecked === false : false
+                                        text: "Delta check not done: previous results unavailable"
+                                        font.pixelSize: 13
+                                        color: window.accentColor
+                                        wrapMode: Text.WordWrap
+                                    }
+                                    
+                                    // Electrodes that never reached a plateau, or still run on
+                                    // their nominal calibration
+                                    Text {
+                                        width: parent.width
+                                        visible: text.length > 0
+                                        text: {
+                                            var results = resultsColumn.currentResults
+                                            if (!results)
+                                                return ""
+                                            var lines = []
+                                            if (results.unsettledFields && results.unsettledFields.length > 0)
+                                                lines.push("Not settled: " + results.unsettledFields.join(", "))
+                                            if (results.uncalibratedFields && results.uncalibratedFields.length > 0)
+                                                lines.push("Not calibrated: " + results.uncalibratedFields.join(", "))
+                                            return lines.join("\n")
+                                        }
+                                        font.pixelSize: 13
+                                        font.bold: true
+                                        color: window.errorColor
+                                        wrapMode: Text.WordWrap
+                                    }
+                                    
                                     Grid {
                                         id: bloodGasGrid
                                         width: parent.width
@@ -496,6 +749,68 @@ Rectangle {
                                 }
                             }
                             
+                            // Comparison with the patient's previous results
+                            Rectangle {
+                                visible: parent.resultsAvailable && parent.patientHistory !== null &&
+                                         parent.patientHistory.count > 0
+                                width: parent.width
+                                height: historyContent.implicitHeight + 30
+                                color: "#F8F9FA"
+                                radius: 8
+                                border.color: "#E0E0E0"
+                                border.width: 1
+                                
+                                Column {
+                                    id: historyContent
+                                    anchors.fill: parent
+                                    anchors.margins: 15
+                                    spacing: 10
+                                    
+                                    Text {
+                                        text: "Previous Results" + (resultsColumn.patientHistory
+                                              ? " (" + resultsColumn.patientHistory.count + ")" : "")
+                                        font.pixelSize: 16
+                                        font.bold: true
+                                        color: window.primaryColor
+                                    }
+                                    
+                                    Text {
+                                        visible: text.length > 0
+                                        text: describeLastResultTime(resultsColumn.patientHistory)
+                                        font.pixelSize: 12
+                                        color: "#666666"
+                                    }
+                                    
+                                    Grid {
+                                        width: parent.width
+                                        columns: 4
+                                        columnSpacing: 20
+                                        rowSpacing: 6
+                                        
+                                        Repeater {
+                                            model: ["", "Now", "Previous", "Range"]
+                                            Text {
+                                                text: modelData
+                                                font.pixelSize: 12
+                                                font.bold: true
+                                                color: "#666666"
+                                            }
+                                        }
+                                        
+                                        Repeater {
+                                            model: historyRows(resultsColumn.patientHistory)
+                                            Text {
+                                                text: modelData.text
+                                                font.pixelSize: 13
+                                                font.bold: modelData.column === 1
+                                                color: modelData.column === 1 && modelData.changed
+                                                       ? window.errorColor : "#333333"
+                                            }
+                                        }
+                                    }
+                                }
+                            }
+                            
                             // Additional parameters would go here...
                             // (Electrolytes, Metabolites sections similar to Blood Gas)
                             
@@ -550,7 +865,33 @@ Rectangle {
                String(now.getMonth() + 1).padStart(2, '0') +
                String(now.getDate()).padStart(2, '0') +
                String(now.getHours()).padStart(2, '0') +
-               String(now.getMinutes()).padStart(2, '0')
+               String(now.getMinutes()).padStart(2, '0') +
+               String(now.getSeconds()).padStart(2, '0')
+    }
+    
+    function lookupOrder(code) {
+        currentOrder = orderWorklist ? orderWorklist.lookup(code) : {}
+        if (currentOrder.patientId) {
+            patientIdField.text = currentOrder.patientId
+            if (bloodGasAnalyzer) {
+                bloodGasAnalyzer.prefetchPatientHistory(currentOrder.patientId)
+            }
+        }
+        if (currentOrder.barcode) {
+            sampleIdField.text = currentOrder.barcode
+        }
+    }
+    
+    function describeOrder(order) {
+        if (!order.accession && !order.patientId) {
+            return "No matching order in worklist"
+        }
+        var name = [order.lastName, order.firstName].filter(function(part) { return part }).join(", ")
+        var details = [name, order.birthDate, order.sex, order.location].filter(function(part) { return part })
+        if (order.accession) {
+            details.push("Order " + order.accession + (order.testName ? " (" + order.testName + ")" : ""))
+        }
+        return details.join(" • ")
     }
     
     function canStartAnalysis() {
@@ -560,20 +901,36 @@ Rectangle {
     }
     
     function startAnalysis() {
-        if (!bloodGasAnalyzer || analysisInProgress) return
+        if (!bloodGasAnalyzer) return
         
         var sampleData = {
             "sampleId": sampleIdField.text,
             "patientId": patientIdField.text,
+            "accession": currentOrder.accession || "",
+            "specimen": specimenCombo.currentText.toLowerCase(),
+            "sex": currentOrder.sex || "",
+            "birthDate": currentOrder.birthDate || "",
             "temperature": parseFloat(temperatureField.text),
+            "FiO2": fiO2Field.text.length > 0 ? parseFloat(fiO2Field.text) / 100.0 : 0.21,
             "bloodGas": bloodGasCheck.checked,
             "electrolytes": electrolyteCheck.checked,
             "metabolites": metaboliteCheck.checked,
             "timestamp": new Date().toISOString()
         }
+        if (albuminField.text.length > 0) {
+            sampleData["albumin"] = parseFloat(albuminField.text)
+        }
         
-        bloodGasAnalyzer.startAnalysis(sampleData)
-        window.showMessage("Analysis started...", "info")
+        var queued = analysisInProgress
+        if (bloodGasAnalyzer.startAnalysis(sampleData) > 0) {
+            window.showMessage(queued ? "Sample " + sampleData.sampleId + " queued" : "Analysis started...", "info")
+            
+            // Ready for the next sample right away
+            sampleIdField.text = generateSampleId()
+            patientIdField.text = ""
+            orderField.text = ""
+            currentOrder = {}
+        }
     }
     
     function stopAnalysis() {
@@ -586,12 +943,18 @@ Rectangle {
     function clearForm() {
         sampleIdField.text = generateSampleId()
         patientIdField.text = ""
+        orderField.text = ""
+        currentOrder = {}
+        specimenCombo.currentIndex = 0
         temperatureField.text = "37.0"
+        fiO2Field.text = "21"
+        albuminField.text = ""
         bloodGasCheck.checked = true
         electrolyteCheck.checked = true
         metaboliteCheck.checked = true
         resultsColumn.resultsAvailable = false
         resultsColumn.currentResults = null
+        resultsColumn.patientHistory = null
     }
     
     function getResultValue(parameter) {
@@ -606,22 +969,55 @@ Rectangle {
             return "#E0E0E0"
         }
         
-        var value = resultsColumn.currentResults[parameter]
-        var normal = false
+        // Flagged against the patient's reference ranges by the analyzer
+        var results = resultsColumn.currentResults
+        var abnormal = (results.lowFields || []).indexOf(parameter) >= 0 ||
+                       (results.highFields || []).indexOf(parameter) >= 0
         
-        switch(parameter) {
-            case "pH":
-                normal = value >= 7.35 && value <= 7.45
-                break
-            case "pO2":
-                normal = value >= 80 && value <= 100
-                break
-            case "pCO2":
-                normal = value >= 35 && value <= 45
-                break
+        return abnormal ? window.errorColor : window.successColor
+    }
+    
+    // Cells of the comparison grid, row by row: analyte, now, previous, range
+    function historyRows(history) {
+        var cells = []
+        if (!history || !history.trends) {
+            return cells
         }
-        
-        return normal ? window.successColor : window.errorColor
+        var analytes = [["pH", "pH", 3], ["pCO2", "pCO₂", 1], ["pO2", "pO₂", 1], ["HCO3", "HCO₃", 1],
+                        ["Na", "Na⁺", 0], ["K", "K⁺", 1], ["Cl", "Cl⁻", 0], ["Ca", "Ca²⁺", 2],
+                        ["Glucose", "Glucose", 0], ["Lactate", "Lactate", 1]]
+        var results = resultsColumn.currentResults || {}
+        var deltaFields = results.deltaFields || []
+        for (var i = 0; i < analytes.length; ++i) {
+            var field = analytes[i][0]
+            var decimals = analytes[i][2]
+            var trend = history.trends[field]
+            if (!trend) {
+                continue
+            }
+            var now = results[field]
+            cells.push({ "column": 0, "text": analytes[i][1] })
+            cells.push({ "column": 1, "text": now !== undefined ? now.toFixed(decimals) : "–",
+                         "changed": deltaFields.indexOf(field) >= 0 })
+            cells.push({ "column": 2, "text": trend.latest.toFixed(decimals) })
+            cells.push({ "column": 3, "text": trend.count > 1
+                         ? trend.min.toFixed(decimals) + "–" + trend.max.toFixed(decimals) : "" })
+        }
+        return cells
+    }
+    
+    function describeLastResultTime(history) {
+        if (!history || !history.results || history.results.length === 0) {
+            return ""
+        }
+        var minutes = Math.round((new Date() - new Date(history.results[0].timestamp)) / 60000)
+        if (minutes < 60) {
+            return "Last result " + minutes + " min ago"
+        }
+        if (minutes < 48 * 60) {
+            return "Last result " + Math.round(minutes / 60) + " h ago"
+        }
+        return "Last result " + Math.round(minutes / (24 * 60)) + " days ago"
     }
     
     function printResults() {
@@ -645,10 +1041,28 @@ Rectangle {
     // Handle analysis completion
     Connections {
         target: bloodGasAnalyzer
+        function onChannelGroupCompleted(queueId, group, values) {
+            // Channels appear as they settle, ahead of the complete record
+            resultsColumn.currentResults = bloodGasAnalyzer.liveResults
+            resultsColumn.patientHistory = bloodGasAnalyzer.patientHistory(resultsColumn.currentResults.patientId || "")
+            resultsColumn.resultsAvailable = true
+        }
         function onAnalysisCompleted(results) {
             resultsColumn.currentResults = results
+            resultsColumn.patientHistory = bloodGasAnalyzer.patientHistory(results.patientId || "")
             resultsColumn.resultsAvailable = true
-            window.showMessage("Analysis completed successfully!", "success")
+        }
+        function onPatientHistoryReady(patientId, history) {
+            // Only when the read was slower than the measurement; a later
+            // prefetch for the same patient already includes this result
+            var results = resultsColumn.currentResults
+            var shown = resultsColumn.patientHistory
+            if (results && results.patientId === patientId && (!shown || !shown.patientId)) {
+                resultsColumn.patientHistory = history
+            }
+        }
+        function onAnalysisFinalized(results) {
+            window.showMessage("Analysis of " + results.sampleId + " completed", "success")
         }
         function onAnalysisError(error) {
             resultsColumn.resultsAvailable = false
@@ -0,0 +1,267 @@
+import QtQuick
+import QtQuick.Controls
+import QtQuick.Layouts
+import TrendChart 1.0
+import "components"
+
+
+Rectangle {
+    id: root
+    color: "lightgrey" //window.backgroundColor
+    
+    readonly property var analytes: [
+        { "field": "pH", "label": "pH", "decimals": 3 },
+        { "field": "pCO2", "label": "pCO₂ (mmHg)", "decimals": 1 },
+        { "field": "pO2", "label": "pO₂ (mmHg)", "decimals": 1 },
+        { "field": "HCO3", "label": "HCO₃ (mmol/L)", "decimals": 1 },
+        { "field": "BE", "label": "BE (mmol/L)", "decimals": 1 },
+        { "field": "Na", "label": "Na⁺ (mmol/L)", "decimals": 0 },
+        { "field": "K", "label": "K⁺ (mmol/L)", "decimals": 1 },
+        { "field": "Cl", "label": "Cl⁻ (mmol/L)", "decimals": 0 },
+        { "field": "Ca", "label": "Ca²⁺ (mmol/L)", "decimals": 2 },
+        { "field": "Glucose", "label": "Glucose (mg/dL)", "decimals": 0 },
+        { "field": "Lactate", "label": "Lactate (mmol/L)", "decimals": 1 }
+    ]
+    readonly property int decimals: analytes[analyteCombo.currentIndex].decimals
+    
+    ColumnLayout {
+        anchors.fill: parent
+        anchors.margins: 20
+        spacing: 20
+        
+        // Header
+        Rectangle {
+            Layout.fillWidth: true
+            Layout.preferredHeight: 80
+            color: "lightgrey" //window.surfaceColor
+            radius: 10
+            border.color: window.primaryColor
+            border.width: 2
+            
+            RowLayout {
+                anchors.fill: parent
+                anchors.margins: 20
+                
+                TouchButton {
+                    text: "← Back"
+                    onClicked: stackView.pop()
+                }
+                
+                Text {
+                    Layout.fillWidth: true
+                    text: "Trends"
+                    font.pixelSize: 24
+                    font.bold: true
+                    color: window.primaryColor
+                    horizontalAlignment: Text.AlignHCenter
+                }
+                
+                TouchButton {
+                    text: "Reset View"
+                    onClicked: resetView()
+                }
+            }
+        }
+        
+        // Series selection
+        Rectangle {
+            Layout.fillWidth: true
+            Layout.preferredHeight: 100
+            color: "lightgrey" //window.surfaceColor
+            radius: 10
+            border.color: "#E0E0E0"
+            border.width: 1
+            
+            RowLayout {
+                anchors.fill: parent
+                anchors.margins: 15
+                spacing: 15
+                
+                InputField {
+                    id: patientField
+                    Layout.preferredWidth: 200
+                    placeholderText: "Patient ID (all if empty)"
+                    icon: "👤"
+                    onEditingFinished: {
+                        if (trendModel) {
+                            trendModel.patientId = text
+                            resetView()
+                        }
+                    }
+                }
+                
+                ComboBox {
+                    id: analyteCombo
+                    Layout.preferredWidth: 200
+                    model: root.analytes.map(function(analyte) { return analyte.label })
+                    font.pixelSize: 14
+                    onActivated: {
+                        if (trendModel) {
+                            trendModel.analyte = root.analytes[currentIndex].field
+                            resetView()
+                        }
+                    }
+                }
+                
+                ComboBox {
+                    id: styleCombo
+                    Layout.preferredWidth: 140
+                    model: ["Line", "Scatter"]
+                    font.pixelSize: 14
+                }
+                
+                Item { Layout.fillWidth: true }
+                
+                Text {
+                    text: trendModel ? trendModel.sourceCount + " results" +
+                                       (trendModel.count < trendModel.sourceCount ? " (" + trendModel.count + " shown)" : "")
+                                     : ""
+                    font.pixelSize: 14
+                    color: "#666666"
+                }
+            }
+        }
+        
+        // Chart
+        Rectangle {
+            Layout.fillWidth: true
+            Layout.fillHeight: true
+            color: "white"
+            radius: 10
+            border.color: "#E0E0E0"
+            border.width: 1
+            
+            Text {
+                anchors.left: parent.left
+                anchors.top: chart.top
+                anchors.leftMargin: 10
+                text: chart.yMax.toFixed(root.decimals)
+                font.pixelSize: 12
+                color: "#666666"
+            }
+            
+            Text {
+                anchors.left: parent.left
+                anchors.bottom: chart.bottom
+                anchors.leftMargin: 10
+                text: chart.yMin.toFixed(root.decimals)
+                font.pixelSize: 12
+                color: "#666666"
+            }
+            
+            Text {
+                anchors.left: chart.left
+                anchors.top: chart.bottom
+                anchors.topMargin: 5
+                text: formatTime(chart.xMin)
+                font.pixelSize: 12
+                color: "#666666"
+            }
+            
+            Text {
+                anchors.right: chart.right
+                anchors.top: chart.bottom
+                anchors.topMargin: 5
+                text: formatTime(chart.xMax)
+                font.pixelSize: 12
+                color: "#666666"
+            }
+            
+            TrendChart {
+                id: chart
+                anchors.fill: parent
+                anchors.leftMargin: 70
+                anchors.rightMargin: 20
+                anchors.topMargin: 20
+                anchors.bottomMargin: 40
+                model: trendModel
+                color: window.primaryColor
+                seriesStyle: styleCombo.currentIndex === 0 ? TrendChart.Line : TrendChart.Scatter
+                
+                // One point per pixel at most
+                onWidthChanged: {
+                    if (trendModel) {
+                        trendModel.width = Math.round(width)
+                    }
+                }
+                
+                // Only the transform changes while panning and zooming; the
+                // model reduces the new range once the gesture has settled
+                onViewChanged: {
+                    if (!followData) {
+                        rangeTimer.restart()
+                    }
+                }
+                
+                DragHandler {
+                    id: dragHandler
+                    target: null
+                    property point previous: Qt.point(0, 0)
+                    onActiveChanged: previous = Qt.point(0, 0)
+                    onTranslationChanged: {
+                        chart.pan(translation.x - previous.x, translation.y - previous.y)
+                        previous = Qt.point(translation.x, translation.y)
+                    }
+                }
+                
+                PinchHandler {
+                    target: null
+                    property real previousScale: 1.0
+                    onActiveChanged: previousScale = 1.0
+                    onActiveScaleChanged: {
+                        chart.zoom(activeScale / previousScale, centroid.position.x)
+                        previousScale = activeScale
+                    }
+                }
+                
+                WheelHandler {
+                    target: null
+                    onWheel: function(event) {
+                        chart.zoom(event.angleDelta.y > 0 ? 1.25 : 0.8, point.position.x)
+                    }
+                }
+            }
+            
+            Text {
+                anchors.centerIn: chart
+                visible: trendModel ? trendModel.count === 0 : true
+                text: trendModel && trendModel.loading ? "Loading results..." : "No results to chart"
+                font.pixelSize: 16
+                color: "#999999"
+            }
+        }
+    }
+    
+    Timer {
+        id: rangeTimer
+        interval: 300
+        onTriggered: {
+            if (trendModel && !chart.followData) {
+                trendModel.from = new Date(chart.xMin)
+                trendModel.to = new Date(chart.xMax)
+            }
+        }
+    }
+    
+    // Functions
+    function resetView() {
+        rangeTimer.stop()
+        if (trendModel) {
+            trendModel.from = new Date(NaN)
+            trendModel.to = new Date(NaN)
+        }
+        chart.resetView()
+    }
+    
+    function formatTime(ms) {
+        return Qt.formatDateTime(new Date(ms), "yyyy-MM-dd hh:mm")
+    }
+    
+    Component.onCompleted: {
+        if (trendModel) {
+            trendModel.analyte = analytes[analyteCombo.currentIndex].field
+            trendModel.width = Math.round(chart.width)
+            resetView()
+        }
+    }
+}
@@ -19,6 +19,8 @@ Rectangle {
     property int fontSize: 16
     
     signal accepted()
+    // Return pressed or focus lost
+    signal editingFinished()
     // signal textChanged()
     
     // Touch-friendly sizing
@@ -83,6 +85,7 @@ Rectangle {
                 }
                 
                 onAccepted: root.accepted()
+                onEditingFinished: root.editingFinished()
                 onTextChanged: root.textChanged()
                 
                 // Handle touch events
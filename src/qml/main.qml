@@ -219,6 +219,9 @@ ApplicationWindow {
             case "sample":
                 stackView.push("qrc:/src/qml/SampleInputView.qml")
                 break
+            case "trends":
+                stackView.push("qrc:/src/qml/TrendView.qml")
+                break
             default:
                 console.log("Unknown view:", viewName)
         }
@@ -244,5 +247,10 @@ ApplicationWindow {
         function onCalibrationFailed(reason) {
             showMessage("Calibration failed: " + reason, "error")
         }
+        function onRecalibrationRecommendedChanged() {
+            if (calibrationManager.recalibrationRecommended) {
+                showMessage("Drift detected in patient results; recalibration recommended", "warning")
+            }
+        }
     }
 }
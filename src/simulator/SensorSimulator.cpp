@@ -0,0 +1,284 @@
+// Sensor board simulator. Opens a pseudo-terminal and streams framed
+// electrode signals on it (see SensorProtocol.h) at a fixed sample rate,
+// so the analyzer's device layer can be exercised and benchmarked without
+// hardware. Point the analyzer at it with BGA_SENSOR_DEVICE=<link>.
+
+#include "SensorProtocol.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <random>
+#include <termios.h>
+#include <unistd.h>
+
+using namespace SensorProtocol;
+
+class SensorSimulator : public QObject
+{
+public:
+    SensorSimulator(int sampleRate, int frameSamples, double noiseUv)
+        : m_masterFd(-1)
+        , m_slaveFd(-1)
+        , m_sampleRate(sampleRate)
+        , m_frameSamples(frameSamples)
+        , m_noiseUv(noiseUv)
+        , m_sequence(0)
+        , m_samplesSent(0)
+        , m_measurementId(0)
+        , m_overruns(0)
+        , m_random(std::random_device{}())
+    {
+        for (int channel = 0; channel < CHANNEL_COUNT; ++channel) {
+            const double calibrant = toMillivolts(ELECTRODES[channel], ELECTRODES[channel].calibrantValue);
+            m_channels[channel] = Channel{calibrant, calibrant, 0};
+        }
+    }
+
+    ~SensorSimulator()
+    {
+        if (!m_linkPath.isEmpty()) {
+            QFile::remove(m_linkPath);
+        }
+        if (m_slaveFd >= 0) {
+            ::close(m_slaveFd);
+        }
+        if (m_masterFd >= 0) {
+            ::close(m_masterFd);
+        }
+    }
+
+    bool open(const QString &linkPath)
+    {
+        m_masterFd = ::posix_openpt(O_RDWR | O_NOCTTY);
+        if (m_masterFd < 0 || ::grantpt(m_masterFd) != 0 || ::unlockpt(m_masterFd) != 0) {
+            qCritical() << "Failed to create pseudo-terminal:" << std::strerror(errno);
+            return false;
+        }
+        const QString slavePath = QString::fromLocal8Bit(::ptsname(m_masterFd));
+
+        // Raw mode so frames pass through the line discipline untouched
+        termios tio;
+        if (::tcgetattr(m_masterFd, &tio) == 0) {
+            ::cfmakeraw(&tio);
+            ::tcsetattr(m_masterFd, TCSANOW, &tio);
+        }
+        ::fcntl(m_masterFd, F_SETFL, ::fcntl(m_masterFd, F_GETFL) | O_NONBLOCK);
+
+        // Holding the slave open keeps the pty alive across analyzer restarts
+        m_slaveFd = ::open(slavePath.toLocal8Bit().constData(), O_RDWR | O_NOCTTY);
+
+        if (!linkPath.isEmpty()) {
+            QFile::remove(linkPath);
+            if (QFile::link(slavePath, linkPath)) {
+                m_linkPath = linkPath;
+            } else {
+                qWarning() << "Failed to create link" << linkPath;
+            }
+        }
+
+        auto *notifier = new QSocketNotifier(m_masterFd, QSocketNotifier::Read, this);
+        connect(notifier, &QSocketNotifier::activated, this, [this]() { readCommands(); });
+
+        qInfo().noquote() << "Sensor simulator on" << slavePath
+                          << (m_linkPath.isEmpty() ? QString() : "(" + m_linkPath + ")")
+                          << "-" << m_sampleRate << "samples/s x" << CHANNEL_COUNT << "channels,"
+                          << m_frameSamples << "samples per frame";
+        return true;
+    }
+
+    void start()
+    {
+        m_clock.start();
+
+        auto *tick = new QTimer(this);
+        tick->setTimerType(Qt::PreciseTimer);
+        tick->setInterval(qMax(1, m_frameSamples * 1000 / m_sampleRate));
+        connect(tick, &QTimer::timeout, this, [this]() { produce(); });
+        tick->start();
+
+        auto *report = new QTimer(this);
+        report->setInterval(REPORT_INTERVAL_MS);
+        connect(report, &QTimer::timeout, this, [this]() {
+            qInfo() << "frames" << m_sequence << "overruns" << m_overruns << "pending bytes" << m_pending.size();
+        });
+        report->start();
+    }
+
+private:
+    // Each electrode relaxes exponentially from where it was towards the
+    // potential for the fluid in front of it
+    struct Channel {
+        double startMv;
+        double targetMv;
+        qint64 changedUs;
+    };
+
+    // Emits every sample that is due by now, so timer jitter changes frame
+    // timing but never the sample rate
+    void produce()
+    {
+        const qint64 nowUs = m_clock.nsecsElapsed() / 1000;
+        const qint64 due = nowUs * m_sampleRate / 1000000;
+        while (m_samplesSent + m_frameSamples <= due) {
+            appendSamplesFrame();
+        }
+        flush();
+    }
+
+    void appendSamplesFrame()
+    {
+        const int payloadSize = SAMPLES_HEADER_SIZE + m_frameSamples * CHANNEL_COUNT * 4;
+        m_payload.resize(payloadSize);
+        char *p = m_payload.data();
+
+        const qint64 firstUs = m_samplesSent * 1000000 / m_sampleRate;
+        const qint64 deviceTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        qToLittleEndian<quint32>(m_sequence++, p);
+        qToLittleEndian<quint64>(quint64(deviceTimeUs), p + 4);
+        qToLittleEndian<quint32>(m_measurementId, p + 12);
+        p[16] = char(CHANNEL_COUNT);
+        qToLittleEndian<quint16>(quint16(m_frameSamples), p + 17);
+
+        std::normal_distribution<double> noise(0.0, qMax(m_noiseUv, 1e-9));
+        char *out = p + SAMPLES_HEADER_SIZE;
+        for (int sample = 0; sample < m_frameSamples; ++sample) {
+            const qint64 tUs = firstUs + sample * 1000000 / m_sampleRate;
+            for (int channel = 0; channel < CHANNEL_COUNT; ++channel) {
+                const Channel &c = m_channels[channel];
+                const double elapsedMs = (tUs - c.changedUs) / 1000.0;
+                const double mv = c.targetMv + (c.startMv - c.targetMv) *
+                                  std::exp(-qMax(0.0, elapsedMs) / ELECTRODES[channel].timeConstantMs);
+                qToLittleEndian<qint32>(qint32(std::lround(mv * 1000.0 + noise(m_random))), out);
+                out += 4;
+            }
+        }
+        m_samplesSent += m_frameSamples;
+
+        // A reader that falls behind loses whole frames, seen as sequence gaps
+        if (m_pending.size() > MAX_PENDING_BYTES) {
+            m_overruns++;
+            return;
+        }
+        appendFrame(m_pending, Samples, m_payload.constData(), m_payload.size());
+    }
+
+    void flush()
+    {
+        while (!m_pending.isEmpty()) {
+            const ssize_t n = ::write(m_masterFd, m_pending.constData(), size_t(m_pending.size()));
+            if (n <= 0) {
+                return; // pty buffer full; retried on the next tick
+            }
+            m_pending.remove(0, n);
+        }
+    }
+
+    void readCommands()
+    {
+        char chunk[256];
+        ssize_t n;
+        while ((n = ::read(m_masterFd, chunk, sizeof(chunk))) > 0) {
+            m_parser.append(chunk, n);
+        }
+
+        Frame frame;
+        while (m_parser.next(frame)) {
+            if (frame.type == StartMeasurement && frame.payload.size() >= 4) {
+                m_measurementId = qFromLittleEndian<quint32>(frame.payload.constData());
+                drawSample();
+            } else if (frame.type == StopMeasurement) {
+                m_measurementId = 0;
+                for (int channel = 0; channel < CHANNEL_COUNT; ++channel) {
+                    retarget(channel, ELECTRODES[channel].calibrantValue);
+                }
+            }
+        }
+    }
+
+    // A patient sample: mostly normal values with the occasional outlier
+    void drawSample()
+    {
+        static const std::array<std::pair<double, double>, CHANNEL_COUNT> population = {{
+            {7.40, 0.06}, {40.0, 7.0}, {95.0, 15.0},
+            {140.0, 3.5}, {4.2, 0.5}, {103.0, 3.5}, {2.45, 0.15},
+            {100.0, 20.0}, {1.3, 0.7}
+        }};
+        for (int channel = 0; channel < CHANNEL_COUNT; ++channel) {
+            std::normal_distribution<double> value(population[channel].first, population[channel].second);
+            retarget(channel, qMax(population[channel].first * 0.1, value(m_random)));
+        }
+        qInfo() << "measurement" << m_measurementId << "started";
+    }
+
+    void retarget(int channel, double value)
+    {
+        // Start from wherever the electrode is now
+        Channel &c = m_channels[channel];
+        const qint64 nowUs = m_samplesSent * 1000000 / m_sampleRate;
+        const double elapsedMs = (nowUs - c.changedUs) / 1000.0;
+        c.startMv = c.targetMv + (c.startMv - c.targetMv) * std::exp(-qMax(0.0, elapsedMs) / ELECTRODES[channel].timeConstantMs);
+        c.targetMv = toMillivolts(ELECTRODES[channel], value);
+        c.changedUs = nowUs;
+    }
+
+    int m_masterFd;
+    int m_slaveFd;
+    QString m_linkPath;
+    int m_sampleRate;
+    int m_frameSamples;
+    double m_noiseUv;
+    quint32 m_sequence;
+    qint64 m_samplesSent;
+    quint32 m_measurementId;
+    quint64 m_overruns;
+    std::array<Channel, CHANNEL_COUNT> m_channels;
+    QElapsedTimer m_clock;
+    QByteArray m_payload;
+    QByteArray m_pending;
+    FrameParser m_parser;
+    std::mt19937 m_random;
+
+    static const int MAX_PENDING_BYTES = 256 * 1024;
+    static const int REPORT_INTERVAL_MS = 5000;
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("BloodGasSensorSimulator");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Streams simulated electrode signals over a pseudo-terminal");
+    parser.addHelpOption();
+    QCommandLineOption rateOption("rate", "Samples per second per channel.", "hz", "1000");
+    QCommandLineOption frameOption("frame-samples", "Samples per channel in each frame.", "count", "10");
+    QCommandLineOption noiseOption("noise", "Electrode noise, microvolts RMS.", "uv", "40");
+    QCommandLineOption linkOption("link", "Symlink to create for the pty.", "path", "/tmp/bga-sensor");
+    parser.addOptions({rateOption, frameOption, noiseOption, linkOption});
+    parser.process(app);
+
+    const int rate = qBound(1, parser.value(rateOption).toInt(), 100000);
+    const int frameSamples = qBound(1, parser.value(frameOption).toInt(), MAX_PAYLOAD / (CHANNEL_COUNT * 4));
+
+    SensorSimulator simulator(rate, frameSamples, parser.value(noiseOption).toDouble());
+    if (!simulator.open(parser.value(linkOption))) {
+        return 1;
+    }
+    simulator.start();
+
+    return app.exec();
+}
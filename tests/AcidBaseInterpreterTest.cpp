@@ -0,0 +1,172 @@
+#include "AcidBaseInterpreterTest.h"
+#include "AcidBaseInterpreter.h"
+
+#include <QtTest/QtTest>
+
+using namespace AcidBaseInterpreter;
+
+Q_DECLARE_METATYPE(AcidBaseInterpreter::Primary)
+Q_DECLARE_METATYPE(AcidBaseInterpreter::Compensation)
+
+void AcidBaseInterpreterTest::testClassification_data()
+{
+    QTest::addColumn<double>("pH");
+    QTest::addColumn<double>("pCO2");
+    QTest::addColumn<double>("HCO3");
+    QTest::addColumn<double>("BE");
+    QTest::addColumn<Primary>("expectedPrimary");
+    QTest::addColumn<Compensation>("expectedCompensation");
+
+    // Each branch, and both sides of every threshold it tests
+    QTest::newRow("normal") << 7.40 << 40.0 << 24.0 << 0.0
+        << Primary::NormalPH << Compensation::Uncompensated;
+    QTest::newRow("pH 7.35 is not acidemia") << 7.35 << 40.0 << 24.0 << 0.0
+        << Primary::NormalPH << Compensation::Uncompensated;
+    QTest::newRow("pH 7.45 is not alkalemia") << 7.45 << 40.0 << 24.0 << 0.0
+        << Primary::NormalPH << Compensation::Uncompensated;
+    QTest::newRow("normal pH is never compensated") << 7.40 << 50.0 << 30.0 << 4.0
+        << Primary::NormalPH << Compensation::Uncompensated;
+    QTest::newRow("respiratory acidosis") << 7.25 << 60.0 << 24.0 << 0.0
+        << Primary::RespiratoryAcidosis << Compensation::Uncompensated;
+    QTest::newRow("respiratory acidosis HCO3 24.5") << 7.30 << 60.0 << 24.5 << 0.0
+        << Primary::RespiratoryAcidosis << Compensation::PartiallyCompensated;
+    QTest::newRow("respiratory acidosis HCO3 28") << 7.30 << 60.0 << 28.0 << 0.0
+        << Primary::RespiratoryAcidosis << Compensation::PartiallyCompensated;
+    QTest::newRow("respiratory acidosis HCO3 28.5") << 7.34 << 60.0 << 28.5 << 0.0
+        << Primary::RespiratoryAcidosis << Compensation::FullyCompensated;
+    QTest::newRow("respiratory over metabolic") << 7.10 << 60.0 << 18.0 << -8.0
+        << Primary::RespiratoryAcidosis << Compensation::Uncompensated;
+    QTest::newRow("pCO2 45 is not respiratory") << 7.30 << 45.0 << 24.0 << 0.0
+        << Primary::MixedAcidosis << Compensation::Uncompensated;
+    QTest::newRow("pCO2 45.1 is respiratory") << 7.30 << 45.1 << 24.0 << 0.0
+        << Primary::RespiratoryAcidosis << Compensation::Uncompensated;
+    QTest::newRow("metabolic acidosis") << 7.25 << 40.0 << 15.0 << -10.0
+        << Primary::MetabolicAcidosis << Compensation::Uncompensated;
+    QTest::newRow("metabolic acidosis pCO2 39") << 7.30 << 39.0 << 15.0 << -10.0
+        << Primary::MetabolicAcidosis << Compensation::PartiallyCompensated;
+    QTest::newRow("metabolic acidosis pCO2 35") << 7.30 << 35.0 << 15.0 << -10.0
+        << Primary::MetabolicAcidosis << Compensation::PartiallyCompensated;
+    QTest::newRow("metabolic acidosis pCO2 34") << 7.34 << 34.0 << 15.0 << -10.0
+        << Primary::MetabolicAcidosis << Compensation::FullyCompensated;
+    QTest::newRow("HCO3 22 and BE -2 are not metabolic") << 7.30 << 40.0 << 22.0 << -2.0
+        << Primary::MixedAcidosis << Compensation::Uncompensated;
+    QTest::newRow("HCO3 21.9 is metabolic") << 7.30 << 40.0 << 21.9 << -2.0
+        << Primary::MetabolicAcidosis << Compensation::Uncompensated;
+    QTest::newRow("BE -2.1 is metabolic") << 7.30 << 40.0 << 22.0 << -2.1
+        << Primary::MetabolicAcidosis << Compensation::Uncompensated;
+    QTest::newRow("respiratory alkalosis") << 7.55 << 25.0 << 24.0 << 0.0
+        << Primary::RespiratoryAlkalosis << Compensation::Uncompensated;
+    QTest::newRow("respiratory alkalosis HCO3 23.5") << 7.50 << 25.0 << 23.5 << 0.0
+        << Primary::RespiratoryAlkalosis << Compensation::PartiallyCompensated;
+    QTest::newRow("respiratory alkalosis HCO3 22") << 7.50 << 25.0 << 22.0 << 0.0
+        << Primary::RespiratoryAlkalosis << Compensation::PartiallyCompensated;
+    QTest::newRow("respiratory alkalosis HCO3 21.5") << 7.46 << 25.0 << 21.5 << 0.0
+        << Primary::RespiratoryAlkalosis << Compensation::FullyCompensated;
+    QTest::newRow("pCO2 35 is not respiratory") << 7.50 << 35.0 << 24.0 << 0.0
+        << Primary::MixedAlkalosis << Compensation::Uncompensated;
+    QTest::newRow("pCO2 34.9 is respiratory") << 7.50 << 34.9 << 24.0 << 0.0
+        << Primary::RespiratoryAlkalosis << Compensation::Uncompensated;
+    QTest::newRow("metabolic alkalosis") << 7.50 << 40.0 << 32.0 << 8.0
+        << Primary::MetabolicAlkalosis << Compensation::Uncompensated;
+    QTest::newRow("metabolic alkalosis pCO2 42") << 7.50 << 42.0 << 32.0 << 8.0
+        << Primary::MetabolicAlkalosis << Compensation::PartiallyCompensated;
+    QTest::newRow("metabolic alkalosis pCO2 45") << 7.50 << 45.0 << 32.0 << 8.0
+        << Primary::MetabolicAlkalosis << Compensation::PartiallyCompensated;
+    QTest::newRow("metabolic alkalosis pCO2 46") << 7.46 << 46.0 << 32.0 << 8.0
+        << Primary::MetabolicAlkalosis << Compensation::FullyCompensated;
+    QTest::newRow("HCO3 28 and BE 2 are not metabolic") << 7.50 << 40.0 << 28.0 << 2.0
+        << Primary::MixedAlkalosis << Compensation::Uncompensated;
+    QTest::newRow("HCO3 28.1 is metabolic") << 7.50 << 40.0 << 28.1 << 2.0
+        << Primary::MetabolicAlkalosis << Compensation::Uncompensated;
+    QTest::newRow("BE 2.1 is metabolic") << 7.50 << 40.0 << 28.0 << 2.1
+        << Primary::MetabolicAlkalosis << Compensation::Uncompensated;
+    QTest::newRow("missing pH") << qQNaN() << 40.0 << 24.0 << 0.0
+        << Primary::Unclassified << Compensation::Uncompensated;
+    QTest::newRow("missing pCO2") << 7.25 << qQNaN() << 15.0 << -10.0
+        << Primary::Unclassified << Compensation::Uncompensated;
+    QTest::newRow("missing HCO3") << 7.25 << 60.0 << qQNaN() << 0.0
+        << Primary::Unclassified << Compensation::Uncompensated;
+    QTest::newRow("missing BE is classified") << 7.25 << 40.0 << 15.0 << qQNaN()
+        << Primary::MetabolicAcidosis << Compensation::Uncompensated;
+}
+
+void AcidBaseInterpreterTest::testClassification()
+{
+    QFETCH(double, pH);
+    QFETCH(double, pCO2);
+    QFETCH(double, HCO3);
+    QFETCH(double, BE);
+    QFETCH(Primary, expectedPrimary);
+    QFETCH(Compensation, expectedCompensation);
+
+    const Flags flags = classify(pH, pCO2, 95.0, HCO3, BE);
+    QCOMPARE(primary(flags), expectedPrimary);
+    QCOMPARE(compensation(flags), expectedCompensation);
+    QVERIFY(!((flags & FullyCompensated) && (flags & PartiallyCompensated)));
+}
+
+void AcidBaseInterpreterTest::testOxygenation_data()
+{
+    QTest::addColumn<double>("pO2");
+    QTest::addColumn<bool>("hypoxemia");
+    QTest::addColumn<bool>("hyperoxemia");
+
+    QTest::newRow("normal") << 95.0 << false << false;
+    QTest::newRow("pO2 80") << 80.0 << false << false;
+    QTest::newRow("pO2 79.9") << 79.9 << true << false;
+    QTest::newRow("pO2 100") << 100.0 << false << false;
+    QTest::newRow("pO2 100.1") << 100.1 << false << true;
+    QTest::newRow("missing pO2") << qQNaN() << false << false;
+}
+
+void AcidBaseInterpreterTest::testOxygenation()
+{
+    QFETCH(double, pO2);
+    QFETCH(bool, hypoxemia);
+    QFETCH(bool, hyperoxemia);
+
+    const Flags flags = classify(7.40, 40.0, pO2, 24.0, 0.0);
+    QCOMPARE(bool(flags & Hypoxemia), hypoxemia);
+    QCOMPARE(bool(flags & Hyperoxemia), hyperoxemia);
+    // Oxygenation does not move the acid-base classification
+    QCOMPARE(primary(flags), Primary::NormalPH);
+}
+
+void AcidBaseInterpreterTest::testBatchMatchesSingle()
+{
+    QList<float> pH, pCO2, pO2, hco3, be;
+    for (float ph = 7.0f; ph <= 7.7f; ph += 0.05f) {
+        for (float co2 = 20.0f; co2 <= 70.0f; co2 += 5.0f) {
+            for (float bicarbonate = 12.0f; bicarbonate <= 36.0f; bicarbonate += 2.0f) {
+                pH.append(ph);
+                pCO2.append(co2);
+                pO2.append(co2 * 2.0f);
+                hco3.append(bicarbonate);
+                be.append(bicarbonate - 24.0f);
+            }
+        }
+    }
+    pH.append(qQNaN());
+    pCO2.append(40.0f);
+    pO2.append(95.0f);
+    hco3.append(24.0f);
+    be.append(0.0f);
+
+    QList<Flags> flags(pH.size());
+    classifyBatch({pH.constData(), pCO2.constData(), pO2.constData(), hco3.constData(), be.constData()},
+                  flags.data(), flags.size());
+    for (qsizetype i = 0; i < flags.size(); ++i) {
+        QCOMPARE(flags.at(i), detail::classify(pH.at(i), pCO2.at(i), pO2.at(i), hco3.at(i), be.at(i)));
+    }
+    QVERIFY(flags.last() & Unclassified);
+}
+
+void AcidBaseInterpreterTest::testNames()
+{
+    QCOMPARE(QString(primaryName(Primary::MetabolicAcidosis)) +
+                 compensationName(Compensation::PartiallyCompensated),
+             QString("Metabolic Acidosis (Partially Compensated)"));
+    QCOMPARE(QString(primaryName(Primary::NormalPH)), QString("Normal pH"));
+    QCOMPARE(QString(primaryName(Primary::Unclassified)), QString("Unclassified"));
+    QCOMPARE(QString(compensationName(Compensation::Uncompensated)), QString(" (Uncompensated)"));
+}
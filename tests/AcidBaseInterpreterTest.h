@@ -0,0 +1,19 @@
+#ifndef ACIDBASEINTERPRETERTEST_H
+#define ACIDBASEINTERPRETERTEST_H
+
+#include <QObject>
+
+class AcidBaseInterpreterTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testClassification_data();
+    void testClassification();
+    void testOxygenation_data();
+    void testOxygenation();
+    void testBatchMatchesSingle();
+    void testNames();
+};
+
+#endif // ACIDBASEINTERPRETERTEST_H
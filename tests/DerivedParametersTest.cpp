@@ -0,0 +1,144 @@
+#include "DerivedParametersTest.h"
+#include "DerivedParameters.h"
+
+#include <QtTest/QtTest>
+
+#include <cmath>
+
+using namespace DerivedParameters;
+
+namespace {
+const QVariantMap ELECTROLYTES{{"Na", 140.0}, {"Cl", 104.0}, {"HCO3", 24.0}};
+
+QVariantMap with(QVariantMap result, const QVariantMap &more)
+{
+    result.insert(more);
+    return result;
+}
+
+QList<QVariantMap> batchResults()
+{
+    return {
+        with(ELECTROLYTES, {{"pH", 7.40}, {"pCO2", 40.0}, {"pO2", 90.0}, {"BE", 0.0}, {"SO2", 97.0}}),
+        with(ELECTROLYTES, {{"albumin", 2.5}, {"FiO2", 60}, {"pO2", 120.0}, {"pCO2", 35.0}}),
+        {{"pH", 7.21}, {"pCO2", 58.0}, {"pO2", 62.0}, {"temperature", 34.5}, {"Hb", 9.0}},
+        {{"BE", -8.0}, {"SO2", 88.0}, {"FiO2", 0.35}},
+        {},
+    };
+}
+}
+
+void DerivedParametersTest::testReferenceValues_data()
+{
+    QTest::addColumn<QVariantMap>("result");
+    QTest::addColumn<int>("parameter");
+    QTest::addColumn<double>("expected"); // NaN when it cannot be derived
+    QTest::addColumn<double>("tolerance");
+
+    const double missing = qQNaN();
+
+    QTest::newRow("anion gap") << ELECTROLYTES << int(AnionGap) << 12.0 << 0.01;
+    QTest::newRow("anion gap without Cl") << QVariantMap{{"Na", 140.0}, {"HCO3", 24.0}}
+        << int(AnionGap) << missing << 0.0;
+    QTest::newRow("anion gap, low albumin") << with(ELECTROLYTES, {{"albumin", 2.0}})
+        << int(AnionGapAlbumin) << 17.0 << 0.01;
+    QTest::newRow("anion gap, normal albumin") << with(ELECTROLYTES, {{"albumin", 4.0}})
+        << int(AnionGapAlbumin) << 12.0 << 0.01;
+    QTest::newRow("anion gap without albumin") << ELECTROLYTES << int(AnionGapAlbumin) << missing << 0.0;
+
+    // 0.21 * (760 - 47) - 40 / 0.8 - 90
+    QTest::newRow("A-a gradient on room air") << QVariantMap{{"pCO2", 40.0}, {"pO2", 90.0}}
+        << int(AaGradient) << 9.73 << 0.01;
+    QTest::newRow("A-a gradient, FiO2 fraction") << QVariantMap{{"pCO2", 40.0}, {"pO2", 100.0}, {"FiO2", 0.5}}
+        << int(AaGradient) << 206.5 << 0.05;
+    QTest::newRow("A-a gradient, FiO2 percent") << QVariantMap{{"pCO2", 40.0}, {"pO2", 100.0}, {"FiO2", 50}}
+        << int(AaGradient) << 206.5 << 0.05;
+    QTest::newRow("A-a gradient without pCO2") << QVariantMap{{"pO2", 90.0}} << int(AaGradient) << missing << 0.0;
+
+    QTest::newRow("P/F on room air") << QVariantMap{{"pO2", 95.0}} << int(PFRatio) << 452.38 << 0.05;
+    QTest::newRow("P/F, FiO2 fraction") << QVariantMap{{"pO2", 100.0}, {"FiO2", 0.5}} << int(PFRatio) << 200.0 << 0.05;
+    QTest::newRow("P/F, FiO2 percent") << QVariantMap{{"pO2", 80.0}, {"FiO2", 40}} << int(PFRatio) << 200.0 << 0.05;
+    QTest::newRow("P/F, FiO2 1 is a fraction") << QVariantMap{{"pO2", 300.0}, {"FiO2", 1.0}}
+        << int(PFRatio) << 300.0 << 0.05;
+    QTest::newRow("P/F, empty FiO2 is room air") << QVariantMap{{"pO2", 95.0}, {"FiO2", ""}}
+        << int(PFRatio) << 452.38 << 0.05;
+    QTest::newRow("P/F without pO2") << QVariantMap{{"FiO2", 0.5}} << int(PFRatio) << missing << 0.0;
+
+    QTest::newRow("standard HCO3, normal") << QVariantMap{{"BE", 0.0}, {"SO2", 100.0}}
+        << int(StandardHCO3) << 24.47 << 0.01;
+    QTest::newRow("standard HCO3, base deficit") << QVariantMap{{"BE", -10.0}, {"SO2", 100.0}}
+        << int(StandardHCO3) << 16.72 << 0.01;
+    QTest::newRow("standard HCO3, desaturated") << QVariantMap{{"BE", 5.0}, {"SO2", 90.0}, {"Hb", 15.0}}
+        << int(StandardHCO3) << 28.68 << 0.01;
+    QTest::newRow("standard HCO3 without SO2") << QVariantMap{{"BE", 0.0}} << int(StandardHCO3) << missing << 0.0;
+
+    QTest::newRow("pH at 39 °C") << QVariantMap{{"pH", 7.40}, {"temperature", 39.0}}
+        << int(PHPatient) << 7.3706 << 0.0005;
+    QTest::newRow("pH at 37 °C by default") << QVariantMap{{"pH", 7.40}} << int(PHPatient) << 7.40 << 0.0005;
+    QTest::newRow("pCO2 at 39 °C") << QVariantMap{{"pCO2", 40.0}, {"temperature", 39.0}}
+        << int(PCO2Patient) << 43.66 << 0.01;
+    QTest::newRow("pCO2 at 33 °C") << QVariantMap{{"pCO2", 40.0}, {"temperature", 33.0}}
+        << int(PCO2Patient) << 33.58 << 0.01;
+    QTest::newRow("pO2 at 39 °C") << QVariantMap{{"pO2", 90.0}, {"temperature", 39.0}}
+        << int(PO2Patient) << 102.09 << 0.05;
+    QTest::newRow("pO2 at 33 °C") << QVariantMap{{"pO2", 90.0}, {"temperature", 33.0}}
+        << int(PO2Patient) << 69.95 << 0.05;
+    QTest::newRow("pO2 at 37 °C by default") << QVariantMap{{"pO2", 90.0}} << int(PO2Patient) << 90.0 << 0.01;
+}
+
+void DerivedParametersTest::testReferenceValues()
+{
+    QFETCH(QVariantMap, result);
+    QFETCH(int, parameter);
+    QFETCH(double, expected);
+    QFETCH(double, tolerance);
+
+    Record record(result);
+    const float actual = record.value(Parameter(parameter));
+    if (std::isnan(expected)) {
+        QVERIFY(std::isnan(actual));
+        QVERIFY(!record.variant(Parameter(parameter)).isValid());
+    } else {
+        QVERIFY2(std::abs(actual - expected) <= tolerance,
+                 qPrintable(QString("%1, expected %2").arg(actual).arg(expected)));
+    }
+}
+
+void DerivedParametersTest::testBatchMatchesRecord()
+{
+    const QList<QVariantMap> results = batchResults();
+    Columns columns;
+    for (const QVariantMap &result : results) {
+        columns.append(result);
+    }
+    computeBatch(columns, (1u << PARAMETER_COUNT) - 1);
+
+    for (qsizetype row = 0; row < results.size(); ++row) {
+        Record record(results.at(row));
+        for (int parameter = 0; parameter < PARAMETER_COUNT; ++parameter) {
+            const float single = record.value(Parameter(parameter));
+            const float batch = columns.values[parameter].at(row);
+            QVERIFY(std::isnan(single) == std::isnan(batch));
+            if (!std::isnan(single)) {
+                QCOMPARE(batch, single);
+            }
+        }
+    }
+}
+
+void DerivedParametersTest::testMissingLeftOut()
+{
+    // Only the defaulted inputs besides pH: every other parameter is missing
+    const QVariantMap derived = Record(QVariantMap{{"pH", 7.40}}).toMap();
+    QCOMPARE(derived.keys(), QStringList{"pHPatient"});
+
+    QVERIFY(Record().toMap().isEmpty());
+
+    // Asking for the albumin-corrected gap alone computes the gap it needs
+    Columns columns;
+    columns.append(with(ELECTROLYTES, {{"albumin", 3.0}}));
+    computeBatch(columns, 1u << AnionGapAlbumin);
+    QCOMPARE(columns.values[AnionGap].size(), qsizetype(1));
+    QCOMPARE(columns.values[AnionGapAlbumin].at(0), 14.5f);
+    QVERIFY(columns.values[PFRatio].isEmpty());
+}
@@ -0,0 +1,17 @@
+#ifndef DERIVEDPARAMETERSTEST_H
+#define DERIVEDPARAMETERSTEST_H
+
+#include <QObject>
+
+class DerivedParametersTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testReferenceValues_data();
+    void testReferenceValues();
+    void testBatchMatchesRecord();
+    void testMissingLeftOut();
+};
+
+#endif // DERIVEDPARAMETERSTEST_H
@@ -0,0 +1,160 @@
+#include "HL7OutboundQueueTest.h"
+#include "HL7OutboundQueue.h"
+
+#include <QtTest/QtTest>
+
+#include <algorithm>
+
+namespace {
+HL7OutboundMessage message(const QString &sampleId, bool critical = false)
+{
+    HL7OutboundMessage result;
+    result.type = "ORU^R01";
+    result.sampleId = sampleId;
+    result.critical = critical;
+    return result;
+}
+
+QString routineId(int i)
+{
+    return QString("R%1").arg(i);
+}
+
+// Sample IDs in the order the queue hands them out
+QStringList drain(HL7OutboundQueue &queue)
+{
+    QStringList ids;
+    HL7OutboundMessage next;
+    while (queue.take(true, next)) {
+        ids.append(next.sampleId);
+    }
+    return ids;
+}
+}
+
+void HL7OutboundQueueTest::testCriticalPreemptsBacklog()
+{
+    // An outage: routine results pile up while every attempt fails
+    HL7OutboundQueue queue(1000, 200);
+    const int backlog = 500;
+    for (int i = 1; i <= backlog; ++i) {
+        QVERIFY(queue.push(message(routineId(i))));
+    }
+    for (int attempt = 0; attempt < 5; ++attempt) {
+        QList<HL7OutboundMessage> inFlight(4);
+        for (HL7OutboundMessage &sent : inFlight) {
+            QVERIFY(queue.take(true, sent));
+        }
+        for (qsizetype i = inFlight.size() - 1; i >= 0; --i) {
+            queue.putBack(inFlight.at(i));
+        }
+    }
+    QCOMPARE(queue.routineSize(), backlog);
+
+    // A critical potassium arrives and fails once too
+    QVERIFY(queue.push(message("K-CRIT", true)));
+    HL7OutboundMessage next;
+    QVERIFY(queue.take(true, next));
+    QCOMPARE(next.sampleId, QString("K-CRIT"));
+    queue.putBack(next);
+    QVERIFY(queue.push(message(routineId(backlog + 1))));
+
+    // When the link comes back it still goes first, then the backlog in order
+    const QStringList sent = drain(queue);
+    QCOMPARE(sent.size(), backlog + 2);
+    QCOMPARE(sent.first(), QString("K-CRIT"));
+    for (int i = 1; i <= backlog + 1; ++i) {
+        QCOMPARE(sent.at(i), routineId(i));
+    }
+    QVERIFY(queue.isEmpty());
+}
+
+void HL7OutboundQueueTest::testFailedMessagesKeepTheirPlace_data()
+{
+    QTest::addColumn<QList<int>>("failureOrder"); // indexes of the taken messages
+
+    QTest::newRow("in order") << QList<int>{0, 1, 2};
+    QTest::newRow("reversed") << QList<int>{2, 1, 0};
+    QTest::newRow("middle first") << QList<int>{1, 2, 0};
+    QTest::newRow("one of three") << QList<int>{1};
+}
+
+void HL7OutboundQueueTest::testFailedMessagesKeepTheirPlace()
+{
+    QFETCH(QList<int>, failureOrder);
+
+    HL7OutboundQueue queue(100, 100);
+    for (int i = 1; i <= 6; ++i) {
+        QVERIFY(queue.push(message(routineId(i))));
+    }
+    QList<HL7OutboundMessage> inFlight(3);
+    for (HL7OutboundMessage &sent : inFlight) {
+        QVERIFY(queue.take(true, sent));
+    }
+    for (const int index : failureOrder) {
+        queue.putBack(inFlight.at(index));
+    }
+
+    // The failed ones come out in their original order, ahead of the rest
+    QStringList expected;
+    QList<int> failed = failureOrder;
+    std::sort(failed.begin(), failed.end());
+    for (const int index : failed) {
+        expected.append(routineId(index + 1));
+    }
+    for (int i = 4; i <= 6; ++i) {
+        expected.append(routineId(i));
+    }
+    QCOMPARE(drain(queue), expected);
+}
+
+void HL7OutboundQueueTest::testLaneLimits_data()
+{
+    QTest::addColumn<bool>("critical");
+    QTest::addColumn<int>("maxRoutine");
+    QTest::addColumn<int>("maxCritical");
+    QTest::addColumn<int>("expectedLimit");
+
+    QTest::newRow("routine") << false << 3 << 10 << 3;
+    QTest::newRow("critical") << true << 10 << 2 << 2;
+    QTest::newRow("critical, routine lane tiny") << true << 1 << 5 << 5;
+    QTest::newRow("limit below one") << false << 0 << 10 << 1;
+}
+
+void HL7OutboundQueueTest::testLaneLimits()
+{
+    QFETCH(bool, critical);
+    QFETCH(int, maxRoutine);
+    QFETCH(int, maxCritical);
+    QFETCH(int, expectedLimit);
+
+    HL7OutboundQueue queue(maxRoutine, maxCritical);
+    for (int i = 0; i < expectedLimit; ++i) {
+        QVERIFY(queue.push(message(routineId(i), critical)));
+    }
+    QVERIFY(!queue.push(message("overflow", critical)));
+
+    // A message that failed always goes back, even into a full lane
+    HL7OutboundMessage next;
+    QVERIFY(queue.take(true, next));
+    QVERIFY(queue.push(message("refill", critical)));
+    queue.putBack(next);
+    QCOMPARE(critical ? queue.criticalSize() : queue.routineSize(), expectedLimit + 1);
+
+    // The other lane is not affected
+    QVERIFY(queue.push(message("other", !critical)));
+}
+
+void HL7OutboundQueueTest::testRoutineHeldBack()
+{
+    HL7OutboundQueue queue(10, 10);
+    QVERIFY(queue.push(message("R1")));
+    QVERIFY(queue.push(message("C1", true)));
+
+    HL7OutboundMessage next;
+    QVERIFY(queue.take(false, next));
+    QCOMPARE(next.sampleId, QString("C1"));
+    QVERIFY(!queue.take(false, next));
+    QVERIFY(queue.take(true, next));
+    QCOMPARE(next.sampleId, QString("R1"));
+}
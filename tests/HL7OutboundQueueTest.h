@@ -0,0 +1,19 @@
+#ifndef HL7OUTBOUNDQUEUETEST_H
+#define HL7OUTBOUNDQUEUETEST_H
+
+#include <QObject>
+
+class HL7OutboundQueueTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testCriticalPreemptsBacklog();
+    void testFailedMessagesKeepTheirPlace_data();
+    void testFailedMessagesKeepTheirPlace();
+    void testLaneLimits_data();
+    void testLaneLimits();
+    void testRoutineHeldBack();
+};
+
+#endif // HL7OUTBOUNDQUEUETEST_H
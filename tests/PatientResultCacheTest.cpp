@@ -0,0 +1,87 @@
+#include "PatientResultCacheTest.h"
+#include "PatientResultCache.h"
+
+#include <QtTest/QtTest>
+
+#include <QDateTime>
+#include <QTimeZone>
+
+using namespace ResultRules;
+
+namespace {
+const QDateTime FIRST_RESULT(QDate(2026, 1, 5), QTime(8, 0), QTimeZone::utc());
+const int HOUR = 60;
+const int DAY = 24 * 60;
+
+QVariantMap result(int analyte, float value, int minutes)
+{
+    return QVariantMap{{"patientId", "P1"},
+                       {"timestamp", FIRST_RESULT.addSecs(minutes * 60).toString(Qt::ISODate)},
+                       {ANALYTE_FIELDS[analyte], value}};
+}
+}
+
+void PatientResultCacheTest::testDeltaRules_data()
+{
+    QTest::addColumn<int>("analyte");
+    QTest::addColumn<float>("previous");
+    QTest::addColumn<float>("current");
+    QTest::addColumn<int>("minutes");
+    QTest::addColumn<bool>("flagged");
+
+    // Each rule just inside and just outside its window
+    QTest::newRow("pH within an hour") << int(PH) << 7.40f << 7.15f << HOUR << true;
+    QTest::newRow("pH after an hour") << int(PH) << 7.40f << 7.15f << HOUR + 1 << false;
+    QTest::newRow("pH small change") << int(PH) << 7.40f << 7.25f << 10 << false;
+    QTest::newRow("pCO2 within an hour") << int(PCO2) << 40.0f << 65.0f << HOUR << true;
+    QTest::newRow("pCO2 after an hour") << int(PCO2) << 40.0f << 65.0f << HOUR + 1 << false;
+    QTest::newRow("HCO3 within a day") << int(HCO3) << 24.0f << 14.0f << DAY << true;
+    QTest::newRow("HCO3 after a day") << int(HCO3) << 24.0f << 14.0f << DAY + 1 << false;
+    QTest::newRow("Na within a day") << int(Na) << 140.0f << 152.0f << DAY << true;
+    QTest::newRow("Na after a day") << int(Na) << 140.0f << 152.0f << DAY + 1 << false;
+    // K has an hourly rule under its daily one
+    QTest::newRow("K hourly rule") << int(K) << 4.0f << 5.2f << HOUR << true;
+    QTest::newRow("K hourly change after an hour") << int(K) << 4.0f << 5.2f << HOUR + 1 << false;
+    QTest::newRow("K daily rule") << int(K) << 4.0f << 5.7f << 20 * HOUR << true;
+    QTest::newRow("K daily change after a day") << int(K) << 4.0f << 5.7f << DAY + 1 << false;
+    QTest::newRow("K small change") << int(K) << 4.0f << 4.8f << 10 << false;
+    QTest::newRow("Cl within a day") << int(Cl) << 100.0f << 112.0f << DAY << true;
+    QTest::newRow("Cl after a day") << int(Cl) << 100.0f << 112.0f << DAY + 1 << false;
+    QTest::newRow("Ca within a day") << int(Ca) << 1.20f << 0.60f << DAY << true;
+    QTest::newRow("Ca after a day") << int(Ca) << 1.20f << 0.60f << DAY + 1 << false;
+    QTest::newRow("Glucose within an hour") << int(Glucose) << 100.0f << 320.0f << HOUR << true;
+    QTest::newRow("Glucose after an hour") << int(Glucose) << 100.0f << 320.0f << HOUR + 1 << false;
+    QTest::newRow("Lactate within an hour") << int(Lactate) << 1.0f << 6.0f << HOUR << true;
+    QTest::newRow("Lactate after an hour") << int(Lactate) << 1.0f << 6.0f << HOUR + 1 << false;
+    QTest::newRow("pO2 has no rule") << int(PO2) << 100.0f << 400.0f << 10 << false;
+}
+
+void PatientResultCacheTest::testDeltaRules()
+{
+    QFETCH(int, analyte);
+    QFETCH(float, previous);
+    QFETCH(float, current);
+    QFETCH(int, minutes);
+    QFETCH(bool, flagged);
+
+    PatientResultCache cache(4);
+    QVariantMap first = result(analyte, previous, 0);
+    cache.checkAndAdd(first);
+
+    QVariantMap second = result(analyte, current, minutes);
+    const quint16 flags = cache.checkAndAdd(second);
+    QCOMPARE(flags, quint16(flagged ? 1u << analyte : 0u));
+    QVERIFY(second.value("deltaChecked").toBool());
+    QCOMPARE(second.value("deltaFlags").toInt(), int(flags));
+    QCOMPARE(second.value("deltaFields").toStringList(),
+             flagged ? QStringList{ANALYTE_FIELDS[analyte]} : QStringList());
+}
+
+void PatientResultCacheTest::testUnknownPatient()
+{
+    PatientResultCache cache(4);
+    QVariantMap first = result(K, 4.0f, 0);
+    QCOMPARE(cache.checkAndAdd(first), quint16(0));
+    QVERIFY(!first.value("deltaChecked").toBool());
+    QVERIFY(cache.contains("P1"));
+}
@@ -0,0 +1,16 @@
+#ifndef PATIENTRESULTCACHETEST_H
+#define PATIENTRESULTCACHETEST_H
+
+#include <QObject>
+
+class PatientResultCacheTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testDeltaRules_data();
+    void testDeltaRules();
+    void testUnknownPatient();
+};
+
+#endif // PATIENTRESULTCACHETEST_H
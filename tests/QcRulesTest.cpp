@@ -0,0 +1,164 @@
+#include "QcRulesTest.h"
+#include "QcRules.h"
+
+#include <QtTest/QtTest>
+
+using namespace QcRules;
+
+namespace {
+// pH controlled at every level with mean 0 and SD 1, so values are z-scores
+Targets unitTargets()
+{
+    Targets targets;
+    for (int level = 0; level < LEVEL_COUNT; ++level) {
+        targets[level][ResultRules::PH] = {0.0, 1.0};
+    }
+    return targets;
+}
+
+QVariantMap phRun(int level, double value)
+{
+    return QVariantMap{{QString::number(level), QVariantMap{{"pH", value}}}};
+}
+
+QList<double> repeated(double value, int count)
+{
+    return QList<double>(count, value);
+}
+}
+
+void QcRulesTest::testChannelRules_data()
+{
+    QTest::addColumn<QList<double>>("values");
+    QTest::addColumn<int>("rules");
+    QTest::addColumn<bool>("rejected");
+
+    QTest::newRow("within 2 SD") << QList<double>{1.5} << 0 << false;
+    QTest::newRow("1-2s only warns") << QList<double>{2.5} << int(Rule12s) << false;
+    QTest::newRow("1-3s high") << QList<double>{3.5} << (Rule12s | Rule13s) << true;
+    QTest::newRow("1-3s low") << QList<double>{-3.2} << (Rule12s | Rule13s) << true;
+    QTest::newRow("2-2s in a row") << QList<double>{2.5, 2.5} << (Rule12s | Rule22s) << true;
+    QTest::newRow("2-2s on opposite sides") << QList<double>{-2.5, 2.5} << int(Rule12s) << false;
+    QTest::newRow("2-2s with a value between") << QList<double>{2.5, 0.5, 2.5} << int(Rule12s) << false;
+    QTest::newRow("4-1s") << repeated(1.5, 4) << int(Rule41s) << true;
+    QTest::newRow("4-1s low") << repeated(-1.5, 4) << int(Rule41s) << true;
+    QTest::newRow("three beyond 1 SD") << repeated(1.5, 3) << 0 << false;
+    QTest::newRow("4-1s broken within 1 SD") << QList<double>{1.5, 1.5, 0.5, 1.5, 1.5} << 0 << false;
+    QTest::newRow("10-x") << repeated(0.5, 10) << int(Rule10x) << true;
+    QTest::newRow("10-x low") << repeated(-0.5, 10) << int(Rule10x) << true;
+    QTest::newRow("nine on one side") << repeated(0.5, 9) << 0 << false;
+}
+
+void QcRulesTest::testChannelRules()
+{
+    QFETCH(QList<double>, values);
+    QFETCH(int, rules);
+    QFETCH(bool, rejected);
+
+    const Targets targets = unitTargets();
+    Channels channels;
+    Evaluation evaluation;
+    for (const double value : std::as_const(values)) {
+        evaluation = evaluate(phRun(1, value), targets, channels);
+    }
+    QVERIFY(evaluation.measured[0][ResultRules::PH]);
+    QCOMPARE(evaluation.rules[0][ResultRules::PH], rules);
+    QCOMPARE(evaluation.runRules, rules);
+    QCOMPARE(evaluation.isRejected(), rejected);
+    QCOMPARE(channels[0][ResultRules::PH].size, int(values.size()));
+}
+
+void QcRulesTest::testAcrossLevels_data()
+{
+    QTest::addColumn<int>("secondLevel");
+    QTest::addColumn<double>("first");
+    QTest::addColumn<double>("second");
+    QTest::addColumn<int>("shared");
+    QTest::addColumn<int>("runRules");
+
+    QTest::newRow("2-2s across levels") << 2 << 2.5 << 2.2 << int(Rule22s) << (Rule12s | Rule22s);
+    QTest::newRow("2-2s across levels low") << 3 << -2.5 << -2.2 << int(Rule22s) << (Rule12s | Rule22s);
+    QTest::newRow("R-4s") << 2 << 2.5 << -2.2 << int(RuleR4s) << (Rule12s | RuleR4s);
+    QTest::newRow("R-4s across levels 1 and 3") << 3 << -2.1 << 2.1 << int(RuleR4s) << (Rule12s | RuleR4s);
+    QTest::newRow("one level beyond 2 SD") << 2 << 2.5 << 1.0 << 0 << int(Rule12s);
+    QTest::newRow("4 SD apart, one within 2 SD") << 2 << 2.5 << -1.8 << 0 << int(Rule12s);
+    QTest::newRow("within limits") << 2 << 0.5 << -0.5 << 0 << 0;
+}
+
+void QcRulesTest::testAcrossLevels()
+{
+    QFETCH(int, secondLevel);
+    QFETCH(double, first);
+    QFETCH(double, second);
+    QFETCH(int, shared);
+    QFETCH(int, runRules);
+
+    Channels channels;
+    QVariantMap run = phRun(1, first);
+    run.insert(phRun(secondLevel, second));
+    const Evaluation evaluation = evaluate(run, unitTargets(), channels);
+
+    // Both levels carry the rules they break together
+    QCOMPARE(evaluation.rules[0][ResultRules::PH] & (Rule22s | RuleR4s), shared);
+    QCOMPARE(evaluation.rules[secondLevel - 1][ResultRules::PH] & (Rule22s | RuleR4s), shared);
+    QCOMPARE(evaluation.runRules, runRules);
+    QCOMPARE(evaluation.isRejected(), shared != 0);
+}
+
+void QcRulesTest::testUncontrolled()
+{
+    Channels channels;
+    QVariantMap run{{"1", QVariantMap{{"pH", 5.0}, {"K", 9.0}}},
+                    {"4", QVariantMap{{"pH", 9.0}}}};
+    QTest::ignoreMessage(QtWarningMsg, "Ignoring unknown control level \"4\"");
+    const Evaluation evaluation = evaluate(run, unitTargets(), channels);
+
+    // K has no target SD, and there is no fourth level
+    QVERIFY(evaluation.measured[0][ResultRules::PH]);
+    QVERIFY(!evaluation.measured[0][ResultRules::K]);
+    QCOMPARE(evaluation.rules[0][ResultRules::K], 0);
+    QCOMPARE(channels[0][ResultRules::K].size, 0);
+    QCOMPARE(evaluation.runRules, Rule12s | Rule13s);
+}
+
+void QcRulesTest::testReplay_data()
+{
+    QTest::addColumn<QList<double>>("history");
+    QTest::addColumn<qint64>("acknowledgedRun");
+    QTest::addColumn<double>("next");
+    QTest::addColumn<int>("rules");
+
+    // History runs are numbered from 1; an acknowledged rejection's run
+    // is not in the history
+    QTest::newRow("2-2s carries over") << QList<double>{2.5} << qint64(0) << 2.5 << (Rule12s | Rule22s);
+    QTest::newRow("2-2s restarted after the last run") << QList<double>{2.5} << qint64(2) << 2.5 << int(Rule12s);
+    QTest::newRow("4-1s carries over") << repeated(1.5, 3) << qint64(0) << 1.5 << int(Rule41s);
+    QTest::newRow("4-1s restarted between runs") << repeated(1.5, 3) << qint64(2) << 1.5 << 0;
+    QTest::newRow("10-x carries over") << repeated(0.5, 9) << qint64(0) << 0.5 << int(Rule10x);
+    QTest::newRow("10-x restarted between runs") << repeated(0.5, 9) << qint64(5) << 0.5 << 0;
+}
+
+void QcRulesTest::testReplay()
+{
+    QFETCH(QList<double>, history);
+    QFETCH(qint64, acknowledgedRun);
+    QFETCH(double, next);
+    QFETCH(int, rules);
+
+    QVariantList rows;
+    for (int i = 0; i < history.size(); ++i) {
+        rows.append(QVariantMap{{"level", 1}, {"analyte", "pH"}, {"value", history[i]}, {"runId", i + 1}});
+    }
+    QVariantList acknowledged;
+    if (acknowledgedRun > 0) {
+        acknowledged.append(QVariantMap{{"level", 1}, {"analyte", "pH"}, {"runId", acknowledgedRun}});
+    }
+
+    const Targets targets = unitTargets();
+    Channels channels = replay(rows, acknowledged, targets);
+    // The restart forgets the runs, not the values
+    QCOMPARE(channels[0][ResultRules::PH].size, int(history.size()));
+
+    const Evaluation evaluation = evaluate(phRun(1, next), targets, channels);
+    QCOMPARE(evaluation.rules[0][ResultRules::PH], rules);
+}
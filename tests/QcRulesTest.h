@@ -0,0 +1,20 @@
+#ifndef QCRULESTEST_H
+#define QCRULESTEST_H
+
+#include <QObject>
+
+class QcRulesTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testChannelRules_data();
+    void testChannelRules();
+    void testAcrossLevels_data();
+    void testAcrossLevels();
+    void testUncontrolled();
+    void testReplay_data();
+    void testReplay();
+};
+
+#endif // QCRULESTEST_H
@@ -0,0 +1,174 @@
+#include "QuantileSketchTest.h"
+#include "QuantileSketch.h"
+
+#include <QtTest/QtTest>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace {
+// Ranks are documented to be off by about 1.7/k of the count
+const double MAX_RANK_ERROR = 0.01;
+
+QList<float> normalValues(int count, float mean, float sd)
+{
+    std::mt19937 generator(42);
+    std::normal_distribution<float> distribution(mean, sd);
+    QList<float> values;
+    values.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        values.append(distribution(generator));
+    }
+    return values;
+}
+
+QList<float> exponentialValues(int count, float mean)
+{
+    std::mt19937 generator(7);
+    std::exponential_distribution<float> distribution(1.0f / mean);
+    QList<float> values;
+    values.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        values.append(distribution(generator));
+    }
+    return values;
+}
+
+// 1 to count, in a scrambled order
+QList<float> permutation(int count)
+{
+    QList<float> values;
+    values.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        values.append(float((qint64(i) * 7919) % count + 1));
+    }
+    return values;
+}
+
+// How far q is from the range of ranks the estimate holds in the sorted
+// values, as a fraction of the count
+double rankError(const QList<float> &sorted, double q, float estimate)
+{
+    const double low = double(std::lower_bound(sorted.cbegin(), sorted.cend(), estimate) - sorted.cbegin()) / sorted.size();
+    const double high = double(std::upper_bound(sorted.cbegin(), sorted.cend(), estimate) - sorted.cbegin()) / sorted.size();
+    return q < low ? low - q : (q > high ? q - high : 0.0);
+}
+
+double maxRankError(const QuantileSketch &sketch, QList<float> values)
+{
+    std::sort(values.begin(), values.end());
+    double worst = 0.0;
+    for (int percent = 1; percent < 100; ++percent) {
+        const double q = percent / 100.0;
+        worst = std::max(worst, rankError(values, q, sketch.quantile(q)));
+    }
+    return worst;
+}
+}
+
+void QuantileSketchTest::testEmpty()
+{
+    QuantileSketch sketch;
+    QVERIFY(sketch.isEmpty());
+    QCOMPARE(sketch.count(), quint64(0));
+    QVERIFY(std::isnan(sketch.quantile(0.5)));
+    QVERIFY(std::isnan(sketch.min()));
+
+    // Missing values are not counted
+    sketch.add(std::numeric_limits<float>::quiet_NaN());
+    QVERIFY(sketch.isEmpty());
+
+    QuantileSketch other;
+    sketch.merge(other);
+    QVERIFY(sketch.isEmpty());
+}
+
+void QuantileSketchTest::testExactBeforeCompaction()
+{
+    const QList<float> values = permutation(100);
+    QuantileSketch sketch;
+    for (float value : values) {
+        sketch.add(value);
+    }
+    QCOMPARE(sketch.count(), quint64(100));
+    QCOMPARE(sketch.min(), 1.0f);
+    QCOMPARE(sketch.max(), 100.0f);
+    QCOMPARE(sketch.quantile(0.0), 1.0f);
+    QCOMPARE(sketch.quantile(0.01), 1.0f);
+    QCOMPARE(sketch.quantile(0.5), 50.0f);
+    QCOMPARE(sketch.quantile(0.505), 51.0f);
+    QCOMPARE(sketch.quantile(0.95), 95.0f);
+    QCOMPARE(sketch.quantile(1.0), 100.0f);
+}
+
+void QuantileSketchTest::testRankError_data()
+{
+    QTest::addColumn<QList<float>>("values");
+
+    QTest::newRow("normal pH, 1000") << normalValues(1000, 7.4f, 0.05f);
+    QTest::newRow("normal pH, 200000") << normalValues(200000, 7.4f, 0.05f);
+    QTest::newRow("exponential lactate, 200000") << exponentialValues(200000, 1.5f);
+    QTest::newRow("uniform, 200000") << permutation(200000);
+}
+
+void QuantileSketchTest::testRankError()
+{
+    QFETCH(QList<float>, values);
+
+    QuantileSketch sketch;
+    for (float value : values) {
+        sketch.add(value);
+    }
+    QCOMPARE(sketch.count(), quint64(values.size()));
+    QCOMPARE(sketch.min(), *std::min_element(values.cbegin(), values.cend()));
+    QCOMPARE(sketch.max(), *std::max_element(values.cbegin(), values.cend()));
+
+    const double error = maxRankError(sketch, values);
+    QVERIFY2(error <= MAX_RANK_ERROR, qPrintable(QString("rank error %1").arg(error)));
+
+    // Compaction keeps a few k values, however many went in
+    QVERIFY(sketch.serialize().size() < qsizetype(4 * QuantileSketch::DEFAULT_K * sizeof(float)));
+}
+
+void QuantileSketchTest::testMerge()
+{
+    const QList<float> values = normalValues(200000, 140.0f, 4.0f);
+    QuantileSketch parts[3];
+    for (qsizetype i = 0; i < values.size(); ++i) {
+        parts[i % 3].add(values.at(i));
+    }
+
+    QuantileSketch merged;
+    for (const QuantileSketch &part : parts) {
+        merged.merge(part);
+    }
+    QCOMPARE(merged.count(), quint64(values.size()));
+    QCOMPARE(merged.min(), *std::min_element(values.cbegin(), values.cend()));
+    QCOMPARE(merged.max(), *std::max_element(values.cbegin(), values.cend()));
+    const double error = maxRankError(merged, values);
+    QVERIFY2(error <= MAX_RANK_ERROR, qPrintable(QString("rank error %1").arg(error)));
+}
+
+void QuantileSketchTest::testSerialize()
+{
+    QuantileSketch sketch;
+    for (float value : exponentialValues(50000, 2.0f)) {
+        sketch.add(value);
+    }
+
+    QuantileSketch restored;
+    QVERIFY(restored.deserialize(sketch.serialize()));
+    QCOMPARE(restored.count(), sketch.count());
+    QCOMPARE(restored.min(), sketch.min());
+    QCOMPARE(restored.max(), sketch.max());
+    for (int percent = 0; percent <= 100; percent += 5) {
+        QCOMPARE(restored.quantile(percent / 100.0), sketch.quantile(percent / 100.0));
+    }
+
+    QVERIFY(!restored.deserialize(QByteArray("not a sketch")));
+    QVERIFY(restored.isEmpty());
+    QVERIFY(!restored.deserialize(sketch.serialize().left(40)));
+    QVERIFY(restored.isEmpty());
+}
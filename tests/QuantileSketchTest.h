@@ -0,0 +1,19 @@
+#ifndef QUANTILESKETCHTEST_H
+#define QUANTILESKETCHTEST_H
+
+#include <QObject>
+
+class QuantileSketchTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testEmpty();
+    void testExactBeforeCompaction();
+    void testRankError_data();
+    void testRankError();
+    void testMerge();
+    void testSerialize();
+};
+
+#endif // QUANTILESKETCHTEST_H
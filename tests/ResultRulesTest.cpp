@@ -0,0 +1,158 @@
+#include "ResultRulesTest.h"
+#include "ResultRules.h"
+
+#include <QtTest/QtTest>
+
+#include <limits>
+
+using namespace ResultRules;
+
+namespace {
+const float NONE = std::numeric_limits<float>::quiet_NaN();
+const qint32 ADULT_DAYS = 18 * 365;
+
+// Potassium ranges that overlap by age band, specimen and sex, and a
+// sodium range for men only
+QList<RangeRule> testRules()
+{
+    QList<RangeRule> rules;
+    RangeRule all{K};
+    all.limits = {3.5f, 5.1f, 2.5f, 6.5f};
+    rules.append(all);
+
+    RangeRule neonate{K};
+    neonate.minAgeDays = 0;
+    neonate.maxAgeDays = 28;
+    neonate.limits = {3.7f, 5.9f, NONE, NONE};
+    rules.append(neonate);
+
+    RangeRule infant{K};
+    infant.minAgeDays = 0;
+    infant.maxAgeDays = 365;
+    infant.limits = {3.6f, 5.5f, NONE, NONE};
+    rules.append(infant);
+
+    RangeRule venous{K, Venous};
+    venous.limits = {NONE, 5.3f, NONE, NONE};
+    rules.append(venous);
+
+    RangeRule adultWoman{K, Arterial, Female};
+    adultWoman.minAgeDays = ADULT_DAYS;
+    adultWoman.limits = {3.4f, NONE, NONE, NONE};
+    rules.append(adultWoman);
+
+    RangeRule men{Na, AnySpecimen, Male};
+    men.limits = {136.0f, 145.0f, 120.0f, 160.0f};
+    rules.append(men);
+    return rules;
+}
+}
+
+void ResultRulesTest::testLookup_data()
+{
+    QTest::addColumn<int>("analyte");
+    QTest::addColumn<int>("specimen");
+    QTest::addColumn<int>("sex");
+    QTest::addColumn<int>("ageDays");
+    QTest::addColumn<float>("low");
+    QTest::addColumn<float>("high");
+    QTest::addColumn<float>("criticalLow");
+    QTest::addColumn<float>("criticalHigh");
+
+    QTest::newRow("adult man") << int(K) << int(Arterial) << int(Male) << 40 * 365
+        << 3.5f << 5.1f << 2.5f << 6.5f;
+    QTest::newRow("unknown age takes the all-ages rule") << int(K) << int(Arterial) << int(Male) << -1
+        << 3.5f << 5.1f << 2.5f << 6.5f;
+    // Neonate and infant bands overlap; the narrower one wins, and the
+    // critical limits they leave out come from the all-ages rule
+    QTest::newRow("neonate") << int(K) << int(Arterial) << int(Male) << 0
+        << 3.7f << 5.9f << 2.5f << 6.5f;
+    QTest::newRow("last neonate day") << int(K) << int(Arterial) << int(Male) << 27
+        << 3.7f << 5.9f << 2.5f << 6.5f;
+    QTest::newRow("first infant day") << int(K) << int(Arterial) << int(Male) << 28
+        << 3.6f << 5.5f << 2.5f << 6.5f;
+    QTest::newRow("last infant day") << int(K) << int(Arterial) << int(Male) << 364
+        << 3.6f << 5.5f << 2.5f << 6.5f;
+    QTest::newRow("one year") << int(K) << int(Arterial) << int(Male) << 365
+        << 3.5f << 5.1f << 2.5f << 6.5f;
+    // A specimen rule beats an age band, limit by limit
+    QTest::newRow("venous neonate") << int(K) << int(Venous) << int(Female) << 10
+        << 3.7f << 5.3f << 2.5f << 6.5f;
+    QTest::newRow("venous adult") << int(K) << int(Venous) << int(Male) << 40 * 365
+        << 3.5f << 5.3f << 2.5f << 6.5f;
+    QTest::newRow("capillary takes the any-specimen rule") << int(K) << int(Capillary) << int(Male) << 40 * 365
+        << 3.5f << 5.1f << 2.5f << 6.5f;
+    QTest::newRow("adult woman") << int(K) << int(Arterial) << int(Female) << ADULT_DAYS
+        << 3.4f << 5.1f << 2.5f << 6.5f;
+    QTest::newRow("day before adulthood") << int(K) << int(Arterial) << int(Female) << ADULT_DAYS - 1
+        << 3.5f << 5.1f << 2.5f << 6.5f;
+    QTest::newRow("woman of unknown age") << int(K) << int(Arterial) << int(Female) << -1
+        << 3.5f << 5.1f << 2.5f << 6.5f;
+    QTest::newRow("venous adult woman") << int(K) << int(Venous) << int(Female) << ADULT_DAYS
+        << 3.5f << 5.3f << 2.5f << 6.5f;
+    QTest::newRow("adult of unknown sex") << int(K) << int(Arterial) << int(AnySex) << ADULT_DAYS
+        << 3.5f << 5.1f << 2.5f << 6.5f;
+    QTest::newRow("sex rule matches") << int(Na) << int(Arterial) << int(Male) << 40 * 365
+        << 136.0f << 145.0f << 120.0f << 160.0f;
+    // No row matches: every limit is missing, which never flags
+    QTest::newRow("sex rule does not match") << int(Na) << int(Arterial) << int(Female) << 40 * 365
+        << NONE << NONE << NONE << NONE;
+    QTest::newRow("unknown sex is not male") << int(Na) << int(Venous) << int(AnySex) << 40 * 365
+        << NONE << NONE << NONE << NONE;
+    QTest::newRow("analyte without rules") << int(Glucose) << int(Arterial) << int(Male) << 40 * 365
+        << NONE << NONE << NONE << NONE;
+}
+
+void ResultRulesTest::testLookup()
+{
+    QFETCH(int, analyte);
+    QFETCH(int, specimen);
+    QFETCH(int, sex);
+    QFETCH(int, ageDays);
+    QFETCH(float, low);
+    QFETCH(float, high);
+    QFETCH(float, criticalLow);
+    QFETCH(float, criticalHigh);
+
+    const QList<RangeRule> rules = testRules();
+    const RangeTable table(rules, 7);
+    QCOMPARE(table.revision(), 7);
+    QCOMPARE(table.ruleCount(), int(rules.size()));
+
+    Demographics patient;
+    patient.specimen = Specimen(specimen);
+    patient.sex = Sex(sex);
+    patient.ageDays = ageDays;
+    const Limits &limits = table.lookup(Analyte(analyte), patient);
+    QCOMPARE(limits.low, low);
+    QCOMPARE(limits.high, high);
+    QCOMPARE(limits.criticalLow, criticalLow);
+    QCOMPARE(limits.criticalHigh, criticalHigh);
+}
+
+void ResultRulesTest::testEmptyTable()
+{
+    const RangeTable table;
+    QCOMPARE(table.ruleCount(), 0);
+    const Limits &limits = table.lookup(PH, demographics("arterial", "M", 10000));
+    QVERIFY(qIsNaN(limits.low));
+    QVERIFY(qIsNaN(limits.high));
+    QVERIFY(qIsNaN(limits.criticalLow));
+    QVERIFY(qIsNaN(limits.criticalHigh));
+}
+
+void ResultRulesTest::testDemographics()
+{
+    Demographics patient = demographics("", "", QVariant());
+    QCOMPARE(patient.specimen, Arterial);
+    QCOMPARE(patient.sex, AnySex);
+    QCOMPARE(patient.ageDays, -1);
+
+    patient = demographics("Venous", "female", 400);
+    QCOMPARE(patient.specimen, Venous);
+    QCOMPARE(patient.sex, Female);
+    QCOMPARE(patient.ageDays, 400);
+
+    QCOMPARE(sexFromString(" m "), Male);
+    QCOMPARE(sexFromString("U"), AnySex);
+}
@@ -0,0 +1,17 @@
+#ifndef RESULTRULESTEST_H
+#define RESULTRULESTEST_H
+
+#include <QObject>
+
+class ResultRulesTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testLookup_data();
+    void testLookup();
+    void testEmptyTable();
+    void testDemographics();
+};
+
+#endif // RESULTRULESTEST_H
@@ -0,0 +1,115 @@
+#include "WaveformCodecTest.h"
+#include "WaveformCodec.h"
+
+#include <QtTest/QtTest>
+
+#include <cmath>
+#include <limits>
+
+Q_DECLARE_METATYPE(Waveform)
+
+namespace {
+const qint32 MIN = std::numeric_limits<qint32>::min();
+const qint32 MAX = std::numeric_limits<qint32>::max();
+
+Waveform waveform(int samplePeriodUs, const QList<Waveform::Channel> &channels)
+{
+    Waveform result;
+    result.samplePeriodUs = samplePeriodUs;
+    result.channels = channels;
+    return result;
+}
+
+// A slow electrode settling curve with a little noise, as decimated
+QList<qint32> settlingTrace(int points)
+{
+    QList<qint32> trace;
+    for (int i = 0; i < points; ++i) {
+        trace.append(qint32(-120000 + 35000 * (1.0 - std::exp(-i / 40.0))) + (i * 7919) % 11 - 5);
+    }
+    return trace;
+}
+}
+
+void WaveformCodecTest::testRoundTrip_data()
+{
+    QTest::addColumn<Waveform>("original");
+    QTest::addColumn<bool>("compress");
+
+    const QList<Waveform> waveforms = {
+        waveform(0, {}),
+        waveform(10000, {}),
+        waveform(10000, {{"pH", {}}, {"pCO2", {}}}),
+        waveform(10000, {{"pH", {42}}}),
+        waveform(10000, {{"pH", settlingTrace(600)}, {"pCO2", settlingTrace(450)}, {"Na", {}}}),
+        // Deltas that wrap in 32 bits, and values at both limits
+        waveform(250, {{"extremes", {MIN, MAX, MIN, 0, MAX, MAX, -1, MIN, 1, MAX}}}),
+        waveform(250, {{"flat", QList<qint32>(1000, MIN)}}),
+        waveform(1, {{QString::fromUtf8("pO₂ µV"), {-1, 0, 1, -64, 63, -65, 64}}}),
+    };
+    const char *const names[] = {
+        "no channels", "no channels with period", "empty traces", "one point", "settling traces",
+        "extreme deltas", "flat at minimum", "UTF-8 name"
+    };
+    for (qsizetype i = 0; i < waveforms.size(); ++i) {
+        QTest::addRow("%s, raw", names[i]) << waveforms.at(i) << false;
+        QTest::addRow("%s, compressed", names[i]) << waveforms.at(i) << true;
+    }
+}
+
+void WaveformCodecTest::testRoundTrip()
+{
+    QFETCH(Waveform, original);
+    QFETCH(bool, compress);
+
+    const QByteArray blob = WaveformCodec::encode(original, compress);
+    QVERIFY(!blob.isEmpty());
+    if (!compress) {
+        QCOMPARE(quint8(blob.at(0)), quint8(WaveformCodec::Version1));
+    }
+
+    Waveform decoded;
+    decoded.samplePeriodUs = -1;
+    decoded.channels.append(Waveform::Channel{"stale", {1, 2, 3}});
+    QVERIFY(WaveformCodec::decode(blob, decoded));
+    QCOMPARE(decoded.samplePeriodUs, original.samplePeriodUs);
+    QCOMPARE(decoded.isEmpty(), original.isEmpty());
+    QCOMPARE(decoded.channels.size(), original.channels.size());
+    for (qsizetype i = 0; i < original.channels.size(); ++i) {
+        QCOMPARE(decoded.channels.at(i).name, original.channels.at(i).name);
+        QCOMPARE(decoded.channels.at(i).microvolts, original.channels.at(i).microvolts);
+    }
+}
+
+void WaveformCodecTest::testSmallDeltasTakeOneByte()
+{
+    // Deltas in [-64, 63] zigzag to a single varint byte
+    QList<qint32> trace = {0};
+    for (int i = 1; i < 1000; ++i) {
+        trace.append(trace.last() + (i % 2 ? 63 : -64));
+    }
+    const QByteArray blob = WaveformCodec::encode(waveform(10000, {{"K", trace}}), false);
+    // flags, period (2 bytes), channel count, name length, name, point count (2 bytes)
+    QCOMPARE(blob.size(), qsizetype(1 + 2 + 1 + 1 + 1 + 2) + trace.size());
+
+    trace.append(trace.last() + 64);
+    QCOMPARE(WaveformCodec::encode(waveform(10000, {{"K", trace}}), false).size(), blob.size() + 2);
+}
+
+void WaveformCodecTest::testRejectsCorruptBlobs()
+{
+    const QByteArray blob = WaveformCodec::encode(waveform(10000, {{"pH", settlingTrace(100)}}), false);
+    Waveform decoded;
+
+    QVERIFY(!WaveformCodec::decode(QByteArray(), decoded));
+    QVERIFY(decoded.isEmpty());
+    for (qsizetype size = 1; size < blob.size(); ++size) {
+        QVERIFY2(!WaveformCodec::decode(blob.left(size), decoded), qPrintable(QString::number(size)));
+    }
+    QVERIFY(!WaveformCodec::decode(blob + '\0', decoded));
+
+    QByteArray version = blob;
+    version[0] = char(0x02);
+    QVERIFY(!WaveformCodec::decode(version, decoded));
+    QVERIFY(decoded.isEmpty());
+}
@@ -0,0 +1,17 @@
+#ifndef WAVEFORMCODECTEST_H
+#define WAVEFORMCODECTEST_H
+
+#include <QObject>
+
+class WaveformCodecTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testRoundTrip_data();
+    void testRoundTrip();
+    void testSmallDeltasTakeOneByte();
+    void testRejectsCorruptBlobs();
+};
+
+#endif // WAVEFORMCODECTEST_H
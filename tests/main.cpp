@@ -0,0 +1,51 @@
+#include <QCoreApplication>
+#include <QtTest/QtTest>
+
+#include "AcidBaseInterpreterTest.h"
+#include "DerivedParametersTest.h"
+#include "ResultRulesTest.h"
+#include "WaveformCodecTest.h"
+#include "QuantileSketchTest.h"
+#include "HL7OutboundQueueTest.h"
+#include "QcRulesTest.h"
+#include "PatientResultCacheTest.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    int status = 0;
+    {
+        AcidBaseInterpreterTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        DerivedParametersTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        ResultRulesTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        WaveformCodecTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        QuantileSketchTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        HL7OutboundQueueTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        QcRulesTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        PatientResultCacheTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    return status;
+}